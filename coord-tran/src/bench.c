@@ -0,0 +1,539 @@
+/**
+ * bench - Benchmarks for the coordinate transformation library
+ *
+ * Compares the throughput of the scalar and batch conversions for a radar
+ * scan from one site, with the spherical and WGS-84 models, and the error
+ * of the sphere over that scan; then the same scan through a polar lookup
+ * table, and its interpolation error. Then times single calls, including
+ * the special cases, with warmup and repetitions, optionally writing the
+ * results as JSON and comparing them with a baseline from an earlier run.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "lib.h"
+#include "polar.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_GATES 1000
+#define NUM_AZIMUTHS 1000
+#define NUM_POINTS (NUM_GATES * NUM_AZIMUTHS)
+#define GATE_SPACING 3.0 // Range gate spacing (km)
+
+// Radar site: Wallops Islands
+#define SITE_LON -75.0
+#define SITE_LAT 37.0
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_result(const char *name, double scalar, double batch) {
+  printf("%-10s %14.0f %14.0f %8.2f\n", name, NUM_POINTS / scalar,
+         NUM_POINTS / batch, scalar / batch);
+}
+
+typedef int (*r2g_fn)(double, double, double, double, double *, double *);
+typedef int (*r2g_batch_fn)(size_t, const double *restrict,
+                            const double *restrict, double, double,
+                            double *restrict, double *restrict);
+typedef int (*g2r_fn)(double *, double *, double, double, double, double);
+typedef int (*g2r_batch_fn)(size_t, double *restrict, double *restrict,
+                            double, double, const double *restrict,
+                            const double *restrict);
+
+/**
+ * Time r2g from the scan to (lon, lat), scalar then batch (into out1,
+ * out2), and check that both give the same results
+ */
+static int bench_r2g(const char *name, r2g_fn scalar_fn,
+                     r2g_batch_fn batch_fn, const double *range,
+                     const double *bearing, double *lon, double *lat,
+                     double *out1, double *out2) {
+  double t0 = now();
+  for (int i = 0; i < NUM_POINTS; i++) {
+    scalar_fn(range[i], bearing[i], SITE_LON, SITE_LAT, &lon[i], &lat[i]);
+  }
+  double scalar = now() - t0;
+  t0 = now();
+  batch_fn(NUM_POINTS, range, bearing, SITE_LON, SITE_LAT, out1, out2);
+  double batch = now() - t0;
+  print_result(name, scalar, batch);
+  if (memcmp(lon, out1, NUM_POINTS * sizeof(double)) != 0 ||
+      memcmp(lat, out2, NUM_POINTS * sizeof(double)) != 0) {
+    fprintf(stderr, "Error: %s batch results differ.\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Time g2r from (lon, lat) to (range, bearing), scalar then batch (into
+ * out1, out2), and check that both give the same results
+ */
+static int bench_g2r(const char *name, g2r_fn scalar_fn,
+                     g2r_batch_fn batch_fn, double *range, double *bearing,
+                     const double *lon, const double *lat, double *out1,
+                     double *out2) {
+  double t0 = now();
+  for (int i = 0; i < NUM_POINTS; i++) {
+    scalar_fn(&range[i], &bearing[i], SITE_LON, SITE_LAT, lon[i], lat[i]);
+  }
+  double scalar = now() - t0;
+  t0 = now();
+  batch_fn(NUM_POINTS, out1, out2, SITE_LON, SITE_LAT, lon, lat);
+  double batch = now() - t0;
+  print_result(name, scalar, batch);
+  if (memcmp(range, out1, NUM_POINTS * sizeof(double)) != 0 ||
+      memcmp(bearing, out2, NUM_POINTS * sizeof(double)) != 0) {
+    fprintf(stderr, "Error: %s batch results differ.\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+static void make_scan(double *range, double *bearing) {
+  // One scan: every range gate at every azimuth
+  for (int i = 0; i < NUM_AZIMUTHS; i++) {
+    for (int j = 0; j < NUM_GATES; j++) {
+      range[i * NUM_GATES + j] = (j + 1) * GATE_SPACING;
+      bearing[i * NUM_GATES + j] = i * (360.0 / NUM_AZIMUTHS);
+    }
+  }
+}
+
+static int bench_scan(void) {
+  double *range = malloc(NUM_POINTS * sizeof(double));
+  double *bearing = malloc(NUM_POINTS * sizeof(double));
+  double *lon = malloc(NUM_POINTS * sizeof(double));
+  double *lat = malloc(NUM_POINTS * sizeof(double));
+  double *lon_wgs84 = malloc(NUM_POINTS * sizeof(double));
+  double *lat_wgs84 = malloc(NUM_POINTS * sizeof(double));
+  double *out1 = malloc(NUM_POINTS * sizeof(double));
+  double *out2 = malloc(NUM_POINTS * sizeof(double));
+  if (!range || !bearing || !lon || !lat || !lon_wgs84 || !lat_wgs84 ||
+      !out1 || !out2) {
+    fprintf(stderr, "Error: Allocation failed.\n");
+    return 1;
+  }
+
+  make_scan(range, bearing);
+  printf("%d points from (%.1f, %.1f), out to %.0f km\n", NUM_POINTS,
+         SITE_LON, SITE_LAT, NUM_GATES * GATE_SPACING);
+  printf("%-10s %14s %14s %8s\n", "case", "scalar(pt/s)", "batch(pt/s)",
+         "speedup");
+
+  // Scan to geodetic and back, with each model
+  int status = bench_r2g("r2g", r2g, r2g_batch, range, bearing, lon, lat,
+                         out1, out2);
+  status |= bench_r2g("r2g_wgs84", r2g_wgs84, r2g_wgs84_batch, range,
+                      bearing, lon_wgs84, lat_wgs84, out1, out2);
+  status |= bench_g2r("g2r", g2r, g2r_batch, range, bearing, lon, lat, out1,
+                      out2);
+  status |= bench_g2r("g2r_wgs84", g2r_wgs84, g2r_wgs84_batch, range,
+                      bearing, lon_wgs84, lat_wgs84, out1, out2);
+  if (status != 0) {
+    return 1;
+  }
+
+  // Error of the sphere against WGS-84 over the same scan: where r2g puts
+  // each gate, and the range and bearing g2r gives for the true position
+  make_scan(range, bearing);
+  double max_position = 0.0, max_range = 0.0, max_bearing = 0.0;
+  for (int i = 0; i < NUM_POINTS; i++) {
+    double r, b;
+    g2r_wgs84(&r, &b, lon[i], lat[i], lon_wgs84[i], lat_wgs84[i]);
+    max_position = fmax(max_position, r);
+  }
+  g2r_batch(NUM_POINTS, out1, out2, SITE_LON, SITE_LAT, lon_wgs84,
+            lat_wgs84);
+  for (int i = 0; i < NUM_POINTS; i++) {
+    double db = fabs(out2[i] - bearing[i]);
+    max_range = fmax(max_range, fabs(out1[i] - range[i]));
+    max_bearing = fmax(max_bearing, fmin(db, 360.0 - db));
+  }
+  printf("sphere vs WGS-84: r2g position error up to %.3f km, g2r range "
+         "error up to %.3f km, bearing up to %.4f deg\n",
+         max_position, max_range, max_bearing);
+
+  // Polar lookup table of the scan: node fetches instead of r2g, and
+  // bilinear interpolation at random off-grid samples
+  double t0 = now();
+  struct polar_table table;
+  if (polar_table_build(&table, SITE_LON, SITE_LAT, GATE_SPACING,
+                        GATE_SPACING, NUM_GATES, NUM_AZIMUTHS,
+                        EARTH_WGS84) != 0) {
+    return 1;
+  }
+  printf("polar table: built in %.3f s, interpolation error up to %.4f km\n",
+         now() - t0, polar_table_error(&table));
+  printf("%-10s %14s %14s %8s\n", "case", "r2g(pt/s)", "table(pt/s)",
+         "speedup");
+
+  make_scan(range, bearing);
+  t0 = now();
+  r2g_wgs84_batch(NUM_POINTS, range, bearing, SITE_LON, SITE_LAT, lon, lat);
+  double scalar = now() - t0;
+  t0 = now();
+  for (uint32_t a = 0; a < NUM_AZIMUTHS; a++) {
+    for (uint32_t g = 0; g < NUM_GATES; g++) {
+      size_t i = (size_t)a * NUM_GATES + g;
+      polar_table_node(&table, g, a, &out1[i], &out2[i]);
+    }
+  }
+  double batch = now() - t0;
+  print_result("nodes", scalar, batch);
+  if (memcmp(lon, out1, NUM_POINTS * sizeof(double)) != 0 ||
+      memcmp(lat, out2, NUM_POINTS * sizeof(double)) != 0) {
+    fprintf(stderr, "Error: polar table nodes differ from r2g.\n");
+    return 1;
+  }
+
+  srand(1);
+  for (int i = 0; i < NUM_POINTS; i++) {
+    double u = rand() / (RAND_MAX + 1.0);
+    range[i] = GATE_SPACING * (1 + (NUM_GATES - 1) * u);
+    bearing[i] = 360.0 * (rand() / (RAND_MAX + 1.0));
+  }
+  t0 = now();
+  for (int i = 0; i < NUM_POINTS; i++) {
+    r2g_wgs84(range[i], bearing[i], SITE_LON, SITE_LAT, &lon[i], &lat[i]);
+  }
+  scalar = now() - t0;
+  t0 = now();
+  for (int i = 0; i < NUM_POINTS; i++) {
+    polar_table_lookup(&table, range[i], bearing[i], &out1[i], &out2[i]);
+  }
+  batch = now() - t0;
+  print_result("bilinear", scalar, batch);
+  polar_table_free(&table);
+
+  free(range);
+  free(bearing);
+  free(lon);
+  free(lat);
+  free(lon_wgs84);
+  free(lat_wgs84);
+  free(out1);
+  free(out2);
+  return 0;
+}
+
+// Microbenchmarks: each repetition makes enough calls to take at least
+// MICRO_MIN_TIME; the statistics are over the time per call of the
+// repetitions after the warmup ones
+#define MICRO_WARMUP 3
+#define MICRO_REPS 21
+#define MICRO_MIN_TIME 0.01 // Minimum time of a repetition (s)
+#define MAX_MICRO 32
+
+struct micro_result {
+  char name[32];
+  double median; // Time per call (ns)
+  double mad;    // Median absolute deviation from the median (ns)
+  double min;    // Fastest repetition (ns)
+  double max;    // Slowest repetition (ns)
+  size_t calls;  // Calls per repetition
+};
+
+// Make `n` calls of the function under test
+typedef void (*micro_fn)(size_t n);
+
+// Inputs cycled through by the microbenchmarks, and a sink for the outputs
+#define NUM_INPUTS 64
+static double in_a[NUM_INPUTS], in_b[NUM_INPUTS];
+static volatile double sink;
+
+static void micro_g2r(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double r, b;
+    g2r(&r, &b, SITE_LON, SITE_LAT, in_a[i % NUM_INPUTS],
+        in_b[i % NUM_INPUTS]);
+    sink = r + b;
+  }
+}
+
+static void micro_g2r_same_point(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double r, b;
+    g2r(&r, &b, in_a[i % NUM_INPUTS], in_b[i % NUM_INPUTS],
+        in_a[i % NUM_INPUTS], in_b[i % NUM_INPUTS]);
+    sink = r + b;
+  }
+}
+
+static void micro_g2r_pole(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double r, b;
+    g2r(&r, &b, 0.0, 90.0, in_a[i % NUM_INPUTS], in_b[i % NUM_INPUTS]);
+    sink = r + b;
+  }
+}
+
+static void micro_g2r_pole_to_pole(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double r, b;
+    g2r(&r, &b, in_a[i % NUM_INPUTS], 90.0, 0.0, i % 2 ? 90.0 : -90.0);
+    sink = r + b;
+  }
+}
+
+static void micro_r2g(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double lon, lat;
+    r2g(in_a[i % NUM_INPUTS] * 30.0, in_b[i % NUM_INPUTS] * 4.0, SITE_LON,
+        SITE_LAT, &lon, &lat);
+    sink = lon + lat;
+  }
+}
+
+static void micro_r2g_zero_range(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double lon, lat;
+    r2g(0.0, in_b[i % NUM_INPUTS] * 4.0, in_a[i % NUM_INPUTS],
+        in_b[i % NUM_INPUTS], &lon, &lat);
+    sink = lon + lat;
+  }
+}
+
+static void micro_r2g_pole(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double lon, lat;
+    r2g(in_a[i % NUM_INPUTS] * 30.0, in_b[i % NUM_INPUTS] * 4.0, 0.0,
+        i % 2 ? 90.0 : -90.0, &lon, &lat);
+    sink = lon + lat;
+  }
+}
+
+static void micro_r2g_antipode(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double lon, lat;
+    r2g(EARTH_RADIUS * M_PI, in_b[i % NUM_INPUTS] * 4.0,
+        in_a[i % NUM_INPUTS], 90.0, &lon, &lat);
+    sink = lon + lat;
+  }
+}
+
+static void micro_g2r_wgs84(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double r, b;
+    g2r_wgs84(&r, &b, SITE_LON, SITE_LAT, in_a[i % NUM_INPUTS],
+              in_b[i % NUM_INPUTS]);
+    sink = r + b;
+  }
+}
+
+static void micro_r2g_wgs84(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double lon, lat;
+    r2g_wgs84(in_a[i % NUM_INPUTS] * 30.0, in_b[i % NUM_INPUTS] * 4.0,
+              SITE_LON, SITE_LAT, &lon, &lat);
+    sink = lon + lat;
+  }
+}
+
+static const struct {
+  const char *name;
+  micro_fn fn;
+} micro_cases[] = {
+    {"g2r", micro_g2r},
+    {"g2r_same_point", micro_g2r_same_point},
+    {"g2r_pole", micro_g2r_pole},
+    {"g2r_pole_to_pole", micro_g2r_pole_to_pole},
+    {"r2g", micro_r2g},
+    {"r2g_zero_range", micro_r2g_zero_range},
+    {"r2g_pole", micro_r2g_pole},
+    {"r2g_antipode", micro_r2g_antipode},
+    {"g2r_wgs84", micro_g2r_wgs84},
+    {"r2g_wgs84", micro_r2g_wgs84},
+};
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double time_calls(micro_fn fn, size_t n) {
+  double t0 = now();
+  fn(n);
+  return now() - t0;
+}
+
+static void micro_run(struct micro_result *res, const char *name,
+                      micro_fn fn) {
+  // Double the calls until a repetition is long enough (also warms up)
+  size_t n = 1;
+  while (time_calls(fn, n) < MICRO_MIN_TIME) {
+    n *= 2;
+  }
+  for (int i = 0; i < MICRO_WARMUP; i++) {
+    time_calls(fn, n);
+  }
+
+  double t[MICRO_REPS], dev[MICRO_REPS];
+  for (int i = 0; i < MICRO_REPS; i++) {
+    t[i] = time_calls(fn, n) / n * 1e9;
+  }
+  qsort(t, MICRO_REPS, sizeof(double), compare_doubles);
+  double median = t[MICRO_REPS / 2];
+  for (int i = 0; i < MICRO_REPS; i++) {
+    dev[i] = fabs(t[i] - median);
+  }
+  qsort(dev, MICRO_REPS, sizeof(double), compare_doubles);
+
+  snprintf(res->name, sizeof(res->name), "%s", name);
+  res->median = median;
+  res->mad = dev[MICRO_REPS / 2];
+  res->min = t[0];
+  res->max = t[MICRO_REPS - 1];
+  res->calls = n;
+}
+
+static int write_json(const char *filename, const struct micro_result *res,
+                      int n) {
+  FILE *fp = fopen(filename, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "Error: Cannot open %s for writing.\n", filename);
+    return 1;
+  }
+  // One result per line, so baselines can be read back without a parser
+  fprintf(fp, "{\n  \"unit\": \"ns/call\",\n  \"results\": [\n");
+  for (int i = 0; i < n; i++) {
+    fprintf(fp,
+            "    {\"name\": \"%s\", \"median\": %.3f, \"mad\": %.3f, "
+            "\"min\": %.3f, \"max\": %.3f, \"calls\": %zu}%s\n",
+            res[i].name, res[i].median, res[i].mad, res[i].min, res[i].max,
+            res[i].calls, i < n - 1 ? "," : "");
+  }
+  fprintf(fp, "  ]\n}\n");
+  return fclose(fp) != 0;
+}
+
+// Read the results of a write_json file; returns the number read, or -1
+static int read_json(const char *filename, struct micro_result *res,
+                     int max) {
+  FILE *fp = fopen(filename, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+  char line[256];
+  int n = 0;
+  while (n < max && fgets(line, sizeof(line), fp) != NULL) {
+    struct micro_result *r = &res[n];
+    if (sscanf(line, " {\"name\": \"%31[^\"]\", \"median\": %lf, \"mad\": %lf",
+               r->name, &r->median, &r->mad) == 3) {
+      n++;
+    }
+  }
+  fclose(fp);
+  return n;
+}
+
+static void print_usage(const char *progname) {
+  printf("Usage: %s [options]\n", progname);
+  printf("Options:\n");
+  printf("  -m|--micro-only        Only run the microbenchmarks\n");
+  printf("  -j|--json <file>       Write the microbenchmark results as "
+         "JSON\n");
+  printf("  -b|--baseline <file>   Compare with the results of an earlier "
+         "--json run\n");
+  printf("  -t|--threshold <pct>   Slowdown reported as a regression "
+         "(default: 10)\n");
+  printf("  -h|--help              Show this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+  int micro_only = 0;
+  const char *json_file = NULL;
+  const char *baseline_file = NULL;
+  double threshold = 10.0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--micro-only") == 0) {
+      micro_only = 1;
+    } else if ((strcmp(argv[i], "-j") == 0 ||
+                strcmp(argv[i], "--json") == 0) &&
+               i + 1 < argc) {
+      json_file = argv[++i];
+    } else if ((strcmp(argv[i], "-b") == 0 ||
+                strcmp(argv[i], "--baseline") == 0) &&
+               i + 1 < argc) {
+      baseline_file = argv[++i];
+    } else if ((strcmp(argv[i], "-t") == 0 ||
+                strcmp(argv[i], "--threshold") == 0) &&
+               i + 1 < argc) {
+      threshold = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      print_usage(argv[0]);
+      return 0;
+    } else {
+      fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!micro_only && bench_scan() != 0) {
+    return 1;
+  }
+
+  // Points around the site, up to about 1000 km away
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    in_a[i] = SITE_LON + 10.0 * cos(i * 0.7) * (i % 8 + 1) / 8.0;
+    in_b[i] = SITE_LAT + 8.0 * sin(i * 0.7) * (i % 8 + 1) / 8.0;
+  }
+
+  struct micro_result base[MAX_MICRO];
+  int num_base = 0;
+  if (baseline_file != NULL) {
+    num_base = read_json(baseline_file, base, MAX_MICRO);
+    if (num_base < 0) {
+      fprintf(stderr, "Warning: No baseline %s, not comparing.\n",
+              baseline_file);
+      num_base = 0;
+    }
+  }
+
+  const int num_micro = sizeof(micro_cases) / sizeof(micro_cases[0]);
+  struct micro_result res[MAX_MICRO];
+  int regressions = 0;
+  printf("%d repetitions of >= %.0f ms after %d warmup, ns/call\n",
+         MICRO_REPS, MICRO_MIN_TIME * 1e3, MICRO_WARMUP);
+  printf("%-18s %10s %8s %10s %10s %10s\n", "case", "median", "mad", "min",
+         "max", "baseline");
+  for (int i = 0; i < num_micro; i++) {
+    micro_run(&res[i], micro_cases[i].name, micro_cases[i].fn);
+    printf("%-18s %10.2f %8.2f %10.2f %10.2f", res[i].name, res[i].median,
+           res[i].mad, res[i].min, res[i].max);
+
+    // A regression is a slowdown above the threshold and well above the
+    // spread of both runs
+    for (int j = 0; j < num_base; j++) {
+      if (strcmp(base[j].name, res[i].name) == 0) {
+        double change = (res[i].median / base[j].median - 1.0) * 100.0;
+        int slower = change > threshold &&
+                     res[i].median - base[j].median >
+                         3.0 * (res[i].mad + base[j].mad);
+        printf(" %+9.1f%%%s", change, slower ? " REGRESSION" : "");
+        regressions += slower;
+      }
+    }
+    printf("\n");
+  }
+
+  if (json_file != NULL && write_json(json_file, res, num_micro) != 0) {
+    fprintf(stderr, "Error: Failed to write %s.\n", json_file);
+    return 1;
+  }
+  if (regressions > 0) {
+    fprintf(stderr, "Error: %d regressions against %s.\n", regressions,
+            baseline_file);
+    return 1;
+  }
+  return 0;
+}
@@ -5,6 +5,7 @@
  */
 
 #include "lib.h"
+#include "stream.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,15 +16,110 @@ void print_description() {
 }
 
 void print_usage() {
-  printf("Usage: g2r <lon1> <lat1> <lon2> <lat2>\n");
+  printf("Usage: g2r [-e|--sphere] <lon1> <lat1> <lon2> <lat2>\n");
+  printf("       g2r [-e|--sphere] -s|--stream [file]\n");
   printf("  All coordinates should be in decimal degrees.\n");
   printf("  Output is <range> <bearing>\n");
   printf("  with range in kilometers and bearing in decimal degrees.\n\n");
   printf("Options:\n");
-  printf("  -h, --help  Display this help message (must be the only arg).\n\n");
+  printf("  -h, --help           Display this help message (must be the only "
+         "arg).\n");
+  printf("  -e, --wgs84          Use Vincenty's formulae on the WGS-84 "
+         "ellipsoid%s.\n",
+         EARTH_MODEL_DEFAULT == EARTH_WGS84 ? " (default)" : "");
+  printf("      --sphere         Use the haversine formula on a sphere%s.\n",
+         EARTH_MODEL_DEFAULT == EARTH_SPHERE ? " (default)" : "");
+  printf("  -s, --stream [file]  Read one <lon1> <lat1> <lon2> <lat2> record "
+         "per line\n");
+  printf("                       (whitespace- or comma-delimited) from file "
+         "or stdin.\n");
+  printf("                       Invalid records are reported and output as "
+         "\"nan nan\".\n\n");
+}
+
+/* Earth model of the conversions */
+static enum earth_model model = EARTH_MODEL_DEFAULT;
+
+/**
+ * g2r or g2r_wgs84, depending on the model
+ */
+int convert(double *range, double *bearing, double lonInitial,
+            double latInitial, double lonFinal, double latFinal) {
+  if (model == EARTH_WGS84) {
+    return g2r_wgs84(range, bearing, lonInitial, latInitial, lonFinal,
+                     latFinal);
+  }
+  return g2r(range, bearing, lonInitial, latInitial, lonFinal, latFinal);
+}
+
+/**
+ * Check the inputs, returning an error message or NULL if valid
+ */
+const char *validate(double lonInitial, double latInitial, double lonFinal,
+                     double latFinal) {
+  if (lonInitial < -180.0 || lonInitial >= 180.0 || lonFinal < -180.0 ||
+      lonFinal >= 180.0 || latInitial < -90.0 || latInitial > 90.0 ||
+      latFinal < -90.0 || latFinal > 90.0) {
+    return "Invalid coordinates. "
+           "Longitude must be [-180, 180), latitude [-90, 90].";
+  }
+  return NULL;
+}
+
+/**
+ * Convert one streamed record
+ */
+int convert_record(const double in[STREAM_NUM_IN],
+                   double out[STREAM_NUM_OUT], long line) {
+  const char *error = validate(in[0], in[1], in[2], in[3]);
+  if (error != NULL) {
+    fprintf(stderr, "Error: line %ld: %s\n", line, error);
+    return 1;
+  }
+  if (convert(&out[0], &out[1], in[0], in[1], in[2], in[3]) != 0) {
+    fprintf(stderr, "Error: line %ld: Calculation failed.\n", line);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Streaming mode: convert all records from a file or stdin
+ */
+int run_stream(const char *filename) {
+  FILE *in = stdin;
+  if (filename != NULL && strcmp(filename, "-") != 0) {
+    in = fopen(filename, "r");
+    if (in == NULL) {
+      fprintf(stderr, "Error: Cannot open '%s'.\n", filename);
+      return 1;
+    }
+  }
+  static const int decimals[STREAM_NUM_OUT] = {3, 4};
+  long invalid = stream_convert(in, stdout, convert_record, decimals);
+  if (in != stdin) {
+    fclose(in);
+  }
+  return invalid != 0;
 }
 
 int main(int argc, char *argv[]) {
+  // The Earth model option comes first
+  if (argc > 1 &&
+      (strcmp(argv[1], "-e") == 0 || strcmp(argv[1], "--wgs84") == 0)) {
+    model = EARTH_WGS84;
+    argc--;
+    argv++;
+  } else if (argc > 1 && strcmp(argv[1], "--sphere") == 0) {
+    model = EARTH_SPHERE;
+    argc--;
+    argv++;
+  }
+
+  if ((argc == 2 || argc == 3) &&
+      (strcmp(argv[1], "-s") == 0 || strcmp(argv[1], "--stream") == 0)) {
+    return run_stream(argc == 3 ? argv[2] : NULL);
+  }
   if (argc == 2) {
     if ((strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
       print_description();
@@ -46,17 +142,16 @@ int main(int argc, char *argv[]) {
   double latFinal = atof(argv[4]);
 
   // Validate inputs
-  if (lonInitial < -180.0 || lonInitial >= 180.0 || lonFinal < -180.0 ||
-      lonFinal >= 180.0 || latInitial < -90.0 || latInitial > 90.0 ||
-      latFinal < -90.0 || latFinal > 90.0) {
-    fprintf(stderr, "Error: Invalid coordinates. ");
-    fprintf(stderr, "Longitude must be [-180, 180), latitude [-90, 90].\n");
+  const char *error = validate(lonInitial, latInitial, lonFinal, latFinal);
+  if (error != NULL) {
+    fprintf(stderr, "Error: %s\n", error);
     return 1;
   }
 
   // Call the g2r function
   double range, bearing;
-  if (g2r(&range, &bearing, lonInitial, latInitial, lonFinal, latFinal) != 0) {
+  if (convert(&range, &bearing, lonInitial, latInitial, lonFinal, latFinal) !=
+      0) {
     fprintf(stderr, "Error: Calculation failed.\n");
     return 1;
   }
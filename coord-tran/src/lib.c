@@ -20,44 +20,58 @@ static double deg2rad(double degrees) { return degrees * (M_PI / 180.0); }
 static double rad2deg(double radians) { return radians * (180.0 / M_PI); }
 
 /**
- * Geodetic to Radar conversion (Haversine formula)
- * Calculates range and bearing from initial to final coordinates
- *
- * @param range Pointer to store the calculated range (km)
- * @param bearing Pointer to store the calculated initial bearing (deg)
- * @param lonInitial Initial longitude (deg)
- * @param latInitial Initial latitude (deg)
- * @param lonFinal Final longitude (deg)
- * @param latFinal Final latitude (deg)
- * @return 0 on success, non-zero on failure
+ * Per-origin terms shared by all conversions from the same initial point
  */
-int g2r(double *range, double *bearing, double lonInitial, double latInitial,
-        double lonFinal, double latFinal) {
+struct origin {
+  double lon;     // Initial longitude (deg)
+  double lat;     // Initial latitude (deg)
+  double lon1;    // Initial longitude (rad)
+  double lat1;    // Initial latitude (rad)
+  double sinLat1; // sin(lat1)
+  double cosLat1; // cos(lat1)
+};
 
-  if (range == NULL || bearing == NULL) {
-    return -1; // Invalid pointers
-  }
+/**
+ * Compute the per-origin terms
+ */
+static void origin_init(struct origin *o, double lonInitial,
+                        double latInitial) {
+  o->lon = lonInitial;
+  o->lat = latInitial;
+  o->lon1 = deg2rad(lonInitial);
+  o->lat1 = deg2rad(latInitial);
+  o->sinLat1 = sin(o->lat1);
+  o->cosLat1 = cos(o->lat1);
+}
 
+/**
+ * Geodetic to Radar conversion from a prepared origin (see g2r)
+ */
+static inline void g2r_origin(const struct origin *o, double *range,
+                              double *bearing, double lonFinal,
+                              double latFinal) {
   // If the points are the same, range is zero and bearing is undetermined
-  if (latInitial == latFinal && lonInitial == lonFinal) {
+  if (o->lat == latFinal && o->lon == lonFinal) {
     *range = 0.0;
     *bearing = UNDETERMINED_BEARING;
-    return 0;
+    return;
   }
 
   // Convert degrees to radians
-  double lat1 = deg2rad(latInitial);
-  double lon1 = deg2rad(lonInitial);
   double lat2 = deg2rad(latFinal);
   double lon2 = deg2rad(lonFinal);
+  double sinLat2 = sin(lat2);
+  double cosLat2 = cos(lat2);
 
   // Calculate differences
-  double dlon = lon2 - lon1;
-  double dlat = lat2 - lat1;
+  double dlon = lon2 - o->lon1;
+  double dlat = lat2 - o->lat1;
 
   // Haversine formula
-  double a = sin(dlat / 2) * sin(dlat / 2) +
-             cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+  double sinHalfDlat = sin(dlat / 2);
+  double sinHalfDlon = sin(dlon / 2);
+  double a = sinHalfDlat * sinHalfDlat +
+             o->cosLat1 * cosLat2 * sinHalfDlon * sinHalfDlon;
   double c = 2 * atan2(sqrt(a), sqrt(1 - a));
 
   // Calculate range (distance)
@@ -65,78 +79,62 @@ int g2r(double *range, double *bearing, double lonInitial, double latInitial,
 
   // If the points are at the poles (same or opposite pole), bearing is
   // undetermined
-  if (fabs(latInitial) == 90.0 && fabs(latFinal) == 90.0) {
+  if (fabs(o->lat) == 90.0 && fabs(latFinal) == 90.0) {
     *bearing = UNDETERMINED_BEARING;
-    return 0;
+    return;
   }
 
   // Calculate bearing
-  double y = sin(dlon) * cos(lat2);
-  double x = cos(lat1) * sin(lat2) - sin(lat1) * cos(lat2) * cos(dlon);
+  double y = sin(dlon) * cosLat2;
+  double x = o->cosLat1 * sinLat2 - o->sinLat1 * cosLat2 * cos(dlon);
   double bearing_rad = atan2(y, x);
 
   // Convert bearing to degrees, normalized to [0, 360)
   *bearing = fmod(rad2deg(bearing_rad) + 360.0, 360.0);
-
-  return 0;
 }
 
 /**
- * Radar to Geodetic conversion
- * Calculates final coordinates given initial point, range, and bearing
- *
- * @param range Distance from initial point (km)
- * @param bearing Initial bearing (deg)
- * @param lonInitial Initial longitude (deg)
- * @param latInitial Initial latitude (deg)
- * @param lonFinal Pointer to store calculated final longitude (deg)
- * @param latFinal Pointer to store calculated final latitude (deg)
- * @return 0 on success, non-zero on failure
+ * Radar to Geodetic conversion from a prepared origin (see r2g)
  */
-int r2g(double range, double bearing, double lonInitial, double latInitial,
-        double *lonFinal, double *latFinal) {
-
-  if (lonFinal == NULL || latFinal == NULL) {
-    return -1; // Invalid pointers
-  }
-
+static inline void r2g_origin(const struct origin *o, double range,
+                              double bearing, double *lonFinal,
+                              double *latFinal) {
   // If range is zero, stay where we are
   if (range == 0.0) {
-    *lonFinal = lonInitial;
-    *latFinal = latInitial;
-    return 0;
+    *lonFinal = o->lon;
+    *latFinal = o->lat;
+    return;
   }
 
   // If we are at a pole, and range is pi r_e, we go to the opposite pole
   // and keep the same longitude
-  if (fabs(latInitial) == 90.0 && range == EARTH_RADIUS * M_PI) {
-    *latFinal = -latInitial;
-    *lonFinal = lonInitial;
-    return 0;
+  if (fabs(o->lat) == 90.0 && range == EARTH_RADIUS * M_PI) {
+    *latFinal = -o->lat;
+    *lonFinal = o->lon;
+    return;
   }
 
   // Convert to radians
-  double lat1 = deg2rad(latInitial);
-  double lon1 = deg2rad(lonInitial);
   double brng = deg2rad(bearing);
 
   // Angular distance in radians
   double angular_distance = range / EARTH_RADIUS;
+  double sinDist = sin(angular_distance);
+  double cosDist = cos(angular_distance);
 
   // Calculate final latitude
-  double lat2 = asin(sin(lat1) * cos(angular_distance) +
-                     cos(lat1) * sin(angular_distance) * cos(brng));
+  double lat2 = asin(o->sinLat1 * cosDist + o->cosLat1 * sinDist * cos(brng));
 
   // Calculate final longitude
   // If we are at a pole, the final longitude is determined by the bearing
   double lon2;
-  if (latInitial == 90.0) {
+  if (o->lat == 90.0) {
     lon2 = M_PI - brng;
-  } else if (latInitial == -90.0) {
+  } else if (o->lat == -90.0) {
     lon2 = brng;
   } else {
-    lon2 = lon1 + atan2(sin(brng) * sin(angular_distance) * cos(lat1),
-                        cos(angular_distance) - sin(lat1) * sin(lat2));
+    lon2 = o->lon1 + atan2(sin(brng) * sinDist * o->cosLat1,
+                           cosDist - o->sinLat1 * sin(lat2));
   }
 
   // Convert back to degrees
@@ -145,6 +143,116 @@ int r2g(double range, double bearing, double lonInitial, double latInitial,
 
   // Normalize longitude to [-180, 180)
   *lonFinal = fmod(*lonFinal + 540.0, 360.0) - 180.0;
+}
+
+/**
+ * Geodetic to Radar conversion (Haversine formula)
+ * Calculates range and bearing from initial to final coordinates
+ *
+ * @param range Pointer to store the calculated range (km)
+ * @param bearing Pointer to store the calculated initial bearing (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Final longitude (deg)
+ * @param latFinal Final latitude (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int g2r(double *range, double *bearing, double lonInitial, double latInitial,
+        double lonFinal, double latFinal) {
 
+  if (range == NULL || bearing == NULL) {
+    return -1; // Invalid pointers
+  }
+
+  struct origin o;
+  origin_init(&o, lonInitial, latInitial);
+  g2r_origin(&o, range, bearing, lonFinal, latFinal);
+  return 0;
+}
+
+/**
+ * Radar to Geodetic conversion
+ * Calculates final coordinates given initial point, range, and bearing
+ *
+ * @param range Distance from initial point (km)
+ * @param bearing Initial bearing (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Pointer to store calculated final longitude (deg)
+ * @param latFinal Pointer to store calculated final latitude (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int r2g(double range, double bearing, double lonInitial, double latInitial,
+        double *lonFinal, double *latFinal) {
+
+  if (lonFinal == NULL || latFinal == NULL) {
+    return -1; // Invalid pointers
+  }
+
+  struct origin o;
+  origin_init(&o, lonInitial, latInitial);
+  r2g_origin(&o, range, bearing, lonFinal, latFinal);
+  return 0;
+}
+
+/**
+ * Batch Geodetic to Radar conversion from one initial point
+ *
+ * @param n Number of points
+ * @param range Array to store the calculated ranges (km)
+ * @param bearing Array to store the calculated initial bearings (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Array of final longitudes (deg)
+ * @param latFinal Array of final latitudes (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int g2r_batch(size_t n, double *restrict range, double *restrict bearing,
+              double lonInitial, double latInitial,
+              const double *restrict lonFinal,
+              const double *restrict latFinal) {
+
+  if (n > 0 && (range == NULL || bearing == NULL || lonFinal == NULL ||
+                latFinal == NULL)) {
+    return -1; // Invalid pointers
+  }
+
+  // The origin trig is computed once for the whole batch
+  struct origin o;
+  origin_init(&o, lonInitial, latInitial);
+  for (size_t i = 0; i < n; i++) {
+    g2r_origin(&o, &range[i], &bearing[i], lonFinal[i], latFinal[i]);
+  }
+  return 0;
+}
+
+/**
+ * Batch Radar to Geodetic conversion from one initial point
+ *
+ * @param n Number of points
+ * @param range Array of distances from the initial point (km)
+ * @param bearing Array of initial bearings (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Array to store the calculated final longitudes (deg)
+ * @param latFinal Array to store the calculated final latitudes (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int r2g_batch(size_t n, const double *restrict range,
+              const double *restrict bearing, double lonInitial,
+              double latInitial, double *restrict lonFinal,
+              double *restrict latFinal) {
+
+  if (n > 0 && (range == NULL || bearing == NULL || lonFinal == NULL ||
+                latFinal == NULL)) {
+    return -1; // Invalid pointers
+  }
+
+  // The origin trig is computed once for the whole batch
+  struct origin o;
+  origin_init(&o, lonInitial, latInitial);
+  for (size_t i = 0; i < n; i++) {
+    r2g_origin(&o, range[i], bearing[i], &lonFinal[i], &latFinal[i]);
+  }
   return 0;
 }
@@ -8,6 +8,8 @@
 #ifndef COORD_TRAN_LIB_H
 #define COORD_TRAN_LIB_H
 
+#include <stddef.h>
+
 /* Define M_PI if it's not already defined */
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -16,6 +18,24 @@
 #define EARTH_RADIUS 6371.0         // Earth radius (km)
 #define UNDETERMINED_BEARING -999.0 // Special value for undetermined bearing
 
+#define WGS84_A 6378.137            // WGS-84 semi-major axis (km)
+#define WGS84_F (1 / 298.257223563) // WGS-84 flattening
+#define WGS84_POLE_TO_POLE 20003.931458624 // WGS-84 pole-to-pole distance (km)
+
+/**
+ * Earth models, for tools that select the conversion at run time
+ */
+enum earth_model {
+  EARTH_SPHERE, // Sphere of radius EARTH_RADIUS: g2r, r2g
+  EARTH_WGS84,  // WGS-84 ellipsoid: g2r_wgs84, r2g_wgs84
+};
+
+/* Model used by the g2r and r2g tools unless given on the command line;
+   build with -DEARTH_MODEL_DEFAULT=EARTH_WGS84 to change it */
+#ifndef EARTH_MODEL_DEFAULT
+#define EARTH_MODEL_DEFAULT EARTH_SPHERE
+#endif
+
 /**
  * Geodetic to Radar conversion (Haversine formula)
  * Calculates range and bearing from initial to final coordinates
@@ -46,4 +66,116 @@ int g2r(double *range, double *bearing, double lonInitial, double latInitial,
 int r2g(double range, double bearing, double lonInitial, double latInitial,
         double *lonFinal, double *latFinal);
 
+/**
+ * Batch Geodetic to Radar conversion from one initial point
+ * Same as g2r for each (lonFinal[i], latFinal[i]), with the trig of the
+ * initial point computed once; the results are identical to g2r's
+ *
+ * @param n Number of points
+ * @param range Array to store the calculated ranges (km)
+ * @param bearing Array to store the calculated initial bearings (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Array of final longitudes (deg)
+ * @param latFinal Array of final latitudes (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int g2r_batch(size_t n, double *restrict range, double *restrict bearing,
+              double lonInitial, double latInitial,
+              const double *restrict lonFinal,
+              const double *restrict latFinal);
+
+/**
+ * Batch Radar to Geodetic conversion from one initial point
+ * Same as r2g for each (range[i], bearing[i]), with the trig of the initial
+ * point computed once; the results are identical to r2g's
+ *
+ * @param n Number of points
+ * @param range Array of distances from the initial point (km)
+ * @param bearing Array of initial bearings (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Array to store the calculated final longitudes (deg)
+ * @param latFinal Array to store the calculated final latitudes (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int r2g_batch(size_t n, const double *restrict range,
+              const double *restrict bearing, double lonInitial,
+              double latInitial, double *restrict lonFinal,
+              double *restrict latFinal);
+
+/**
+ * Geodetic to Radar conversion on the WGS-84 ellipsoid (Vincenty inverse)
+ * Same as g2r, including the special cases, but with geodesic range and
+ * bearing; accurate to well below a millimeter
+ *
+ * @param range Pointer to store the calculated range (km)
+ * @param bearing Pointer to store the calculated initial bearing (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Final longitude (deg)
+ * @param latFinal Final latitude (deg)
+ * @return 0 on success, non-zero on failure (including nearly antipodal
+ * points, for which the iteration does not converge)
+ */
+int g2r_wgs84(double *range, double *bearing, double lonInitial,
+              double latInitial, double lonFinal, double latFinal);
+
+/**
+ * Radar to Geodetic conversion on the WGS-84 ellipsoid (Vincenty direct)
+ * Same as r2g, including the special cases, with range along the geodesic
+ *
+ * @param range Distance from initial point (km)
+ * @param bearing Initial bearing (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Pointer to store calculated final longitude (deg)
+ * @param latFinal Pointer to store calculated final latitude (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int r2g_wgs84(double range, double bearing, double lonInitial,
+              double latInitial, double *lonFinal, double *latFinal);
+
+/**
+ * Batch Geodetic to Radar conversion on the WGS-84 ellipsoid from one
+ * initial point
+ * Same as g2r_wgs84 for each point, with the reduced latitude of the
+ * initial point computed once; the results are identical to g2r_wgs84's,
+ * and points for which it fails get NAN range and bearing
+ *
+ * @param n Number of points
+ * @param range Array to store the calculated ranges (km)
+ * @param bearing Array to store the calculated initial bearings (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Array of final longitudes (deg)
+ * @param latFinal Array of final latitudes (deg)
+ * @return 0 on success, non-zero if any point failed
+ */
+int g2r_wgs84_batch(size_t n, double *restrict range,
+                    double *restrict bearing, double lonInitial,
+                    double latInitial, const double *restrict lonFinal,
+                    const double *restrict latFinal);
+
+/**
+ * Batch Radar to Geodetic conversion on the WGS-84 ellipsoid from one
+ * initial point
+ * Same as r2g_wgs84 for each point, with the initial point terms computed
+ * once, and the bearing terms once per run of equal bearings (so order a
+ * scan beam by beam); the results are identical to r2g_wgs84's
+ *
+ * @param n Number of points
+ * @param range Array of distances from the initial point (km)
+ * @param bearing Array of initial bearings (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Array to store the calculated final longitudes (deg)
+ * @param latFinal Array to store the calculated final latitudes (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int r2g_wgs84_batch(size_t n, const double *restrict range,
+                    const double *restrict bearing, double lonInitial,
+                    double latInitial, double *restrict lonFinal,
+                    double *restrict latFinal);
+
 #endif /* COORD_TRAN_LIB_H */
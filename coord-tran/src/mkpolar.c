@@ -0,0 +1,94 @@
+/**
+ * mkpolar - Build a polar lookup table for a radar site
+ *
+ * Computes the final coordinates of every range gate and azimuth bin and
+ * saves them to a file that can be memory-mapped (see polar.h)
+ */
+
+#include "lib.h"
+#include "polar.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_description() {
+  printf("Build a lookup table of final geodetic coordinates for every range "
+         "gate\nand azimuth bin of a radar site.\n\n");
+}
+
+void print_usage() {
+  printf("Usage: mkpolar [-e|--sphere] <lon1> <lat1> <first_gate> "
+         "<gate_spacing>\n"
+         "               <num_gates> <num_azimuths> <file>\n");
+  printf("  Coordinates in decimal degrees, gate range and spacing in "
+         "kilometers.\n");
+  printf("  Azimuth bins are evenly spaced over 360 degrees from north.\n");
+  printf("  Prints the largest interpolation error (km) of the table.\n\n");
+  printf("Options:\n");
+  printf("  -h, --help           Display this help message (must be the only "
+         "arg).\n");
+  printf("  -e, --wgs84          Use Vincenty's formulae on the WGS-84 "
+         "ellipsoid%s.\n",
+         EARTH_MODEL_DEFAULT == EARTH_WGS84 ? " (default)" : "");
+  printf("      --sphere         Use the haversine formula on a sphere%s.\n\n",
+         EARTH_MODEL_DEFAULT == EARTH_SPHERE ? " (default)" : "");
+}
+
+int main(int argc, char *argv[]) {
+  // The Earth model option comes first
+  enum earth_model model = EARTH_MODEL_DEFAULT;
+  if (argc > 1 &&
+      (strcmp(argv[1], "-e") == 0 || strcmp(argv[1], "--wgs84") == 0)) {
+    model = EARTH_WGS84;
+    argc--;
+    argv++;
+  } else if (argc > 1 && strcmp(argv[1], "--sphere") == 0) {
+    model = EARTH_SPHERE;
+    argc--;
+    argv++;
+  }
+
+  if (argc == 2 &&
+      (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+    print_description();
+    print_usage();
+    return 0;
+  }
+  if (argc != 8) {
+    fprintf(stderr, "Error: Incorrect number of arguments.\n");
+    print_usage();
+    return 1;
+  }
+  double lonInitial = atof(argv[1]);
+  double latInitial = atof(argv[2]);
+  double firstGate = atof(argv[3]);
+  double gateSpacing = atof(argv[4]);
+  long numGates = atol(argv[5]);
+  long numAzimuths = atol(argv[6]);
+  const char *path = argv[7];
+
+  // Validate inputs
+  if (lonInitial < -180.0 || lonInitial >= 180.0 || latInitial < -90.0 ||
+      latInitial > 90.0 || firstGate < 0.0 || gateSpacing <= 0.0 ||
+      numGates < 2 || numGates > 1000000 || numAzimuths < 2 ||
+      numAzimuths > 1000000) {
+    fprintf(stderr, "Error: Invalid inputs. "
+                    "Longitude must be [-180, 180), latitude [-90, 90], "
+                    "first gate >= 0, spacing > 0, and 2 to 1000000 gates "
+                    "and azimuths.\n");
+    return 1;
+  }
+
+  struct polar_table table;
+  if (polar_table_build(&table, lonInitial, latInitial, firstGate,
+                        gateSpacing, numGates, numAzimuths, model) != 0) {
+    return 1;
+  }
+  int status = polar_table_save(&table, path);
+  if (status == 0) {
+    printf("%.6f\n", polar_table_error(&table));
+  }
+  polar_table_free(&table);
+  return status;
+}
@@ -0,0 +1,258 @@
+/**
+ * @file
+ * @brief Polar lookup tables of radar range gates and azimuth bins
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "polar.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t byte_order = 0x01020304;
+
+/**
+ * Size of the nodes (bytes)
+ */
+static size_t nodes_size(const struct polar_header *h) {
+  return 2 * sizeof(double) * (size_t)h->num_gates * h->num_azimuths;
+}
+
+int polar_table_build(struct polar_table *table, double lonInitial,
+                      double latInitial, double firstGate, double gateSpacing,
+                      uint32_t numGates, uint32_t numAzimuths,
+                      enum earth_model model) {
+  if (table == NULL) {
+    return -1; // Invalid pointer
+  }
+  memset(table, 0, sizeof(*table));
+  if (numGates < 2 || numAzimuths < 2 || !(firstGate >= 0.0) ||
+      !(gateSpacing > 0.0) ||
+      (model != EARTH_SPHERE && model != EARTH_WGS84)) {
+    fprintf(stderr,
+            "Error: Invalid polar table dimensions or Earth model.\n");
+    return 1;
+  }
+
+  struct polar_header *h = &table->header;
+  memcpy(h->magic, POLAR_MAGIC, sizeof(POLAR_MAGIC));
+  h->version = POLAR_VERSION;
+  h->byte_order = byte_order;
+  h->lon = lonInitial;
+  h->lat = latInitial;
+  h->first_gate = firstGate;
+  h->gate_spacing = gateSpacing;
+  h->num_gates = numGates;
+  h->num_azimuths = numAzimuths;
+  h->model = model;
+  h->data_offset =
+      (sizeof(*h) + POLAR_ALIGN - 1) / POLAR_ALIGN * POLAR_ALIGN;
+
+  double *nodes = malloc(nodes_size(h));
+  double *range = malloc(numGates * sizeof(double));
+  double *bearing = malloc(numGates * sizeof(double));
+  double *lon = malloc(numGates * sizeof(double));
+  double *lat = malloc(numGates * sizeof(double));
+  if (!nodes || !range || !bearing || !lon || !lat) {
+    fprintf(stderr, "Error: Failed to allocate the polar table.\n");
+    free(nodes);
+    nodes = NULL;
+  }
+
+  // One beam at a time, through the batch functions
+  for (uint32_t a = 0; nodes != NULL && a < numAzimuths; a++) {
+    for (uint32_t g = 0; g < numGates; g++) {
+      range[g] = firstGate + g * gateSpacing;
+      bearing[g] = a * (360.0 / numAzimuths);
+    }
+    if (model == EARTH_WGS84) {
+      r2g_wgs84_batch(numGates, range, bearing, lonInitial, latInitial, lon,
+                      lat);
+    } else {
+      r2g_batch(numGates, range, bearing, lonInitial, latInitial, lon, lat);
+    }
+    double *beam = nodes + 2 * (size_t)a * numGates;
+    for (uint32_t g = 0; g < numGates; g++) {
+      beam[2 * g] = lon[g];
+      beam[2 * g + 1] = lat[g];
+    }
+  }
+  free(range);
+  free(bearing);
+  free(lon);
+  free(lat);
+
+  table->nodes = nodes;
+  return nodes == NULL;
+}
+
+int polar_table_save(const struct polar_table *table, const char *path) {
+  if (table == NULL || table->nodes == NULL) {
+    return -1; // Invalid pointer
+  }
+
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "Error: Cannot open '%s' for writing.\n", path);
+    return 1;
+  }
+  static const char zeros[POLAR_ALIGN];
+  const struct polar_header *h = &table->header;
+  size_t pad = h->data_offset - sizeof(*h);
+  int status = fwrite(h, sizeof(*h), 1, fp) != 1 ||
+               fwrite(zeros, 1, pad, fp) != pad ||
+               fwrite(table->nodes, nodes_size(h), 1, fp) != 1;
+  if (fclose(fp) != 0) {
+    status = 1;
+  }
+  if (status != 0) {
+    fprintf(stderr, "Error: Failed to write '%s'.\n", path);
+  }
+  return status;
+}
+
+int polar_table_map(struct polar_table *table, const char *path) {
+  if (table == NULL) {
+    return -1; // Invalid pointer
+  }
+  memset(table, 0, sizeof(*table));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error: Cannot open '%s': %s.\n", path, strerror(errno));
+    return 1;
+  }
+  struct stat st;
+  void *ptr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 &&
+      (size_t)st.st_size >= sizeof(struct polar_header)) {
+    ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr, "Error: '%s' is not a polar table.\n", path);
+    return 1;
+  }
+
+  // Check the header against the file size before trusting the nodes
+  const struct polar_header *h = ptr;
+  size_t size = st.st_size;
+  if (memcmp(h->magic, POLAR_MAGIC, sizeof(POLAR_MAGIC)) != 0 ||
+      h->version != POLAR_VERSION || h->byte_order != byte_order ||
+      (h->model != EARTH_SPHERE && h->model != EARTH_WGS84) ||
+      !isfinite(h->lon) || !isfinite(h->lat) || !(h->first_gate >= 0.0) ||
+      !(h->gate_spacing > 0.0) || !isfinite(h->first_gate) ||
+      !isfinite(h->gate_spacing) || h->num_gates < 2 ||
+      h->num_azimuths < 2 || h->data_offset % sizeof(double) != 0 ||
+      h->data_offset > size ||
+      (size_t)h->num_gates * h->num_azimuths >
+          (size - h->data_offset) / (2 * sizeof(double))) {
+    fprintf(stderr,
+            "Error: '%s' is not a polar table, or has an unsupported "
+            "version or byte order.\n",
+            path);
+    munmap(ptr, size);
+    return 1;
+  }
+
+  table->header = *h;
+  table->nodes = (const double *)((const char *)ptr + h->data_offset);
+  table->mapping = ptr;
+  table->mapping_size = size;
+  return 0;
+}
+
+void polar_table_free(struct polar_table *table) {
+  if (table == NULL) {
+    return;
+  }
+  if (table->mapping != NULL) {
+    munmap(table->mapping, table->mapping_size);
+  } else {
+    free((void *)table->nodes);
+  }
+  table->nodes = NULL;
+  table->mapping = NULL;
+}
+
+int polar_table_lookup(const struct polar_table *table, double range,
+                       double bearing, double *lonFinal, double *latFinal) {
+  if (table == NULL || lonFinal == NULL || latFinal == NULL) {
+    return -1; // Invalid pointers
+  }
+  const struct polar_header *h = &table->header;
+
+  // Cell and position within it; the last gate belongs to the last cell
+  double x = (range - h->first_gate) / h->gate_spacing;
+  double y = bearing * (h->num_azimuths / 360.0);
+  if (!(x >= 0.0 && x <= h->num_gates - 1) ||
+      !(bearing >= 0.0 && bearing < 360.0)) {
+    return 1;
+  }
+  uint32_t g = (uint32_t)x;
+  if (g == h->num_gates - 1) {
+    g--;
+  }
+  uint32_t a = (uint32_t)y;
+  if (a == h->num_azimuths) {
+    a--; // Rounded up from just below 360
+  }
+  uint32_t a1 = a + 1 < h->num_azimuths ? a + 1 : 0;
+  double fg = x - g;
+  double fa = y - a;
+
+  double lon00, lat00, lon10, lat10, lon01, lat01, lon11, lat11;
+  polar_table_node(table, g, a, &lon00, &lat00);
+  polar_table_node(table, g + 1, a, &lon10, &lat10);
+  polar_table_node(table, g, a1, &lon01, &lat01);
+  polar_table_node(table, g + 1, a1, &lon11, &lat11);
+
+  // Longitudes relative to the first node, for cells across 180 deg
+  double d10 = remainder(lon10 - lon00, 360.0);
+  double d01 = remainder(lon01 - lon00, 360.0);
+  double d11 = remainder(lon11 - lon00, 360.0);
+  double dlon = (1 - fa) * fg * d10 + fa * ((1 - fg) * d01 + fg * d11);
+  *lonFinal = lon00 + dlon;
+  *latFinal = (1 - fa) * ((1 - fg) * lat00 + fg * lat10) +
+              fa * ((1 - fg) * lat01 + fg * lat11);
+
+  // Normalize longitude to [-180, 180)
+  if (*lonFinal < -180.0 || *lonFinal >= 180.0) {
+    *lonFinal = fmod(*lonFinal + 540.0, 360.0) - 180.0;
+  }
+  return 0;
+}
+
+double polar_table_error(const struct polar_table *table) {
+  const struct polar_header *h = &table->header;
+  double max_error = 0.0;
+  for (uint32_t a = 0; a < h->num_azimuths; a++) {
+    double bearing = (a + 0.5) * (360.0 / h->num_azimuths);
+    for (uint32_t g = 0; g + 1 < h->num_gates; g++) {
+      double range = h->first_gate + (g + 0.5) * h->gate_spacing;
+      double lon, lat, lon_table, lat_table, error, unused;
+      int status =
+          polar_table_lookup(table, range, bearing, &lon_table, &lat_table);
+      if (status != 0) {
+      } else if (h->model == EARTH_WGS84) {
+        status = r2g_wgs84(range, bearing, h->lon, h->lat, &lon, &lat) ||
+                 g2r_wgs84(&error, &unused, lon, lat, lon_table, lat_table);
+      } else {
+        status = r2g(range, bearing, h->lon, h->lat, &lon, &lat) ||
+                 g2r(&error, &unused, lon, lat, lon_table, lat_table);
+      }
+      if (status != 0) {
+        return NAN; // E.g. nearly antipodal to r2g's point (Vincenty)
+      }
+      max_error = fmax(max_error, error);
+    }
+  }
+  return max_error;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file
+ * @brief Polar lookup tables of radar range gates and azimuth bins
+ *
+ * A table holds the final coordinates of every (range gate, azimuth bin)
+ * node of a fixed radar site, computed once with r2g (or r2g_wgs84), so
+ * that each sample of a sweep costs a table fetch instead of several
+ * transcendental functions. Tables can be saved to disk and memory-mapped,
+ * and off-grid samples are interpolated bilinearly.
+ *
+ * File layout (native byte order): a struct polar_header, then at
+ * data_offset the nodes as doubles, lon and lat interleaved, azimuth-major:
+ * node (gate g, azimuth a) is at index 2 * (a * num_gates + g)
+ */
+
+#ifndef COORD_TRAN_POLAR_H
+#define COORD_TRAN_POLAR_H
+
+#include "lib.h"
+#include <stdint.h>
+
+#define POLAR_MAGIC "CTPOLAR" // File magic (with the terminating NUL)
+#define POLAR_VERSION 1       // File format version
+#define POLAR_ALIGN 64        // Alignment of the nodes in the file (bytes)
+
+/**
+ * File header
+ */
+struct polar_header {
+  char magic[8];          // POLAR_MAGIC
+  uint32_t version;       // POLAR_VERSION
+  uint32_t byte_order;    // 0x01020304 as written
+  double lon;             // Initial longitude (deg)
+  double lat;             // Initial latitude (deg)
+  double first_gate;      // Range of the first gate (km)
+  double gate_spacing;    // Range gate spacing (km)
+  uint32_t num_gates;     // Number of range gates
+  uint32_t num_azimuths;  // Number of azimuth bins, evenly over 360 deg
+  uint32_t model;         // enum earth_model of the nodes
+  uint32_t reserved;      // Zero
+  uint64_t data_offset;   // Offset of the nodes (bytes)
+};
+
+/**
+ * Lookup table, built in memory or mapped from a file
+ */
+struct polar_table {
+  struct polar_header header; // Table parameters
+  const double *nodes;        // Node coordinates (see the file layout)
+  void *mapping;              // File mapping, or NULL if built
+  size_t mapping_size;        // Size of the mapping (bytes)
+};
+
+/**
+ * Build a table: node (g, a) is r2g of range first_gate + g * gate_spacing
+ * and bearing a * 360 / num_azimuths
+ *
+ * @param table Table to initialize (free with polar_table_free)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param firstGate Range of the first gate (km)
+ * @param gateSpacing Range gate spacing (km)
+ * @param numGates Number of range gates (at least 2)
+ * @param numAzimuths Number of azimuth bins (at least 2)
+ * @param model Earth model (r2g or r2g_wgs84)
+ * @return 0 on success, non-zero on failure
+ */
+int polar_table_build(struct polar_table *table, double lonInitial,
+                      double latInitial, double firstGate, double gateSpacing,
+                      uint32_t numGates, uint32_t numAzimuths,
+                      enum earth_model model);
+
+/**
+ * Save a table to a file
+ *
+ * @param table Table
+ * @param path File name
+ * @return 0 on success, non-zero on failure
+ */
+int polar_table_save(const struct polar_table *table, const char *path);
+
+/**
+ * Map a table file read-only, after checking its header
+ *
+ * @param table Table to initialize (free with polar_table_free)
+ * @param path File name
+ * @return 0 on success, non-zero on failure
+ */
+int polar_table_map(struct polar_table *table, const char *path);
+
+/**
+ * Free a built table or unmap a mapped one
+ *
+ * @param table Table
+ */
+void polar_table_free(struct polar_table *table);
+
+/**
+ * Coordinates of a node
+ * Identical to the r2g result the table was built with
+ *
+ * @param table Table
+ * @param gate Range gate index
+ * @param azimuth Azimuth bin index
+ * @param lonFinal Pointer to store the final longitude (deg)
+ * @param latFinal Pointer to store the final latitude (deg)
+ */
+static inline void polar_table_node(const struct polar_table *table,
+                                    uint32_t gate, uint32_t azimuth,
+                                    double *lonFinal, double *latFinal) {
+  const double *node =
+      table->nodes + 2 * ((size_t)azimuth * table->header.num_gates + gate);
+  *lonFinal = node[0];
+  *latFinal = node[1];
+}
+
+/**
+ * Radar to Geodetic conversion by bilinear interpolation between the four
+ * surrounding nodes (in longitude and latitude)
+ * The error is largest in the middle of the cells, and grows with range
+ * and with the square of the cell size (see polar_table_error); cells
+ * around a pole are not interpolated meaningfully
+ *
+ * @param table Table
+ * @param range Distance from the initial point (km), within the gates
+ * @param bearing Initial bearing (deg), [0, 360)
+ * @param lonFinal Pointer to store the final longitude (deg)
+ * @param latFinal Pointer to store the final latitude (deg)
+ * @return 0 on success, non-zero if the range is outside the table or the
+ * bearing outside [0, 360)
+ */
+int polar_table_lookup(const struct polar_table *table, double range,
+                       double bearing, double *lonFinal, double *latFinal);
+
+/**
+ * Interpolation error of a table
+ * Compares polar_table_lookup with r2g (or r2g_wgs84) in the middle of
+ * every cell, where bilinear interpolation is least accurate
+ *
+ * @param table Table
+ * @return Largest distance between the two (km), or NaN if a distance
+ * could not be computed
+ */
+double polar_table_error(const struct polar_table *table);
+
+#endif /* COORD_TRAN_POLAR_H */
@@ -5,6 +5,7 @@
  */
 
 #include "lib.h"
+#include "stream.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,15 +16,143 @@ void print_description() {
 }
 
 void print_usage() {
-  printf("Usage: r2g <lon1> <lat1> <range> <bearing>\n");
+  printf("Usage: r2g [-e|--sphere] <lon1> <lat1> <range> <bearing>\n");
+  printf("       r2g [-e|--sphere] -s|--stream [file]\n");
   printf("  Coordinates in decimal degrees, range in kilometers, bearing in "
          "decimal degrees.\n");
   printf("  Output is <lon2> <lat2> (decimal degrees).\n\n");
   printf("Options:\n");
-  printf("  -h, --help  Display this help message (must be the only arg).\n\n");
+  printf("  -h, --help           Display this help message (must be the only "
+         "arg).\n");
+  printf("  -e, --wgs84          Use Vincenty's formulae on the WGS-84 "
+         "ellipsoid%s.\n",
+         EARTH_MODEL_DEFAULT == EARTH_WGS84 ? " (default)" : "");
+  printf("      --sphere         Use the haversine formula on a sphere%s.\n",
+         EARTH_MODEL_DEFAULT == EARTH_SPHERE ? " (default)" : "");
+  printf("  -s, --stream [file]  Read one <lon1> <lat1> <range> <bearing> "
+         "record per line\n");
+  printf("                       (whitespace- or comma-delimited) from file "
+         "or stdin.\n");
+  printf("                       Invalid records are reported and output as "
+         "\"nan nan\".\n\n");
+}
+
+/* Earth model of the conversions */
+static enum earth_model model = EARTH_MODEL_DEFAULT;
+
+/**
+ * r2g or r2g_wgs84, depending on the model
+ */
+int convert(double range, double bearing, double lonInitial,
+            double latInitial, double *lonFinal, double *latFinal) {
+  if (model == EARTH_WGS84) {
+    return r2g_wgs84(range, bearing, lonInitial, latInitial, lonFinal,
+                     latFinal);
+  }
+  return r2g(range, bearing, lonInitial, latInitial, lonFinal, latFinal);
+}
+
+/**
+ * Check the inputs, returning an error message or NULL if valid
+ * The range may be snapped to the pole-to-pole distance, and a warning
+ * may be returned in *warning (NULL otherwise)
+ */
+const char *validate(double lonInitial, double latInitial, double *range,
+                     double bearing, const char **warning) {
+  *warning = NULL;
+  double pole_to_pole =
+      model == EARTH_WGS84 ? WGS84_POLE_TO_POLE : EARTH_RADIUS * M_PI;
+
+  // Special bearing cases
+  if (bearing == UNDETERMINED_BEARING) {
+    if (*range == 0.0) {
+    } else if (fabs(latInitial) == 90 &&
+               fabs(*range - pole_to_pole) < 1e-3) {
+      // Snap to pole-to-pole distance
+      *range = pole_to_pole;
+    } else {
+      return "Undetermined input bearing "
+             "can only be used with zero range "
+             "or pole-to-pole.";
+    }
+  } else {
+    if (*range == 0.0) {
+      *warning = "Input range is zero, "
+                 "input bearing has no effect.";
+    }
+  }
+
+  // Validate inputs
+  if (lonInitial < -180.0 || lonInitial >= 180.0 || latInitial < -90.0 ||
+      latInitial > 90.0 || *range < 0.0 ||
+      (bearing > UNDETERMINED_BEARING && bearing < 0.0) ||
+      (bearing < UNDETERMINED_BEARING) || bearing >= 360.0) {
+    return "Invalid inputs. "
+           "Longitude must be [-180, 180), latitude [-90, 90], "
+           "range > 0, bearing [0, 360).";
+  }
+  return NULL;
+}
+
+/**
+ * Convert one streamed record
+ */
+int convert_record(const double in[STREAM_NUM_IN],
+                   double out[STREAM_NUM_OUT], long line) {
+  double range = in[2];
+  const char *warning;
+  const char *error = validate(in[0], in[1], &range, in[3], &warning);
+  if (warning != NULL) {
+    fprintf(stderr, "Warning: line %ld: %s\n", line, warning);
+  }
+  if (error != NULL) {
+    fprintf(stderr, "Error: line %ld: %s\n", line, error);
+    return 1;
+  }
+  if (convert(range, in[3], in[0], in[1], &out[0], &out[1]) != 0) {
+    fprintf(stderr, "Error: line %ld: Calculation failed.\n", line);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Streaming mode: convert all records from a file or stdin
+ */
+int run_stream(const char *filename) {
+  FILE *in = stdin;
+  if (filename != NULL && strcmp(filename, "-") != 0) {
+    in = fopen(filename, "r");
+    if (in == NULL) {
+      fprintf(stderr, "Error: Cannot open '%s'.\n", filename);
+      return 1;
+    }
+  }
+  static const int decimals[STREAM_NUM_OUT] = {4, 4};
+  long invalid = stream_convert(in, stdout, convert_record, decimals);
+  if (in != stdin) {
+    fclose(in);
+  }
+  return invalid != 0;
 }
 
 int main(int argc, char *argv[]) {
+  // The Earth model option comes first
+  if (argc > 1 &&
+      (strcmp(argv[1], "-e") == 0 || strcmp(argv[1], "--wgs84") == 0)) {
+    model = EARTH_WGS84;
+    argc--;
+    argv++;
+  } else if (argc > 1 && strcmp(argv[1], "--sphere") == 0) {
+    model = EARTH_SPHERE;
+    argc--;
+    argv++;
+  }
+
+  if ((argc == 2 || argc == 3) &&
+      (strcmp(argv[1], "-s") == 0 || strcmp(argv[1], "--stream") == 0)) {
+    return run_stream(argc == 3 ? argv[2] : NULL);
+  }
   if (argc == 2) {
     if ((strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
       print_description();
@@ -45,40 +174,22 @@ int main(int argc, char *argv[]) {
   double range = atof(argv[3]);
   double bearing = atof(argv[4]);
 
-  // Special bearing cases
-  if (bearing == UNDETERMINED_BEARING) {
-    if (range == 0.0) {
-    } else if (fabs(latInitial) == 90 &&
-               fabs(range - EARTH_RADIUS * M_PI) < 1e-3) {
-      // Snap to pole-to-pole distance
-      range = EARTH_RADIUS * M_PI;
-    } else {
-      fprintf(stderr, "Error: Undetermined input bearing ");
-      fprintf(stderr, "can only be used with zero range ");
-      fprintf(stderr, "or pole-to-pole.\n");
-      return 1;
-    }
-  } else {
-    if (range == 0.0) {
-      fprintf(stderr, "Warning: Input range is zero, ");
-      fprintf(stderr, "input bearing has no effect.\n");
-    }
-  }
-
   // Validate inputs
-  if (lonInitial < -180.0 || lonInitial >= 180.0 || latInitial < -90.0 ||
-      latInitial > 90.0 || range < 0.0 ||
-      (bearing > UNDETERMINED_BEARING && bearing < 0.0) ||
-      (bearing < UNDETERMINED_BEARING) || bearing >= 360.0) {
-    fprintf(stderr, "Error: Invalid inputs. ");
-    fprintf(stderr, "Longitude must be [-180, 180), latitude [-90, 90], ");
-    fprintf(stderr, "range > 0, bearing [0, 360).\n");
+  const char *warning;
+  const char *error =
+      validate(lonInitial, latInitial, &range, bearing, &warning);
+  if (warning != NULL) {
+    fprintf(stderr, "Warning: %s\n", warning);
+  }
+  if (error != NULL) {
+    fprintf(stderr, "Error: %s\n", error);
     return 1;
   }
 
   // Call the r2g function
   double lonFinal, latFinal;
-  if (r2g(range, bearing, lonInitial, latInitial, &lonFinal, &latFinal) != 0) {
+  if (convert(range, bearing, lonInitial, latInitial, &lonFinal, &latFinal) !=
+      0) {
     fprintf(stderr, "Error: Calculation failed.\n");
     return 1;
   }
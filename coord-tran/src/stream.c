@@ -0,0 +1,299 @@
+/**
+ * @file
+ * @brief Streaming record conversion for the g2r and r2g tools
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "stream.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IN_BUFFER_SIZE (1 << 20)  // Input chunk size (longest line)
+#define OUT_BUFFER_SIZE (1 << 16) // Output buffer size
+
+// Powers of ten that are exact in double precision
+static const double pow10_exact[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/**
+ * Parse with strtod, for what the fast path does not handle
+ */
+static int parse_slow(const char *begin, const char *end, double *value) {
+  char buf[64];
+  size_t len = end - begin;
+  if (len >= sizeof(buf)) {
+    return 1;
+  }
+  memcpy(buf, begin, len);
+  buf[len] = '\0';
+
+  char *stop;
+  *value = strtod(buf, &stop);
+  return len == 0 || stop != buf + len || !isfinite(*value);
+}
+
+int stream_parse_double(const char *begin, const char *end, double *value) {
+  // Fast path (Clinger): a decimal mantissa of up to 15 digits is exact in
+  // double precision, and so are powers of ten up to 1e22, so a single
+  // multiplication or division gives the correctly rounded result
+  const char *p = begin;
+  int negative = 0;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;   // Significant digits in the mantissa
+  int exponent = 0; // Decimal exponent of the mantissa
+  int any = 0;      // Whether any digit was seen
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    any = 1;
+    if (mantissa != 0 || *p != '0') {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits++;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+      any = 1;
+      if (mantissa != 0 || *p != '0') {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits++;
+      }
+      exponent--;
+    }
+  }
+  if (p < end && (*p == 'e' || *p == 'E') && any) {
+    const char *q = p + 1;
+    int exp_negative = 0;
+    if (q < end && (*q == '-' || *q == '+')) {
+      exp_negative = *q == '-';
+      q++;
+    }
+    int exp_value = 0;
+    int exp_digits = 0;
+    for (; q < end && *q >= '0' && *q <= '9' && exp_digits < 4; q++) {
+      exp_value = exp_value * 10 + (*q - '0');
+      exp_digits++;
+    }
+    if (exp_digits > 0) {
+      exponent += exp_negative ? -exp_value : exp_value;
+      p = q;
+    }
+  }
+
+  if (!any || p != end || digits > 15 || exponent < -22 || exponent > 22) {
+    return parse_slow(begin, end, value);
+  }
+
+  double v = (double)mantissa;
+  if (exponent < 0) {
+    v /= pow10_exact[-exponent];
+  } else {
+    v *= pow10_exact[exponent];
+  }
+  *value = negative ? -v : v;
+  return 0;
+}
+
+int stream_format_fixed(char *buf, double value, int decimals) {
+  // Fast path: scale to an integer and round. The scaled value has an
+  // error below 1e-7 for values below 1e9, so unless it is that close to a
+  // tie, rounding it gives the same digits as printf's exact conversion.
+  double scaled = fabs(value) * pow10_exact[decimals];
+  if (scaled < 1e9) {
+    double whole = floor(scaled);
+    double frac = scaled - whole;
+    if (fabs(frac - 0.5) > 1e-6) {
+      uint64_t v = (uint64_t)whole + (frac > 0.5);
+      char digits[24];
+      int n = 0;
+      do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+      } while (v > 0 || n <= decimals);
+
+      char *p = buf;
+      if (signbit(value)) {
+        *p++ = '-';
+      }
+      while (n > decimals) {
+        *p++ = digits[--n];
+      }
+      if (decimals > 0) {
+        *p++ = '.';
+        while (n > 0) {
+          *p++ = digits[--n];
+        }
+      }
+      return p - buf;
+    }
+  }
+  return snprintf(buf, STREAM_FORMAT_MAX, "%.*f", decimals, value);
+}
+
+static int is_delimiter(char c) {
+  return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+/**
+ * Output buffer in front of a stream
+ */
+struct out_buffer {
+  FILE *fp;
+  size_t len;
+  int error;
+  char data[OUT_BUFFER_SIZE];
+};
+
+static void out_flush(struct out_buffer *out) {
+  if (out->len > 0 && fwrite(out->data, 1, out->len, out->fp) != out->len) {
+    out->error = 1;
+  }
+  out->len = 0;
+}
+
+/**
+ * Make room for at least `size` characters
+ */
+static char *out_reserve(struct out_buffer *out, size_t size) {
+  if (out->len + size > sizeof(out->data)) {
+    out_flush(out);
+  }
+  return out->data + out->len;
+}
+
+/**
+ * Convert one line [p, end) and write its output line
+ * Returns 1 if the record is invalid, 0 otherwise (including skipped lines)
+ */
+static int convert_line(const char *p, const char *end, long line,
+                        stream_convert_fn convert, const int *decimals,
+                        struct out_buffer *out) {
+  // Skip leading delimiters, then blank and comment lines
+  while (p < end && is_delimiter(*p)) {
+    p++;
+  }
+  if (p == end || *p == '#') {
+    return 0;
+  }
+
+  double in[STREAM_NUM_IN];
+  int num_fields = 0;
+  int bad_number = 0;
+  while (p < end) {
+    const char *token = p;
+    while (p < end && !is_delimiter(*p)) {
+      p++;
+    }
+    if (num_fields < STREAM_NUM_IN &&
+        stream_parse_double(token, p, &in[num_fields]) != 0) {
+      bad_number = 1;
+    }
+    num_fields++;
+    while (p < end && is_delimiter(*p)) {
+      p++;
+    }
+  }
+
+  double result[STREAM_NUM_OUT];
+  int invalid = 1;
+  if (bad_number) {
+    fprintf(stderr, "Error: line %ld: Invalid number.\n", line);
+  } else if (num_fields != STREAM_NUM_IN) {
+    fprintf(stderr, "Error: line %ld: Expected %d values, got %d.\n", line,
+            STREAM_NUM_IN, num_fields);
+  } else {
+    invalid = convert(in, result, line) != 0;
+  }
+
+  char *q = out_reserve(out, STREAM_NUM_OUT * (STREAM_FORMAT_MAX + 1));
+  for (int i = 0; i < STREAM_NUM_OUT; i++) {
+    if (invalid) {
+      memcpy(q, "nan", 3);
+      q += 3;
+    } else {
+      q += stream_format_fixed(q, result[i], decimals[i]);
+    }
+    *q++ = i + 1 < STREAM_NUM_OUT ? ' ' : '\n';
+  }
+  out->len = q - out->data;
+  return invalid;
+}
+
+long stream_convert(FILE *in, FILE *out, stream_convert_fn convert,
+                    const int decimals[STREAM_NUM_OUT]) {
+  char *buf = malloc(IN_BUFFER_SIZE);
+  struct out_buffer *ob = malloc(sizeof(*ob));
+  if (buf == NULL || ob == NULL) {
+    free(buf);
+    free(ob);
+    fprintf(stderr, "Error: Failed to allocate stream buffers.\n");
+    return -1;
+  }
+  ob->fp = out;
+  ob->len = 0;
+  ob->error = 0;
+
+  long invalid = 0;
+  long line = 0;
+  size_t len = 0; // Characters in buf, starting with a partial line
+  int eof = 0;
+  while (!eof) {
+    // Read whatever is available (rather than waiting for a full chunk as
+    // fread would), so that a live feed is converted as it arrives
+    ssize_t n = read(fileno(in), buf + len, IN_BUFFER_SIZE - len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "Error: Failed to read input.\n");
+      invalid = -1;
+      break;
+    }
+    len += n;
+    eof = n == 0;
+
+    // Convert all complete lines, and the last one at the end of the input
+    char *p = buf;
+    char *end = buf + len;
+    for (;;) {
+      char *nl = memchr(p, '\n', end - p);
+      if (nl == NULL) {
+        if (!eof || p == end) {
+          break;
+        }
+        nl = end;
+      }
+      invalid += convert_line(p, nl, ++line, convert, decimals, ob);
+      p = nl < end ? nl + 1 : end;
+    }
+
+    out_flush(ob);
+
+    // Keep the partial line for the next chunk
+    len = end - p;
+    if (len == IN_BUFFER_SIZE) {
+      fprintf(stderr, "Error: line %ld: Line too long.\n", line + 1);
+      invalid = -1;
+      break;
+    }
+    memmove(buf, p, len);
+  }
+
+  out_flush(ob);
+  if (fflush(out) != 0 || ob->error) {
+    fprintf(stderr, "Error: Failed to write output.\n");
+    invalid = -1;
+  }
+  free(buf);
+  free(ob);
+  return invalid;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @brief Streaming record conversion for the g2r and r2g tools
+ *
+ * Reads records of four numbers (whitespace- or comma-delimited, one record
+ * per line) in chunks of up to 1 MiB, converts each one, and writes two
+ * numbers per record through an output buffer that is flushed after each
+ * chunk
+ */
+
+#ifndef COORD_TRAN_STREAM_H
+#define COORD_TRAN_STREAM_H
+
+#include <stdio.h>
+
+#define STREAM_NUM_IN 4       // Number of input fields per record
+#define STREAM_NUM_OUT 2      // Number of output fields per record
+#define STREAM_FORMAT_MAX 330 // Longest formatted number (any double, %.9f)
+
+/**
+ * Conversion of one record
+ * Reports its own errors and warnings on stderr, prefixed with the line
+ *
+ * @param in Input fields
+ * @param out Array to store the output fields
+ * @param line Line number of the record (from 1)
+ * @return 0 on success, non-zero if the record is invalid
+ */
+typedef int (*stream_convert_fn)(const double in[STREAM_NUM_IN],
+                                 double out[STREAM_NUM_OUT], long line);
+
+/**
+ * Convert all records from a stream
+ * Blank lines and lines starting with '#' are skipped; every other line
+ * gives one output line, with "nan nan" for invalid records, so the output
+ * stays aligned with the input
+ *
+ * @param in Input stream
+ * @param out Output stream
+ * @param convert Conversion function
+ * @param decimals Number of decimals of each output field
+ * @return Number of invalid records, or -1 on read or write error
+ */
+long stream_convert(FILE *in, FILE *out, stream_convert_fn convert,
+                    const int decimals[STREAM_NUM_OUT]);
+
+/**
+ * Parse a number
+ * Same result as strtod, but with a fast path for plain decimal numbers
+ *
+ * @param begin First character
+ * @param end One past the last character
+ * @param value Pointer to store the value
+ * @return 0 on success, non-zero if [begin, end) is not a finite number
+ */
+int stream_parse_double(const char *begin, const char *end, double *value);
+
+/**
+ * Format a number with a fixed number of decimals
+ * Same output as printf's "%.*f", with a fast path for moderate values
+ *
+ * @param buf Buffer to write to (at least STREAM_FORMAT_MAX characters)
+ * @param value Value
+ * @param decimals Number of decimals (0 to 9)
+ * @return Number of characters written (no terminating NUL)
+ */
+int stream_format_fixed(char *buf, double value, int decimals);
+
+#endif /* COORD_TRAN_STREAM_H */
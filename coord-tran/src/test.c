@@ -2,10 +2,18 @@
  * Test program for coordinate transformation library
  */
 
+#define _DEFAULT_SOURCE
+
 #include "lib.h"
+#include "polar.h"
+#include "stream.h"
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #define EPSILON 1.0e-10
 
@@ -58,8 +66,558 @@ int test_g2r_r2g_roundtrip() {
   }
 }
 
-int main() {
+int test_batch_matches_scalar() {
+  printf("Testing g2r_batch and r2g_batch against g2r and r2g...\n");
+
+  // Initial points: Wallops Islands, and both poles for the special cases
+  const double origins[][2] = {{-75.0, 37.0}, {0.0, 90.0}, {0.0, -90.0}};
+  const int num_origins = sizeof(origins) / sizeof(origins[0]);
+
+  // Final points on a grid, plus the same point and both poles
+  enum { N = 13 * 19 + 3 };
+  double lon2[N], lat2[N], range[N], bearing[N];
+  double lon_result[N], lat_result[N];
+
+  int mismatches = 0;
+  for (int k = 0; k < num_origins; k++) {
+    double lon1 = origins[k][0];
+    double lat1 = origins[k][1];
+
+    int n = 0;
+    for (int i = 0; i < 13; i++) {
+      for (int j = 0; j < 19; j++) {
+        lon2[n] = -180.0 + 30.0 * i;
+        lat2[n] = -90.0 + 10.0 * j;
+        n++;
+      }
+    }
+    lon2[n] = lon1;
+    lat2[n++] = lat1;
+    lon2[n] = 0.0;
+    lat2[n++] = 90.0;
+    lon2[n] = 0.0;
+    lat2[n++] = -90.0;
+
+    if (g2r_batch(N, range, bearing, lon1, lat1, lon2, lat2) != 0 ||
+        r2g_batch(N, range, bearing, lon1, lat1, lon_result, lat_result) !=
+            0) {
+      printf("Batch conversion failed\n");
+      return 1;
+    }
+
+    for (int i = 0; i < N; i++) {
+      double r, b, lon, lat;
+      g2r(&r, &b, lon1, lat1, lon2[i], lat2[i]);
+      r2g(range[i], bearing[i], lon1, lat1, &lon, &lat);
+      if (r != range[i] || b != bearing[i] || lon != lon_result[i] ||
+          lat != lat_result[i]) {
+        printf("Mismatch from (%g, %g) to (%g, %g)\n", lon1, lat1, lon2[i],
+               lat2[i]);
+        mismatches++;
+      }
+    }
+  }
+
+  if (mismatches == 0) {
+    printf("Batch results are identical to the scalar ones\n");
+    return 0;
+  } else {
+    printf("%d batch results differ from the scalar ones\n", mismatches);
+    return 1;
+  }
+}
+
+int test_wgs84() {
+  printf("Testing g2r_wgs84 and r2g_wgs84...\n");
+  int failures = 0;
+
+  // Vincenty's example: Flinders Peak to Buninyong (Survey Review, 1975)
+  double lon1 = 144.0 + 25.0 / 60 + 29.52440 / 3600;
+  double lat1 = -(37.0 + 57.0 / 60 + 3.72030 / 3600);
+  double lon2 = 143.0 + 55.0 / 60 + 35.38390 / 3600;
+  double lat2 = -(37.0 + 39.0 / 60 + 10.15610 / 3600);
+  double range, bearing, lon, lat;
+  if (g2r_wgs84(&range, &bearing, lon1, lat1, lon2, lat2) != 0 ||
+      fabs(range - 54.972271) > 1e-6 ||
+      fabs(bearing - (306.0 + 52.0 / 60 + 5.37 / 3600)) > 1e-5) {
+    printf("Inverse mismatch: %.6f km, %.6f deg\n", range, bearing);
+    failures++;
+  }
+  if (r2g_wgs84(range, bearing, lon1, lat1, &lon, &lat) != 0 ||
+      fabs(lon - lon2) > EPSILON || fabs(lat - lat2) > EPSILON) {
+    printf("Direct mismatch: %.10f, %.10f\n", lon, lat);
+    failures++;
+  }
+
+  // The same example moved across 180 deg, and points more than 180 deg
+  // of longitude apart (the short way round is across 180 deg)
+  double r2, b2;
+  if (g2r_wgs84(&r2, &b2, lon1 + 35.6 - 360.0, lat1, lon2 + 35.6, lat2) !=
+          0 ||
+      fabs(r2 - range) > 1e-8 || fabs(b2 - bearing) > 1e-8 ||
+      r2g_wgs84(range, bearing, lon1 + 35.6 - 360.0, lat1, &lon, &lat) !=
+          0 ||
+      fabs(lon - (lon2 + 35.6)) > EPSILON || fabs(lat - lat2) > EPSILON) {
+    printf("Mismatch across 180 deg: %.6f km, %.6f deg\n", r2, b2);
+    failures++;
+  }
+  if (g2r_wgs84(&range, &bearing, -170.0, 37.0, 170.0, 10.0) != 0 ||
+      g2r_wgs84(&r2, &b2, 10.0, 37.0, -10.0, 10.0) != 0 ||
+      fabs(r2 - range) > 1e-8 || fabs(b2 - bearing) > 1e-8) {
+    printf("Mismatch over 180 deg apart: %.6f km, %.6f deg\n", range,
+           bearing);
+    failures++;
+  }
+
+  // Special cases, as for the sphere
+  g2r_wgs84(&range, &bearing, 20.0, 30.0, 20.0, 30.0);
+  if (range != 0.0 || bearing != UNDETERMINED_BEARING) {
+    printf("Same point: %g, %g\n", range, bearing);
+    failures++;
+  }
+  g2r_wgs84(&range, &bearing, 0.0, 90.0, 0.0, -90.0);
+  if (fabs(range - WGS84_POLE_TO_POLE) > 1e-6 ||
+      bearing != UNDETERMINED_BEARING) {
+    printf("Pole to pole: %.9f, %g\n", range, bearing);
+    failures++;
+  }
+  r2g_wgs84(WGS84_POLE_TO_POLE, UNDETERMINED_BEARING, 0.0, 90.0, &lon, &lat);
+  if (lon != 0.0 || lat != -90.0) {
+    printf("Pole to pole: %g, %g\n", lon, lat);
+    failures++;
+  }
+  if (g2r_wgs84(&range, &bearing, 0.0, 0.0, 179.8, 0.3) == 0) {
+    printf("Nearly antipodal points did not fail\n");
+    failures++;
+  }
+
+  // Roundtrip and batch from a radar site, out to 5000 km
+  enum { N = 36 * 50 };
+  double ranges[N], bearings[N], lons[N], lats[N], ranges2[N], bearings2[N];
+  for (int i = 0; i < 36; i++) {
+    for (int j = 0; j < 50; j++) {
+      ranges[i * 50 + j] = 100.0 * (j + 1);
+      bearings[i * 50 + j] = 10.0 * i;
+    }
+  }
+  if (r2g_wgs84_batch(N, ranges, bearings, -75.0, 37.0, lons, lats) != 0 ||
+      g2r_wgs84_batch(N, ranges2, bearings2, -75.0, 37.0, lons, lats) != 0) {
+    printf("Batch conversion failed\n");
+    return 1;
+  }
+  for (int i = 0; i < N; i++) {
+    double r, b;
+    r2g_wgs84(ranges[i], bearings[i], -75.0, 37.0, &lon, &lat);
+    g2r_wgs84(&r, &b, -75.0, 37.0, lons[i], lats[i]);
+    if (lon != lons[i] || lat != lats[i] || r != ranges2[i] ||
+        b != bearings2[i]) {
+      printf("Batch mismatch at %g km, %g deg\n", ranges[i], bearings[i]);
+      failures++;
+    }
+    double db = fabs(bearings2[i] - bearings[i]);
+    if (fabs(ranges2[i] - ranges[i]) > 1e-8 || fmin(db, 360.0 - db) > 1e-8) {
+      printf("Roundtrip mismatch at %g km, %g deg\n", ranges[i],
+             bearings[i]);
+      failures++;
+    }
+  }
+
+  if (failures == 0) {
+    printf("WGS-84 results match the reference and round trip\n");
+    return 0;
+  } else {
+    printf("%d WGS-84 failures\n", failures);
+    return 1;
+  }
+}
+
+int test_polar_table() {
+  printf("Testing polar lookup tables...\n");
+  int failures = 0;
+
+  // Sites: Wallops Islands, and one next to 180 deg for the wrap-around
+  const double sites[][2] = {{-75.0, 37.0}, {179.5, -20.0}};
+  for (int k = 0; k < 2; k++) {
+    for (int model = EARTH_SPHERE; model <= EARTH_WGS84; model++) {
+      double lon1 = sites[k][0];
+      double lat1 = sites[k][1];
+      struct polar_table table, mapped;
+      if (polar_table_build(&table, lon1, lat1, 6.0, 3.0, 200, 360,
+                            model) != 0) {
+        printf("Failed to build a table\n");
+        return 1;
+      }
+
+      // Nodes are the r2g results
+      for (uint32_t a = 0; a < 360; a += 7) {
+        for (uint32_t g = 0; g < 200; g += 3) {
+          double range = 6.0 + g * 3.0;
+          double bearing = a;
+          double lon, lat, lon_node, lat_node, lon_lookup, lat_lookup;
+          if (model == EARTH_WGS84) {
+            r2g_wgs84(range, bearing, lon1, lat1, &lon, &lat);
+          } else {
+            r2g(range, bearing, lon1, lat1, &lon, &lat);
+          }
+          polar_table_node(&table, g, a, &lon_node, &lat_node);
+          if (polar_table_lookup(&table, range, bearing, &lon_lookup,
+                                 &lat_lookup) != 0 ||
+              lon_node != lon || lat_node != lat ||
+              fabs(remainder(lon_lookup - lon, 360.0)) > EPSILON ||
+              fabs(lat_lookup - lat) > EPSILON) {
+            printf("Node mismatch at %g km, %g deg\n", range, bearing);
+            failures++;
+          }
+        }
+      }
+
+      // Off the table
+      double lon, lat;
+      if (polar_table_lookup(&table, 5.9, 10.0, &lon, &lat) == 0 ||
+          polar_table_lookup(&table, 6.0 + 199 * 3.0 + 0.1, 10.0, &lon,
+                             &lat) == 0 ||
+          polar_table_lookup(&table, 100.0, 360.0, &lon, &lat) == 0) {
+        printf("Lookup outside the table did not fail\n");
+        failures++;
+      }
+
+      // Interpolation error, out to 600 km with 1 deg bins
+      double error = polar_table_error(&table);
+      if (!(error < 0.05)) {
+        printf("Interpolation error of %g km\n", error);
+        failures++;
+      }
+
+      // Saved and mapped tables are identical
+      char path[] = "/tmp/coord-tran-polar-XXXXXX";
+      int fd = mkstemp(path);
+      if (fd < 0) {
+        printf("Failed to create a temporary file\n");
+        return 1;
+      }
+      close(fd);
+      if (polar_table_save(&table, path) != 0 ||
+          polar_table_map(&mapped, path) != 0) {
+        printf("Failed to save or map a table\n");
+        failures++;
+      } else {
+        if (memcmp(&table.header, &mapped.header, sizeof(table.header)) !=
+                0 ||
+            memcmp(table.nodes, mapped.nodes,
+                   2 * sizeof(double) * 200 * 360) != 0) {
+          printf("Mapped table differs\n");
+          failures++;
+        }
+        polar_table_free(&mapped);
+      }
+
+      // A header with an unknown Earth model is rejected
+      FILE *fp = fopen(path, "r+b");
+      uint32_t bad_model = 7;
+      if (fp == NULL ||
+          fseek(fp, offsetof(struct polar_header, model), SEEK_SET) != 0 ||
+          fwrite(&bad_model, sizeof(bad_model), 1, fp) != 1) {
+        printf("Failed to modify a table\n");
+        failures++;
+      }
+      if (fp != NULL) {
+        fclose(fp);
+      }
+      if (polar_table_map(&mapped, path) == 0) {
+        printf("Mapped a table with an invalid model\n");
+        polar_table_free(&mapped);
+        failures++;
+      }
+      unlink(path);
+      polar_table_free(&table);
+    }
+  }
+
+  if (failures == 0) {
+    printf("Tables match r2g at the nodes and interpolate within bounds\n");
+    return 0;
+  } else {
+    printf("%d polar table failures\n", failures);
+    return 1;
+  }
+}
+
+int test_stream_parse_format() {
+  printf("Testing stream number parsing and formatting...\n");
+
+  // Tokens for the parser, including ones that need the strtod fallback
+  const char *tokens[] = {"0",       "-0",          "+12.5",  "-75",
+                          "37.",     ".5",          "1e3",    "2.5E-3",
+                          "180.000", "0.1",         "1e-30",  "0x10",
+                          "123456789012345678", "20015.086796020572"};
+  const char *bad_tokens[] = {"", "-", ".", "1e", "abc", "1.2.3", "nan",
+                              "inf", "12a"};
+  int failures = 0;
+
+  for (size_t i = 0; i < sizeof(tokens) / sizeof(tokens[0]); i++) {
+    double value;
+    const char *t = tokens[i];
+    if (stream_parse_double(t, t + strlen(t), &value) != 0 ||
+        memcmp(&value, &(double){strtod(t, NULL)}, sizeof(value)) != 0) {
+      printf("Parse mismatch for '%s'\n", t);
+      failures++;
+    }
+  }
+  for (size_t i = 0; i < sizeof(bad_tokens) / sizeof(bad_tokens[0]); i++) {
+    double value;
+    const char *t = bad_tokens[i];
+    if (stream_parse_double(t, t + strlen(t), &value) == 0) {
+      printf("Parse accepted '%s'\n", t);
+      failures++;
+    }
+  }
+
+  // Random values in the output ranges, printed and parsed back, and
+  // formatted like printf (including near-ties and negative zero)
+  srand(1);
+  for (int i = 0; i < 200000; i++) {
+    double value = (rand() / (double)RAND_MAX - 0.5) * 40000.0;
+    if (i % 4 == 1) {
+      value = round(value * 1000.0) / 1000.0 + 0.0005;
+    } else if (i % 4 == 2) {
+      value = -(rand() % 100) * 1e-5;
+    }
+    int decimals = i % 5;
+
+    char expected[STREAM_FORMAT_MAX], got[STREAM_FORMAT_MAX];
+    snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+    int len = stream_format_fixed(got, value, decimals);
+    got[len] = '\0';
+    if (strcmp(expected, got) != 0) {
+      printf("Format mismatch: '%s' vs '%s'\n", expected, got);
+      failures++;
+    }
+
+    char text[64];
+    double parsed;
+    snprintf(text, sizeof(text), "%.*f", 3 + decimals, value);
+    if (stream_parse_double(text, text + strlen(text), &parsed) != 0 ||
+        parsed != strtod(text, NULL)) {
+      printf("Parse mismatch for '%s'\n", text);
+      failures++;
+    }
+  }
+
+  if (failures == 0) {
+    printf("Parsing and formatting match strtod and printf\n");
+    return 0;
+  } else {
+    printf("%d parsing or formatting mismatches\n", failures);
+    return 1;
+  }
+}
+
+/**
+ * Expected per-point output of a stream tool for one record, or "nan nan"
+ */
+void stream_expected(char *buf, size_t size, int tool_r2g, int wgs84,
+                     const double in[STREAM_NUM_IN]) {
+  double a, b;
+  int status;
+  if (!tool_r2g) {
+    if (in[0] < -180.0 || in[0] >= 180.0 || in[2] < -180.0 ||
+        in[2] >= 180.0 || fabs(in[1]) > 90.0 || fabs(in[3]) > 90.0) {
+      status = 1;
+    } else if (wgs84) {
+      status = g2r_wgs84(&a, &b, in[0], in[1], in[2], in[3]);
+    } else {
+      status = g2r(&a, &b, in[0], in[1], in[2], in[3]);
+    }
+  } else {
+    if (in[0] < -180.0 || in[0] >= 180.0 || fabs(in[1]) > 90.0 ||
+        in[2] < 0.0 || in[3] < 0.0 || in[3] >= 360.0) {
+      status = 1;
+    } else if (wgs84) {
+      status = r2g_wgs84(in[2], in[3], in[0], in[1], &a, &b);
+    } else {
+      status = r2g(in[2], in[3], in[0], in[1], &a, &b);
+    }
+  }
+  if (status != 0) {
+    snprintf(buf, size, "nan nan");
+  } else {
+    snprintf(buf, size, tool_r2g ? "%.4f %.4f" : "%.3f %.4f", a, b);
+  }
+}
+
+int test_stream_tools(const char *bindir) {
+  printf("Testing g2r and r2g --stream against per-point results...\n");
+
+  // Over 1 MiB of input, so several read chunks, with lines split between
+  // them, in each delimiter style, with skipped and malformed lines
+  enum { N = 40000 };
+  static char fields[N][STREAM_NUM_IN][24];
+  static int malformed[N];
+  const char *tools[] = {"g2r", "r2g"};
+  int failures = 0;
+
+  for (int tool = 0; tool < 2; tool++) {
+    for (int wgs84 = 0; wgs84 <= 1; wgs84++) {
+      char in_path[] = "/tmp/coord-tran-stream-in-XXXXXX";
+      char out_path[] = "/tmp/coord-tran-stream-out-XXXXXX";
+      int in_fd = mkstemp(in_path);
+      int out_fd = mkstemp(out_path);
+      FILE *in = in_fd < 0 ? NULL : fdopen(in_fd, "w");
+      if (in == NULL || out_fd < 0) {
+        printf("Failed to create temporary files\n");
+        return 1;
+      }
+      close(out_fd);
+
+      srand(2 + tool * 2 + wgs84);
+      for (int i = 0; i < N; i++) {
+        double v[STREAM_NUM_IN];
+        v[0] = (rand() / (RAND_MAX + 1.0) - 0.5) * 360.0;
+        v[1] = (rand() / (RAND_MAX + 1.0) - 0.5) * 160.0;
+        if (tool == 0) {
+          v[2] = (rand() / (RAND_MAX + 1.0) - 0.5) * 360.0;
+          v[3] = (rand() / (RAND_MAX + 1.0) - 0.5) * 160.0;
+        } else {
+          v[2] = rand() / (RAND_MAX + 1.0) * 5000.0;
+          v[3] = rand() / (RAND_MAX + 1.0) * 360.0;
+        }
+        if (i % 101 == 13) {
+          v[3] = 400.0; // Out of range, so invalid
+        }
+        for (int k = 0; k < STREAM_NUM_IN; k++) {
+          snprintf(fields[i][k], sizeof(fields[i][k]), "%.6f", v[k]);
+        }
+
+        malformed[i] = i % 97 == 5 || i % 89 == 7;
+        if (i % 50 == 1) {
+          fputs("\n# comment\n \t\n", in);
+        }
+        if (i % 97 == 5) {
+          fprintf(in, "%s %s %s\n", fields[i][0], fields[i][1],
+                  fields[i][2]);
+        } else if (i % 89 == 7) {
+          fprintf(in, "%s %s x%s %s\n", fields[i][0], fields[i][1],
+                  fields[i][2], fields[i][3]);
+        } else {
+          const char *formats[] = {"%s %s %s %s", "%s,%s,%s,%s",
+                                   " %s\t%s\t %s\t%s\r"};
+          fprintf(in, formats[i % 3], fields[i][0], fields[i][1],
+                  fields[i][2], fields[i][3]);
+          if (i + 1 < N) {
+            fputc('\n', in); // No newline after the last line
+          }
+        }
+      }
+      fclose(in);
+
+      // Read from a pipe, and from the file
+      const char *model = wgs84 ? "--wgs84" : "--sphere";
+      char command[512];
+      if (wgs84) {
+        snprintf(command, sizeof(command),
+                 "cat %s | %s/%s %s --stream > %s 2> /dev/null", in_path,
+                 bindir, tools[tool], model, out_path);
+      } else {
+        snprintf(command, sizeof(command),
+                 "%s/%s %s --stream %s > %s 2> /dev/null", bindir,
+                 tools[tool], model, in_path, out_path);
+      }
+      int status = system(command);
+      if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 1) {
+        printf("%s --stream did not exit with status 1\n", tools[tool]);
+        failures++;
+      }
+
+      FILE *out = fopen(out_path, "r");
+      if (out == NULL) {
+        printf("Failed to read the %s output\n", tools[tool]);
+        return 1;
+      }
+      char line[256], expected[256];
+      int lines = 0;
+      while (fgets(line, sizeof(line), out) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (lines >= N) {
+          lines++;
+          continue;
+        }
+        int i = lines++;
+        double v[STREAM_NUM_IN];
+        for (int k = 0; k < STREAM_NUM_IN; k++) {
+          v[k] = strtod(fields[i][k], NULL);
+        }
+        if (malformed[i]) {
+          snprintf(expected, sizeof(expected), "nan nan");
+        } else {
+          stream_expected(expected, sizeof(expected), tool, wgs84, v);
+        }
+
+        // And the tool itself on some of the records
+        if (i % 1000 == 0 || i % 101 == 13) {
+          FILE *p = NULL;
+          if (snprintf(command, sizeof(command),
+                       "%s/%s %s %s %s %s %s 2> /dev/null", bindir,
+                       tools[tool], model, fields[i][0], fields[i][1],
+                       fields[i][2], fields[i][3]) < (int)sizeof(command)) {
+            p = popen(command, "r");
+          }
+          char single[256] = "nan nan";
+          if (p == NULL) {
+            printf("Failed to run %s\n", tools[tool]);
+            return 1;
+          }
+          if (fgets(single, sizeof(single), p) != NULL) {
+            single[strcspn(single, "\n")] = '\0';
+          }
+          pclose(p);
+          if (!malformed[i] && strcmp(single, expected) != 0) {
+            printf("%s line %d: per-point '%s', expected '%s'\n",
+                   tools[tool], i + 1, single, expected);
+            failures++;
+          }
+        }
+
+        if (strcmp(line, expected) != 0) {
+          printf("%s %s line %d: '%s', expected '%s'\n", tools[tool], model,
+                 i + 1, line, expected);
+          failures++;
+        }
+      }
+      fclose(out);
+      if (lines != N) {
+        printf("%s %s: %d output lines, expected %d\n", tools[tool], model,
+               lines, N);
+        failures++;
+      }
+      unlink(in_path);
+      unlink(out_path);
+    }
+  }
+
+  if (failures == 0) {
+    printf("Streamed results match the per-point ones\n");
+    return 0;
+  } else {
+    printf("%d stream failures\n", failures);
+    return 1;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  // The tools are next to this program
+  char bindir[256] = ".";
+  const char *slash = argc > 0 ? strrchr(argv[0], '/') : NULL;
+  if (slash != NULL && (size_t)(slash - argv[0]) < sizeof(bindir)) {
+    memcpy(bindir, argv[0], slash - argv[0]);
+    bindir[slash - argv[0]] = '\0';
+  }
+
   int result = test_g2r_r2g_roundtrip();
+  result |= test_batch_matches_scalar();
+  result |= test_wgs84();
+  result |= test_polar_table();
+  result |= test_stream_parse_format();
+  result |= test_stream_tools(bindir);
   printf("Test %s\n", result == 0 ? "PASSED" : "FAILED");
 
   return result;
@@ -0,0 +1,404 @@
+/**
+ * @file
+ * @brief Coordinate transformation library: radar <-> geodetic,
+ * on the WGS-84 ellipsoid (Vincenty's direct and inverse formulae)
+ *
+ * T. Vincenty, "Direct and inverse solutions of geodesics on the ellipsoid
+ * with application of nested equations", Survey Review 23(176), 1975
+ */
+
+#include "lib.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define WGS84_B (WGS84_A * (1 - WGS84_F)) // Semi-minor axis (km)
+#define MAX_ITERATIONS 200 // Iteration limit (only reached near antipodes)
+#define TOLERANCE 1e-12    // Convergence tolerance (rad), about 6 um
+
+/**
+ * Convert degrees to radians
+ */
+static double deg2rad(double degrees) { return degrees * (M_PI / 180.0); }
+
+/**
+ * Convert radians to degrees
+ */
+static double rad2deg(double radians) { return radians * (180.0 / M_PI); }
+
+/**
+ * Per-origin ellipsoid terms shared by all conversions from the same
+ * initial point
+ */
+struct origin {
+  double lon;    // Initial longitude (deg)
+  double lat;    // Initial latitude (deg)
+  double lon1;   // Initial longitude (rad)
+  double sinU1;  // sin of the initial reduced latitude
+  double cosU1;  // cos of the initial reduced latitude
+};
+
+/**
+ * Per-bearing terms of the direct problem, shared by all ranges along the
+ * same bearing from the same origin (e.g., the gates of one radar beam)
+ */
+struct azimuth {
+  double bearing;  // Initial bearing (deg), NAN if not set
+  double sinAlpha1; // sin(initial azimuth)
+  double cosAlpha1; // cos(initial azimuth)
+  double sigma1;    // Angular distance from the equator to the origin
+  double sinAlpha;  // sin(azimuth at the equator)
+  double cos2Alpha; // cos^2(azimuth at the equator)
+  double A;         // Series coefficients of the distance
+  double B;
+  double C;         // Series coefficient of the longitude
+};
+
+/**
+ * Reduced latitude of a geodetic latitude (rad)
+ */
+static void reduced_latitude(double lat, double *sinU, double *cosU) {
+  double tanU = (1 - WGS84_F) * tan(lat);
+  *cosU = 1 / sqrt(1 + tanU * tanU);
+  *sinU = tanU * *cosU;
+}
+
+/**
+ * Series coefficients A and B of the distance, for u^2
+ */
+static void distance_coefficients(double uSq, double *A, double *B) {
+  *A = 1 + uSq / 16384 * (4096 + uSq * (-768 + uSq * (320 - 175 * uSq)));
+  *B = uSq / 1024 * (256 + uSq * (-128 + uSq * (74 - 47 * uSq)));
+}
+
+/**
+ * Series coefficient C of the longitude, for cos^2(alpha)
+ */
+static double longitude_coefficient(double cos2Alpha) {
+  return WGS84_F / 16 * cos2Alpha * (4 + WGS84_F * (4 - 3 * cos2Alpha));
+}
+
+/**
+ * Correction of the angular distance, Vincenty's Delta sigma
+ */
+static double delta_sigma(double B, double sinSigma, double cosSigma,
+                          double cos2SigmaM) {
+  double c2 = cos2SigmaM * cos2SigmaM;
+  return B * sinSigma *
+         (cos2SigmaM + B / 4 *
+                           (cosSigma * (-1 + 2 * c2) -
+                            B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma) *
+                                (-3 + 4 * c2)));
+}
+
+/**
+ * Compute the per-origin terms
+ */
+static void origin_init(struct origin *o, double lonInitial,
+                        double latInitial) {
+  o->lon = lonInitial;
+  o->lat = latInitial;
+  o->lon1 = deg2rad(lonInitial);
+  reduced_latitude(deg2rad(latInitial), &o->sinU1, &o->cosU1);
+}
+
+/**
+ * Compute the per-bearing terms
+ */
+static void azimuth_init(const struct origin *o, struct azimuth *az,
+                         double bearing) {
+  double alpha1 = deg2rad(bearing);
+  az->bearing = bearing;
+  az->sinAlpha1 = sin(alpha1);
+  az->cosAlpha1 = cos(alpha1);
+  az->sigma1 = atan2(o->sinU1, o->cosU1 * az->cosAlpha1);
+  az->sinAlpha = o->cosU1 * az->sinAlpha1;
+  az->cos2Alpha = 1 - az->sinAlpha * az->sinAlpha;
+  double uSq = az->cos2Alpha * (WGS84_A * WGS84_A - WGS84_B * WGS84_B) /
+               (WGS84_B * WGS84_B);
+  distance_coefficients(uSq, &az->A, &az->B);
+  az->C = longitude_coefficient(az->cos2Alpha);
+}
+
+/**
+ * Geodetic to Radar conversion from a prepared origin (see g2r_wgs84)
+ * Returns non-zero if the iteration does not converge
+ */
+static inline int g2r_origin(const struct origin *o, double *range,
+                             double *bearing, double lonFinal,
+                             double latFinal) {
+  // If the points are the same, range is zero and bearing is undetermined
+  if (o->lat == latFinal && o->lon == lonFinal) {
+    *range = 0.0;
+    *bearing = UNDETERMINED_BEARING;
+    return 0;
+  }
+
+  double sinU2, cosU2;
+  reduced_latitude(deg2rad(latFinal), &sinU2, &cosU2);
+  double sinU1sinU2 = o->sinU1 * sinU2;
+  double cosU1cosU2 = o->cosU1 * cosU2;
+
+  // Iterate on the longitude difference on the auxiliary sphere, the short
+  // way round (across 180 deg if that is shorter)
+  double L = remainder(deg2rad(lonFinal) - o->lon1, 2 * M_PI);
+  double lambda = L;
+  double sinLambda, cosLambda, sinSigma, cosSigma, sigma, cos2Alpha,
+      cos2SigmaM;
+  int iteration = 0;
+  for (;;) {
+    sinLambda = sin(lambda);
+    cosLambda = cos(lambda);
+    double y = cosU2 * sinLambda;
+    double x = o->cosU1 * sinU2 - o->sinU1 * cosU2 * cosLambda;
+    sinSigma = sqrt(y * y + x * x);
+    if (sinSigma == 0.0) {
+      // Coincident points (e.g., longitudes -180 and 180)
+      *range = 0.0;
+      *bearing = UNDETERMINED_BEARING;
+      return 0;
+    }
+    cosSigma = sinU1sinU2 + cosU1cosU2 * cosLambda;
+    sigma = atan2(sinSigma, cosSigma);
+    double sinAlpha = cosU1cosU2 * sinLambda / sinSigma;
+    cos2Alpha = 1 - sinAlpha * sinAlpha;
+    // On the equator cos2Alpha is zero, and so is the term it multiplies
+    cos2SigmaM =
+        cos2Alpha != 0.0 ? cosSigma - 2 * sinU1sinU2 / cos2Alpha : 0.0;
+    double C = longitude_coefficient(cos2Alpha);
+    double previous = lambda;
+    lambda = L + (1 - C) * WGS84_F * sinAlpha *
+                     (sigma + C * sinSigma *
+                                  (cos2SigmaM +
+                                   C * cosSigma *
+                                       (-1 + 2 * cos2SigmaM * cos2SigmaM)));
+    if (fabs(lambda - previous) < TOLERANCE) {
+      break;
+    }
+    if (++iteration == MAX_ITERATIONS || fabs(lambda) > M_PI) {
+      return 1; // Nearly antipodal points
+    }
+  }
+
+  // Calculate range (distance)
+  double uSq = cos2Alpha * (WGS84_A * WGS84_A - WGS84_B * WGS84_B) /
+               (WGS84_B * WGS84_B);
+  double A, B;
+  distance_coefficients(uSq, &A, &B);
+  *range = WGS84_B * A *
+           (sigma - delta_sigma(B, sinSigma, cosSigma, cos2SigmaM));
+
+  // If the points are at the poles (same or opposite pole), bearing is
+  // undetermined
+  if (fabs(o->lat) == 90.0 && fabs(latFinal) == 90.0) {
+    *bearing = UNDETERMINED_BEARING;
+    return 0;
+  }
+
+  // Calculate bearing
+  double bearing_rad =
+      atan2(cosU2 * sinLambda,
+            o->cosU1 * sinU2 - o->sinU1 * cosU2 * cosLambda);
+
+  // Convert bearing to degrees, normalized to [0, 360)
+  *bearing = fmod(rad2deg(bearing_rad) + 360.0, 360.0);
+  return 0;
+}
+
+/**
+ * Radar to Geodetic conversion from a prepared origin and bearing (see
+ * r2g_wgs84)
+ */
+static inline void r2g_origin(const struct origin *o, const struct azimuth *az,
+                              double range, double *lonFinal,
+                              double *latFinal) {
+  // If range is zero, stay where we are
+  if (range == 0.0) {
+    *lonFinal = o->lon;
+    *latFinal = o->lat;
+    return;
+  }
+
+  // If we are at a pole, and range is the meridian length, we go to the
+  // opposite pole and keep the same longitude
+  if (fabs(o->lat) == 90.0 && range == WGS84_POLE_TO_POLE) {
+    *latFinal = -o->lat;
+    *lonFinal = o->lon;
+    return;
+  }
+
+  // Iterate on the angular distance on the auxiliary sphere
+  double sigma0 = range / (WGS84_B * az->A);
+  double sigma = sigma0;
+  double sinSigma, cosSigma, cos2SigmaM;
+  for (int i = 0; i < MAX_ITERATIONS; i++) {
+    cos2SigmaM = cos(2 * az->sigma1 + sigma);
+    sinSigma = sin(sigma);
+    cosSigma = cos(sigma);
+    double previous = sigma;
+    sigma = sigma0 + delta_sigma(az->B, sinSigma, cosSigma, cos2SigmaM);
+    if (fabs(sigma - previous) < TOLERANCE) {
+      break;
+    }
+  }
+  cos2SigmaM = cos(2 * az->sigma1 + sigma);
+  sinSigma = sin(sigma);
+  cosSigma = cos(sigma);
+
+  // Calculate final latitude
+  double x = o->sinU1 * sinSigma - o->cosU1 * cosSigma * az->cosAlpha1;
+  double lat2 =
+      atan2(o->sinU1 * cosSigma + o->cosU1 * sinSigma * az->cosAlpha1,
+            (1 - WGS84_F) * sqrt(az->sinAlpha * az->sinAlpha + x * x));
+
+  // Calculate final longitude
+  // If we are at a pole, the final longitude is determined by the bearing
+  double lon2;
+  if (o->lat == 90.0) {
+    lon2 = M_PI - deg2rad(az->bearing);
+  } else if (o->lat == -90.0) {
+    lon2 = deg2rad(az->bearing);
+  } else {
+    double lambda = atan2(sinSigma * az->sinAlpha1,
+                          o->cosU1 * cosSigma -
+                              o->sinU1 * sinSigma * az->cosAlpha1);
+    double L = lambda - (1 - az->C) * WGS84_F * az->sinAlpha *
+                            (sigma + az->C * sinSigma *
+                                         (cos2SigmaM +
+                                          az->C * cosSigma *
+                                              (-1 + 2 * cos2SigmaM *
+                                                        cos2SigmaM)));
+    lon2 = o->lon1 + L;
+  }
+
+  // Convert back to degrees
+  *latFinal = rad2deg(lat2);
+  *lonFinal = rad2deg(lon2);
+
+  // Normalize longitude to [-180, 180)
+  *lonFinal = fmod(*lonFinal + 540.0, 360.0) - 180.0;
+}
+
+/**
+ * Geodetic to Radar conversion on the WGS-84 ellipsoid (Vincenty inverse)
+ *
+ * @param range Pointer to store the calculated range (km)
+ * @param bearing Pointer to store the calculated initial bearing (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Final longitude (deg)
+ * @param latFinal Final latitude (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int g2r_wgs84(double *range, double *bearing, double lonInitial,
+              double latInitial, double lonFinal, double latFinal) {
+
+  if (range == NULL || bearing == NULL) {
+    return -1; // Invalid pointers
+  }
+
+  struct origin o;
+  origin_init(&o, lonInitial, latInitial);
+  return g2r_origin(&o, range, bearing, lonFinal, latFinal);
+}
+
+/**
+ * Radar to Geodetic conversion on the WGS-84 ellipsoid (Vincenty direct)
+ *
+ * @param range Distance from initial point (km)
+ * @param bearing Initial bearing (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Pointer to store calculated final longitude (deg)
+ * @param latFinal Pointer to store calculated final latitude (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int r2g_wgs84(double range, double bearing, double lonInitial,
+              double latInitial, double *lonFinal, double *latFinal) {
+
+  if (lonFinal == NULL || latFinal == NULL) {
+    return -1; // Invalid pointers
+  }
+
+  struct origin o;
+  struct azimuth az;
+  origin_init(&o, lonInitial, latInitial);
+  azimuth_init(&o, &az, bearing);
+  r2g_origin(&o, &az, range, lonFinal, latFinal);
+  return 0;
+}
+
+/**
+ * Batch Geodetic to Radar conversion on the WGS-84 ellipsoid from one
+ * initial point
+ *
+ * @param n Number of points
+ * @param range Array to store the calculated ranges (km)
+ * @param bearing Array to store the calculated initial bearings (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Array of final longitudes (deg)
+ * @param latFinal Array of final latitudes (deg)
+ * @return 0 on success, non-zero if any point failed
+ */
+int g2r_wgs84_batch(size_t n, double *restrict range,
+                    double *restrict bearing, double lonInitial,
+                    double latInitial, const double *restrict lonFinal,
+                    const double *restrict latFinal) {
+
+  if (n > 0 && (range == NULL || bearing == NULL || lonFinal == NULL ||
+                latFinal == NULL)) {
+    return -1; // Invalid pointers
+  }
+
+  // The origin terms are computed once for the whole batch
+  struct origin o;
+  origin_init(&o, lonInitial, latInitial);
+  int status = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (g2r_origin(&o, &range[i], &bearing[i], lonFinal[i], latFinal[i]) !=
+        0) {
+      range[i] = NAN;
+      bearing[i] = NAN;
+      status = 1;
+    }
+  }
+  return status;
+}
+
+/**
+ * Batch Radar to Geodetic conversion on the WGS-84 ellipsoid from one
+ * initial point
+ *
+ * @param n Number of points
+ * @param range Array of distances from the initial point (km)
+ * @param bearing Array of initial bearings (deg)
+ * @param lonInitial Initial longitude (deg)
+ * @param latInitial Initial latitude (deg)
+ * @param lonFinal Array to store the calculated final longitudes (deg)
+ * @param latFinal Array to store the calculated final latitudes (deg)
+ * @return 0 on success, non-zero on failure
+ */
+int r2g_wgs84_batch(size_t n, const double *restrict range,
+                    const double *restrict bearing, double lonInitial,
+                    double latInitial, double *restrict lonFinal,
+                    double *restrict latFinal) {
+
+  if (n > 0 && (range == NULL || bearing == NULL || lonFinal == NULL ||
+                latFinal == NULL)) {
+    return -1; // Invalid pointers
+  }
+
+  // The origin terms are computed once for the whole batch, and the bearing
+  // terms once per run of points with the same bearing
+  struct origin o;
+  struct azimuth az;
+  origin_init(&o, lonInitial, latInitial);
+  az.bearing = NAN;
+  for (size_t i = 0; i < n; i++) {
+    if (bearing[i] != az.bearing) {
+      azimuth_init(&o, &az, bearing[i]);
+    }
+    r2g_origin(&o, &az, range[i], &lonFinal[i], &latFinal[i]);
+  }
+  return 0;
+}
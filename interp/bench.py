@@ -0,0 +1,144 @@
+#!/usr/bin/env -S uv run --script
+"""
+Compare the native k-d tree IDW (src/idw.c) with the NumPy `idw()` of plots.py
+for growing numbers of observations (N) and grid points (M).
+"""
+# /// script
+# dependencies = [
+#   "numpy",
+# ]
+# ///
+
+from __future__ import annotations
+
+import ctypes
+import math
+import time
+from pathlib import Path
+
+HERE = Path(__file__).parent
+
+# Largest distance matrix of the NumPy method (it makes a few of them)
+NUMPY_MAX_BYTES = 1 << 29
+
+
+class IdwOptions(ctypes.Structure):
+    _fields_ = [
+        ("power", ctypes.c_double),
+        ("k", ctypes.c_int),
+        ("radius", ctypes.c_double),
+        ("fill", ctypes.c_double),
+    ]
+
+
+def load_library() -> ctypes.CDLL:
+    """Load the shared library built by `make -C src`."""
+    lib = ctypes.CDLL(str(HERE / "bin" / "libidw.so"))
+    p = ctypes.POINTER(ctypes.c_double)
+    lib.idw_tree_build.restype = ctypes.c_void_p
+    lib.idw_tree_build.argtypes = [ctypes.c_size_t, p, p, p, ctypes.c_int]
+    lib.idw_tree_free.argtypes = [ctypes.c_void_p]
+    lib.idw_points.restype = ctypes.c_int
+    lib.idw_points.argtypes = [
+        ctypes.c_void_p,
+        ctypes.POINTER(IdwOptions),
+        ctypes.c_size_t,
+        p,
+        p,
+        p,
+        ctypes.c_int,
+    ]
+    return lib
+
+
+def idw_native(lib, xi, yi, zi, xg, yg, *, power=2, k=0, radius=0.0, threads=0):
+    """Same as `idw()` with k=0 and radius=0 (planar distance),
+    else with only the k nearest and/or those within the radius.
+    Returns the values and the build and interpolation times (s)."""
+    import numpy as np
+
+    def ptr(a):
+        return a.ctypes.data_as(ctypes.POINTER(ctypes.c_double))
+
+    xi, yi, zi, xg, yg = (
+        np.ascontiguousarray(a, dtype=np.float64) for a in (xi, yi, zi, xg, yg)
+    )
+    t0 = time.perf_counter()
+    tree = lib.idw_tree_build(xi.size, ptr(xi), ptr(yi), ptr(zi), 0)
+    t1 = time.perf_counter()
+    if not tree:
+        raise MemoryError("idw_tree_build failed")
+    zg = np.empty_like(xg)
+    opt = IdwOptions(power, k, radius, math.nan)
+    try:
+        if (
+            lib.idw_points(
+                tree, ctypes.byref(opt), xg.size, ptr(xg), ptr(yg), ptr(zg), threads
+            )
+            != 0
+        ):
+            raise RuntimeError("idw_points failed")
+    finally:
+        t2 = time.perf_counter()
+        lib.idw_tree_free(tree)
+    return zg, t1 - t0, t2 - t1
+
+
+def main() -> None:
+    import argparse
+
+    import numpy as np
+
+    from plots import idw
+
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument(
+        "-j",
+        "--threads",
+        type=int,
+        default=0,
+        help="Threads of the native method (default: one per processor).",
+    )
+    args = parser.parse_args()
+
+    lib = load_library()
+    rng = np.random.default_rng(1)
+
+    print(
+        f"{'N':>8} {'M':>8} {'numpy(s)':>10} {'all(s)':>10} {'k=16(s)':>10} {'build(s)':>10} {'max diff':>10}"
+    )
+    for n in [100, 1_000, 10_000, 100_000]:
+        xi = rng.uniform(121, 131, n)
+        yi = rng.uniform(10, 16, n)
+        zi = rng.uniform(0, 10, n)
+        for m in [10_000, 100_000, 1_000_000]:
+            xg = rng.uniform(121, 131, m)
+            yg = rng.uniform(10, 16, m)
+
+            t_numpy = diff = math.nan
+            if n * m * 8 <= NUMPY_MAX_BYTES:
+                t0 = time.perf_counter()
+                z_numpy = idw(xi, yi, zi, xg, yg)
+                t_numpy = time.perf_counter() - t0
+
+            t_all = math.nan
+            if n * m <= 1e9:
+                z_all, _, t_all = idw_native(
+                    lib, xi, yi, zi, xg, yg, threads=args.threads
+                )
+                if not math.isnan(t_numpy):
+                    diff = np.max(
+                        np.abs(z_all - z_numpy) / np.maximum(np.abs(z_numpy), 1)
+                    )
+
+            _, t_build, t_knn = idw_native(
+                lib, xi, yi, zi, xg, yg, k=16, threads=args.threads
+            )
+            print(
+                f"{n:8d} {m:8d} {t_numpy:10.3f} {t_all:10.3f} {t_knn:10.3f} {t_build:10.4f} {diff:10.1e}",
+                flush=True,
+            )
+
+
+if __name__ == "__main__":
+    main()
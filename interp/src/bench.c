@@ -0,0 +1,204 @@
+/**
+ * bench - Benchmarks for the IDW interpolation library
+ *
+ * Times building the tree and interpolating to grids for growing numbers
+ * of observations (N) and grid points (M), with the k nearest, within a
+ * radius, and with all observations (the dense method of plots.py, for
+ * the smaller sizes); then the scaling of a large grid with threads.
+ * bench.py compares the same sizes with the NumPy implementation.
+ * Then the same for natural neighbor interpolation: building the
+ * triangulation along the curve and by inserting the points one by one
+ * in random order, and the grids.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "idw.h"
+#include "nn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Observations and grid over the same region (degrees)
+#define LON0 -130.0
+#define LON1 -60.0
+#define LAT0 20.0
+#define LAT1 55.0
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double uniform(double lo, double hi) {
+  return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+/* Counts the streamed values, so the rows are not optimized away */
+static int count_row(size_t row, const double *values, void *ctx) {
+  (void)row;
+  *(double *)ctx += values[0];
+  return 0;
+}
+
+/**
+ * Square-ish grid of about m points over the region
+ */
+static struct idw_grid make_grid(size_t m) {
+  size_t ny = 1;
+  while (ny * ny * 2 < m) {
+    ny++;
+  }
+  size_t nx = (m + ny - 1) / ny;
+  struct idw_grid grid = {LON0, (LON1 - LON0) / (nx - 1), LAT0,
+                          (LAT1 - LAT0) / (ny > 1 ? ny - 1 : 1), nx, ny};
+  return grid;
+}
+
+/**
+ * Time one configuration; returns the seconds of the grid, or -1 on error
+ */
+static double time_grid(const struct idw_tree *tree,
+                        const struct idw_options *opt,
+                        const struct idw_grid *grid, int threads) {
+  double sink = 0.0;
+  double t0 = now();
+  if (idw_grid_stream(tree, opt, grid, threads, count_row, &sink) != 0) {
+    return -1.0;
+  }
+  return now() - t0;
+}
+
+int main(void) {
+  const size_t sizes_n[] = {1000, 10000, 100000, 1000000};
+  const size_t sizes_m[] = {10000, 100000, 1000000};
+  const int num_n = sizeof(sizes_n) / sizeof(sizes_n[0]);
+  const int num_m = sizeof(sizes_m) / sizeof(sizes_m[0]);
+  const size_t max_n = sizes_n[num_n - 1];
+
+  double *x = malloc(max_n * sizeof(double));
+  double *y = malloc(max_n * sizeof(double));
+  double *z = malloc(max_n * sizeof(double));
+  if (!x || !y || !z) {
+    fprintf(stderr, "Error: Allocation failed.\n");
+    return 1;
+  }
+  srand(1);
+  for (size_t i = 0; i < max_n; i++) {
+    x[i] = uniform(LON0, LON1);
+    y[i] = uniform(LAT0, LAT1);
+    z[i] = uniform(0.0, 50.0);
+  }
+
+  const struct {
+    const char *name;
+    struct idw_options opt;
+    size_t max_nm; // Largest N * M to run
+  } methods[] = {
+      {"k=16", {2.0, 16, 0.0, NAN}, (size_t)-1},
+      {"r=100km", {2.0, 0, 100.0, NAN}, (size_t)-1},
+      {"all", {2.0, 0, 0.0, NAN}, 200000000},
+  };
+  const int num_methods = sizeof(methods) / sizeof(methods[0]);
+
+  printf("Sphere, one thread; build ms, then grid points/s\n");
+  printf("%8s %8s %9s", "N", "M", "build");
+  for (int k = 0; k < num_methods; k++) {
+    printf(" %12s", methods[k].name);
+  }
+  printf("\n");
+  for (int i = 0; i < num_n; i++) {
+    double t0 = now();
+    struct idw_tree *tree = idw_tree_build(sizes_n[i], x, y, z, IDW_SPHERE);
+    double build = now() - t0;
+    if (tree == NULL) {
+      fprintf(stderr, "Error: Failed to build the tree.\n");
+      return 1;
+    }
+    for (int j = 0; j < num_m; j++) {
+      struct idw_grid grid = make_grid(sizes_m[j]);
+      size_t m = grid.nx * grid.ny;
+      printf("%8zu %8zu %9.1f", sizes_n[i], m, build * 1e3);
+      for (int k = 0; k < num_methods; k++) {
+        if (sizes_n[i] * m > methods[k].max_nm) {
+          printf(" %12s", "-");
+          continue;
+        }
+        double t = time_grid(tree, &methods[k].opt, &grid, 1);
+        if (t < 0.0) {
+          fprintf(stderr, "Error: Interpolation failed.\n");
+          return 1;
+        }
+        printf(" %12.0f", m / t);
+      }
+      printf("\n");
+      fflush(stdout);
+    }
+    idw_tree_free(tree);
+  }
+
+  // Thread scaling for the largest tree and grid
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  struct idw_tree *tree = idw_tree_build(max_n, x, y, z, IDW_SPHERE);
+  struct idw_grid grid = make_grid(sizes_m[num_m - 1]);
+  printf("\nThreads (N %zu, M %zu, k=16), %ld processors\n", max_n,
+         grid.nx * grid.ny, cpus);
+  printf("%8s %12s %8s\n", "threads", "points/s", "speedup");
+  double t1 = 0.0;
+  for (int threads = 1; threads <= (cpus > 1 ? cpus : 1); threads *= 2) {
+    double t = time_grid(tree, &methods[0].opt, &grid, threads);
+    t1 = threads == 1 ? t : t1;
+    printf("%8d %12.0f %8.2f\n", threads, grid.nx * grid.ny / t, t1 / t);
+  }
+  idw_tree_free(tree);
+
+  // Natural neighbor: both builds, then the grids (one thread, and all)
+  printf("\nNatural neighbor; build and insert ms, then grid points/s\n");
+  printf("%8s %8s %9s %9s %12s %12s\n", "N", "M", "build", "insert",
+         "1 thread", "threads");
+  for (int i = 1; i < num_n; i++) {
+    double t0 = now();
+    struct nn_tri *tri = nn_build(sizes_n[i], x, y, z);
+    double build = now() - t0;
+    struct nn_tri *inserted = nn_create();
+    t0 = now();
+    for (size_t j = 0; inserted != NULL && j < sizes_n[i]; j++) {
+      if (nn_insert(inserted, x[j], y[j], z[j]) < 0) {
+        nn_free(inserted);
+        inserted = NULL;
+      }
+    }
+    double insert = now() - t0;
+    if (tri == NULL || inserted == NULL) {
+      fprintf(stderr, "Error: Failed to triangulate.\n");
+      return 1;
+    }
+    nn_free(inserted);
+    for (int j = 1; j < num_m; j++) {
+      struct idw_grid grid = make_grid(sizes_m[j]);
+      size_t m = grid.nx * grid.ny;
+      printf("%8zu %8zu %9.1f %9.1f", sizes_n[i], m, build * 1e3,
+             insert * 1e3);
+      for (int threads = 1; threads >= 0; threads--) {
+        double sink = 0.0;
+        t0 = now();
+        if (nn_grid_stream(tri, &grid, NAN, threads, count_row, &sink) != 0) {
+          fprintf(stderr, "Error: Interpolation failed.\n");
+          return 1;
+        }
+        printf(" %12.0f", m / (now() - t0));
+      }
+      printf("\n");
+      fflush(stdout);
+    }
+    nn_free(tri);
+  }
+
+  free(x);
+  free(y);
+  free(z);
+  return 0;
+}
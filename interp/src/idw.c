@@ -0,0 +1,467 @@
+/**
+ * @file
+ * @brief Inverse distance weighting interpolation with a k-d tree
+ */
+
+#include "idw.h"
+#include "lib.h"
+#include "par.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEAF_SIZE 16       // Most observations in a leaf
+#define STACK_NEIGHBORS 64 // Largest k without allocating in idw_point
+
+/**
+ * Node of the tree, covering observations [begin, end) with a bounding box
+ */
+struct node {
+  size_t begin, end;
+  size_t left, right; // Child nodes (0 for a leaf)
+  double lo[3], hi[3];
+};
+
+struct idw_tree {
+  enum idw_metric metric;
+  int dim;          // 2 for the plane, 3 for the unit sphere
+  size_t n;         // Number of observations
+  double *p;        // Coordinates (3 per observation), in tree order
+  double *z;        // Values, in tree order
+  struct node *nodes;
+  size_t num_nodes;
+};
+
+/**
+ * Neighbor in a query: squared distance in the tree's coordinates
+ */
+struct neighbor {
+  double d2;
+  size_t i;
+};
+
+/**
+ * Options converted to the tree's coordinates
+ */
+struct query {
+  const struct idw_tree *tree;
+  const struct idw_options *opt;
+  double max_d2; // Squared radius (chord on the sphere), or INFINITY
+};
+
+/**
+ * Coordinates of a point in the tree's space
+ */
+static void to_tree(enum idw_metric metric, double x, double y,
+                    double p[3]) {
+  if (metric == IDW_SPHERE) {
+    double lon = x * (M_PI / 180.0);
+    double lat = y * (M_PI / 180.0);
+    p[0] = cos(lat) * cos(lon);
+    p[1] = cos(lat) * sin(lon);
+    p[2] = sin(lat);
+  } else {
+    p[0] = x;
+    p[1] = y;
+    p[2] = 0.0;
+  }
+}
+
+/**
+ * Distance from the squared distance in the tree's space; on the sphere,
+ * a = (chord / 2)^2 is the haversine of the central angle, as in g2r
+ */
+static double distance(enum idw_metric metric, double d2) {
+  if (metric == IDW_SPHERE) {
+    double a = d2 / 4.0;
+    return EARTH_RADIUS * 2 * atan2(sqrt(a), sqrt(1 - a));
+  }
+  return sqrt(d2);
+}
+
+static double dist2(const double *a, const double *b) {
+  double dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+  return dx * dx + dy * dy + dz * dz;
+}
+
+/**
+ * Squared distance from a point to a node's bounding box
+ */
+static double box_dist2(const struct node *nd, const double *p) {
+  double s = 0.0;
+  for (int d = 0; d < 3; d++) {
+    double e = p[d] < nd->lo[d] ? nd->lo[d] - p[d]
+               : p[d] > nd->hi[d] ? p[d] - nd->hi[d]
+                                  : 0.0;
+    s += e * e;
+  }
+  return s;
+}
+
+static void swap_obs(struct idw_tree *t, size_t a, size_t b) {
+  double tmp[3];
+  memcpy(tmp, &t->p[3 * a], sizeof(tmp));
+  memcpy(&t->p[3 * a], &t->p[3 * b], sizeof(tmp));
+  memcpy(&t->p[3 * b], tmp, sizeof(tmp));
+  double z = t->z[a];
+  t->z[a] = t->z[b];
+  t->z[b] = z;
+}
+
+/**
+ * Partially sort [begin, end) by coordinate d so that k is in its sorted
+ * place (quickselect)
+ */
+static void select_obs(struct idw_tree *t, size_t begin, size_t end, size_t k,
+                       int d) {
+  while (end - begin > 1) {
+    double pivot = t->p[3 * (begin + (end - begin) / 2) + d];
+    size_t i = begin, j = end - 1;
+    while (i <= j) {
+      while (t->p[3 * i + d] < pivot) {
+        i++;
+      }
+      while (t->p[3 * j + d] > pivot) {
+        j--;
+      }
+      if (i <= j) {
+        swap_obs(t, i, j);
+        i++;
+        if (j == 0) {
+          break;
+        }
+        j--;
+      }
+    }
+    // Now [begin, j] <= pivot <= [i, end)
+    if (k <= j) {
+      end = j + 1;
+    } else if (k >= i) {
+      begin = i;
+    } else {
+      return;
+    }
+  }
+}
+
+/**
+ * Build the subtree of [begin, end) at node index `index`
+ */
+static void build(struct idw_tree *t, size_t index, size_t begin,
+                  size_t end) {
+  struct node *nd = &t->nodes[index];
+  nd->begin = begin;
+  nd->end = end;
+  nd->left = nd->right = 0;
+  for (int d = 0; d < 3; d++) {
+    nd->lo[d] = nd->hi[d] = t->p[3 * begin + d];
+  }
+  for (size_t i = begin + 1; i < end; i++) {
+    for (int d = 0; d < 3; d++) {
+      double v = t->p[3 * i + d];
+      nd->lo[d] = v < nd->lo[d] ? v : nd->lo[d];
+      nd->hi[d] = v > nd->hi[d] ? v : nd->hi[d];
+    }
+  }
+  if (end - begin <= LEAF_SIZE) {
+    return;
+  }
+
+  // Split the widest dimension at the median
+  int split = 0;
+  for (int d = 1; d < t->dim; d++) {
+    if (nd->hi[d] - nd->lo[d] > nd->hi[split] - nd->lo[split]) {
+      split = d;
+    }
+  }
+  size_t mid = begin + (end - begin) / 2;
+  select_obs(t, begin, end, mid, split);
+
+  size_t left = t->num_nodes++;
+  size_t right = t->num_nodes++;
+  t->nodes[index].left = left;
+  t->nodes[index].right = right;
+  build(t, left, begin, mid);
+  build(t, right, mid, end);
+}
+
+struct idw_tree *idw_tree_build(size_t n, const double *x, const double *y,
+                                const double *z, enum idw_metric metric) {
+  if (n == 0 || x == NULL || y == NULL || z == NULL) {
+    return NULL;
+  }
+  struct idw_tree *t = calloc(1, sizeof(*t));
+  if (t == NULL) {
+    return NULL;
+  }
+  t->metric = metric;
+  t->dim = metric == IDW_SPHERE ? 3 : 2;
+  t->n = n;
+  t->p = malloc(3 * n * sizeof(double));
+  t->z = malloc(n * sizeof(double));
+  // A tree with leaves of more than LEAF_SIZE / 2 has fewer than
+  // 4 n / LEAF_SIZE + 1 nodes
+  t->nodes = malloc((4 * n / LEAF_SIZE + 1) * sizeof(struct node));
+  if (t->p == NULL || t->z == NULL || t->nodes == NULL) {
+    idw_tree_free(t);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    to_tree(metric, x[i], y[i], &t->p[3 * i]);
+    t->z[i] = z[i];
+  }
+  t->num_nodes = 1;
+  build(t, 0, 0, n);
+  return t;
+}
+
+void idw_tree_free(struct idw_tree *tree) {
+  if (tree != NULL) {
+    free(tree->p);
+    free(tree->z);
+    free(tree->nodes);
+    free(tree);
+  }
+}
+
+/**
+ * Sums of a weighted mean; observations at distance zero are counted
+ * apart and take all the weight
+ */
+struct sums {
+  double w, wz;
+  size_t num_zero;
+  double z_zero;
+};
+
+static void add(struct sums *s, const struct query *q, double d2, double z) {
+  if (d2 == 0.0) {
+    s->num_zero++;
+    s->z_zero += z;
+    return;
+  }
+  double d = distance(q->tree->metric, d2);
+  double w = q->opt->power == 2.0 ? 1.0 / (d * d) : pow(d, -q->opt->power);
+  s->w += w;
+  s->wz += w * z;
+}
+
+static double mean(const struct sums *s, const struct query *q) {
+  if (s->num_zero > 0) {
+    return s->z_zero / s->num_zero;
+  }
+  return s->w > 0.0 ? s->wz / s->w : q->opt->fill;
+}
+
+/**
+ * Add all observations within the radius of the subtree at `index`
+ */
+static void sum_radius(const struct query *q, size_t index, const double *p,
+                       struct sums *s) {
+  const struct idw_tree *t = q->tree;
+  const struct node *nd = &t->nodes[index];
+  if (box_dist2(nd, p) > q->max_d2) {
+    return;
+  }
+  if (nd->left == 0) {
+    for (size_t i = nd->begin; i < nd->end; i++) {
+      double d2 = dist2(p, &t->p[3 * i]);
+      if (d2 <= q->max_d2) {
+        add(s, q, d2, t->z[i]);
+      }
+    }
+    return;
+  }
+  sum_radius(q, nd->left, p, s);
+  sum_radius(q, nd->right, p, s);
+}
+
+/**
+ * Max-heap of the k nearest neighbors so far
+ */
+struct heap {
+  struct neighbor *a;
+  int size, k;
+};
+
+static void heap_push(struct heap *h, double d2, size_t i) {
+  struct neighbor *a = h->a;
+  int c;
+  if (h->size < h->k) {
+    // Sift up from the end
+    c = h->size++;
+    while (c > 0 && a[(c - 1) / 2].d2 < d2) {
+      a[c] = a[(c - 1) / 2];
+      c = (c - 1) / 2;
+    }
+  } else {
+    // Replace the farthest and sift down
+    c = 0;
+    for (;;) {
+      int child = 2 * c + 1;
+      if (child >= h->size) {
+        break;
+      }
+      if (child + 1 < h->size && a[child + 1].d2 > a[child].d2) {
+        child++;
+      }
+      if (a[child].d2 <= d2) {
+        break;
+      }
+      a[c] = a[child];
+      c = child;
+    }
+  }
+  a[c] = (struct neighbor){d2, i};
+}
+
+/**
+ * Squared distance beyond which no neighbor is needed
+ */
+static double heap_bound(const struct heap *h, const struct query *q) {
+  return h->size < h->k ? q->max_d2 : h->a[0].d2;
+}
+
+/**
+ * Find the k nearest within the radius in the subtree at `index`, nearer
+ * child first
+ */
+static void search_knn(const struct query *q, size_t index, const double *p,
+                       struct heap *h) {
+  const struct idw_tree *t = q->tree;
+  const struct node *nd = &t->nodes[index];
+  if (nd->left == 0) {
+    for (size_t i = nd->begin; i < nd->end; i++) {
+      double d2 = dist2(p, &t->p[3 * i]);
+      if (h->size < h->k ? d2 <= q->max_d2 : d2 < h->a[0].d2) {
+        heap_push(h, d2, i);
+      }
+    }
+    return;
+  }
+  size_t near = nd->left, far = nd->right;
+  double d_near = box_dist2(&t->nodes[near], p);
+  double d_far = box_dist2(&t->nodes[far], p);
+  if (d_far < d_near) {
+    size_t tmp = near;
+    near = far;
+    far = tmp;
+    double d = d_near;
+    d_near = d_far;
+    d_far = d;
+  }
+  if (d_near <= heap_bound(h, q)) {
+    search_knn(q, near, p, h);
+  }
+  if (d_far <= heap_bound(h, q)) {
+    search_knn(q, far, p, h);
+  }
+}
+
+static void query_init(struct query *q, const struct idw_tree *tree,
+                       const struct idw_options *opt) {
+  q->tree = tree;
+  q->opt = opt;
+  q->max_d2 = INFINITY;
+  if (opt->radius > 0.0) {
+    if (tree->metric == IDW_SPHERE) {
+      // Chord of the great-circle radius, if less than half way round
+      double angle = opt->radius / EARTH_RADIUS;
+      if (angle < M_PI) {
+        double chord = 2.0 * sin(angle / 2.0);
+        q->max_d2 = chord * chord;
+      }
+    } else {
+      q->max_d2 = opt->radius * opt->radius;
+    }
+  }
+}
+
+/**
+ * Interpolate to one point, with room for k neighbors in `buf`
+ */
+static double query_point(const struct query *q, double x, double y,
+                          struct neighbor *buf) {
+  const struct idw_tree *t = q->tree;
+  double p[3];
+  to_tree(t->metric, x, y, p);
+  struct sums s = {0};
+
+  if (q->opt->k > 0 && (size_t)q->opt->k < t->n) {
+    struct heap h = {buf, 0, q->opt->k};
+    search_knn(q, 0, p, &h);
+    for (int j = 0; j < h.size; j++) {
+      add(&s, q, h.a[j].d2, t->z[h.a[j].i]);
+    }
+  } else if (q->max_d2 < INFINITY) {
+    sum_radius(q, 0, p, &s);
+  } else {
+    for (size_t i = 0; i < t->n; i++) {
+      add(&s, q, dist2(p, &t->p[3 * i]), t->z[i]);
+    }
+  }
+  return mean(&s, q);
+}
+
+double idw_point(const struct idw_tree *tree, const struct idw_options *opt,
+                 double x, double y) {
+  struct query q;
+  query_init(&q, tree, opt);
+  struct neighbor stack[STACK_NEIGHBORS];
+  struct neighbor *buf = stack;
+  if (opt->k > STACK_NEIGHBORS) {
+    buf = malloc(opt->k * sizeof(*buf));
+    if (buf == NULL) {
+      return NAN;
+    }
+  }
+  double z = query_point(&q, x, y, buf);
+  if (buf != stack) {
+    free(buf);
+  }
+  return z;
+}
+
+/**
+ * Interpolate points [begin, end) (par_fn)
+ */
+static int eval_points(const struct par_points *points, size_t begin,
+                       size_t end, double *z, void *ctx) {
+  const struct query *q = ctx;
+  int k = q->opt->k > 0 ? q->opt->k : 1;
+  struct neighbor *buf = malloc(k * sizeof(*buf));
+  if (buf == NULL) {
+    return 1;
+  }
+  for (size_t i = begin; i < end; i++) {
+    double x, y;
+    par_point(points, i, &x, &y);
+    z[i] = query_point(q, x, y, buf);
+  }
+  free(buf);
+  return 0;
+}
+
+int idw_points(const struct idw_tree *tree, const struct idw_options *opt,
+               size_t n, const double *x, const double *y, double *z,
+               int num_threads) {
+  if (tree == NULL || opt == NULL) {
+    return -1;
+  }
+  struct query q;
+  query_init(&q, tree, opt);
+  return par_points(n, x, y, z, num_threads, eval_points, &q);
+}
+
+int idw_grid_stream(const struct idw_tree *tree,
+                    const struct idw_options *opt,
+                    const struct idw_grid *grid, int num_threads,
+                    idw_row_fn fn, void *ctx) {
+  if (tree == NULL || opt == NULL || grid == NULL || fn == NULL) {
+    return -1;
+  }
+  struct query q;
+  query_init(&q, tree, opt);
+  return par_grid_stream(grid, num_threads, eval_points, &q, fn, ctx);
+}
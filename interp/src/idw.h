@@ -0,0 +1,144 @@
+/**
+ * @file
+ * @brief Inverse distance weighting (IDW) interpolation with a k-d tree
+ *
+ * Interpolates scattered observations to any number of points, using only
+ * the k nearest observations, or the ones within a radius, or both, instead
+ * of all of them. The observations are put in a k-d tree once; each query
+ * then visits only the nodes that can hold neighbors, so memory is linear
+ * in the number of observations and the time per point is logarithmic.
+ *
+ * Two metrics are supported:
+ *
+ * - IDW_PLANE: Euclidean distance between (x, y), like `idw()` in
+ *   `plots.py`
+ * - IDW_SPHERE: great-circle distance in km between (longitude, latitude)
+ *   in degrees on a sphere of radius EARTH_RADIUS, the range of coord-tran's
+ *   g2r (haversine formula); the tree holds points on the unit sphere, where
+ *   the nearest by chord are the nearest by great circle
+ */
+
+#ifndef INTERP_IDW_H
+#define INTERP_IDW_H
+
+#include <math.h>
+#include <stddef.h>
+
+/**
+ * Distance metrics
+ */
+enum idw_metric {
+  IDW_PLANE,  // Euclidean distance between (x, y)
+  IDW_SPHERE, // Great-circle distance (km) between (lon, lat) in degrees
+};
+
+/**
+ * Interpolation options
+ */
+struct idw_options {
+  double power;  // Power of the distance in the weights (e.g. 2)
+  int k;         // Number of nearest observations to use (0: all)
+  double radius; // Largest distance of the observations to use (0: any)
+  double fill;   // Value where no observation is within the radius
+};
+
+/**
+ * Default options: power 2, all observations, NaN fill value
+ */
+#define IDW_OPTIONS_DEFAULT {2.0, 0, 0.0, NAN}
+
+/**
+ * Regular grid, row by row (x varies fastest)
+ */
+struct idw_grid {
+  double x0, dx; // First x (or longitude) and step
+  double y0, dy; // First y (or latitude) and step
+  size_t nx, ny; // Number of columns and rows
+};
+
+/**
+ * Observations in a k-d tree (opaque)
+ */
+struct idw_tree;
+
+/**
+ * Row callback of idw_grid_stream
+ *
+ * @param row Row index (from 0, in order)
+ * @param values Interpolated values of the row (nx values)
+ * @param ctx Context pointer given to idw_grid_stream
+ * @return 0 to continue, non-zero to stop
+ */
+typedef int (*idw_row_fn)(size_t row, const double *values, void *ctx);
+
+/**
+ * Build a k-d tree of observations
+ * The inputs are copied, so they can be freed afterwards
+ *
+ * @param n Number of observations
+ * @param x Observation x (or longitude in degrees)
+ * @param y Observation y (or latitude in degrees)
+ * @param z Observation values
+ * @param metric Distance metric
+ * @return Tree, or NULL on allocation failure or if n is 0
+ */
+struct idw_tree *idw_tree_build(size_t n, const double *x, const double *y,
+                                const double *z, enum idw_metric metric);
+
+/**
+ * Free a tree from idw_tree_build (NULL is ignored)
+ */
+void idw_tree_free(struct idw_tree *tree);
+
+/**
+ * Interpolate to one point
+ * An observation at distance zero gets all the weight (the mean of the
+ * values if several are at the point)
+ *
+ * @param tree Observations
+ * @param opt Options
+ * @param x Point x (or longitude in degrees)
+ * @param y Point y (or latitude in degrees)
+ * @return Interpolated value, or opt->fill if no observation is within
+ * opt->radius
+ */
+double idw_point(const struct idw_tree *tree, const struct idw_options *opt,
+                 double x, double y);
+
+/**
+ * Interpolate to many points, using multiple threads
+ * Each value is the same as idw_point's
+ *
+ * @param tree Observations
+ * @param opt Options
+ * @param n Number of points
+ * @param x Point x (or longitude in degrees)
+ * @param y Point y (or latitude in degrees)
+ * @param z Array to store the interpolated values
+ * @param num_threads Number of threads (<= 0 for one per processor)
+ * @return 0 on success, non-zero on failure
+ */
+int idw_points(const struct idw_tree *tree, const struct idw_options *opt,
+               size_t n, const double *x, const double *y, double *z,
+               int num_threads);
+
+/**
+ * Interpolate to a regular grid, passing each row to a callback in order
+ * Rows are computed a block at a time, using multiple threads, so memory
+ * does not grow with the grid size
+ *
+ * @param tree Observations
+ * @param opt Options
+ * @param grid Grid
+ * @param num_threads Number of threads (<= 0 for one per processor)
+ * @param fn Row callback
+ * @param ctx Context pointer passed to fn
+ * @return 0 on success, the callback's non-zero value if it stopped, or -1
+ * on failure
+ */
+int idw_grid_stream(const struct idw_tree *tree,
+                    const struct idw_options *opt,
+                    const struct idw_grid *grid, int num_threads,
+                    idw_row_fn fn, void *ctx);
+
+#endif /* INTERP_IDW_H */
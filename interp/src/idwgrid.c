@@ -0,0 +1,253 @@
+/**
+ * idwgrid - Inverse distance weighting (or natural neighbor interpolation)
+ * of scattered observations to a grid
+ *
+ * Reads observations (x y value per line) and writes the interpolated grid
+ * row by row as it is computed, as text or raw float64
+ */
+
+#include "idw.h"
+#include "nn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_usage() {
+  printf("Usage: idwgrid [options] -g <x0,x1,nx,y0,y1,ny> [file]\n");
+  printf("  Reads one <x> <y> <value> observation per line (whitespace- or "
+         "comma-delimited)\n");
+  printf("  from file or stdin; blank lines and lines starting with '#' "
+         "are skipped.\n");
+  printf("  Writes one line of nx values per grid row, from y0 to y1.\n\n");
+  printf("Options:\n");
+  printf("  -h, --help           Display this help message.\n");
+  printf("  -g, --grid <spec>    Grid from x0 to x1 and y0 to y1, with nx "
+         "and ny points.\n");
+  printf("  -s, --sphere         x and y are longitude and latitude in "
+         "degrees,\n");
+  printf("                       with great-circle distances in km (as "
+         "g2r).\n");
+  printf("  -p, --power <p>      Power of the distance (default: 2).\n");
+  printf("  -k, --neighbors <k>  Use the k nearest observations (default: "
+         "all).\n");
+  printf("  -r, --radius <r>     Use the observations within r (default: "
+         "any).\n");
+  printf("  -f, --fill <value>   Value with no observation within r "
+         "(default: nan).\n");
+  printf("  -n, --natural        Natural neighbor interpolation (planar) "
+         "instead;\n");
+  printf("                       the fill value is outside the observations' "
+         "hull.\n");
+  printf("  -j, --threads <n>    Number of threads (default: one per "
+         "processor).\n");
+  printf("  -b, --binary         Write raw float64 values instead of "
+         "text.\n\n");
+}
+
+/**
+ * Read observations, growing the arrays as needed
+ *
+ * @return Number of observations, or -1 on error (reported on stderr)
+ */
+long read_observations(FILE *in, double **x, double **y, double **z) {
+  size_t n = 0, cap = 0;
+  char line[1024];
+  long line_num = 0;
+  *x = *y = *z = NULL;
+  while (fgets(line, sizeof(line), in) != NULL) {
+    line_num++;
+    char *s = line + strspn(line, " \t\r\n");
+    if (*s == '\0' || *s == '#') {
+      continue;
+    }
+    double v[3];
+    for (int i = 0; i < 3; i++) {
+      char *end;
+      v[i] = strtod(s, &end);
+      if (end == s) {
+        fprintf(stderr, "Error: line %ld: Expected three numbers.\n",
+                line_num);
+        return -1;
+      }
+      s = end + strspn(end, " \t,");
+    }
+    if (n == cap) {
+      cap = cap > 0 ? 2 * cap : 1024;
+      double *nx = realloc(*x, cap * sizeof(double));
+      double *ny = nx ? realloc(*y, cap * sizeof(double)) : NULL;
+      double *nz = ny ? realloc(*z, cap * sizeof(double)) : NULL;
+      if (nx != NULL) {
+        *x = nx;
+      }
+      if (ny != NULL) {
+        *y = ny;
+      }
+      if (nz == NULL) {
+        fprintf(stderr, "Error: Allocation failed.\n");
+        return -1;
+      }
+      *z = nz;
+    }
+    (*x)[n] = v[0];
+    (*y)[n] = v[1];
+    (*z)[n] = v[2];
+    n++;
+  }
+  return (long)n;
+}
+
+/**
+ * Parse "x0,x1,nx,y0,y1,ny"
+ */
+int parse_grid(const char *spec, struct idw_grid *grid) {
+  double x0, x1, y0, y1;
+  long nx, ny;
+  if (sscanf(spec, "%lf,%lf,%ld,%lf,%lf,%ld", &x0, &x1, &nx, &y0, &y1,
+             &ny) != 6 ||
+      nx < 1 || ny < 1) {
+    return 1;
+  }
+  grid->x0 = x0;
+  grid->dx = nx > 1 ? (x1 - x0) / (nx - 1) : 0.0;
+  grid->nx = nx;
+  grid->y0 = y0;
+  grid->dy = ny > 1 ? (y1 - y0) / (ny - 1) : 0.0;
+  grid->ny = ny;
+  return 0;
+}
+
+/* Output of the rows */
+struct output {
+  FILE *out;
+  size_t nx;
+  int binary;
+};
+
+int write_row(size_t row, const double *values, void *ctx) {
+  struct output *o = ctx;
+  (void)row;
+  if (o->binary) {
+    return fwrite(values, sizeof(double), o->nx, o->out) != o->nx;
+  }
+  for (size_t i = 0; i < o->nx; i++) {
+    if (fprintf(o->out, i + 1 < o->nx ? "%.6g " : "%.6g\n", values[i]) < 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  struct idw_options opt = IDW_OPTIONS_DEFAULT;
+  enum idw_metric metric = IDW_PLANE;
+  struct idw_grid grid;
+  int have_grid = 0, binary = 0, natural = 0, threads = 0;
+  const char *filename = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    int has_value = i + 1 < argc;
+    if (strcmp(a, "-h") == 0 || strcmp(a, "--help") == 0) {
+      print_usage();
+      return 0;
+    } else if (strcmp(a, "-s") == 0 || strcmp(a, "--sphere") == 0) {
+      metric = IDW_SPHERE;
+    } else if (strcmp(a, "-n") == 0 || strcmp(a, "--natural") == 0) {
+      natural = 1;
+    } else if (strcmp(a, "-b") == 0 || strcmp(a, "--binary") == 0) {
+      binary = 1;
+    } else if ((strcmp(a, "-g") == 0 || strcmp(a, "--grid") == 0) &&
+               has_value) {
+      if (parse_grid(argv[++i], &grid) != 0) {
+        fprintf(stderr, "Error: Invalid grid '%s'.\n", argv[i]);
+        return 1;
+      }
+      have_grid = 1;
+    } else if ((strcmp(a, "-p") == 0 || strcmp(a, "--power") == 0) &&
+               has_value) {
+      opt.power = atof(argv[++i]);
+    } else if ((strcmp(a, "-k") == 0 || strcmp(a, "--neighbors") == 0) &&
+               has_value) {
+      opt.k = atoi(argv[++i]);
+    } else if ((strcmp(a, "-r") == 0 || strcmp(a, "--radius") == 0) &&
+               has_value) {
+      opt.radius = atof(argv[++i]);
+    } else if ((strcmp(a, "-f") == 0 || strcmp(a, "--fill") == 0) &&
+               has_value) {
+      opt.fill = atof(argv[++i]);
+    } else if ((strcmp(a, "-j") == 0 || strcmp(a, "--threads") == 0) &&
+               has_value) {
+      threads = atoi(argv[++i]);
+    } else if (a[0] != '-' || strcmp(a, "-") == 0) {
+      filename = a;
+    } else {
+      fprintf(stderr, "Error: Invalid argument '%s'.\n", a);
+      print_usage();
+      return 1;
+    }
+  }
+  if (!have_grid) {
+    fprintf(stderr, "Error: No grid given.\n");
+    print_usage();
+    return 1;
+  }
+  if (opt.k < 0 || opt.radius < 0.0 || !(opt.power > 0.0)) {
+    fprintf(stderr, "Error: Invalid power, neighbors or radius.\n");
+    return 1;
+  }
+  if (natural && metric == IDW_SPHERE) {
+    fprintf(stderr, "Error: Natural neighbor interpolation is planar.\n");
+    return 1;
+  }
+
+  FILE *in = stdin;
+  if (filename != NULL && strcmp(filename, "-") != 0) {
+    in = fopen(filename, "r");
+    if (in == NULL) {
+      fprintf(stderr, "Error: Cannot open '%s'.\n", filename);
+      return 1;
+    }
+  }
+  double *x, *y, *z;
+  long n = read_observations(in, &x, &y, &z);
+  if (in != stdin) {
+    fclose(in);
+  }
+  if (n <= 0) {
+    if (n == 0) {
+      fprintf(stderr, "Error: No observations.\n");
+    }
+    free(x);
+    free(y);
+    free(z);
+    return 1;
+  }
+
+  struct idw_tree *tree = NULL;
+  struct nn_tri *tri = NULL;
+  if (natural) {
+    tri = nn_build(n, x, y, z);
+  } else {
+    tree = idw_tree_build(n, x, y, z, metric);
+  }
+  free(x);
+  free(y);
+  free(z);
+  if (tree == NULL && tri == NULL) {
+    fprintf(stderr, "Error: Allocation failed.\n");
+    return 1;
+  }
+
+  struct output o = {stdout, grid.nx, binary};
+  int status =
+      natural
+          ? nn_grid_stream(tri, &grid, opt.fill, threads, write_row, &o)
+          : idw_grid_stream(tree, &opt, &grid, threads, write_row, &o);
+  idw_tree_free(tree);
+  nn_free(tri);
+  if (status != 0 || fflush(stdout) != 0) {
+    fprintf(stderr, "Error: Failed to write the grid.\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,1217 @@
+/**
+ * @file
+ * @brief Natural neighbor interpolation on an incremental Delaunay
+ * triangulation
+ */
+
+#include "nn.h"
+#include "par.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INF -1             // Vertex at infinity, the last of ghost triangles
+#define DELETED -2         // First vertex of a free triangle
+#define CELL_VERTICES 2    // Vertices per cell of the locator grid
+#define GRID_MIN_VERTICES 64 // Vertices before the locator grid is used
+
+/**
+ * Triangle: vertices counterclockwise, and the neighbor opposite each
+ * (across the edge of the two other vertices)
+ * A ghost triangle (a, b, INF) covers the outside of hull edge a -> b;
+ * a free one has v[0] DELETED and the next free triangle in n[0]
+ */
+struct tri {
+  int v[3];
+  int n[3];
+};
+
+/**
+ * Edge a -> b of a cavity's boundary, counterclockwise, with the triangle
+ * outside it, the slot of that triangle's neighbors pointing into the
+ * cavity, and the new triangle (a, b, p) replacing the cavity's
+ */
+struct edge {
+  int a, b;
+  int out, slot;
+  int t;
+};
+
+/**
+ * Triangles whose circumcircles hold a point, and their boundary
+ */
+struct cavity {
+  int *tris;
+  size_t num_tris, cap_tris;
+  struct edge *edges;
+  size_t num_edges, cap_edges;
+  double *work; // Circumcenters and polygons of the Sibson weights
+  size_t cap_work;
+};
+
+struct nn_tri {
+  // Vertices: coordinates, sum and number of the values at the point, and
+  // a real triangle holding the vertex
+  double *x, *y, *z_sum;
+  int *count;
+  int *vtri;
+  size_t nv, cap_v;
+
+  struct tri *t;
+  size_t nt, cap_t; // Slots used (including free ones) and allocated
+  int free_t;       // First free triangle, or -1
+  size_t num_real;  // Real (not ghost or free) triangles
+  int hint;         // Real triangle near the last insertion
+
+  // Locator grid: the last vertex inserted in each cell, or -1
+  int *cells;
+  int gnx, gny;
+  double gx0, gy0, gsx, gsy; // Origin and cells per unit
+  size_t grid_nv;            // Vertices when the grid was built
+
+  struct cavity cav; // Insertion scratch
+};
+
+/*
+ * Robust predicates (Shewchuk, "Adaptive Precision Floating-Point
+ * Arithmetic and Fast Robust Geometric Predicates", 1997): a determinant is
+ * evaluated in double precision, and only if its error bound leaves the
+ * sign open, again exactly with expansions, sums of nonoverlapping doubles
+ * in increasing magnitude whose sign is that of the last one. Zero
+ * components are dropped, so the expansions only grow with the bits the
+ * inputs need: a difference of nearby coordinates is usually exact, and
+ * stays one double. This needs IEEE double arithmetic that is rounded after
+ * every operation (no x87 extended precision, and no contraction into fused
+ * multiply-adds, which -std=c99 turns off in GCC).
+ */
+
+#define EPSILON 1.1102230246251565e-16 // 2^-53, half an ulp of 1
+#define SPLITTER 134217729.0           // 2^27 + 1
+
+// Relative error bounds of the double precision determinants
+static const double orient_bound = (3.0 + 16.0 * EPSILON) * EPSILON;
+static const double incircle_bound = (10.0 + 96.0 * EPSILON) * EPSILON;
+
+// Longest expansions of the exact incircle determinant: a difference has 2
+// components, a lift (sum of two squares) 16, a 2x2 minor 16, a lift times
+// a minor 2 * 16 * 16, and the sum of the three such terms 3 times that
+#define LIFT_MAX 16
+#define TERM_MAX (2 * LIFT_MAX * LIFT_MAX)
+
+/**
+ * a + b = x + y exactly, with x the rounded sum (Knuth)
+ */
+static inline void two_sum(double a, double b, double *x, double *y) {
+  double s = a + b;
+  double bv = s - a;
+  double av = s - bv;
+  *y = (a - av) + (b - bv);
+  *x = s;
+}
+
+/**
+ * As two_sum, for |a| >= |b| (Dekker)
+ */
+static inline void fast_two_sum(double a, double b, double *x, double *y) {
+  double s = a + b;
+  *y = b - (s - a);
+  *x = s;
+}
+
+/**
+ * a = hi + lo, each with at most 26 significant bits
+ */
+static inline void split(double a, double *hi, double *lo) {
+  double c = SPLITTER * a;
+  double big = c - a;
+  *hi = c - big;
+  *lo = a - *hi;
+}
+
+/**
+ * a * b = x + y exactly, with x the rounded product and b already split
+ */
+static inline void two_product_split(double a, double b, double bhi,
+                                     double blo, double *x, double *y) {
+  double p = a * b;
+  double ahi, alo;
+  split(a, &ahi, &alo);
+  double err = p - ahi * bhi - alo * bhi - ahi * blo;
+  *y = alo * blo - err;
+  *x = p;
+}
+
+/**
+ * h = e + f, merging by magnitude and summing with two_sum; h has at most
+ * ne + nf components and must not overlap e or f
+ *
+ * @return Number of components of h
+ */
+static int expansion_sum(int ne, const double *e, int nf, const double *f,
+                         double *h) {
+  int i = 0, j = 0, n = 0;
+  double q = 0.0;
+  for (int k = 0; k < ne + nf; k++) {
+    double c = j == nf || (i < ne && fabs(e[i]) < fabs(f[j])) ? e[i++]
+                                                              : f[j++];
+    if (k == 0) {
+      q = c;
+      continue;
+    }
+    double r;
+    two_sum(q, c, &q, &r);
+    if (r != 0.0) {
+      h[n++] = r;
+    }
+  }
+  if (q != 0.0 || n == 0) {
+    h[n++] = q;
+  }
+  return n;
+}
+
+/**
+ * h = e * b; h has at most 2 * ne components and must not overlap e
+ *
+ * @return Number of components of h
+ */
+static int expansion_scale(int ne, const double *e, double b, double *h) {
+  double bhi, blo, q, r;
+  split(b, &bhi, &blo);
+  two_product_split(e[0], b, bhi, blo, &q, &r);
+  int n = 0;
+  if (r != 0.0) {
+    h[n++] = r;
+  }
+  for (int i = 1; i < ne; i++) {
+    double p, pr, sum;
+    two_product_split(e[i], b, bhi, blo, &p, &pr);
+    two_sum(q, pr, &sum, &r);
+    if (r != 0.0) {
+      h[n++] = r;
+    }
+    fast_two_sum(p, sum, &q, &r);
+    if (r != 0.0) {
+      h[n++] = r;
+    }
+  }
+  if (q != 0.0 || n == 0) {
+    h[n++] = q;
+  }
+  return n;
+}
+
+/**
+ * h = e * f, as the sum of e scaled by each component of f; h has at most
+ * 2 * ne * nf components, and `scratch` room for 2 * ne + 2 * ne * nf
+ *
+ * @return Number of components of h
+ */
+static int expansion_product(int ne, const double *e, int nf,
+                             const double *f, double *h, double *scratch) {
+  double *part = scratch, *sum = scratch + 2 * ne;
+  int n = 0;
+  for (int j = 0; j < nf; j++) {
+    int m = expansion_scale(ne, e, f[j], part);
+    n = expansion_sum(n, h, m, part, sum);
+    memcpy(h, sum, n * sizeof(double));
+  }
+  return n;
+}
+
+/**
+ * a - b exactly, as an expansion of 1 or 2 components
+ */
+static int expansion_diff(double a, double b, double *h) {
+  double x, y;
+  two_sum(a, -b, &x, &y);
+  if (y == 0.0) {
+    h[0] = x;
+    return 1;
+  }
+  h[0] = y;
+  h[1] = x;
+  return 2;
+}
+
+static void expansion_negate(int n, double *e) {
+  for (int i = 0; i < n; i++) {
+    e[i] = -e[i];
+  }
+}
+
+/**
+ * Exact orient: (bx - ax) (cy - ay) - (by - ay) (cx - ax)
+ */
+static double orient_exact(double ax, double ay, double bx, double by,
+                           double cx, double cy) {
+  double d[4][2], l[8], r[8], det[16], scratch[12];
+  int n0 = expansion_diff(bx, ax, d[0]), n1 = expansion_diff(cy, ay, d[1]);
+  int n2 = expansion_diff(by, ay, d[2]), n3 = expansion_diff(cx, ax, d[3]);
+  int nl = expansion_product(n0, d[0], n1, d[1], l, scratch);
+  int nr = expansion_product(n2, d[2], n3, d[3], r, scratch);
+  expansion_negate(nr, r);
+  int n = expansion_sum(nl, l, nr, r, det);
+  return det[n - 1];
+}
+
+/**
+ * Orientation of (a, b, c): positive if counterclockwise, negative if
+ * clockwise, zero if on a line; exact in sign
+ */
+static double orient(double ax, double ay, double bx, double by, double cx,
+                     double cy) {
+  double l = (bx - ax) * (cy - ay);
+  double r = (by - ay) * (cx - ax);
+  double det = l - r;
+  double bound = orient_bound * (fabs(l) + fabs(r));
+  if (det > bound || -det > bound) {
+    return det;
+  }
+  return orient_exact(ax, ay, bx, by, cx, cy);
+}
+
+/**
+ * One term of the exact incircle determinant: the lift of point p (its
+ * squared distance to d) times the minor of q and r,
+ * ((px - dx)^2 + (py - dy)^2) ((qx - dx) (ry - dy) - (rx - dx) (qy - dy))
+ *
+ * @return Number of components of h (at most TERM_MAX)
+ */
+static int incircle_term(const double *px, int npx, const double *py,
+                         int npy, const double *qx, int nqx,
+                         const double *qy, int nqy, const double *rx,
+                         int nrx, const double *ry, int nry, double *h) {
+  double xx[8], yy[8], lift[LIFT_MAX], l[8], r[8], minor[LIFT_MAX];
+  double scratch[2 * LIFT_MAX + TERM_MAX];
+  int nxx = expansion_product(npx, px, npx, px, xx, scratch);
+  int nyy = expansion_product(npy, py, npy, py, yy, scratch);
+  int nlift = expansion_sum(nxx, xx, nyy, yy, lift);
+  int nl = expansion_product(nqx, qx, nry, ry, l, scratch);
+  int nr = expansion_product(nrx, rx, nqy, qy, r, scratch);
+  expansion_negate(nr, r);
+  int nminor = expansion_sum(nl, l, nr, r, minor);
+  return expansion_product(nlift, lift, nminor, minor, h, scratch);
+}
+
+/**
+ * Exact incircle, by expanding along the lifts as the double precision
+ * determinant
+ */
+static double incircle_exact(double ax, double ay, double bx, double by,
+                             double cx, double cy, double dx, double dy) {
+  double d[6][2];
+  int n[6];
+  n[0] = expansion_diff(ax, dx, d[0]);
+  n[1] = expansion_diff(ay, dy, d[1]);
+  n[2] = expansion_diff(bx, dx, d[2]);
+  n[3] = expansion_diff(by, dy, d[3]);
+  n[4] = expansion_diff(cx, dx, d[4]);
+  n[5] = expansion_diff(cy, dy, d[5]);
+
+  double ta[TERM_MAX], tb[TERM_MAX], tc[TERM_MAX], ab[2 * TERM_MAX];
+  double det[3 * TERM_MAX];
+  int na = incircle_term(d[0], n[0], d[1], n[1], d[2], n[2], d[3], n[3],
+                         d[4], n[4], d[5], n[5], ta);
+  int nb = incircle_term(d[2], n[2], d[3], n[3], d[4], n[4], d[5], n[5],
+                         d[0], n[0], d[1], n[1], tb);
+  int nc = incircle_term(d[4], n[4], d[5], n[5], d[0], n[0], d[1], n[1],
+                         d[2], n[2], d[3], n[3], tc);
+  int nab = expansion_sum(na, ta, nb, tb, ab);
+  int ndet = expansion_sum(nab, ab, nc, tc, det);
+  return det[ndet - 1];
+}
+
+/**
+ * Positive if d is inside the circle through counterclockwise (a, b, c),
+ * negative if outside, zero if on it; exact in sign
+ */
+static double incircle(double ax, double ay, double bx, double by, double cx,
+                       double cy, double dx, double dy) {
+  double adx = ax - dx, ady = ay - dy;
+  double bdx = bx - dx, bdy = by - dy;
+  double cdx = cx - dx, cdy = cy - dy;
+  double alift = adx * adx + ady * ady;
+  double blift = bdx * bdx + bdy * bdy;
+  double clift = cdx * cdx + cdy * cdy;
+  double det = alift * (bdx * cdy - cdx * bdy) +
+               blift * (cdx * ady - adx * cdy) +
+               clift * (adx * bdy - bdx * ady);
+  double permanent = (fabs(bdx * cdy) + fabs(cdx * bdy)) * alift +
+                     (fabs(cdx * ady) + fabs(adx * cdy)) * blift +
+                     (fabs(adx * bdy) + fabs(bdx * ady)) * clift;
+  double bound = incircle_bound * permanent;
+  if (det > bound || -det > bound) {
+    return det;
+  }
+  return incircle_exact(ax, ay, bx, by, cx, cy, dx, dy);
+}
+
+static int is_ghost(const struct tri *t) { return t->v[2] == INF; }
+
+/**
+ * Index of vertex v in t
+ */
+static int vindex(const struct tri *t, int v) {
+  return t->v[0] == v ? 0 : t->v[1] == v ? 1 : 2;
+}
+
+/**
+ * Whether (px, py) is inside the circumcircle of triangle t; for a ghost,
+ * strictly outside its hull edge, or on the edge between its ends
+ */
+static int in_disk(const struct nn_tri *tri, int t, double px, double py) {
+  const int *v = tri->t[t].v;
+  const double *x = tri->x, *y = tri->y;
+  if (v[2] == INF) {
+    double o = orient(x[v[0]], y[v[0]], x[v[1]], y[v[1]], px, py);
+    if (o != 0.0) {
+      return o > 0.0;
+    }
+    // On the edge's line: between its ends, compared exactly
+    double a = x[v[0]], b = x[v[1]], p = px;
+    if (a == b) {
+      a = y[v[0]], b = y[v[1]], p = py;
+    }
+    return a < b ? p > a && p < b : p < a && p > b;
+  }
+  return incircle(x[v[0]], y[v[0]], x[v[1]], y[v[1]], x[v[2]], y[v[2]], px,
+                  py) > 0.0;
+}
+
+/**
+ * Walk from real triangle `start` towards (px, py), crossing a random edge
+ * that has the point on its outer side until there is none
+ *
+ * @return Real triangle holding the point (possibly on its edges), or the
+ * ghost triangle of a hull edge that has it outside
+ */
+static int locate(const struct nn_tri *tri, double px, double py,
+                  int start) {
+  const double *x = tri->x, *y = tri->y;
+  int t = start, prev = -1;
+  uint32_t r = 2463534242u;
+  for (size_t step = 0; step <= tri->nt; step++) {
+    const struct tri *T = &tri->t[t];
+    if (is_ghost(T)) {
+      return t;
+    }
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    int next = -1;
+    for (int k = 0; k < 3 && next < 0; k++) {
+      int i = (r + k) % 3;
+      int a = T->v[(i + 1) % 3], b = T->v[(i + 2) % 3];
+      if (T->n[i] != prev && orient(x[a], y[a], x[b], y[b], px, py) < 0.0) {
+        next = T->n[i];
+      }
+    }
+    if (next < 0) {
+      return t;
+    }
+    prev = t;
+    t = next;
+  }
+
+  // The walk can't cycle with consistent predicates; as a safeguard, test
+  // every triangle
+  int outside = -1;
+  for (size_t t = 0; t < tri->nt; t++) {
+    const int *v = tri->t[t].v;
+    if (v[0] == DELETED) {
+      continue;
+    }
+    if (v[2] == INF) {
+      if (outside < 0 &&
+          orient(x[v[0]], y[v[0]], x[v[1]], y[v[1]], px, py) > 0.0) {
+        outside = t;
+      }
+    } else if (orient(x[v[0]], y[v[0]], x[v[1]], y[v[1]], px, py) >= 0.0 &&
+               orient(x[v[1]], y[v[1]], x[v[2]], y[v[2]], px, py) >= 0.0 &&
+               orient(x[v[2]], y[v[2]], x[v[0]], y[v[0]], px, py) >= 0.0) {
+      return t;
+    }
+  }
+  return outside >= 0 ? outside : start;
+}
+
+static void cell_of(const struct nn_tri *tri, double px, double py, int *ix,
+                    int *iy) {
+  double cx = (px - tri->gx0) * tri->gsx;
+  double cy = (py - tri->gy0) * tri->gsy;
+  *ix = cx < 0.0 ? 0 : cx >= tri->gnx ? tri->gnx - 1 : (int)cx;
+  *iy = cy < 0.0 ? 0 : cy >= tri->gny ? tri->gny - 1 : (int)cy;
+}
+
+static int cell_index(const struct nn_tri *tri, double px, double py) {
+  int ix, iy;
+  cell_of(tri, px, py, &ix, &iy);
+  return iy * tri->gnx + ix;
+}
+
+/**
+ * Real triangle to start a walk to (px, py) from: one of the vertex last
+ * inserted in the point's cell, or in the nearest ring of cells around it
+ * that has one, or the hint
+ */
+static int start_triangle(const struct nn_tri *tri, double px, double py) {
+  if (tri->cells == NULL) {
+    return tri->hint;
+  }
+  int ix, iy;
+  cell_of(tri, px, py, &ix, &iy);
+  int max_r = tri->gnx > tri->gny ? tri->gnx : tri->gny;
+  for (int r = 0; r < max_r; r++) {
+    for (int j = iy - r; j <= iy + r; j++) {
+      if (j < 0 || j >= tri->gny) {
+        continue;
+      }
+      // The whole row at the top and bottom, else its two ends
+      int step = j == iy - r || j == iy + r ? 1 : 2 * r;
+      for (int i = ix - r; i <= ix + r; i += step > 0 ? step : 1) {
+        int v = i >= 0 && i < tri->gnx ? tri->cells[j * tri->gnx + i] : -1;
+        if (v >= 0) {
+          return tri->vtri[v];
+        }
+      }
+    }
+  }
+  return tri->hint;
+}
+
+/**
+ * Rebuild the locator grid over the vertices' bounding box, with about
+ * CELL_VERTICES vertices per cell
+ */
+static void grid_rebuild(struct nn_tri *tri) {
+  double x0 = tri->x[0], x1 = x0, y0 = tri->y[0], y1 = y0;
+  for (size_t i = 1; i < tri->nv; i++) {
+    x0 = fmin(x0, tri->x[i]);
+    x1 = fmax(x1, tri->x[i]);
+    y0 = fmin(y0, tri->y[i]);
+    y1 = fmax(y1, tri->y[i]);
+  }
+  double w = x1 > x0 ? x1 - x0 : 1.0, h = y1 > y0 ? y1 - y0 : 1.0;
+  double num_cells = (double)tri->nv / CELL_VERTICES + 1.0;
+  double nx = fmin(fmax(round(sqrt(num_cells * w / h)), 1.0), num_cells);
+  double ny = fmax(floor(num_cells / nx), 1.0);
+  int *cells = realloc(tri->cells, (size_t)nx * (size_t)ny * sizeof(int));
+  if (cells == NULL) {
+    return; // Keep the old grid
+  }
+  tri->cells = cells;
+  tri->gnx = (int)nx;
+  tri->gny = (int)ny;
+  tri->gx0 = x0;
+  tri->gy0 = y0;
+  tri->gsx = nx / w;
+  tri->gsy = ny / h;
+  tri->grid_nv = tri->nv;
+  for (size_t i = 0; i < (size_t)tri->gnx * tri->gny; i++) {
+    cells[i] = -1;
+  }
+  for (size_t i = 0; i < tri->nv; i++) {
+    cells[cell_index(tri, tri->x[i], tri->y[i])] = (int)i;
+  }
+}
+
+/**
+ * Record vertex v in the locator grid, rebuilding it as the vertices grow
+ */
+static void grid_add(struct nn_tri *tri, int v) {
+  double cx = (tri->x[v] - tri->gx0) * tri->gsx;
+  double cy = (tri->y[v] - tri->gy0) * tri->gsy;
+  int outside = cx < 0.0 || cx > tri->gnx || cy < 0.0 || cy > tri->gny;
+  // Rebuilding when the grid is outgrown, or doesn't cover the points, is
+  // amortized by the growth it waits for
+  if (tri->nv >= 4 * tri->grid_nv + GRID_MIN_VERTICES ||
+      (outside && tri->nv >= 2 * tri->grid_nv + GRID_MIN_VERTICES)) {
+    grid_rebuild(tri);
+  } else if (tri->cells != NULL) {
+    tri->cells[cell_index(tri, tri->x[v], tri->y[v])] = v;
+  }
+}
+
+static int cavity_add_tri(struct cavity *cav, int t) {
+  if (cav->num_tris == cav->cap_tris) {
+    size_t cap = cav->cap_tris > 0 ? 2 * cav->cap_tris : 16;
+    int *tris = realloc(cav->tris, cap * sizeof(*tris));
+    if (tris == NULL) {
+      return -1;
+    }
+    cav->tris = tris;
+    cav->cap_tris = cap;
+  }
+  cav->tris[cav->num_tris++] = t;
+  return 0;
+}
+
+static int cavity_add_edge(struct cavity *cav, struct edge e) {
+  if (cav->num_edges == cav->cap_edges) {
+    size_t cap = cav->cap_edges > 0 ? 2 * cav->cap_edges : 16;
+    struct edge *edges = realloc(cav->edges, cap * sizeof(*edges));
+    if (edges == NULL) {
+      return -1;
+    }
+    cav->edges = edges;
+    cav->cap_edges = cap;
+  }
+  cav->edges[cav->num_edges++] = e;
+  return 0;
+}
+
+static int cavity_has(const struct cavity *cav, int t) {
+  for (size_t k = 0; k < cav->num_tris; k++) {
+    if (cav->tris[k] == t) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void cavity_free(struct cavity *cav) {
+  free(cav->tris);
+  free(cav->edges);
+  free(cav->work);
+}
+
+/**
+ * Find the triangles whose circumcircles hold (px, py), from t0 (which
+ * holds the point), and their boundary
+ *
+ * @param no_ghosts Stop if a ghost triangle is reached
+ * @return 0 on success, 1 if stopped at a ghost, -1 on allocation failure
+ */
+static int cavity_grow(const struct nn_tri *tri, struct cavity *cav,
+                       double px, double py, int t0, int no_ghosts) {
+  cav->num_tris = cav->num_edges = 0;
+  if (cavity_add_tri(cav, t0) != 0) {
+    return -1;
+  }
+  for (size_t k = 0; k < cav->num_tris; k++) {
+    int t = cav->tris[k];
+    const struct tri *T = &tri->t[t];
+    for (int i = 0; i < 3; i++) {
+      int o = T->n[i];
+      if (cavity_has(cav, o)) {
+        continue;
+      }
+      if (in_disk(tri, o, px, py)) {
+        if (no_ghosts && is_ghost(&tri->t[o])) {
+          return 1;
+        }
+        if (cavity_add_tri(cav, o) != 0) {
+          return -1;
+        }
+      } else {
+        struct edge e = {T->v[(i + 1) % 3], T->v[(i + 2) % 3], o,
+                         tri->t[o].n[0] == t   ? 0
+                         : tri->t[o].n[1] == t ? 1
+                                               : 2,
+                         -1};
+        if (cavity_add_edge(cav, e) != 0) {
+          return -1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * Triangle slot for a new triangle (capacity reserved beforehand)
+ */
+static int new_tri(struct nn_tri *tri) {
+  if (tri->free_t >= 0) {
+    int t = tri->free_t;
+    tri->free_t = tri->t[t].n[0];
+    return t;
+  }
+  return (int)tri->nt++;
+}
+
+static int reserve_tris(struct nn_tri *tri, size_t n) {
+  if (tri->nt + n > tri->cap_t) {
+    size_t cap = 2 * tri->cap_t > tri->nt + n ? 2 * tri->cap_t : tri->nt + n;
+    struct tri *t = realloc(tri->t, cap * sizeof(*t));
+    if (t == NULL) {
+      return -1;
+    }
+    tri->t = t;
+    tri->cap_t = cap;
+  }
+  return 0;
+}
+
+/**
+ * Set the vertices of t to (a, b, c), rotated so that INF is last
+ */
+static void set_tri(struct tri *t, int a, int b, int c) {
+  if (a == INF) {
+    a = b;
+    b = c;
+    c = INF;
+  } else if (b == INF) {
+    b = a;
+    a = c;
+    c = INF;
+  }
+  t->v[0] = a;
+  t->v[1] = b;
+  t->v[2] = c;
+}
+
+/**
+ * Insert vertex p, which lies in triangle t0 (from locate) and is not one
+ * of its vertices: replace the cavity of p with a fan of triangles to it
+ */
+static int insert_vertex(struct nn_tri *tri, int p, int t0) {
+  struct cavity *cav = &tri->cav;
+  if (cavity_grow(tri, cav, tri->x[p], tri->y[p], t0, 0) != 0 ||
+      reserve_tris(tri, cav->num_edges) != 0) {
+    return -1;
+  }
+
+  for (size_t k = 0; k < cav->num_tris; k++) {
+    struct tri *T = &tri->t[cav->tris[k]];
+    tri->num_real -= !is_ghost(T);
+    T->v[0] = DELETED;
+    T->n[0] = tri->free_t;
+    tri->free_t = cav->tris[k];
+  }
+  for (size_t k = 0; k < cav->num_edges; k++) {
+    struct edge *e = &cav->edges[k];
+    e->t = new_tri(tri);
+    set_tri(&tri->t[e->t], e->a, e->b, p);
+    tri->num_real += !is_ghost(&tri->t[e->t]);
+  }
+
+  // Each new triangle (a, b, p) neighbors the outside triangle across
+  // (a, b), and the new triangles of the boundary edges from b and to a
+  for (size_t k = 0; k < cav->num_edges; k++) {
+    const struct edge *e = &cav->edges[k];
+    struct tri *T = &tri->t[e->t];
+    T->n[vindex(T, p)] = e->out;
+    tri->t[e->out].n[e->slot] = e->t;
+    for (size_t j = 0; j < cav->num_edges; j++) {
+      if (cav->edges[j].a == e->b) {
+        T->n[vindex(T, e->a)] = cav->edges[j].t;
+      }
+      if (cav->edges[j].b == e->a) {
+        T->n[vindex(T, e->b)] = cav->edges[j].t;
+      }
+    }
+    if (!is_ghost(T)) {
+      tri->vtri[p] = tri->vtri[T->v[0]] = tri->vtri[T->v[1]] =
+          tri->vtri[T->v[2]] = e->t;
+      tri->hint = e->t;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Start the triangulation with counterclockwise (a, b, c) and the ghost
+ * triangles of its edges
+ */
+static int init_triangle(struct nn_tri *tri, int a, int b, int c) {
+  if (reserve_tris(tri, 4) != 0) {
+    return -1;
+  }
+  // Real triangle 0 = (a, b, c); ghosts 1, 2, 3 outside a -> c, c -> b and
+  // b -> a, i.e. opposite b, a and c
+  const struct tri init[4] = {
+      {{a, b, c}, {2, 1, 3}},
+      {{a, c, INF}, {2, 3, 0}},
+      {{c, b, INF}, {3, 1, 0}},
+      {{b, a, INF}, {1, 2, 0}},
+  };
+  memcpy(tri->t, init, sizeof(init));
+  tri->nt = 4;
+  tri->num_real = 1;
+  tri->hint = 0;
+  tri->vtri[a] = tri->vtri[b] = tri->vtri[c] = 0;
+  return 0;
+}
+
+static int add_vertex(struct nn_tri *tri, double x, double y, double z) {
+  if (tri->nv == tri->cap_v) {
+    size_t cap = tri->cap_v > 0 ? 2 * tri->cap_v : 64;
+    double *nx = realloc(tri->x, cap * sizeof(double));
+    if (nx != NULL) {
+      tri->x = nx;
+    }
+    double *ny = realloc(tri->y, cap * sizeof(double));
+    if (ny != NULL) {
+      tri->y = ny;
+    }
+    double *nz = realloc(tri->z_sum, cap * sizeof(double));
+    if (nz != NULL) {
+      tri->z_sum = nz;
+    }
+    int *nc = realloc(tri->count, cap * sizeof(int));
+    if (nc != NULL) {
+      tri->count = nc;
+    }
+    int *nt = realloc(tri->vtri, cap * sizeof(int));
+    if (nt != NULL) {
+      tri->vtri = nt;
+    }
+    if (!nx || !ny || !nz || !nc || !nt || cap > INT32_MAX) {
+      return -1;
+    }
+    tri->cap_v = cap;
+  }
+  int v = (int)tri->nv++;
+  tri->x[v] = x;
+  tri->y[v] = y;
+  tri->z_sum[v] = z;
+  tri->count[v] = 1;
+  tri->vtri[v] = -1;
+  return v;
+}
+
+/**
+ * Insert while there are no triangles: keep the vertices until one is off
+ * the line of the first two, then triangulate them all
+ */
+static int insert_first(struct nn_tri *tri, double x, double y, double z) {
+  for (size_t i = 0; i < tri->nv; i++) {
+    if (tri->x[i] == x && tri->y[i] == y) {
+      tri->z_sum[i] += z;
+      tri->count[i]++;
+      return 1;
+    }
+  }
+  int c = add_vertex(tri, x, y, z);
+  if (c < 0) {
+    return -1;
+  }
+  if (c < 2) {
+    return 0;
+  }
+  double o = orient(tri->x[0], tri->y[0], tri->x[1], tri->y[1], x, y);
+  if (o == 0.0) {
+    return 0;
+  }
+  if (init_triangle(tri, o > 0.0 ? 0 : 1, o > 0.0 ? 1 : 0, c) != 0) {
+    tri->nv--;
+    return -1;
+  }
+  for (int v = 2; v < c; v++) {
+    int t = locate(tri, tri->x[v], tri->y[v], tri->hint);
+    if (insert_vertex(tri, v, t) != 0) {
+      return -1;
+    }
+  }
+  grid_add(tri, c);
+  return 0;
+}
+
+struct nn_tri *nn_create(void) {
+  struct nn_tri *tri = calloc(1, sizeof(*tri));
+  if (tri != NULL) {
+    tri->free_t = -1;
+  }
+  return tri;
+}
+
+void nn_free(struct nn_tri *tri) {
+  if (tri != NULL) {
+    free(tri->x);
+    free(tri->y);
+    free(tri->z_sum);
+    free(tri->count);
+    free(tri->vtri);
+    free(tri->t);
+    free(tri->cells);
+    cavity_free(&tri->cav);
+    free(tri);
+  }
+}
+
+/**
+ * Add an observation (nn_insert), walking from triangle `start` (or from
+ * the locator grid's if -1)
+ */
+static int insert(struct nn_tri *tri, double x, double y, double z,
+                  int start) {
+  if (!isfinite(x) || !isfinite(y)) {
+    return -1;
+  }
+  if (tri->num_real == 0) {
+    return insert_first(tri, x, y, z);
+  }
+
+  int t = locate(tri, x, y, start >= 0 ? start : start_triangle(tri, x, y));
+  const struct tri *T = &tri->t[t];
+  for (int k = 0; k < 3 && !is_ghost(T); k++) {
+    int v = T->v[k];
+    if (tri->x[v] == x && tri->y[v] == y) {
+      tri->z_sum[v] += z;
+      tri->count[v]++;
+      return 1;
+    }
+  }
+  int v = add_vertex(tri, x, y, z);
+  if (v < 0) {
+    return -1;
+  }
+  if (insert_vertex(tri, v, t) != 0) {
+    tri->nv--;
+    return -1;
+  }
+  grid_add(tri, v);
+  return 0;
+}
+
+int nn_insert(struct nn_tri *tri, double x, double y, double z) {
+  return insert(tri, x, y, z, -1);
+}
+
+/**
+ * Index along a Hilbert curve of a point of a 65536 x 65536 grid
+ */
+static uint64_t hilbert(uint32_t x, uint32_t y) {
+  const uint32_t n = 1u << 16;
+  uint64_t d = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0, ry = (y & s) > 0;
+    d += (uint64_t)s * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      uint32_t tmp = x;
+      x = y;
+      y = tmp;
+    }
+  }
+  return d;
+}
+
+struct keyed {
+  uint64_t key;
+  size_t i;
+};
+
+static int compare_keyed(const void *a, const void *b) {
+  uint64_t ka = ((const struct keyed *)a)->key;
+  uint64_t kb = ((const struct keyed *)b)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+struct nn_tri *nn_build(size_t n, const double *x, const double *y,
+                        const double *z) {
+  struct nn_tri *tri = nn_create();
+  struct keyed *order = malloc((n > 0 ? n : 1) * sizeof(*order));
+  if (tri == NULL || order == NULL) {
+    nn_free(tri);
+    free(order);
+    return NULL;
+  }
+
+  double x0 = INFINITY, x1 = -INFINITY, y0 = INFINITY, y1 = -INFINITY;
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (isfinite(x[i]) && isfinite(y[i])) {
+      x0 = fmin(x0, x[i]);
+      x1 = fmax(x1, x[i]);
+      y0 = fmin(y0, y[i]);
+      y1 = fmax(y1, y[i]);
+      order[m++].i = i;
+    }
+  }
+  double sx = x1 > x0 ? 65535.0 / (x1 - x0) : 0.0;
+  double sy = y1 > y0 ? 65535.0 / (y1 - y0) : 0.0;
+  for (size_t k = 0; k < m; k++) {
+    size_t i = order[k].i;
+    order[k].key = hilbert((uint32_t)((x[i] - x0) * sx),
+                           (uint32_t)((y[i] - y0) * sy));
+  }
+  qsort(order, m, sizeof(*order), compare_keyed);
+
+  // Each point is next to the last one along the curve, so walk from there;
+  // the grid, over all of them, is for later insertions and queries
+  for (size_t k = 0; k < m; k++) {
+    size_t i = order[k].i;
+    if (insert(tri, x[i], y[i], z[i], tri->num_real > 0 ? tri->hint : -1) <
+        0) {
+      nn_free(tri);
+      free(order);
+      return NULL;
+    }
+  }
+  free(order);
+  if (tri->nv > 0) {
+    grid_rebuild(tri);
+  }
+  return tri;
+}
+
+size_t nn_num_vertices(const struct nn_tri *tri) { return tri->nv; }
+
+size_t nn_num_triangles(const struct nn_tri *tri) { return tri->num_real; }
+
+int nn_check(const struct nn_tri *tri) {
+  const double *x = tri->x, *y = tri->y;
+  size_t num_real = 0, num_ghosts = 0;
+  if (tri->num_real == 0) {
+    return 0;
+  }
+  for (size_t t = 0; t < tri->nt; t++) {
+    const struct tri *T = &tri->t[t];
+    if (T->v[0] == DELETED) {
+      continue;
+    }
+    for (int i = 0; i < 3; i++) {
+      // The neighbor shares the edge, reversed, and points back
+      int o = T->n[i];
+      if (o < 0 || (size_t)o >= tri->nt || tri->t[o].v[0] == DELETED) {
+        return 1;
+      }
+      const struct tri *O = &tri->t[o];
+      int a = T->v[(i + 1) % 3], b = T->v[(i + 2) % 3];
+      int j = vindex(O, b);
+      if (O->v[j] != b || O->v[(j + 1) % 3] != a || O->n[(j + 2) % 3] != t) {
+        return 1;
+      }
+      // The opposite vertex of a real neighbor is not in the circumcircle
+      int w = O->v[(j + 2) % 3];
+      if (!is_ghost(T) && !is_ghost(O) &&
+          incircle(x[T->v[0]], y[T->v[0]], x[T->v[1]], y[T->v[1]],
+                   x[T->v[2]], y[T->v[2]], x[w], y[w]) > 0.0) {
+        return 1;
+      }
+    }
+    if (is_ghost(T)) {
+      // The hull turns right (or goes straight) at each vertex
+      const struct tri *next = &tri->t[T->n[0]];
+      num_ghosts++;
+      if (orient(x[T->v[0]], y[T->v[0]], x[T->v[1]], y[T->v[1]],
+                 x[next->v[1]], y[next->v[1]]) > 0.0) {
+        return 1;
+      }
+    } else {
+      num_real++;
+      if (orient(x[T->v[0]], y[T->v[0]], x[T->v[1]], y[T->v[1]], x[T->v[2]],
+                 y[T->v[2]]) <= 0.0) {
+        return 1;
+      }
+    }
+  }
+  for (size_t v = 0; v < tri->nv; v++) {
+    int t = tri->vtri[v];
+    if (t < 0 || (size_t)t >= tri->nt || tri->t[t].v[0] == DELETED ||
+        is_ghost(&tri->t[t]) || tri->t[t].v[vindex(&tri->t[t], v)] != (int)v) {
+      return 1;
+    }
+  }
+  // Euler: every vertex is in the triangulation
+  return num_real != tri->num_real ||
+         num_real != 2 * tri->nv - num_ghosts - 2;
+}
+
+/**
+ * Circumcenter of (0, 0), (ax, ay), (bx, by)
+ */
+static void circumcenter(double ax, double ay, double bx, double by,
+                         double *cx, double *cy) {
+  double d = 2.0 * (ax * by - ay * bx);
+  double a2 = ax * ax + ay * ay, b2 = bx * bx + by * by;
+  *cx = (by * a2 - ay * b2) / d;
+  *cy = (ax * b2 - bx * a2) / d;
+}
+
+/**
+ * Area of the convex polygon of n points (in any order)
+ */
+static double convex_area(double *p, int n) {
+  double cx = 0.0, cy = 0.0;
+  for (int i = 0; i < n; i++) {
+    cx += p[3 * i];
+    cy += p[3 * i + 1];
+  }
+  cx /= n;
+  cy /= n;
+  // Sort by angle around the centroid (insertion sort, n is small)
+  for (int i = 0; i < n; i++) {
+    p[3 * i + 2] = atan2(p[3 * i + 1] - cy, p[3 * i] - cx);
+  }
+  for (int i = 1; i < n; i++) {
+    double q[3] = {p[3 * i], p[3 * i + 1], p[3 * i + 2]};
+    int j = i - 1;
+    for (; j >= 0 && p[3 * j + 2] > q[2]; j--) {
+      memcpy(&p[3 * (j + 1)], &p[3 * j], sizeof(q));
+    }
+    memcpy(&p[3 * (j + 1)], q, sizeof(q));
+  }
+  double area = 0.0;
+  for (int i = 0; i < n; i++) {
+    int j = (i + 1) % n;
+    area += (p[3 * i] - cx) * (p[3 * j + 1] - cy) -
+            (p[3 * j] - cx) * (p[3 * i + 1] - cy);
+  }
+  return 0.5 * fabs(area);
+}
+
+/**
+ * Sibson interpolation at (qx, qy) into *z, with scratch space in cav
+ *
+ * The Voronoi cell that (qx, qy) would get takes from each natural
+ * neighbor v the convex polygon of: the circumcenters of (q, u, v) and
+ * (q, v, w) for its neighbors u and w along the cavity boundary, and those
+ * of the cavity triangles around v (the Voronoi vertices of v that the
+ * point would remove). Coordinates are relative to the point.
+ *
+ * @return 0 on success, -1 on allocation failure
+ */
+static int sibson(const struct nn_tri *tri, struct cavity *cav, double qx,
+                  double qy, double fill, double *z) {
+  *z = fill;
+  if (tri->num_real == 0 || !isfinite(qx) || !isfinite(qy)) {
+    return 0;
+  }
+  int t = locate(tri, qx, qy, start_triangle(tri, qx, qy));
+  const struct tri *T = &tri->t[t];
+  if (is_ghost(T)) {
+    return 0;
+  }
+  for (int k = 0; k < 3; k++) {
+    int v = T->v[k];
+    if (tri->x[v] == qx && tri->y[v] == qy) {
+      *z = tri->z_sum[v] / tri->count[v];
+      return 0;
+    }
+  }
+  // On the hull, the coordinates tend to linear interpolation along the edge
+  for (int k = 0; k < 3; k++) {
+    int a = T->v[(k + 1) % 3], b = T->v[(k + 2) % 3];
+    if (is_ghost(&tri->t[T->n[k]]) &&
+        orient(tri->x[a], tri->y[a], tri->x[b], tri->y[b], qx, qy) == 0.0) {
+      double ex = tri->x[b] - tri->x[a], ey = tri->y[b] - tri->y[a];
+      double s = ((qx - tri->x[a]) * ex + (qy - tri->y[a]) * ey) /
+                 (ex * ex + ey * ey);
+      *z = (1.0 - s) * (tri->z_sum[a] / tri->count[a]) +
+           s * (tri->z_sum[b] / tri->count[b]);
+      return 0;
+    }
+  }
+  int status = cavity_grow(tri, cav, qx, qy, t, 1);
+  if (status != 0) {
+    return status > 0 ? 0 : -1;
+  }
+
+  // Circumcenters of the cavity triangles, then of the new triangles of the
+  // boundary edges, then room for a polygon
+  size_t nc = cav->num_tris, ne = cav->num_edges;
+  size_t need = 2 * nc + 2 * ne + 3 * (nc + 2);
+  if (need > cav->cap_work) {
+    double *work = realloc(cav->work, need * sizeof(double));
+    if (work == NULL) {
+      return -1;
+    }
+    cav->work = work;
+    cav->cap_work = need;
+  }
+  double *cc = cav->work, *g = cc + 2 * nc, *poly = g + 2 * ne;
+  const double *x = tri->x, *y = tri->y;
+  for (size_t k = 0; k < nc; k++) {
+    const int *v = tri->t[cav->tris[k]].v;
+    double ax = x[v[0]] - qx, ay = y[v[0]] - qy;
+    circumcenter(x[v[1]] - x[v[0]], y[v[1]] - y[v[0]], x[v[2]] - x[v[0]],
+                 y[v[2]] - y[v[0]], &cc[2 * k], &cc[2 * k + 1]);
+    cc[2 * k] += ax;
+    cc[2 * k + 1] += ay;
+  }
+  for (size_t k = 0; k < ne; k++) {
+    const struct edge *e = &cav->edges[k];
+    circumcenter(x[e->a] - qx, y[e->a] - qy, x[e->b] - qx, y[e->b] - qy,
+                 &g[2 * k], &g[2 * k + 1]);
+  }
+
+  double w_sum = 0.0, wz_sum = 0.0;
+  for (size_t k = 0; k < ne; k++) {
+    int v = cav->edges[k].a;
+    int n = 0;
+    poly[3 * n] = g[2 * k];
+    poly[3 * n++ + 1] = g[2 * k + 1];
+    for (size_t j = 0; j < ne; j++) {
+      if (cav->edges[j].b == v) {
+        poly[3 * n] = g[2 * j];
+        poly[3 * n++ + 1] = g[2 * j + 1];
+        break;
+      }
+    }
+    for (size_t j = 0; j < nc; j++) {
+      const int *tv = tri->t[cav->tris[j]].v;
+      if (tv[0] == v || tv[1] == v || tv[2] == v) {
+        poly[3 * n] = cc[2 * j];
+        poly[3 * n++ + 1] = cc[2 * j + 1];
+      }
+    }
+    double w = convex_area(poly, n);
+    w_sum += w;
+    wz_sum += w * (tri->z_sum[v] / tri->count[v]);
+  }
+  if (w_sum > 0.0) {
+    *z = wz_sum / w_sum;
+  }
+  return 0;
+}
+
+double nn_point(const struct nn_tri *tri, double x, double y, double fill) {
+  struct cavity cav = {0};
+  double z;
+  if (sibson(tri, &cav, x, y, fill, &z) != 0) {
+    z = NAN;
+  }
+  cavity_free(&cav);
+  return z;
+}
+
+struct query {
+  const struct nn_tri *tri;
+  double fill;
+};
+
+/**
+ * Interpolate points [begin, end) (par_fn)
+ */
+static int eval_points(const struct par_points *points, size_t begin,
+                       size_t end, double *z, void *ctx) {
+  const struct query *q = ctx;
+  struct cavity cav = {0};
+  int status = 0;
+  for (size_t i = begin; i < end; i++) {
+    double x, y;
+    par_point(points, i, &x, &y);
+    if (sibson(q->tri, &cav, x, y, q->fill, &z[i]) != 0) {
+      status = 1;
+      break;
+    }
+  }
+  cavity_free(&cav);
+  return status;
+}
+
+int nn_points(const struct nn_tri *tri, size_t n, const double *x,
+              const double *y, double *z, double fill, int num_threads) {
+  if (tri == NULL) {
+    return -1;
+  }
+  struct query q = {tri, fill};
+  return par_points(n, x, y, z, num_threads, eval_points, &q);
+}
+
+int nn_grid_stream(const struct nn_tri *tri, const struct idw_grid *grid,
+                   double fill, int num_threads, idw_row_fn fn, void *ctx) {
+  if (tri == NULL || grid == NULL || fn == NULL) {
+    return -1;
+  }
+  struct query q = {tri, fill};
+  return par_grid_stream(grid, num_threads, eval_points, &q, fn, ctx);
+}
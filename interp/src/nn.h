@@ -0,0 +1,136 @@
+/**
+ * @file
+ * @brief Natural neighbor (Sibson) interpolation on a Delaunay triangulation
+ *
+ * The observations are triangulated incrementally (Bowyer-Watson): each new
+ * point is located by walking from a nearby triangle, found through a grid
+ * of recently inserted vertices, and the triangles whose circumcircles hold
+ * it are replaced by a fan around it. The hull is closed by "ghost"
+ * triangles to a vertex at infinity, so points can be added anywhere at any
+ * time, without a bounding triangle or rebuilding.
+ *
+ * The value at a point is the mean of its natural neighbors' values,
+ * weighted by the area each would lose to the point's Voronoi cell if it
+ * were inserted (Sibson's coordinates). It is exact at the observations,
+ * reproduces linear functions, and is smooth except at the observations.
+ * On the convex hull of the observations it is linear along the hull's
+ * edges (the limit of the coordinates there), and points outside it get the
+ * fill value.
+ *
+ * Distances are planar in (x, y), as in `plots.py`. Queries only read the
+ * triangulation, so they can run in parallel, but not at the same time as
+ * insertions.
+ */
+
+#ifndef INTERP_NN_H
+#define INTERP_NN_H
+
+#include "idw.h"
+#include <stddef.h>
+
+/**
+ * Delaunay triangulation of observations (opaque)
+ */
+struct nn_tri;
+
+/**
+ * Create an empty triangulation
+ *
+ * @return Triangulation, or NULL on allocation failure
+ */
+struct nn_tri *nn_create(void);
+
+/**
+ * Triangulate observations, inserting them along a space-filling curve so
+ * that each is found near the previous one
+ *
+ * @param n Number of observations
+ * @param x Observation x
+ * @param y Observation y
+ * @param z Observation values
+ * @return Triangulation, or NULL on allocation failure
+ */
+struct nn_tri *nn_build(size_t n, const double *x, const double *y,
+                        const double *z);
+
+/**
+ * Free a triangulation (NULL is ignored)
+ */
+void nn_free(struct nn_tri *tri);
+
+/**
+ * Add an observation
+ * An observation at the same point as an earlier one is merged with it,
+ * and the point gets the mean of their values
+ *
+ * @param tri Triangulation
+ * @param x Observation x
+ * @param y Observation y
+ * @param z Observation value
+ * @return 0 on success, 1 if merged, -1 on allocation failure or if x or y
+ * is not finite
+ */
+int nn_insert(struct nn_tri *tri, double x, double y, double z);
+
+/**
+ * Number of distinct observation points
+ */
+size_t nn_num_vertices(const struct nn_tri *tri);
+
+/**
+ * Number of triangles (0 until three points are not on a line)
+ */
+size_t nn_num_triangles(const struct nn_tri *tri);
+
+/**
+ * Check the triangulation: neighbors, orientation, the Delaunay property of
+ * every edge, and the number of triangles
+ *
+ * @return 0 if valid, non-zero otherwise
+ */
+int nn_check(const struct nn_tri *tri);
+
+/**
+ * Interpolate to one point
+ *
+ * @param tri Triangulation
+ * @param x Point x
+ * @param y Point y
+ * @param fill Value outside the convex hull of the observations
+ * @return Interpolated value, fill, or NaN on allocation failure
+ */
+double nn_point(const struct nn_tri *tri, double x, double y, double fill);
+
+/**
+ * Interpolate to many points, using multiple threads
+ * Each value is the same as nn_point's
+ *
+ * @param tri Triangulation
+ * @param n Number of points
+ * @param x Point x
+ * @param y Point y
+ * @param z Array to store the interpolated values
+ * @param fill Value outside the convex hull of the observations
+ * @param num_threads Number of threads (<= 0 for one per processor)
+ * @return 0 on success, non-zero on failure
+ */
+int nn_points(const struct nn_tri *tri, size_t n, const double *x,
+              const double *y, double *z, double fill, int num_threads);
+
+/**
+ * Interpolate to a regular grid, passing each row to a callback in order
+ * (see idw_grid_stream)
+ *
+ * @param tri Triangulation
+ * @param grid Grid
+ * @param fill Value outside the convex hull of the observations
+ * @param num_threads Number of threads (<= 0 for one per processor)
+ * @param fn Row callback
+ * @param ctx Context pointer passed to fn
+ * @return 0 on success, the callback's non-zero value if it stopped, or -1
+ * on failure
+ */
+int nn_grid_stream(const struct nn_tri *tri, const struct idw_grid *grid,
+                   double fill, int num_threads, idw_row_fn fn, void *ctx);
+
+#endif /* INTERP_NN_H */
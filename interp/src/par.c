@@ -0,0 +1,130 @@
+/**
+ * @file
+ * @brief Parallel evaluation of interpolation methods over points and grids
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "par.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define CHUNK_POINTS 256   // Points per unit of work of a thread
+#define BLOCK_POINTS 65536 // Points per block of par_grid_stream
+
+struct job {
+  struct par_points points;
+  size_t n;
+  double *z;
+  par_fn fn;
+  void *ctx;
+  int num_threads;
+};
+
+struct worker {
+  const struct job *job;
+  int id;
+  int status;
+};
+
+/**
+ * Evaluate chunks id, id + num_threads, ... of the job
+ */
+static void *work(void *arg) {
+  struct worker *w = arg;
+  const struct job *job = w->job;
+  w->status = 0;
+  for (size_t begin = (size_t)w->id * CHUNK_POINTS; begin < job->n;
+       begin += (size_t)job->num_threads * CHUNK_POINTS) {
+    size_t end = begin + CHUNK_POINTS < job->n ? begin + CHUNK_POINTS : job->n;
+    if (job->fn(&job->points, begin, end, job->z, job->ctx) != 0) {
+      w->status = 1;
+      break;
+    }
+  }
+  return NULL;
+}
+
+static int thread_count(int num_threads, size_t n) {
+  if (num_threads <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cpus > 0 ? (int)cpus : 1;
+  }
+  size_t chunks = (n + CHUNK_POINTS - 1) / CHUNK_POINTS;
+  return (size_t)num_threads > chunks ? (int)(chunks > 0 ? chunks : 1)
+                                      : num_threads;
+}
+
+/**
+ * Run a job on its threads (the calling thread is the first; the chunks of
+ * threads that fail to start are also done here)
+ */
+static int run(struct job *job) {
+  struct worker *workers = malloc(job->num_threads * sizeof(*workers));
+  pthread_t *threads = malloc(job->num_threads * sizeof(*threads));
+  int *started = calloc(job->num_threads, sizeof(*started));
+  if (workers == NULL || threads == NULL || started == NULL) {
+    free(workers);
+    free(threads);
+    free(started);
+    return -1;
+  }
+  for (int i = 0; i < job->num_threads; i++) {
+    workers[i] = (struct worker){job, i, 1};
+  }
+  for (int i = 1; i < job->num_threads; i++) {
+    started[i] = pthread_create(&threads[i], NULL, work, &workers[i]) == 0;
+  }
+  int status = 0;
+  for (int i = 0; i < job->num_threads; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      work(&workers[i]);
+    }
+    status |= workers[i].status;
+  }
+  free(workers);
+  free(threads);
+  free(started);
+  return status != 0 ? -1 : 0;
+}
+
+int par_points(size_t n, const double *x, const double *y, double *z,
+               int num_threads, par_fn fn, void *ctx) {
+  struct job job = {{x, y, NULL, 0}, n, z, fn, ctx, 0};
+  job.num_threads = thread_count(num_threads, n);
+  return run(&job);
+}
+
+int par_grid_stream(const struct idw_grid *grid, int num_threads, par_fn fn,
+                    void *ctx, idw_row_fn row_fn, void *row_ctx) {
+  if (grid->nx == 0 || grid->ny == 0) {
+    return 0;
+  }
+  size_t rows = BLOCK_POINTS / grid->nx > 0 ? BLOCK_POINTS / grid->nx : 1;
+  rows = rows < grid->ny ? rows : grid->ny;
+  double *z = malloc(rows * grid->nx * sizeof(double));
+  if (z == NULL) {
+    return -1;
+  }
+
+  struct job job = {{NULL, NULL, grid, 0}, 0, z, fn, ctx, 0};
+  int status = 0;
+  for (size_t row0 = 0; row0 < grid->ny && status == 0; row0 += rows) {
+    size_t num_rows = row0 + rows < grid->ny ? rows : grid->ny - row0;
+    job.points.row0 = row0;
+    job.n = num_rows * grid->nx;
+    job.num_threads = thread_count(num_threads, job.n);
+    if (run(&job) != 0) {
+      status = -1;
+      break;
+    }
+    for (size_t r = 0; r < num_rows && status == 0; r++) {
+      status = row_fn(row0 + r, &z[r * grid->nx], row_ctx);
+    }
+  }
+  free(z);
+  return status;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Parallel evaluation of interpolation methods over points and grids
+ *
+ * Shared by the IDW and natural neighbor libraries: the points are split
+ * in chunks, which threads take in turn, and grids are computed a block of
+ * rows at a time and passed to a row callback in order.
+ */
+
+#ifndef INTERP_PAR_H
+#define INTERP_PAR_H
+
+#include "idw.h"
+#include <stddef.h>
+
+/**
+ * Points to evaluate: arrays, or rows of a grid from row0
+ */
+struct par_points {
+  const double *x, *y;
+  const struct idw_grid *grid;
+  size_t row0;
+};
+
+/**
+ * Coordinates of point i
+ */
+static inline void par_point(const struct par_points *p, size_t i, double *x,
+                             double *y) {
+  if (p->grid != NULL) {
+    *x = p->grid->x0 + (i % p->grid->nx) * p->grid->dx;
+    *y = p->grid->y0 + (p->row0 + i / p->grid->nx) * p->grid->dy;
+  } else {
+    *x = p->x[i];
+    *y = p->y[i];
+  }
+}
+
+/**
+ * Evaluation of points [begin, end) into z[begin, end)
+ * Called from multiple threads at once, for different ranges
+ *
+ * @return 0 on success, non-zero on failure
+ */
+typedef int (*par_fn)(const struct par_points *points, size_t begin,
+                      size_t end, double *z, void *ctx);
+
+/**
+ * Evaluate n points of arrays
+ *
+ * @param num_threads Number of threads (<= 0 for one per processor)
+ * @return 0 on success, -1 on failure
+ */
+int par_points(size_t n, const double *x, const double *y, double *z,
+               int num_threads, par_fn fn, void *ctx);
+
+/**
+ * Evaluate a grid, passing each row to row_fn in order (see
+ * idw_grid_stream)
+ *
+ * @return 0 on success, row_fn's non-zero value if it stopped, or -1 on
+ * failure
+ */
+int par_grid_stream(const struct idw_grid *grid, int num_threads, par_fn fn,
+                    void *ctx, idw_row_fn row_fn, void *row_ctx);
+
+#endif /* INTERP_PAR_H */
@@ -0,0 +1,487 @@
+/**
+ * Test program for the IDW and natural neighbor interpolation libraries
+ */
+
+#include "idw.h"
+#include "lib.h"
+#include "nn.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_OBS 2000
+#define NUM_QUERIES 500
+#define TOLERANCE 1.0e-9
+
+static double uniform(double lo, double hi) {
+  return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+/* Distances from the query, for sorting indices */
+static const double *sort_dist;
+
+static int compare_index(const void *a, const void *b) {
+  double da = sort_dist[*(const size_t *)a];
+  double db = sort_dist[*(const size_t *)b];
+  return (da > db) - (da < db);
+}
+
+/**
+ * Brute-force IDW: every distance (g2r's range on the sphere), sorted
+ */
+static double reference(enum idw_metric metric, const struct idw_options *opt,
+                        size_t n, const double *x, const double *y,
+                        const double *z, double qx, double qy, double *dist,
+                        size_t *index) {
+  for (size_t i = 0; i < n; i++) {
+    if (metric == IDW_SPHERE) {
+      double bearing;
+      g2r(&dist[i], &bearing, qx, qy, x[i], y[i]);
+    } else {
+      dist[i] = hypot(x[i] - qx, y[i] - qy);
+    }
+    index[i] = i;
+  }
+  sort_dist = dist;
+  qsort(index, n, sizeof(size_t), compare_index);
+
+  size_t k = opt->k > 0 && (size_t)opt->k < n ? (size_t)opt->k : n;
+  double w_sum = 0.0, wz_sum = 0.0;
+  for (size_t j = 0; j < k; j++) {
+    double d = dist[index[j]];
+    if (opt->radius > 0.0 && d > opt->radius) {
+      break;
+    }
+    if (d == 0.0) {
+      return z[index[j]];
+    }
+    double w = pow(d, -opt->power);
+    w_sum += w;
+    wz_sum += w * z[index[j]];
+  }
+  return w_sum > 0.0 ? wz_sum / w_sum : opt->fill;
+}
+
+int test_matches_brute_force() {
+  printf("Testing k-d tree IDW against brute force...\n");
+
+  static double x[NUM_OBS], y[NUM_OBS], z[NUM_OBS], dist[NUM_OBS];
+  static size_t index[NUM_OBS];
+  const struct {
+    enum idw_metric metric;
+    struct idw_options opt;
+  } cases[] = {
+      {IDW_PLANE, {2.0, 0, 0.0, NAN}},    {IDW_PLANE, {2.0, 8, 0.0, NAN}},
+      {IDW_PLANE, {3.0, 1, 0.0, NAN}},    {IDW_PLANE, {1.5, 0, 3.0, -1.0}},
+      {IDW_PLANE, {2.0, 12, 2.0, -1.0}},  {IDW_SPHERE, {2.0, 0, 0.0, NAN}},
+      {IDW_SPHERE, {2.0, 10, 0.0, NAN}},  {IDW_SPHERE, {2.5, 0, 800.0, -1.0}},
+      {IDW_SPHERE, {2.0, 6, 500.0, -1.0}},
+  };
+  const int num_cases = sizeof(cases) / sizeof(cases[0]);
+
+  int failures = 0;
+  srand(1);
+  for (int c = 0; c < num_cases; c++) {
+    enum idw_metric metric = cases[c].metric;
+    const struct idw_options *opt = &cases[c].opt;
+
+    // Observations over a region (crossing the date line on the sphere),
+    // queries over a slightly larger one, including some outside
+    for (int i = 0; i < NUM_OBS; i++) {
+      if (metric == IDW_SPHERE) {
+        x[i] = uniform(-180.0, 180.0);
+        y[i] = uniform(-70.0, 85.0);
+      } else {
+        x[i] = uniform(0.0, 40.0);
+        y[i] = uniform(-10.0, 10.0);
+      }
+      z[i] = uniform(0.0, 10.0);
+    }
+    struct idw_tree *tree = idw_tree_build(NUM_OBS, x, y, z, metric);
+    if (tree == NULL) {
+      printf("Failed to build the tree\n");
+      return 1;
+    }
+
+    double max_diff = 0.0;
+    int num_fill = 0;
+    for (int q = 0; q < NUM_QUERIES; q++) {
+      double qx, qy;
+      if (metric == IDW_SPHERE) {
+        qx = uniform(-180.0, 179.9);
+        qy = uniform(-90.0, 90.0);
+      } else {
+        qx = uniform(-5.0, 45.0);
+        qy = uniform(-15.0, 15.0);
+      }
+      double expected =
+          reference(metric, opt, NUM_OBS, x, y, z, qx, qy, dist, index);
+      double got = idw_point(tree, opt, qx, qy);
+      if (isnan(expected) && isnan(got)) {
+        continue;
+      }
+      num_fill += expected == opt->fill;
+      double diff = fabs(got - expected) / fmax(fabs(expected), 1.0);
+      max_diff = fmax(max_diff, isnan(diff) ? INFINITY : diff);
+    }
+    printf("%-6s power %.1f k %2d radius %5.0f: max difference %.2e "
+           "(%d filled)\n",
+           metric == IDW_SPHERE ? "sphere" : "plane", opt->power, opt->k,
+           opt->radius, max_diff, num_fill);
+    if (!(max_diff < TOLERANCE)) {
+      failures++;
+    }
+    idw_tree_free(tree);
+  }
+
+  if (failures == 0) {
+    printf("Results match brute force within tolerance\n");
+    return 0;
+  } else {
+    printf("%d cases don't match brute force\n", failures);
+    return 1;
+  }
+}
+
+int test_special_cases() {
+  printf("Testing observations at the point, duplicates and fill...\n");
+
+  // Two observations at the same point, and one far away
+  const double x[] = {10.0, 10.0, 50.0};
+  const double y[] = {20.0, 20.0, -30.0};
+  const double z[] = {1.0, 3.0, 100.0};
+  int failures = 0;
+  for (int m = 0; m < 2; m++) {
+    enum idw_metric metric = m ? IDW_SPHERE : IDW_PLANE;
+    struct idw_tree *tree = idw_tree_build(3, x, y, z, metric);
+    struct idw_options all = IDW_OPTIONS_DEFAULT;
+    struct idw_options near = {2.0, 1, 1.0, -999.0};
+
+    // Mean of the duplicates at their point, the value at a single one
+    failures += idw_point(tree, &all, 10.0, 20.0) != 2.0;
+    failures += idw_point(tree, &all, 50.0, -30.0) != 100.0;
+    // Nothing within the radius
+    failures += idw_point(tree, &near, 30.0, 0.0) != -999.0;
+    failures += !isnan(idw_point(tree, &(struct idw_options){2.0, 0, 1.0, NAN},
+                                 30.0, 0.0));
+    // More neighbors than observations is all of them
+    struct idw_options many = {2.0, 10, 0.0, NAN};
+    failures += idw_point(tree, &many, 30.0, 0.0) !=
+                idw_point(tree, &all, 30.0, 0.0);
+    idw_tree_free(tree);
+  }
+  failures += idw_tree_build(0, x, y, z, IDW_PLANE) != NULL;
+
+  if (failures == 0) {
+    printf("Special cases are correct\n");
+    return 0;
+  } else {
+    printf("%d special case failures\n", failures);
+    return 1;
+  }
+}
+
+/* Grid rows collected by the stream callback */
+struct collect {
+  double *values;
+  size_t nx, next_row;
+  int out_of_order;
+};
+
+static int collect_row(size_t row, const double *values, void *ctx) {
+  struct collect *c = ctx;
+  c->out_of_order += row != c->next_row++;
+  memcpy(&c->values[row * c->nx], values, c->nx * sizeof(double));
+  return 0;
+}
+
+static int stop_row(size_t row, const double *values, void *ctx) {
+  (void)values;
+  (void)ctx;
+  return row == 3 ? 42 : 0;
+}
+
+int test_threads_and_stream() {
+  printf("Testing threads and grid streaming against single points...\n");
+
+  enum { N = 5000, NX = 301, NY = 250 };
+  static double x[N], y[N], z[N];
+  static double gx[NX * NY], gy[NX * NY], expected[NX * NY];
+  static double got[NX * NY], streamed[NX * NY];
+  srand(2);
+  for (int i = 0; i < N; i++) {
+    x[i] = uniform(-100.0, -60.0);
+    y[i] = uniform(20.0, 50.0);
+    z[i] = uniform(0.0, 1.0);
+  }
+  // Grid larger than a stream block, so the rows come in several blocks
+  struct idw_grid grid = {-105.0, 0.2, 15.0, 0.15, NX, NY};
+  for (int r = 0; r < NY; r++) {
+    for (int c = 0; c < NX; c++) {
+      gx[r * NX + c] = grid.x0 + c * grid.dx;
+      gy[r * NX + c] = grid.y0 + r * grid.dy;
+    }
+  }
+
+  struct idw_tree *tree = idw_tree_build(N, x, y, z, IDW_SPHERE);
+  struct idw_options opt = {2.0, 16, 300.0, NAN};
+  for (int i = 0; i < NX * NY; i++) {
+    expected[i] = idw_point(tree, &opt, gx[i], gy[i]);
+  }
+
+  int failures = 0;
+  const int threads[] = {1, 3, 8, 0};
+  for (int t = 0; t < 4; t++) {
+    memset(got, 0, sizeof(got));
+    failures += idw_points(tree, &opt, NX * NY, gx, gy, got, threads[t]) != 0;
+    failures += memcmp(got, expected, sizeof(got)) != 0;
+
+    struct collect c = {streamed, NX, 0, 0};
+    memset(streamed, 0, sizeof(streamed));
+    failures += idw_grid_stream(tree, &opt, &grid, threads[t], collect_row,
+                                &c) != 0;
+    failures += c.out_of_order != 0 || c.next_row != NY;
+    failures += memcmp(streamed, expected, sizeof(streamed)) != 0;
+  }
+  failures += idw_grid_stream(tree, &opt, &grid, 2, stop_row, NULL) != 42;
+  idw_tree_free(tree);
+
+  if (failures == 0) {
+    printf("Threaded and streamed results are identical\n");
+    return 0;
+  } else {
+    printf("%d threading or streaming failures\n", failures);
+    return 1;
+  }
+}
+
+/* Linear function, which natural neighbor interpolation reproduces */
+static double plane(double x, double y) { return 2.0 + 3.0 * x - y; }
+
+/**
+ * Observation sets: random, a lattice (many points on the same circles),
+ * points on a line before the rest, and lattices of degrees whose spacing
+ * isn't a power of two (rounded, and moved by less than a rounding error)
+ */
+static size_t make_observations(int set, double *x, double *y) {
+  size_t n = 0;
+  if (set == 0) {
+    for (; n < 20000; n++) {
+      x[n] = uniform(0.0, 10.0);
+      y[n] = uniform(-3.0, 3.0);
+    }
+  } else if (set == 1) {
+    for (int i = 0; i < 60; i++) {
+      for (int j = 0; j < 60; j++) {
+        x[n] = i * 0.5;
+        y[n++] = j * 0.25;
+      }
+    }
+  } else if (set == 3 || set == 4) {
+    for (int i = 0; i < 100; i++) {
+      for (int j = 0; j < 100; j++) {
+        double d = set == 4 && (i + j) % 2 ? 1e-13 : 0.0;
+        x[n] = -75.4 + i * (set == 3 ? 0.1 : 0.01) + d;
+        y[n++] = 37.8 + j * (set == 3 ? 0.1 : 0.03) - d;
+      }
+    }
+  } else {
+    for (; n < 50; n++) {
+      x[n] = n * 0.2;
+      y[n] = 1.0 + n * 0.1;
+    }
+    for (; n < 3000; n++) {
+      x[n] = uniform(0.0, 10.0);
+      y[n] = uniform(0.0, 6.0);
+    }
+  }
+  return n;
+}
+
+int test_nn_triangulation() {
+  printf("Testing the Delaunay triangulation...\n");
+
+  static double x[20000], y[20000], z[20000];
+  int failures = 0;
+  srand(3);
+  for (int set = 0; set < 5; set++) {
+    size_t n = make_observations(set, x, y);
+    for (size_t i = 0; i < n; i++) {
+      z[i] = plane(x[i], y[i]);
+    }
+
+    // Built along the curve, and inserted one by one in the given order
+    struct nn_tri *built = nn_build(n, x, y, z);
+    struct nn_tri *inserted = nn_create();
+    for (size_t i = 0; i < n; i++) {
+      failures += nn_insert(inserted, x[i], y[i], z[i]) != 0;
+    }
+    failures += nn_check(built) != 0 || nn_check(inserted) != 0;
+    failures += nn_num_vertices(built) != n || nn_num_vertices(inserted) != n;
+
+    // Then more: duplicates (merged), and points outside the hull
+    for (int i = 0; i < 200; i++) {
+      size_t j = rand() % n;
+      failures += nn_insert(built, x[j], y[j], z[j]) != 1;
+      double px = uniform(-20.0, 40.0), py = uniform(-20.0, 30.0);
+      failures += nn_insert(built, px, py, plane(px, py)) < 0;
+    }
+    failures += nn_check(built) != 0;
+    failures += nn_insert(built, NAN, 0.0, 0.0) != -1;
+
+    printf("Set %d: %zu points and %zu triangles, then %zu points and "
+           "%zu triangles\n",
+           set, n, nn_num_triangles(inserted), nn_num_vertices(built),
+           nn_num_triangles(built));
+    nn_free(built);
+    nn_free(inserted);
+  }
+
+  // Fewer than three points, or all on a line, make no triangles
+  struct nn_tri *tri = nn_create();
+  for (int i = 0; i < 5; i++) {
+    failures += nn_insert(tri, i, 2.0 * i, 1.0) != 0;
+  }
+  failures += nn_num_triangles(tri) != 0 || nn_check(tri) != 0;
+  failures += !isnan(nn_point(tri, 1.0, 2.0, NAN));
+  failures += nn_insert(tri, 0.0, 1.0, 1.0) != 0;
+  failures += nn_num_triangles(tri) != 4 || nn_check(tri) != 0;
+  nn_free(tri);
+
+  if (failures == 0) {
+    printf("Triangulations are valid\n");
+    return 0;
+  } else {
+    printf("%d triangulation failures\n", failures);
+    return 1;
+  }
+}
+
+int test_nn_interpolation() {
+  printf("Testing natural neighbor interpolation...\n");
+
+  static double x[20000], y[20000], z[20000];
+  int failures = 0;
+  srand(4);
+  for (int set = 0; set < 3; set++) {
+    size_t n = make_observations(set, x, y);
+    for (size_t i = 0; i < n; i++) {
+      z[i] = plane(x[i], y[i]);
+    }
+    struct nn_tri *built = nn_build(n, x, y, z);
+    struct nn_tri *inserted = nn_create();
+    for (size_t i = n; i-- > 0;) {
+      nn_insert(inserted, x[i], y[i], z[i]);
+    }
+
+    // Linear functions are reproduced inside the hull, the observations
+    // exactly, and the coordinates don't depend on the insertion order
+    // (or on the triangulation of points on the same circle)
+    double max_error = 0.0, max_diff = 0.0;
+    int num_fill = 0;
+    for (int q = 0; q < 20000; q++) {
+      double px = uniform(-1.0, 31.0), py = uniform(-4.0, 16.0);
+      if (q % 10 == 0) {
+        px = x[q % n];
+        py = y[q % n];
+      }
+      double a = nn_point(built, px, py, -999.0);
+      double b = nn_point(inserted, px, py, -999.0);
+      if (a == -999.0) {
+        num_fill++;
+        failures += b != -999.0;
+        continue;
+      }
+      max_error = fmax(max_error, fabs(a - plane(px, py)));
+      max_diff = fmax(max_diff, fabs(a - b));
+      failures += q % 10 == 0 && a != z[q % n];
+    }
+    // Linear along the edges of the lattice's hull
+    for (int q = 0; set == 1 && q < 100; q++) {
+      double px = uniform(0.0, 29.5), py = uniform(0.0, 14.75);
+      max_error = fmax(max_error, fabs(nn_point(built, px, 0.0, -999.0) -
+                                       plane(px, 0.0)));
+      max_error = fmax(max_error, fabs(nn_point(built, 29.5, py, -999.0) -
+                                       plane(29.5, py)));
+    }
+    printf("Set %d: max error %.2e, max order difference %.2e, %d filled\n",
+           set, max_error, max_diff, num_fill);
+    failures += !(max_error < 1e-9) || !(max_diff < 1e-9) || num_fill == 0;
+    nn_free(built);
+    nn_free(inserted);
+  }
+
+  if (failures == 0) {
+    printf("Interpolation is linear, exact at the observations, and "
+           "independent of the order\n");
+    return 0;
+  } else {
+    printf("%d interpolation failures\n", failures);
+    return 1;
+  }
+}
+
+int test_nn_threads_and_stream() {
+  printf("Testing natural neighbor threads and streaming...\n");
+
+  enum { N = 5000, NX = 301, NY = 250 };
+  static double x[N], y[N], z[N];
+  static double gx[NX * NY], gy[NX * NY], expected[NX * NY];
+  static double got[NX * NY], streamed[NX * NY];
+  srand(5);
+  for (int i = 0; i < N; i++) {
+    x[i] = uniform(-100.0, -60.0);
+    y[i] = uniform(20.0, 50.0);
+    z[i] = uniform(0.0, 1.0);
+  }
+  struct idw_grid grid = {-105.0, 0.2, 15.0, 0.15, NX, NY};
+  for (int r = 0; r < NY; r++) {
+    for (int c = 0; c < NX; c++) {
+      gx[r * NX + c] = grid.x0 + c * grid.dx;
+      gy[r * NX + c] = grid.y0 + r * grid.dy;
+    }
+  }
+
+  struct nn_tri *tri = nn_build(N, x, y, z);
+  for (int i = 0; i < NX * NY; i++) {
+    expected[i] = nn_point(tri, gx[i], gy[i], -1.0);
+  }
+
+  int failures = 0;
+  const int threads[] = {1, 3, 8, 0};
+  for (int t = 0; t < 4; t++) {
+    memset(got, 0, sizeof(got));
+    failures +=
+        nn_points(tri, NX * NY, gx, gy, got, -1.0, threads[t]) != 0;
+    failures += memcmp(got, expected, sizeof(got)) != 0;
+
+    struct collect c = {streamed, NX, 0, 0};
+    memset(streamed, 0, sizeof(streamed));
+    failures += nn_grid_stream(tri, &grid, -1.0, threads[t], collect_row,
+                               &c) != 0;
+    failures += c.out_of_order != 0 || c.next_row != NY;
+    failures += memcmp(streamed, expected, sizeof(streamed)) != 0;
+  }
+  nn_free(tri);
+
+  if (failures == 0) {
+    printf("Threaded and streamed results are identical\n");
+    return 0;
+  } else {
+    printf("%d threading or streaming failures\n", failures);
+    return 1;
+  }
+}
+
+int main() {
+  int result = test_matches_brute_force();
+  result |= test_special_cases();
+  result |= test_threads_and_stream();
+  result |= test_nn_triangulation();
+  result |= test_nn_interpolation();
+  result |= test_nn_threads_and_stream();
+  printf("Test %s\n", result == 0 ? "PASSED" : "FAILED");
+
+  return result;
+}
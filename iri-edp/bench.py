@@ -0,0 +1,216 @@
+#!/usr/bin/env -S uv run --script
+"""
+Compare the Python module (src/iri_edp, `make python`) with running the
+`iri`, `g2r` and `r2g` programs and parsing their text output, for 10^3 to
+10^6 calls. Sizes that would take longer than --max-seconds are skipped (-).
+"""
+# /// script
+# dependencies = [
+#   "numpy",
+# ]
+# ///
+
+from __future__ import annotations
+
+import math
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+HERE = Path(__file__).parent
+SRC = HERE / "src"
+COORD_TRAN_BIN = HERE.parent / "coord-tran" / "bin"
+
+SIZES = [1_000, 10_000, 100_000, 1_000_000]
+
+# The two cases of `iri -c`: latitude, longitude, year, month, day, hour
+CASES = [(37.8, -75.4, 2021, 3, 3, 11.0 + 25.0), (37.8, -75.4, 2021, 3, 4, 23.0 + 25.0)]
+HEIGHTS = (70.0, 600.0, 10.0)
+
+
+class Timer:
+    """Skip sizes whose time, from the rate of the last size, would exceed a limit."""
+
+    def __init__(self, max_seconds: float):
+        self.max_seconds = max_seconds
+        self.per_call = 0.0
+
+    def run(self, n: int, fn):
+        """Time fn(n), or return (nan, None) if it would take too long."""
+        if self.per_call * n > self.max_seconds:
+            return math.nan, None
+        t0 = time.perf_counter()
+        result = fn(n)
+        t = time.perf_counter() - t0
+        self.per_call = t / n
+        return t, result
+
+
+def fmt(t: float, width: int, digits: int) -> str:
+    """Seconds, or - for a skipped size."""
+    return f"{t:{width}.{digits}f}" if not math.isnan(t) else f"{'-':>{width}}"
+
+
+def iri_subprocess(n: int):
+    """`iri -c` for each profile, parsing the CSV into (n, 13, heights)."""
+    import numpy as np
+
+    profiles = []
+    for i in range(n):
+        out = subprocess.run(
+            ["./iri", "-c", str(i % 2 + 1)],
+            cwd=SRC,
+            capture_output=True,
+            text=True,
+            check=True,
+        ).stdout
+        # The model's messages are mixed in with the CSV
+        rows = [
+            line.split(",")
+            for line in out.splitlines()
+            if line.count(",") == 12 and not line.startswith("height")
+        ]
+        profiles.append(np.array(rows, dtype=float).T)
+    return np.array(profiles)
+
+
+def bench_iri(m, timers: dict, n: int, workers: int) -> str:
+    import numpy as np
+
+    cases = np.array([CASES[i % 2] for i in range(n)])
+    lat, lon, hour = cases[:, 0], cases[:, 1], cases[:, 5]
+    year, month, day = (cases[:, k].astype(np.int32) for k in (2, 3, 4))
+
+    t_sub, z_sub = timers["subprocess"].run(n, iri_subprocess)
+    t_loop, _ = timers["loop"].run(
+        n,
+        lambda n: [m.iri_profiles(*CASES[i % 2], *HEIGHTS) for i in range(n)],
+    )
+    t_array, z = timers["array"].run(
+        n,
+        lambda n: m.iri_profiles(
+            lat, lon, year, month, day, hour, *HEIGHTS, workers=workers
+        ),
+    )
+    diff = math.nan
+    if z_sub is not None and z is not None:
+        # Relative, of the CSV's 6 significant digits
+        diff = np.max(np.abs(z - z_sub) / np.maximum(np.abs(z_sub), 1e-300))
+    return (
+        f"{n:8d} {fmt(t_sub, 12, 2)} {fmt(t_loop, 10, 2)} "
+        f"{fmt(t_array, 10, 2)} {diff:10.1e}"
+    )
+
+
+def coord_subprocess(program: str, args, stream: bool):
+    """Run g2r or r2g per point, or once on a stream; returns (n, 2)."""
+    import numpy as np
+
+    exe = str(COORD_TRAN_BIN / program)
+    if stream:
+        lines = "".join(f"{a} {b} {c} {d}\n" for a, b, c, d in args)
+        out = subprocess.run(
+            [exe, "--stream"], input=lines, capture_output=True, text=True, check=True
+        ).stdout
+    else:
+        out = "".join(
+            subprocess.run(
+                [exe, *map(str, a)], capture_output=True, text=True, check=True
+            ).stdout
+            for a in args
+        )
+    return np.array(out.split(), dtype=float).reshape(-1, 2)
+
+
+def bench_coord(m, program: str, timers: dict, n: int, rng) -> str:
+    import numpy as np
+
+    lon0, lat0 = -75.4, 37.8
+    if program == "g2r":
+        u, v = rng.uniform(-180, 180, n), rng.uniform(-89, 89, n)
+    else:
+        u, v = rng.uniform(0, 3000, n), rng.uniform(0, 360, n)
+    # The same values as the text the programs read
+    u, v = (np.array([float(f"{x:.6f}") for x in a]) for a in (u, v))
+    # The programs take the initial point first, the module as the C functions
+    lines = np.column_stack([np.full(n, lon0), np.full(n, lat0), u, v])
+    if program == "g2r":
+        fn, array_args = m.g2r, (lon0, lat0, u, v)
+    else:
+        fn, array_args = m.r2g, (u, v, lon0, lat0)
+
+    def loop(n):
+        if program == "g2r":
+            return [fn(lon0, lat0, u[i], v[i]) for i in range(n)]
+        return [fn(u[i], v[i], lon0, lat0) for i in range(n)]
+
+    t_sub, _ = timers["subprocess"].run(
+        n, lambda n: coord_subprocess(program, lines[:n], False)
+    )
+    t_stream, z_stream = timers["stream"].run(
+        n, lambda n: coord_subprocess(program, lines, True)
+    )
+    t_loop, _ = timers["loop"].run(n, loop)
+    t_array, z = timers["array"].run(n, lambda n: fn(*array_args))
+    diff = math.nan
+    if z_stream is not None and z is not None:
+        # Absolute, of the programs' fixed decimals
+        diff = np.max(np.abs(np.column_stack(z) - z_stream))
+    return (
+        f"{n:8d} {fmt(t_sub, 12, 2)} {fmt(t_stream, 10, 3)} "
+        f"{fmt(t_loop, 10, 3)} {fmt(t_array, 10, 4)} {diff:10.1e}"
+    )
+
+
+def main() -> None:
+    import argparse
+
+    import numpy as np
+
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument(
+        "--max-seconds",
+        type=float,
+        default=60.0,
+        help="Longest time of one method at one size (default: 60).",
+    )
+    parser.add_argument(
+        "-j",
+        "--workers",
+        type=int,
+        default=1,
+        help="Worker processes of the IRI array calls (0: one per processor).",
+    )
+    args = parser.parse_args()
+
+    sys.path.insert(0, str(SRC))
+    import iri_edp
+
+    iri_edp.init(str(SRC))
+    rng = np.random.default_rng(1)
+
+    for program in ["g2r", "r2g"]:
+        print(f"\n{program} (s)")
+        print(
+            f"{'calls':>8} {'subprocess':>12} {'stream':>10} {'loop':>10} "
+            f"{'array':>10} {'max diff':>10}"
+        )
+        timers = {
+            k: Timer(args.max_seconds)
+            for k in ["subprocess", "stream", "loop", "array"]
+        }
+        for n in SIZES:
+            print(bench_coord(iri_edp, program, timers, n, rng), flush=True)
+
+    print("\niri (s)")
+    print(
+        f"{'calls':>8} {'subprocess':>12} {'loop':>10} {'array':>10} {'max diff':>10}"
+    )
+    timers = {k: Timer(args.max_seconds) for k in ["subprocess", "loop", "array"]}
+    for n in SIZES:
+        print(bench_iri(iri_edp, timers, n, args.workers), flush=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -3,10 +3,12 @@
  * @brief Program to generate a vertical profile from the IRI model
  *
  * This program calls the IRI model to generate a vertical profile of
- * electron density or temperature and outputs the results in CSV format.
+ * electron density or temperature and outputs the results in CSV format, or
+ * one of the binary formats of `iri_writer.h`.
  */
 
 #include "iri_interface.h"
+#include "iri_writer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,6 +20,27 @@ void print_usage(const char *progname) {
   printf("                       - 1: 2021-03-03 11:00 UTC\n");
   printf("                       - 2: 2021-03-04 23:00 UTC\n");
   printf("  -o|--out <filename>  Output file (default: stdout)\n");
+  printf("  -f|--format <format> Output format (default: csv)\n");
+  printf("                       - csv: text\n");
+  printf("                       - raw: binary, profile by profile\n");
+  printf("                       - columnar: binary, column by column (needs "
+         "-o)\n");
+  printf("                       - chunked: binary, column by column per "
+         "chunk\n");
+  printf("  --float32            Write binary values as float32 (default: "
+         "float64)\n");
+  printf("  -p|--columns <list>  Comma-separated columns to write, e.g. "
+         "height,ne,Te\n"
+         "                       (default: all)\n");
+  printf("  -d|--data-dir <dir>  Directory with the IRI data files (default: "
+         "current\n"
+         "                       directory)\n");
+  printf("  --stats <filename>   Time the model stages and write them as "
+         "JSON\n"
+         "                       (-: stdout)\n");
+  printf("  --fast               Fast column mode: interpolate the topside "
+         "ion\n"
+         "                       composition terms from knots every 100 km\n");
   printf("  -h|--help            Show this help message\n");
 }
 
@@ -33,7 +56,13 @@ int main(int argc, char *argv[]) {
   double height_end = 600.0;
   double height_step = 10.0;
   char *output_file = NULL;
+  char *data_dir = NULL;
+  char *stats_file = NULL;
+  int fast = 0;
   int case_num = 1;
+  enum iri_format format = IRI_FORMAT_CSV;
+  int value_size = 8;
+  unsigned columns = IRI_COLUMNS_ALL;
 
   /* Parse command line arguments */
   for (int i = 1; i < argc; i++) {
@@ -44,6 +73,38 @@ int main(int argc, char *argv[]) {
                 (strcmp(argv[i], "--out") == 0)) &&
                i + 1 < argc) {
       output_file = argv[++i];
+    } else if (((strcmp(argv[i], "-d") == 0) ||
+                (strcmp(argv[i], "--data-dir") == 0)) &&
+               i + 1 < argc) {
+      data_dir = argv[++i];
+    } else if (((strcmp(argv[i], "-f") == 0) ||
+                (strcmp(argv[i], "--format") == 0)) &&
+               i + 1 < argc) {
+      const char *name = argv[++i];
+      if (strcmp(name, "csv") == 0) {
+        format = IRI_FORMAT_CSV;
+      } else if (strcmp(name, "raw") == 0) {
+        format = IRI_FORMAT_RAW;
+      } else if (strcmp(name, "columnar") == 0) {
+        format = IRI_FORMAT_COLUMNAR;
+      } else if (strcmp(name, "chunked") == 0) {
+        format = IRI_FORMAT_CHUNKED;
+      } else {
+        fprintf(stderr, "Error: Unknown format %s\n", name);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--float32") == 0) {
+      value_size = 4;
+    } else if (((strcmp(argv[i], "-p") == 0) ||
+                (strcmp(argv[i], "--columns") == 0)) &&
+               i + 1 < argc) {
+      if (iri_parse_columns(argv[++i], &columns) != 0) {
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      stats_file = argv[++i];
+    } else if (strcmp(argv[i], "--fast") == 0) {
+      fast = 1;
     } else if ((strcmp(argv[i], "-h") == 0) ||
                (strcmp(argv[i], "--help") == 0)) {
       print_usage(argv[0]);
@@ -68,26 +129,43 @@ int main(int argc, char *argv[]) {
   }
 
   /* Initialize the IRI model */
-  if (iri_init() != 0) {
+  if (iri_init_with_dir(data_dir) != 0) {
     fprintf(stderr, "Failed to initialize IRI model\n");
     return 1;
   }
 
-  /* Vertical profile outputs */
-  double profiles[NUM_PROFILE][MAX_HEIGHT];
+  if (stats_file != NULL) {
+    iri_stats_enable(1);
+  }
+  iri_fast_columns_enable(fast);
 
-  /* Run the IRI model */
-  if (iri_profiles(latitude, longitude, year, month, day, hour, height_start,
-                   height_end, height_step, profiles) != 0) {
-    fprintf(stderr, "IRI model calculation failed\n");
+  /* Run the IRI model, writing the profile as it is computed */
+  int num_heights = iri_num_heights(height_start, height_end, height_step);
+  struct iri_writer *writer = iri_writer_open(
+      output_file, format, value_size, columns, num_heights, 1);
+  if (writer == NULL) {
     return 1;
   }
+  int status = iri_profiles_write(1, &latitude, &longitude, &year, &month,
+                                  &day, &hour, height_start, height_end,
+                                  height_step, 1, 0, writer);
+  if (status != 0) {
+    fprintf(stderr, "IRI model calculation failed\n");
+  }
+  if (iri_writer_close(writer) != 0) {
+    fprintf(stderr, "Failed to write output\n");
+    status = 1;
+  }
 
-  /* Write results to CSV */
-  if (iri_write_csv(output_file, profiles) != 0) {
-    fprintf(stderr, "Failed to write CSV output\n");
-    return 1;
+  if (stats_file != NULL) {
+    struct iri_stats stats;
+    iri_get_stats(&stats);
+    if (iri_write_stats_json(strcmp(stats_file, "-") == 0 ? NULL : stats_file,
+                             &stats) != 0) {
+      fprintf(stderr, "Failed to write stats\n");
+      status = 1;
+    }
   }
 
-  return 0;
+  return status;
 }
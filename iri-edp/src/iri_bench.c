@@ -0,0 +1,1663 @@
+/**
+ * @file
+ * @brief Benchmarks for the C interface to the IRI model
+ *
+ * Run all cases, or only the ones named on the command line.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "iri_cache.h"
+#include "iri_cube.h"
+#include "iri_field.h"
+#include "iri_interface.h"
+#include "iri_tec.h"
+#include "iri_writer.h"
+#include "lib.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Maximum number of workers for the scaling cases (0: one per processor) */
+static int max_workers = 0;
+
+/* Time taken by model initialization, reported by the latency case */
+static double init_time = 0.0;
+
+/* Data directory, for the cases that initialize the model again */
+static const char *data_dir = NULL;
+
+/* Results file, baseline and regression threshold (%) of the micro case */
+static const char *json_file = NULL;
+static const char *baseline_file = NULL;
+static double regression_threshold = 10.0;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Regional grid of columns around Wallops Island at a fixed time,
+ * as used for building Ne maps
+ */
+static int bench_batch_scaling(void) {
+  const int nlat = 16, nlon = 16;
+  const size_t n = nlat * nlon;
+  const double h_start = 70.0, h_end = 600.0, h_step = 10.0;
+  int num_heights = iri_num_heights(h_start, h_end, h_step);
+
+  double *lat = malloc(n * sizeof(double));
+  double *lon = malloc(n * sizeof(double));
+  int *year = malloc(n * sizeof(int));
+  int *month = malloc(n * sizeof(int));
+  int *day = malloc(n * sizeof(int));
+  double *hour = malloc(n * sizeof(double));
+  double *values = malloc(n * NUM_PROFILE * num_heights * sizeof(double));
+  if (!lat || !lon || !year || !month || !day || !hour || !values) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+  for (int i = 0; i < nlat; i++) {
+    for (int j = 0; j < nlon; j++) {
+      size_t k = i * nlon + j;
+      lat[k] = 30.0 + i * 1.0;
+      lon[k] = -85.0 + j * 1.0;
+      year[k] = 2021;
+      month[k] = 3;
+      day[k] = 3;
+      hour[k] = 11.0 + 25.0;
+    }
+  }
+
+  long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+  int top = max_workers > 0 ? max_workers : (nproc > 0 ? (int)nproc : 1);
+
+  /* Warm up: first calls load coefficient files for the date */
+  if (iri_profiles_batch(1, lat, lon, year, month, day, hour, h_start, h_end,
+                         h_step, 1, values) != 0) {
+    fprintf(stderr, "Warmup run failed\n");
+    return 1;
+  }
+
+  printf("batch_scaling: %zu columns x %d heights\n", n, num_heights);
+  printf("%8s %12s %12s %8s\n", "workers", "time(s)", "columns/s", "speedup");
+  double base = 0.0;
+  for (int w = 1;; w = w * 2 < top ? w * 2 : top) {
+    double t0 = now();
+    int status = iri_profiles_batch(n, lat, lon, year, month, day, hour,
+                                    h_start, h_end, h_step, w, values);
+    double dt = now() - t0;
+    if (status != 0) {
+      fprintf(stderr, "Batch run failed with %d workers\n", w);
+      return 1;
+    }
+    if (w == 1) {
+      base = dt;
+    }
+    printf("%8d %12.4f %12.1f %8.2f\n", w, dt, n / dt, base / dt);
+    if (w >= top) {
+      break;
+    }
+  }
+
+  /* A year without IGRF coefficients stops its worker, which must fail the
+     batch rather than leave the point's profile unwritten */
+  year[5] = 1900;
+  if (iri_profiles_batch(8, lat, lon, year, month, day, hour, h_start, h_end,
+                         h_step, 4, values) == 0) {
+    fprintf(stderr, "Batch run with a stopped worker succeeded\n");
+    return 1;
+  }
+
+  free(lat);
+  free(lon);
+  free(year);
+  free(month);
+  free(day);
+  free(hour);
+  free(values);
+  return 0;
+}
+
+/*
+ * Daily profiles at one station for a year, which changes the month (and
+ * the neighbouring month used for interpolation) over the sweep
+ */
+static int bench_year_sweep(void) {
+  static const int days_in_month[12] = {31, 28, 31, 30, 31, 30,
+                                        31, 31, 30, 31, 30, 31};
+  static double profiles[NUM_PROFILE][MAX_HEIGHT];
+  int calls = 0;
+
+  double t0 = now();
+  for (int month = 1; month <= 12; month++) {
+    for (int day = 1; day <= days_in_month[month - 1]; day++) {
+      if (iri_profiles(37.8, -75.4, 2021, month, day, 11.0 + 25.0, 70.0,
+                       600.0, 10.0, profiles) != 0) {
+        return 1;
+      }
+      calls++;
+    }
+  }
+  double dt = now() - t0;
+
+  printf("year_sweep: %d daily profiles\n", calls);
+  printf("%12s %12s\n", "time(s)", "ms/profile");
+  printf("%12.4f %12.3f\n", dt, dt / calls * 1e3);
+  return 0;
+}
+
+/* Profiles for the 15th of each month in turn, so every call changes month */
+static int bench_month_hop(void) {
+  static double profiles[NUM_PROFILE][MAX_HEIGHT];
+  const int rounds = 10;
+  int calls = 0;
+
+  double t0 = now();
+  for (int r = 0; r < rounds; r++) {
+    for (int month = 1; month <= 12; month++) {
+      if (iri_profiles(37.8, -75.4, 2021, month, 15, 11.0 + 25.0, 70.0,
+                       600.0, 10.0, profiles) != 0) {
+        return 1;
+      }
+      calls++;
+    }
+  }
+  double dt = now() - t0;
+
+  printf("month_hop: %d profiles\n", calls);
+  printf("%12s %12s\n", "time(s)", "ms/profile");
+  printf("%12.4f %12.3f\n", dt, dt / calls * 1e3);
+  return 0;
+}
+
+/* Cost of initialization vs. single calls for new dates, which used to open
+   and parse IGRF and coefficient files */
+static int bench_latency(void) {
+  static double profiles[NUM_PROFILE][MAX_HEIGHT];
+  const int calls = 100;
+
+  double t0 = now();
+  if (iri_profiles(37.8, -75.4, 2020, 1, 1, 11.0 + 25.0, 70.0, 600.0, 10.0,
+                   profiles) != 0) {
+    return 1;
+  }
+  double first = now() - t0;
+
+  double total = 0.0, worst = 0.0;
+  for (int i = 0; i < calls; i++) {
+    /* A different date every call, 11 days apart to cycle through months */
+    int day_of_year = (i * 11) % 365;
+    int month = day_of_year / 31 + 1;
+    int day = day_of_year % 28 + 1;
+    t0 = now();
+    if (iri_profiles(37.8, -75.4, 2021 + i % 4, month, day, 11.0 + 25.0,
+                     70.0, 600.0, 10.0, profiles) != 0) {
+      return 1;
+    }
+    double dt = now() - t0;
+    total += dt;
+    worst = dt > worst ? dt : worst;
+  }
+
+  printf("latency: init and %d calls with changing dates\n", calls);
+  printf("%12s %12s %12s %12s\n", "init(ms)", "first(ms)", "mean(ms)",
+         "max(ms)");
+  printf("%12.3f %12.3f %12.3f %12.3f\n", init_time * 1e3, first * 1e3,
+         total / calls * 1e3, worst * 1e3);
+  return 0;
+}
+
+/*
+ * Writing a grid of profiles with iri_write_csv (one call per profile) and
+ * with each writer format, all columns or Ne only
+ */
+static int bench_writers(void) {
+  const size_t n = 256;
+  const double h_start = 70.0, h_end = 600.0, h_step = 10.0;
+  const int rounds = 5;
+  int num_heights = iri_num_heights(h_start, h_end, h_step);
+  static const struct {
+    const char *name;
+    enum iri_format format;
+    int value_size;
+    unsigned columns;
+  } writers[] = {
+      {"csv", IRI_FORMAT_CSV, 8, IRI_COLUMNS_ALL},
+      {"raw64", IRI_FORMAT_RAW, 8, IRI_COLUMNS_ALL},
+      {"raw32", IRI_FORMAT_RAW, 4, IRI_COLUMNS_ALL},
+      {"columnar32", IRI_FORMAT_COLUMNAR, 4, IRI_COLUMNS_ALL},
+      {"chunked32", IRI_FORMAT_CHUNKED, 4, IRI_COLUMNS_ALL},
+      {"csv_ne", IRI_FORMAT_CSV, 8, IRI_COLUMN(1)},
+      {"raw32_ne", IRI_FORMAT_RAW, 4, IRI_COLUMN(1)},
+  };
+  const int num_writers = sizeof(writers) / sizeof(writers[0]);
+
+  double lat[256], lon[256], hour[256];
+  int year[256], month[256], day[256];
+  double *values = malloc(n * NUM_PROFILE * num_heights * sizeof(double));
+  double(*profile)[MAX_HEIGHT] = malloc(NUM_PROFILE * sizeof(*profile));
+  if (!values || !profile) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+  for (size_t k = 0; k < n; k++) {
+    lat[k] = 30.0 + k / 16;
+    lon[k] = -85.0 + k % 16;
+    year[k] = 2021;
+    month[k] = 3;
+    day[k] = 3;
+    hour[k] = 11.0 + 25.0;
+  }
+  if (iri_profiles_batch(n, lat, lon, year, month, day, hour, h_start, h_end,
+                         h_step, max_workers, values) != 0) {
+    fprintf(stderr, "Batch run failed\n");
+    return 1;
+  }
+
+  char path[] = "/tmp/iri_bench_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  printf("writers: %zu profiles x %d heights\n", n, num_heights);
+  printf("%-14s %12s %12s %12s\n", "writer", "ms", "profiles/s", "bytes");
+
+  /* Baseline: one iri_write_csv call per profile into the same file */
+  double t0 = now();
+  for (int r = 0; r < rounds; r++) {
+    FILE *fp = fopen(path, "w");
+    fclose(fp);
+    for (size_t i = 0; i < n; i++) {
+      for (int j = 0; j < NUM_PROFILE; j++) {
+        memcpy(profile[j], values + (i * NUM_PROFILE + j) * num_heights,
+               num_heights * sizeof(double));
+        profile[j][num_heights] = -1.0;
+      }
+      if (iri_write_csv(path, profile) != 0) {
+        return 1;
+      }
+    }
+  }
+  double dt = (now() - t0) / rounds;
+  printf("%-14s %12.3f %12.0f %12s\n", "iri_write_csv", dt * 1e3, n / dt,
+         "-");
+
+  int status = 0;
+  for (int w = 0; w < num_writers; w++) {
+    t0 = now();
+    for (int r = 0; r < rounds; r++) {
+      struct iri_writer *writer =
+          iri_writer_open(path, writers[w].format, writers[w].value_size,
+                          writers[w].columns, num_heights, n);
+      /* Stream in blocks of 32 profiles, as iri_profiles_write would */
+      for (size_t i = 0; writer != NULL && i < n; i += 32) {
+        iri_writer_write(writer, 32,
+                         values + i * NUM_PROFILE * num_heights);
+      }
+      if (writer == NULL || iri_writer_close(writer) != 0) {
+        status = 1;
+      }
+    }
+    dt = (now() - t0) / rounds;
+    struct stat st;
+    stat(path, &st);
+    printf("%-14s %12.3f %12.0f %12lld\n", writers[w].name, dt * 1e3, n / dt,
+           (long long)st.st_size);
+  }
+
+  unlink(path);
+  free(values);
+  free(profile);
+  return status;
+}
+
+/*
+ * Single profiles with all columns vs. only some, which switches off the
+ * unneeded parts of the model; the selected columns must not change
+ */
+static int bench_columns(void) {
+  static double full[NUM_PROFILE][MAX_HEIGHT];
+  static double part[NUM_PROFILE][MAX_HEIGHT];
+  const int calls = 50;
+  const double h_start = 70.0, h_end = 600.0, h_step = 10.0;
+  int num_heights = iri_num_heights(h_start, h_end, h_step);
+  static const struct {
+    const char *name;
+    unsigned columns;
+  } selections[] = {
+      {"all", IRI_COLUMNS_ALL},
+      {"ne", IRI_COLUMN(1)},
+      {"ne_te", IRI_COLUMN(1) | IRI_COLUMN(3)},
+      {"ions", IRI_COLUMN(5) | IRI_COLUMN(6)},
+  };
+  const int num_selections = sizeof(selections) / sizeof(selections[0]);
+
+  printf("columns: %d profiles x %d heights\n", calls, num_heights);
+  printf("%-8s %12s %12s %12s\n", "columns", "ms/profile", "speedup",
+         "identical");
+
+  double base = 0.0;
+  int status = 0;
+  for (int s = 0; s < num_selections; s++) {
+    int identical = 1;
+    double total = 0.0;
+    for (int i = 0; i < calls; i++) {
+      double lat = 30.0 + i % 10, lon = -85.0 + i / 10;
+      double t0 = now();
+      if (iri_profiles_select(lat, lon, 2021, 3, 3, 11.0 + 25.0, h_start,
+                              h_end, h_step, selections[s].columns,
+                              part) != 0) {
+        return 1;
+      }
+      total += now() - t0;
+      if (iri_profiles(lat, lon, 2021, 3, 3, 11.0 + 25.0, h_start, h_end,
+                       h_step, full) != 0) {
+        return 1;
+      }
+      for (int j = 0; j < NUM_PROFILE; j++) {
+        if ((selections[s].columns & IRI_COLUMN(j)) &&
+            memcmp(full[j], part[j], num_heights * sizeof(double)) != 0) {
+          identical = 0;
+        }
+      }
+    }
+    if (s == 0) {
+      base = total;
+    }
+    printf("%-8s %12.3f %12.2f %12s\n", selections[s].name,
+           total / calls * 1e3, base / total, identical ? "yes" : "NO");
+    status |= !identical;
+  }
+  return status;
+}
+
+/*
+ * Regional vertical TEC map at a fixed time, from 1 to N workers, checked
+ * against single iri_tec calls
+ */
+static int bench_tec_grid(void) {
+  enum { nlat = 12, nlon = 12 };
+  const size_t n = nlat * nlon;
+  const double h_start = 65.0, h_end = 2000.0, h_step = 5.0;
+  double lat[nlat], lon[nlon];
+  double *tec_bottom = malloc(n * sizeof(double));
+  double *tec_top = malloc(n * sizeof(double));
+  if (!tec_bottom || !tec_top) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+  for (int i = 0; i < nlat; i++) {
+    lat[i] = 25.0 + i * 2.5;
+  }
+  for (int j = 0; j < nlon; j++) {
+    lon[j] = -100.0 + j * 2.5;
+  }
+
+  long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+  int top = max_workers > 0 ? max_workers : (nproc > 0 ? (int)nproc : 1);
+
+  printf("tec_grid: %zu cells, %g to %g km in steps of %g km\n", n, h_start,
+         h_end, h_step);
+  printf("%8s %12s %12s %8s\n", "workers", "time(s)", "cells/s", "speedup");
+  double base = 0.0;
+  for (int w = 1;; w = w * 2 < top ? w * 2 : top) {
+    double t0 = now();
+    int status = iri_tec_grid(nlat, lat, nlon, lon, 2021, 3, 3, 18.0 + 25.0,
+                              h_start, h_end, h_step, w, tec_bottom, tec_top);
+    double dt = now() - t0;
+    if (status != 0) {
+      fprintf(stderr, "TEC grid failed with %d workers\n", w);
+      return 1;
+    }
+    if (w == 1) {
+      base = dt;
+    }
+    printf("%8d %12.4f %12.1f %8.2f\n", w, dt, n / dt, base / dt);
+    if (w >= top) {
+      break;
+    }
+  }
+
+  /* The grid must match single calls */
+  double b, t;
+  size_t k = n - 1;
+  if (iri_tec(lat[k / nlon], lon[k % nlon], 2021, 3, 3, 18.0 + 25.0, h_start,
+              h_end, h_step, &b, &t) != 0 ||
+      b != tec_bottom[k] || t != tec_top[k]) {
+    fprintf(stderr, "TEC grid does not match iri_tec\n");
+    return 1;
+  }
+  printf("last cell: %.3f + %.3f TECU\n", b / IRI_TECU, t / IRI_TECU);
+
+  free(tec_bottom);
+  free(tec_top);
+  return 0;
+}
+
+/*
+ * Slant TEC of a radar scan from Wallops Island, with Ne profiles shared by
+ * nearby samples vs. one profile per integration step; and a vertical beam
+ * against iri_tec
+ */
+static int bench_slant_tec(void) {
+  enum { num_beams = 8 };
+  const double site_lat = 37.8, site_lon = -75.4, step = 5.0;
+  const double spacings[] = {50.0, 100.0, 200.0, step};
+  const int num_spacings = sizeof(spacings) / sizeof(spacings[0]);
+  double bearing[num_beams], elevation[num_beams], range[num_beams];
+  double tec[num_beams], tec_fine[num_beams];
+  for (int i = 0; i < num_beams; i++) {
+    bearing[i] = i * (360.0 / num_beams);
+    elevation[i] = 20.0;
+    range[i] = 4000.0;
+  }
+  const double hour = 17.0 + 25.0;
+
+  printf("slant_tec: %d beams at 20 deg elevation, steps of %g km\n",
+         num_beams, step);
+  printf("%10s %12s %12s %12s %12s\n", "spacing", "time(s)", "beams/s",
+         "profiles", "max_err(%)");
+  for (int k = num_spacings - 1; k >= 0; k--) {
+    int profiles = 0;
+    double t0 = now();
+    for (int i = 0; i < num_beams; i++) {
+      int n;
+      if (iri_slant_tec(site_lat, site_lon, bearing[i], elevation[i],
+                        range[i], 2021, 3, 3, hour, step, spacings[k],
+                        &tec[i], &n) != 0) {
+        return 1;
+      }
+      profiles += n;
+    }
+    double dt = now() - t0;
+    if (k == num_spacings - 1) {
+      memcpy(tec_fine, tec, sizeof(tec));
+    }
+    double err = 0.0;
+    for (int i = 0; i < num_beams; i++) {
+      double e = fabs(tec[i] - tec_fine[i]) / tec_fine[i] * 100.0;
+      err = e > err ? e : err;
+    }
+    printf("%10g %12.4f %12.1f %12.1f %12.3f\n", spacings[k], dt,
+           num_beams / dt, (double)profiles / num_beams, err);
+  }
+
+  /* The scan must match single calls */
+  if (iri_slant_tec_scan(num_beams, site_lat, site_lon, bearing, elevation,
+                         range, 2021, 3, 3, hour, step, spacings[0],
+                         max_workers, tec_fine) != 0 ||
+      memcmp(tec, tec_fine, sizeof(tec)) != 0) {
+    fprintf(stderr, "Slant TEC scan does not match iri_slant_tec\n");
+    return 1;
+  }
+
+  double vertical, bottom, top;
+  if (iri_slant_tec(site_lat, site_lon, 0.0, 90.0, IRI_SLANT_HEIGHT_END,
+                    2021, 3, 3, hour, 1.0, spacings[0], &vertical,
+                    NULL) != 0 ||
+      iri_tec(site_lat, site_lon, 2021, 3, 3, hour, IRI_SLANT_HEIGHT_START,
+              IRI_SLANT_HEIGHT_END, 1.0, &bottom, &top) != 0) {
+    return 1;
+  }
+  printf("vertical: %.3f TECU (iri_tec: %.3f TECU)\n", vertical / IRI_TECU,
+         (bottom + top) / IRI_TECU);
+  return 0;
+}
+
+/*
+ * Per-call overhead of the fixed-size profiles vs. a workspace and
+ * caller-sized output (double or float), for a short Ne profile; and a
+ * profile of more than MAX_HEIGHT heights
+ */
+static int bench_workspace(void) {
+  static double fixed[NUM_PROFILE][MAX_HEIGHT];
+  const int calls = 200;
+  const double h_start = 70.0, h_end = 600.0, h_step = 10.0;
+  const int num_heights = iri_num_heights(h_start, h_end, h_step);
+  double *values = malloc(NUM_PROFILE * num_heights * sizeof(double));
+  float *values_f32 = malloc(NUM_PROFILE * num_heights * sizeof(float));
+  struct iri_workspace *ws = iri_workspace_new();
+  if (!values || !values_f32 || !ws) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+
+  printf("workspace: %d Ne profiles x %d heights\n", calls, num_heights);
+  printf("%-22s %12s\n", "call", "us/profile");
+  for (int v = 0; v < 3; v++) {
+    double t0 = now();
+    for (int i = 0; i < calls; i++) {
+      double lat = 30.0 + i % 10, lon = -85.0 + i / 10;
+      int status =
+          v == 0   ? iri_profiles_select(lat, lon, 2021, 3, 3, 11.0 + 25.0,
+                                         h_start, h_end, h_step,
+                                         IRI_COLUMN(1), fixed)
+          : v == 1 ? iri_profiles_ws(ws, lat, lon, 2021, 3, 3, 11.0 + 25.0,
+                                     h_start, h_step, num_heights,
+                                     IRI_COLUMN(1), values)
+                   : iri_profiles_ws_f32(ws, lat, lon, 2021, 3, 3,
+                                         11.0 + 25.0, h_start, h_step,
+                                         num_heights, IRI_COLUMN(1),
+                                         values_f32);
+      if (status != 0) {
+        return 1;
+      }
+    }
+    double dt = (now() - t0) / calls;
+    static const char *names[] = {"iri_profiles_select", "iri_profiles_ws",
+                                  "iri_profiles_ws_f32"};
+    printf("%-22s %12.1f\n", names[v], dt * 1e6);
+  }
+
+  /* 1 km resolution from 60 to 2000 km in one call */
+  const int n = 1941;
+  double *high = malloc(NUM_PROFILE * n * sizeof(double));
+  if (high == NULL) {
+    return 1;
+  }
+  double t0 = now();
+  if (iri_profiles_ws(ws, 37.8, -75.4, 2021, 3, 3, 11.0 + 25.0, 60.0, 1.0, n,
+                      IRI_COLUMN(1), high) != 0) {
+    return 1;
+  }
+  printf("%-22s %12.1f (%d heights)\n", "high resolution",
+         (now() - t0) * 1e6, n);
+
+  free(values);
+  free(values_f32);
+  free(high);
+  iri_workspace_free(ws);
+  return 0;
+}
+
+/* Largest value and trapezoidal integral (in m-2, heights in km) of Ne */
+static void ne_summary(int n, const double *height, const double *ne,
+                       double *ne_max, double *integral) {
+  *ne_max = 0.0;
+  *integral = 0.0;
+  for (int k = 0; k < n; k++) {
+    double v = ne[k] > 0.0 ? ne[k] : 0.0;
+    *ne_max = v > *ne_max ? v : *ne_max;
+    if (k > 0) {
+      double v0 = ne[k - 1] > 0.0 ? ne[k - 1] : 0.0;
+      *integral += 0.5 * (v0 + v) * (height[k] - height[k - 1]) * 1e3;
+    }
+  }
+}
+
+/*
+ * Whether a height list steps by at most `fine_step` within `half` km of a
+ * peak (found on a 1 km profile, so to half a km)
+ */
+static int fine_around(int n, const double *heights, double peak,
+                       double fine_step, double half) {
+  int count = 0;
+  for (int k = 0; k < n; k++) {
+    if (heights[k] >= peak - half && heights[k] <= peak + half) {
+      if (count > 0 && heights[k] - heights[k - 1] > fine_step + 1e-9) {
+        return 0;
+      }
+      count++;
+    }
+  }
+  return count >= (int)(2.0 * half / fine_step);
+}
+
+/*
+ * Whether a peak height list is dense around the F2 peak and the E peak
+ * (the highest Ne of a 1 km profile from `start`, and its local maximum
+ * below 150 km, if any)
+ */
+static int peaks_covered(int n, const double *heights, int n_uniform,
+                         double start, const double *ne, double fine_step,
+                         double window) {
+  int f2 = 0, ok = 1;
+  for (int k = 1; k < n_uniform; k++) {
+    f2 = ne[k] > ne[f2] ? k : f2;
+  }
+  ok &= fine_around(n, heights, start + f2, fine_step, window - 1.0);
+  for (int k = 1; start + k < 150.0 && k + 1 < n_uniform; k++) {
+    if (ne[k] > ne[k - 1] && ne[k] >= ne[k + 1] && k != f2) {
+      ok &= fine_around(n, heights, start + k, fine_step, window - 1.0);
+      break;
+    }
+  }
+  return ok;
+}
+
+/*
+ * Ne profiles at 1 km resolution vs. a height list that is dense only
+ * around the peaks, from 60 to 2000 km; fails if the list misses the peaks
+ * (also with a coarse step that lands exactly on the windows)
+ */
+static int bench_height_list(void) {
+  const int calls = 20;
+  const int n_uniform = 1941, max_list = 1000;
+  double *uniform = malloc(NUM_PROFILE * n_uniform * sizeof(double));
+  double *list = malloc(NUM_PROFILE * max_list * sizeof(double));
+  double *heights = malloc(max_list * sizeof(double));
+  struct iri_workspace *ws = iri_workspace_new();
+  if (!uniform || !list || !heights || !ws) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+
+  printf("height_list: %d Ne profiles, 60 to 2000 km\n", calls);
+  printf("%-10s %10s %12s %14s %14s\n", "heights", "mean n", "ms/profile",
+         "NmF2 err(%)", "TEC err(%)");
+  double t_uniform = 0.0, t_list = 0.0, err_nm = 0.0, err_tec = 0.0;
+  int total_list = 0, status = 0, missed = 0;
+  for (int i = 0; i < calls; i++) {
+    double lat = -60.0 + i * 6.0, lon = -75.4, hour = (i % 24) + 25.0;
+    double t0 = now();
+    status |= iri_profiles_ws(ws, lat, lon, 2021, 3, 3, hour, 60.0, 1.0,
+                              n_uniform, IRI_COLUMN(1), uniform);
+    t_uniform += now() - t0;
+
+    t0 = now();
+    int n = iri_peak_heights(ws, lat, lon, 2021, 3, 3, hour, 60.0, 2000.0,
+                             1.0, 25.0, 30.0, max_list, heights);
+    if (n < 0 || n > max_list) {
+      return 1;
+    }
+    status |= iri_profiles_heights(ws, lat, lon, 2021, 3, 3, hour, n,
+                                   heights, IRI_COLUMN(1), list);
+    t_list += now() - t0;
+    total_list += n;
+
+    missed += !peaks_covered(n, heights, n_uniform, 60.0,
+                             uniform + n_uniform, 1.0, 30.0);
+    int m = iri_peak_heights(ws, lat, lon, 2021, 3, 3, hour, 60.0, 2000.0,
+                             1.0, 50.0, 20.0, max_list - n, heights + n);
+    missed += m < 0 || m > max_list - n ||
+              !peaks_covered(m, heights + n, n_uniform, 60.0,
+                             uniform + n_uniform, 1.0, 20.0);
+
+    double nm_u, tec_u, nm_l, tec_l;
+    ne_summary(n_uniform, uniform, uniform + n_uniform, &nm_u, &tec_u);
+    ne_summary(n, list, list + n, &nm_l, &tec_l);
+    double e = fabs(nm_l - nm_u) / nm_u * 100.0;
+    err_nm = e > err_nm ? e : err_nm;
+    e = fabs(tec_l - tec_u) / tec_u * 100.0;
+    err_tec = e > err_tec ? e : err_tec;
+  }
+  printf("%-10s %10d %12.3f %14s %14s\n", "uniform", n_uniform,
+         t_uniform / calls * 1e3, "-", "-");
+  printf("%-10s %10.0f %12.3f %14.4f %14.4f\n", "peaks",
+         (double)total_list / calls, t_list / calls * 1e3, err_nm, err_tec);
+  if (missed > 0) {
+    printf("%d height lists without fine steps around a peak\n", missed);
+    status = 1;
+  }
+
+  free(uniform);
+  free(list);
+  free(heights);
+  iri_workspace_free(ws);
+  return status;
+}
+
+/* Profiles of a series, compared with the ones computed one by one */
+struct series_check {
+  int num_heights;
+  const double *expected; /* Profiles in the iri_profiles_batch() layout */
+  int mismatches;
+};
+
+static int check_series_profile(size_t index, const double *values,
+                                void *ctx) {
+  struct series_check *c = ctx;
+  size_t size = NUM_PROFILE * c->num_heights;
+  if (memcmp(values, c->expected + index * size, size * sizeof(double))) {
+    c->mismatches++;
+  }
+  return 0;
+}
+
+/*
+ * Station time series: two days every 15 minutes at Wallops Island, with
+ * repeated iri_profiles calls vs. iri_profile_series
+ */
+static int bench_series(void) {
+  enum { num_times = 192 };
+  const double h_start = 70.0, h_end = 600.0, h_step = 10.0;
+  int num_heights = iri_num_heights(h_start, h_end, h_step);
+  int year[num_times], month[num_times], day[num_times];
+  double hour[num_times];
+  for (int i = 0; i < num_times; i++) {
+    year[i] = 2021;
+    month[i] = 3;
+    day[i] = 3 + i / 96;
+    hour[i] = (i % 96) * 0.25 + 25.0;
+  }
+  static double profile[NUM_PROFILE][MAX_HEIGHT];
+  double *expected =
+      malloc(num_times * NUM_PROFILE * num_heights * sizeof(double));
+  if (expected == NULL) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+
+  printf("series: %d times x %d heights\n", num_times, num_heights);
+  printf("%-8s %-20s %12s %12s\n", "columns", "call", "ms/profile",
+         "identical");
+  static const struct {
+    const char *name;
+    unsigned columns;
+  } selections[] = {{"all", IRI_COLUMNS_ALL}, {"ne", IRI_COLUMN(1)}};
+  /* Best of a few rounds, as the differences are small */
+  const int rounds = 3;
+  int status = 0;
+  for (int s = 0; s < 2; s++) {
+    unsigned columns = selections[s].columns;
+    double best = 1e30, best_series = 1e30;
+    struct series_check check = {num_heights, expected, 0};
+    for (int r = 0; r < rounds; r++) {
+      double t0 = now();
+      for (int i = 0; i < num_times; i++) {
+        if (iri_profiles_select(37.8, -75.4, year[i], month[i], day[i],
+                                hour[i], h_start, h_end, h_step, columns,
+                                profile) != 0) {
+          return 1;
+        }
+        for (int j = 0; j < NUM_PROFILE; j++) {
+          memcpy(expected + (i * NUM_PROFILE + j) * num_heights, profile[j],
+                 num_heights * sizeof(double));
+        }
+      }
+      double dt = now() - t0;
+      best = dt < best ? dt : best;
+
+      t0 = now();
+      if (iri_profile_series(NULL, 37.8, -75.4, num_times, year, month, day,
+                             hour, h_start, h_step, num_heights, columns,
+                             check_series_profile, &check) != 0) {
+        return 1;
+      }
+      dt = now() - t0;
+      best_series = dt < best_series ? dt : best_series;
+    }
+    printf("%-8s %-20s %12.3f %12s\n", selections[s].name, "iri_profiles",
+           best / num_times * 1e3, "-");
+    printf("%-8s %-20s %12.3f %12s\n", selections[s].name,
+           "iri_profile_series", best_series / num_times * 1e3,
+           check.mismatches ? "NO" : "yes");
+    status |= check.mismatches != 0;
+  }
+
+  free(expected);
+  return status;
+}
+
+struct bench_case {
+  const char *name;
+  int (*run)(void);
+};
+
+/* One pass of station requests through a cache (NULL: the model) */
+static int cache_pass(struct iri_cache *cache, double jitter, int num_stations,
+                      int num_hours, double *seconds) {
+  static const double ranges[][3] = {{70.0, 600.0, 10.0},
+                                     {100.0, 1000.0, 20.0}};
+  static double profile[NUM_PROFILE][MAX_HEIGHT];
+  double t0 = now();
+  for (int s = 0; s < num_stations; s++) {
+    double lat = 30.0 + 2.0 * (s / 4) + jitter;
+    double lon = -80.0 + 3.0 * (s % 4) - jitter;
+    for (int h = 0; h < num_hours; h++) {
+      for (int r = 0; r < 2; r++) {
+        int status =
+            cache != NULL
+                ? iri_cache_profiles(cache, lat, lon, 2021, 3, 3, h + jitter,
+                                     ranges[r][0], ranges[r][1],
+                                     ranges[r][2], IRI_COLUMNS_ALL, profile)
+                : iri_profiles(lat, lon, 2021, 3, 3, h, ranges[r][0],
+                               ranges[r][1], ranges[r][2], profile);
+        if (status != 0) {
+          return 1;
+        }
+      }
+    }
+  }
+  *seconds = now() - t0;
+  return 0;
+}
+
+static void print_cache_pass(const char *name, int num_requests,
+                             double seconds, const struct iri_cache *cache) {
+  struct iri_cache_stats st = {0};
+  if (cache != NULL) {
+    iri_cache_get_stats(cache, &st);
+  }
+  printf("%-22s %12.4f %8llu %8llu %10llu %10.1f\n", name,
+         seconds / num_requests * 1e3, (unsigned long long)st.hits,
+         (unsigned long long)st.misses, (unsigned long long)st.evictions,
+         st.bytes / 1e6);
+}
+
+/*
+ * Service-like requests (12 stations, hourly, two height ranges) repeated
+ * with small jitter through a profile cache: cold, warm, after a restart
+ * from the saved file, and with a budget of half the entries
+ */
+static int bench_cache(void) {
+  const int num_stations = 12, num_hours = 24;
+  const int num_requests = num_stations * num_hours * 2;
+  const double position_step = 0.01, hour_step = 1.0 / 60.0;
+  const char *path = "bench_cache.bin";
+  double dt;
+
+  printf("cache: %d requests per pass (all columns)\n", num_requests);
+  printf("%-22s %12s %8s %8s %10s %10s\n", "pass", "ms/profile", "hits",
+         "misses", "evictions", "MB");
+  if (cache_pass(NULL, 0.0, num_stations, num_hours, &dt) != 0) {
+    return 1;
+  }
+  print_cache_pass("no cache", num_requests, dt, NULL);
+
+  struct iri_cache *cache = iri_cache_new(64 << 20, position_step, hour_step);
+  if (cache == NULL) {
+    return 1;
+  }
+  int status = cache_pass(cache, 0.0, num_stations, num_hours, &dt);
+  print_cache_pass("cold", num_requests, dt, cache);
+  status |= cache_pass(cache, 0.001, num_stations, num_hours, &dt);
+  print_cache_pass("warm (jittered)", num_requests, dt, cache);
+  status |= iri_cache_save(cache, path);
+  iri_cache_free(cache);
+
+  /* A restarted process */
+  cache = iri_cache_new(64 << 20, position_step, hour_step);
+  if (cache == NULL) {
+    return 1;
+  }
+  dt = now();
+  status |= iri_cache_load(cache, path);
+  double load_time = now() - dt;
+  status |= cache_pass(cache, 0.001, num_stations, num_hours, &dt);
+  print_cache_pass("loaded from file", num_requests, dt, cache);
+  printf("  (loading took %.2f ms)\n", load_time * 1e3);
+  struct iri_cache_stats st;
+  iri_cache_get_stats(cache, &st);
+  size_t half = st.bytes / 2;
+  iri_cache_free(cache);
+  unlink(path);
+
+  /* Half the budget: a cyclic scan evicts every entry before its reuse */
+  cache = iri_cache_new(half, position_step, hour_step);
+  if (cache == NULL) {
+    return 1;
+  }
+  status |= cache_pass(cache, 0.0, num_stations, num_hours, &dt);
+  status |= cache_pass(cache, 0.0, num_stations, num_hours, &dt);
+  print_cache_pass("half budget, 2 passes", num_requests, dt, cache);
+  iri_cache_free(cache);
+  return status;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Uniform in [lo, hi) from a fixed-seed generator, for reproducible points */
+static double uniform(unsigned long *state, double lo, double hi) {
+  *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+  return lo + (hi - lo) * ((*state >> 11) * (1.0 / 9007199254740992.0));
+}
+
+/*
+ * Ne climatology cube (5 deg x 15 deg x 1 h x 10 km, 60S-60N, 80-800 km):
+ * build time, interpolation error against direct IRI at random points,
+ * and lookups per second for both interpolations
+ */
+static int bench_cube(void) {
+  const struct iri_cube_grid grid = {
+      .latitude_start = -60.0,
+      .latitude_step = 5.0,
+      .longitude_start = -180.0,
+      .longitude_step = 15.0,
+      .hour_start = 0.0,
+      .hour_step = 1.0,
+      .height_start = 80.0,
+      .height_step = 10.0,
+      .num_latitudes = 25,
+      .num_longitudes = 24,
+      .num_hours = 24,
+      .num_heights = 73,
+  };
+  const char *path = "bench_cube.bin";
+  enum { num_checks = 1000, num_lookups = 1000000 };
+
+  struct iri_cube built;
+  double t0 = now();
+  if (iri_cube_build(&built, &grid, 2021, 3, 15, max_workers) != 0) {
+    return 1;
+  }
+  double build_time = now() - t0;
+  int status = iri_cube_save(&built, path);
+  iri_cube_free(&built);
+  struct iri_cube cube;
+  status |= iri_cube_map(&cube, path);
+  unlink(path);
+  if (status != 0) {
+    return 1;
+  }
+  printf("cube: %u x %u x %u x %u nodes (%.1f MB), built in %.1f s\n",
+         grid.num_latitudes, grid.num_longitudes, grid.num_hours,
+         grid.num_heights, cube.mapping_size / 1e6, build_time);
+
+  /* Direct IRI at random points inside the grid, one height each */
+  unsigned long state = 12345;
+  double *lat = malloc(num_lookups * sizeof(double));
+  double *lon = malloc(num_lookups * sizeof(double));
+  double *hour = malloc(num_lookups * sizeof(double));
+  double *height = malloc(num_lookups * sizeof(double));
+  double *ne = malloc(num_lookups * sizeof(double));
+  double *expected = malloc(num_checks * sizeof(double));
+  double *errors = malloc(num_checks * sizeof(double));
+  double *values = malloc(NUM_PROFILE * sizeof(double));
+  struct iri_workspace *ws = iri_workspace_new();
+  if (!lat || !lon || !hour || !height || !ne || !expected || !errors ||
+      !values || !ws) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+  for (size_t p = 0; p < num_lookups; p++) {
+    lat[p] = uniform(&state, -60.0, 60.0);
+    lon[p] = uniform(&state, -180.0, 180.0);
+    hour[p] = uniform(&state, 0.0, 24.0);
+    height[p] = uniform(&state, 100.0, 800.0);
+  }
+  t0 = now();
+  for (int p = 0; p < num_checks && status == 0; p++) {
+    status = iri_profiles_heights(ws, lat[p], lon[p], 2021, 3, 15, hour[p], 1,
+                                  &height[p], IRI_COLUMN(1), values);
+    expected[p] = values[1];
+  }
+  double direct_rate = num_checks / (now() - t0);
+  iri_workspace_free(ws);
+  free(values);
+
+  printf("%-8s %14s %12s %12s %12s\n", "method", "lookups/s", "median err",
+         "95% err", "max err");
+  printf("%-8s %14.0f %12s %12s %12s\n", "iri", direct_rate, "-", "-", "-");
+  static const struct {
+    const char *name;
+    enum iri_cube_method method;
+  } methods[] = {{"linear", IRI_CUBE_LINEAR}, {"cubic", IRI_CUBE_CUBIC}};
+  for (int m = 0; m < 2 && status == 0; m++) {
+    t0 = now();
+    size_t outside = iri_cube_ne_batch(&cube, num_lookups, lat, lon, hour,
+                                       height, methods[m].method, ne);
+    double rate = num_lookups / (now() - t0);
+    /* Relative error where Ne is significant (above 1e9 m-3) */
+    int n = 0;
+    for (int p = 0; p < num_checks; p++) {
+      if (expected[p] > 1e9) {
+        errors[n++] = fabs(ne[p] - expected[p]) / expected[p];
+      }
+    }
+    qsort(errors, n, sizeof(double), compare_doubles);
+    printf("%-8s %14.0f %11.2f%% %11.2f%% %11.2f%%\n", methods[m].name, rate,
+           errors[n / 2] * 100, errors[n * 95 / 100] * 100,
+           errors[n - 1] * 100);
+    status |= outside != 0;
+  }
+
+  iri_cube_free(&cube);
+  free(lat);
+  free(lon);
+  free(hour);
+  free(height);
+  free(ne);
+  free(expected);
+  free(errors);
+  return status;
+}
+
+/*
+ * Geomagnetic field at the points of a radar scan from Wallops Island at
+ * 300 km: points per second one at a time (with a new date each call, as
+ * the coefficients were interpolated before, and at one date), batched, by
+ * worker count, and with the L shell; plus checks that batches match
+ * single points and leave the profiles alone
+ */
+static int bench_field(void) {
+  enum { num_bearings = 64, num_ranges = 500, num_l_shell = 2000 };
+  const size_t n = num_bearings * num_ranges;
+  const double site_lat = 37.8, site_lon = -75.4, alt = 300.0;
+  double year;
+  iri_decimal_year(2021, 3, 3, &year);
+  static double profile[2][NUM_PROFILE][MAX_HEIGHT];
+  double *range = malloc(n * sizeof(double));
+  double *bearing = malloc(n * sizeof(double));
+  double *lat = malloc(n * sizeof(double));
+  double *lon = malloc(n * sizeof(double));
+  double *height = malloc(n * sizeof(double));
+  struct iri_field *field = malloc(n * sizeof(*field));
+  struct iri_field *single = malloc(n * sizeof(*single));
+  if (!range || !bearing || !lat || !lon || !height || !field || !single) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+  for (size_t k = 0; k < n; k++) {
+    bearing[k] = 360.0 * (k / num_ranges) / num_bearings;
+    range[k] = 6.0 * (k % num_ranges + 1);
+    height[k] = alt;
+  }
+  if (r2g_batch(n, range, bearing, site_lon, site_lat, lon, lat) != 0) {
+    return 1;
+  }
+
+  printf("field: %zu points at %g km, year %.4f\n", n, alt, year);
+  printf("%-24s %12s %12s\n", "mode", "time(s)", "points/s");
+
+  /* One point per call, alternating dates so each call interpolates the
+     coefficients, then at one date */
+  int status = 0;
+  double t0 = now();
+  for (size_t k = 0; k < n; k++) {
+    status |= iri_field_batch(1, &lat[k], &lon[k], &height[k],
+                              year + (k & 1) * 1e-3, 0, 1, &single[k]);
+  }
+  double dt = now() - t0;
+  printf("%-24s %12.4f %12.0f\n", "single, new date", dt, n / dt);
+  t0 = now();
+  for (size_t k = 0; k < n; k++) {
+    status |= iri_field_batch(1, &lat[k], &lon[k], &height[k], year, 0, 1,
+                              &single[k]);
+  }
+  dt = now() - t0;
+  printf("%-24s %12.4f %12.0f\n", "single, cached", dt, n / dt);
+
+  long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+  int top = max_workers > 0 ? max_workers : (nproc > 0 ? (int)nproc : 1);
+  for (int w = 1;; w = w * 2 < top ? w * 2 : top) {
+    char mode[32];
+    snprintf(mode, sizeof(mode), "batch, %d workers", w);
+    t0 = now();
+    status |= iri_field_batch(n, lat, lon, height, year, 0, w, field);
+    dt = now() - t0;
+    printf("%-24s %12.4f %12.0f\n", mode, dt, n / dt);
+    if (w >= top) {
+      break;
+    }
+  }
+  if (status != 0 || memcmp(field, single, n * sizeof(*field)) != 0) {
+    fprintf(stderr, "Field batch does not match single points\n");
+    return 1;
+  }
+
+  t0 = now();
+  status = iri_field_batch(num_l_shell, lat, lon, height, year, 1, top,
+                           field);
+  dt = now() - t0;
+  printf("%-24s %12.4f %12.0f\n", "batch with L shell", dt,
+         num_l_shell / dt);
+  if (status != 0) {
+    return 1;
+  }
+  printf("near the site: dip %.2f, declination %.2f, modip %.2f deg, "
+         "%.4f G, L %.3f (code %d)\n",
+         field[0].dip, field[0].declination, field[0].modip, field[0].field,
+         field[0].l_shell, field[0].l_code);
+
+  /* Field calls at another date must not change IRI_SUB's coefficients */
+  for (int i = 0; i < 2; i++) {
+    if (iri_profiles(site_lat, site_lon, 2021, 3, 3, 12.0, 100.0, 600.0, 10.0,
+                     profile[i]) != 0 ||
+        iri_field_batch(1, lat, lon, height, year + 3.5, 0, 1, field) != 0) {
+      return 1;
+    }
+  }
+  if (memcmp(profile[0], profile[1], sizeof(profile[0])) != 0) {
+    fprintf(stderr, "Field batch changed the profiles\n");
+    return 1;
+  }
+
+  /* Invalid dates, and years without IGRF sets, fail instead of reaching
+     the Fortran */
+  double invalid;
+  if (iri_decimal_year(2021, 0, 3, &invalid) == 0 ||
+      iri_decimal_year(2021, 13, 3, &invalid) == 0 ||
+      iri_decimal_year(2021, 2, 29, &invalid) == 0 ||
+      iri_decimal_year(2020, 2, 29, &invalid) != 0 ||
+      iri_field_batch(1, lat, lon, height, 1900.0, 0, 1, field) == 0 ||
+      iri_field_batch(1, lat, lon, height, NAN, 0, 1, field) == 0) {
+    fprintf(stderr, "Invalid dates were accepted\n");
+    return 1;
+  }
+
+  free(range);
+  free(bearing);
+  free(lat);
+  free(lon);
+  free(height);
+  free(field);
+  free(single);
+  return 0;
+}
+
+/* Largest relative difference of the fast column mode per output column:
+   the interpolated ions and PF/GF (from the field at the knots), and none
+   elsewhere */
+static const double fast_columns_bound[NUM_PROFILE] = {
+    0.0, 0.0, 0.0, 0.0, 0.0, 2e-3, 2e-3, 2e-3, 0.0, 0.0, 0.0, 2e-3, 1e-3};
+
+/* FNV-1a hash of the exact columns at 100 heights, as computed before
+   CALION was split into CALIONA and CALIONH (gfortran -O0) */
+#define FAST_COLUMNS_EXACT_HASH 0x8004cbaf70db2e4aULL
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *p = data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ p[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/*
+ * Fast column mode against the exact height loop: time per column at 100,
+ * 500 and 1000 heights from 60 to 2000 km, and the largest relative
+ * difference per output column over all heights and columns; fails if the
+ * exact columns changed or the differences exceed their bounds
+ */
+static int bench_fast_columns(void) {
+  enum { num_columns = 12 };
+  const int levels[] = {100, 500, 1000};
+  const int num_levels = sizeof(levels) / sizeof(levels[0]);
+  const double h_start = 60.0, h_end = 2000.0;
+  double max_error[NUM_PROFILE] = {0.0};
+  int status = 0;
+  size_t size = (size_t)NUM_PROFILE * MAX_HEIGHT;
+  double *exact = malloc(num_columns * size * sizeof(double));
+  double *fast = malloc(num_columns * size * sizeof(double));
+  if (exact == NULL || fast == NULL) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+
+  printf("fast_columns: %d columns, %g to %g km\n", num_columns, h_start,
+         h_end);
+  printf("%8s %14s %14s %8s\n", "heights", "exact(ms/col)", "fast(ms/col)",
+         "speedup");
+  for (int l = 0; l < num_levels; l++) {
+    int n = levels[l];
+    double h_step = (h_end - h_start) / (n - 1);
+    double dt[2];
+    for (int on = 0; on <= 1; on++) {
+      double *values = on ? fast : exact;
+      iri_fast_columns_enable(on);
+      double t0 = now();
+      for (int c = 0; c < num_columns; c++) {
+        if (iri_profiles_ws(NULL, -55.0 + 10.0 * c, -150.0 + 25.0 * c, 2021,
+                            3 + c % 4 * 3, 3, 2.0 * c, h_start, h_step, n,
+                            IRI_COLUMNS_ALL, values + c * size) != 0) {
+          iri_fast_columns_enable(0);
+          return 1;
+        }
+      }
+      dt[on] = now() - t0;
+    }
+    iri_fast_columns_enable(0);
+    printf("%8d %14.3f %14.3f %8.2f\n", n, dt[0] / num_columns * 1e3,
+           dt[1] / num_columns * 1e3, dt[0] / dt[1]);
+    if (l == 0) {
+      uint64_t hash = 14695981039346656037ULL;
+      for (int c = 0; c < num_columns; c++) {
+        hash = fnv1a(hash, exact + c * size,
+                     (size_t)NUM_PROFILE * n * sizeof(double));
+      }
+      if (hash != FAST_COLUMNS_EXACT_HASH) {
+        printf("exact columns differ from the unsplit CALION (hash "
+               "%016llx)\n",
+               (unsigned long long)hash);
+        status = 1;
+      }
+    }
+
+    for (int c = 0; c < num_columns; c++) {
+      for (int j = 0; j < NUM_PROFILE; j++) {
+        for (int k = 0; k < n; k++) {
+          double x = exact[c * size + j * n + k];
+          double y = fast[c * size + j * n + k];
+          double e = x > 0.0 ? fabs(y - x) / x : (y != x);
+          if (e > max_error[j]) {
+            max_error[j] = e;
+          }
+        }
+      }
+    }
+  }
+
+  printf("largest relative difference:");
+  for (int j = 0; j < NUM_PROFILE; j++) {
+    if (max_error[j] > 0.0) {
+      printf(" %s %.2e", iri_column_name(j), max_error[j]);
+    }
+  }
+  printf("\n");
+  for (int j = 0; j < NUM_PROFILE; j++) {
+    if (!(max_error[j] <= fast_columns_bound[j])) {
+      printf("%s differs by more than %.0e\n", iri_column_name(j),
+             fast_columns_bound[j]);
+      status = 1;
+    }
+  }
+  free(exact);
+  free(fast);
+  return status;
+}
+
+/*
+ * Time per profile by stage of IRI_SUB, and the cost of the timers
+ */
+static int bench_stages(void) {
+  static double profile[NUM_PROFILE][MAX_HEIGHT];
+  const int calls = 50;
+  const double h_start = 70.0, h_end = 600.0, h_step = 10.0;
+  double total[2];
+
+  /* Warm up, so the first pass isn't penalized */
+  if (iri_profiles(30.0, -85.0, 2021, 3, 3, 11.0 + 25.0, h_start, h_end,
+                   h_step, profile) != 0) {
+    return 1;
+  }
+  for (int on = 0; on <= 1; on++) {
+    iri_stats_enable(on);
+    iri_reset_stats();
+    double t0 = now();
+    for (int i = 0; i < calls; i++) {
+      if (iri_profiles(30.0 + i % 10, -85.0 + i / 10, 2021, 3, 3,
+                       11.0 + 25.0, h_start, h_end, h_step, profile) != 0) {
+        iri_stats_enable(0);
+        return 1;
+      }
+    }
+    total[on] = now() - t0;
+  }
+  iri_stats_enable(0);
+  struct iri_stats stats;
+  iri_get_stats(&stats);
+
+  printf("stages: %d profiles x %d heights, %.3f ms/profile with timers, "
+         "%.3f without\n",
+         calls, iri_num_heights(h_start, h_end, h_step),
+         total[1] / calls * 1e3, total[0] / calls * 1e3);
+  printf("%-8s %14s %12s %12s\n", "stage", "calls/profile", "ms/profile",
+         "% of call");
+  for (int i = 0; i < IRI_NUM_STAGES; i++) {
+    printf("%-8s %14.1f %12.3f %11.1f%%\n", iri_stage_name(i),
+           (double)stats.calls[i] / calls, stats.seconds[i] / calls * 1e3,
+           stats.seconds[i] / stats.seconds[IRI_STAGE_IRI_SUB] * 100);
+  }
+  return 0;
+}
+
+/*
+ * Microbenchmarks: each repetition makes enough calls to take at least
+ * MICRO_MIN_TIME; the statistics are over the time per call of the
+ * repetitions after the warmup ones
+ */
+#define MICRO_WARMUP 3
+#define MICRO_REPS 21
+#define MICRO_MIN_TIME 0.02 /* Minimum time of a repetition (s) */
+#define MAX_MICRO 32
+
+struct micro_result {
+  char name[32];
+  double median; /* Time per call (us) */
+  double mad;    /* Median absolute deviation from the median (us) */
+  double min;    /* Fastest repetition (us) */
+  double max;    /* Slowest repetition (us) */
+  size_t calls;  /* Calls per repetition */
+};
+
+/* Make `n` calls of the function under test */
+typedef int (*micro_fn)(size_t n);
+
+static int micro_init(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (iri_init_with_dir(data_dir) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Profiles of all columns at `num_heights` heights from 70 km */
+static int micro_profiles(size_t n, int num_heights, double h_step,
+                          int month_step) {
+  static double profile[NUM_PROFILE][MAX_HEIGHT];
+  for (size_t i = 0; i < n; i++) {
+    if (iri_profiles(30.0 + i % 10, -75.0, 2021, 1 + i * month_step % 12, 15,
+                     11.0 + 25.0, 70.0, 70.0 + (num_heights - 1) * h_step,
+                     h_step, profile) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int micro_profiles_10(size_t n) {
+  return micro_profiles(n, 10, 50.0, 0);
+}
+
+static int micro_profiles_54(size_t n) {
+  return micro_profiles(n, 54, 10.0, 0);
+}
+
+static int micro_profiles_200(size_t n) {
+  return micro_profiles(n, 200, 5.0, 0);
+}
+
+static int micro_profiles_1000(size_t n) {
+  return micro_profiles(n, 1000, 1.0, 0);
+}
+
+/* A different month every call, which upstream reloads the CCIR and URSI
+   files for */
+static int micro_month_hop(size_t n) {
+  return micro_profiles(n, 54, 10.0, 5);
+}
+
+static int micro_write_csv(size_t n) {
+  static double profile[NUM_PROFILE][MAX_HEIGHT];
+  static int computed = 0;
+  if (!computed) {
+    if (iri_profiles(37.8, -75.4, 2021, 3, 3, 11.0 + 25.0, 70.0, 600.0,
+                     10.0, profile) != 0) {
+      return 1;
+    }
+    computed = 1;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (iri_write_csv("/dev/null", profile) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static const struct {
+  const char *name;
+  micro_fn fn;
+} micro_cases[] = {
+    {"init", micro_init},
+    {"profiles_10", micro_profiles_10},
+    {"profiles_54", micro_profiles_54},
+    {"profiles_200", micro_profiles_200},
+    {"profiles_1000", micro_profiles_1000},
+    {"month_hop", micro_month_hop},
+    {"write_csv", micro_write_csv},
+};
+
+static int time_calls(micro_fn fn, size_t n, double *seconds) {
+  double t0 = now();
+  int status = fn(n);
+  *seconds = now() - t0;
+  return status;
+}
+
+static int micro_run(struct micro_result *res, const char *name,
+                     micro_fn fn) {
+  /* Double the calls until a repetition is long enough (also warms up) */
+  size_t n = 1;
+  double t[MICRO_REPS], dev[MICRO_REPS];
+  for (;;) {
+    if (time_calls(fn, n, &t[0]) != 0) {
+      return 1;
+    }
+    if (t[0] >= MICRO_MIN_TIME) {
+      break;
+    }
+    n *= 2;
+  }
+  for (int i = 0; i < MICRO_WARMUP; i++) {
+    if (time_calls(fn, n, &t[0]) != 0) {
+      return 1;
+    }
+  }
+
+  for (int i = 0; i < MICRO_REPS; i++) {
+    if (time_calls(fn, n, &t[i]) != 0) {
+      return 1;
+    }
+    t[i] = t[i] / n * 1e6;
+  }
+  qsort(t, MICRO_REPS, sizeof(double), compare_doubles);
+  double median = t[MICRO_REPS / 2];
+  for (int i = 0; i < MICRO_REPS; i++) {
+    dev[i] = fabs(t[i] - median);
+  }
+  qsort(dev, MICRO_REPS, sizeof(double), compare_doubles);
+
+  snprintf(res->name, sizeof(res->name), "%s", name);
+  res->median = median;
+  res->mad = dev[MICRO_REPS / 2];
+  res->min = t[0];
+  res->max = t[MICRO_REPS - 1];
+  res->calls = n;
+  return 0;
+}
+
+static int write_micro_json(const char *filename,
+                            const struct micro_result *res, int n) {
+  FILE *fp = fopen(filename, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "Error opening file %s for writing\n", filename);
+    return 1;
+  }
+  /* One result per line, so baselines can be read back without a parser */
+  fprintf(fp, "{\n  \"unit\": \"us/call\",\n  \"results\": [\n");
+  for (int i = 0; i < n; i++) {
+    fprintf(fp,
+            "    {\"name\": \"%s\", \"median\": %.3f, \"mad\": %.3f, "
+            "\"min\": %.3f, \"max\": %.3f, \"calls\": %zu}%s\n",
+            res[i].name, res[i].median, res[i].mad, res[i].min, res[i].max,
+            res[i].calls, i < n - 1 ? "," : "");
+  }
+  fprintf(fp, "  ]\n}\n");
+  return fclose(fp) != 0;
+}
+
+/* Read the results of a write_micro_json() file; -1 if there is none */
+static int read_micro_json(const char *filename, struct micro_result *res,
+                           int max) {
+  FILE *fp = fopen(filename, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+  char line[256];
+  int n = 0;
+  while (n < max && fgets(line, sizeof(line), fp) != NULL) {
+    struct micro_result *r = &res[n];
+    if (sscanf(line, " {\"name\": \"%31[^\"]\", \"median\": %lf, \"mad\": %lf",
+               r->name, &r->median, &r->mad) == 3) {
+      n++;
+    }
+  }
+  fclose(fp);
+  return n;
+}
+
+/*
+ * Single calls with warmup and repetitions, written as JSON (--json) and
+ * compared with an earlier run (--baseline)
+ */
+static int bench_micro(void) {
+  struct micro_result base[MAX_MICRO];
+  int num_base = 0;
+  if (baseline_file != NULL) {
+    num_base = read_micro_json(baseline_file, base, MAX_MICRO);
+    if (num_base < 0) {
+      fprintf(stderr, "Warning: No baseline %s, not comparing\n",
+              baseline_file);
+      num_base = 0;
+    }
+  }
+
+  const int num_micro = sizeof(micro_cases) / sizeof(micro_cases[0]);
+  struct micro_result res[MAX_MICRO];
+  int regressions = 0;
+  printf("micro: %d repetitions of >= %.0f ms after %d warmup, us/call\n",
+         MICRO_REPS, MICRO_MIN_TIME * 1e3, MICRO_WARMUP);
+  printf("%-14s %12s %10s %12s %12s %10s\n", "case", "median", "mad", "min",
+         "max", "baseline");
+  for (int i = 0; i < num_micro; i++) {
+    if (micro_run(&res[i], micro_cases[i].name, micro_cases[i].fn) != 0) {
+      return 1;
+    }
+    printf("%-14s %12.1f %10.1f %12.1f %12.1f", res[i].name, res[i].median,
+           res[i].mad, res[i].min, res[i].max);
+
+    /* A regression is a slowdown above the threshold and well above the
+       spread of both runs */
+    for (int j = 0; j < num_base; j++) {
+      if (strcmp(base[j].name, res[i].name) == 0) {
+        double change = (res[i].median / base[j].median - 1.0) * 100.0;
+        int slower = change > regression_threshold &&
+                     res[i].median - base[j].median >
+                         3.0 * (res[i].mad + base[j].mad);
+        printf(" %+9.1f%%%s", change, slower ? " REGRESSION" : "");
+        regressions += slower;
+      }
+    }
+    printf("\n");
+  }
+
+  if (json_file != NULL && write_micro_json(json_file, res, num_micro) != 0) {
+    return 1;
+  }
+  if (regressions > 0) {
+    fprintf(stderr, "Error: %d regressions against %s\n", regressions,
+            baseline_file);
+    return 1;
+  }
+  return 0;
+}
+
+static const struct bench_case cases[] = {
+    {"batch_scaling", bench_batch_scaling},
+    {"year_sweep", bench_year_sweep},
+    {"month_hop", bench_month_hop},
+    {"latency", bench_latency},
+    {"writers", bench_writers},
+    {"columns", bench_columns},
+    {"tec_grid", bench_tec_grid},
+    {"slant_tec", bench_slant_tec},
+    {"workspace", bench_workspace},
+    {"height_list", bench_height_list},
+    {"series", bench_series},
+    {"cache", bench_cache},
+    {"cube", bench_cube},
+    {"field", bench_field},
+    {"fast_columns", bench_fast_columns},
+    {"stages", bench_stages},
+    {"micro", bench_micro},
+};
+
+static const int num_cases = sizeof(cases) / sizeof(cases[0]);
+
+void print_usage(const char *progname) {
+  printf("Usage: %s [options] [case ...]\n", progname);
+  printf("Options:\n");
+  printf("  -w|--workers <n>     Maximum number of workers (default: one "
+         "per processor)\n");
+  printf("  -d|--data-dir <dir>  Directory with the IRI data files (default: "
+         "current\n"
+         "                       directory)\n");
+  printf("  -j|--json <file>     Write the micro case results as JSON\n");
+  printf("  -b|--baseline <file> Compare the micro case with the results of "
+         "an earlier\n"
+         "                       --json run\n");
+  printf("  -t|--threshold <pct> Slowdown reported as a regression (default: "
+         "10)\n");
+  printf("  -h|--help            Show this help message\n");
+  printf("Cases:\n");
+  for (int i = 0; i < num_cases; i++) {
+    printf("  %s\n", cases[i].name);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const char **selected = malloc(argc * sizeof(*selected));
+  int num_selected = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (((strcmp(argv[i], "-w") == 0) ||
+         (strcmp(argv[i], "--workers") == 0)) &&
+        i + 1 < argc) {
+      max_workers = atoi(argv[++i]);
+    } else if (((strcmp(argv[i], "-d") == 0) ||
+                (strcmp(argv[i], "--data-dir") == 0)) &&
+               i + 1 < argc) {
+      data_dir = argv[++i];
+    } else if (((strcmp(argv[i], "-j") == 0) ||
+                (strcmp(argv[i], "--json") == 0)) &&
+               i + 1 < argc) {
+      json_file = argv[++i];
+    } else if (((strcmp(argv[i], "-b") == 0) ||
+                (strcmp(argv[i], "--baseline") == 0)) &&
+               i + 1 < argc) {
+      baseline_file = argv[++i];
+    } else if (((strcmp(argv[i], "-t") == 0) ||
+                (strcmp(argv[i], "--threshold") == 0)) &&
+               i + 1 < argc) {
+      regression_threshold = atof(argv[++i]);
+    } else if ((strcmp(argv[i], "-h") == 0) ||
+               (strcmp(argv[i], "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else {
+      int found = 0;
+      for (int j = 0; j < num_cases; j++) {
+        if (strcmp(argv[i], cases[j].name) == 0) {
+          found = 1;
+        }
+      }
+      if (!found) {
+        printf("Unknown option or case: %s\n", argv[i]);
+        print_usage(argv[0]);
+        return 1;
+      }
+      selected[num_selected++] = argv[i];
+    }
+  }
+
+  double t0 = now();
+  if (iri_init_with_dir(data_dir) != 0) {
+    fprintf(stderr, "Failed to initialize IRI model\n");
+    return 1;
+  }
+  init_time = now() - t0;
+
+  int status = 0;
+  for (int i = 0; i < num_cases; i++) {
+    int run = num_selected == 0;
+    for (int j = 0; j < num_selected; j++) {
+      if (strcmp(selected[j], cases[i].name) == 0) {
+        run = 1;
+      }
+    }
+    if (run && cases[i].run() != 0) {
+      fprintf(stderr, "Benchmark %s failed\n", cases[i].name);
+      status = 1;
+    }
+  }
+
+  free(selected);
+  return status;
+}
@@ -0,0 +1,402 @@
+/**
+ * @file
+ * @brief Implementation of the memoizing cache of IRI profiles
+ */
+
+#include "iri_cache.h"
+#include "iri_data.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint32_t byte_order = 0x01020304;
+
+/* Smallest number of hash buckets (a power of 2) */
+#define MIN_BUCKETS 64
+
+/* Inputs that identify a profile (no padding, so compared as bytes) */
+struct cache_key {
+  double latitude;
+  double longitude;
+  double hour;
+  double height_start;
+  double height_step;
+  int32_t year;
+  int32_t month;
+  int32_t day;
+  int32_t num_heights;
+  uint32_t columns;
+  uint32_t reserved; /* Zero */
+  uint64_t jf_mask;  /* Bit j - 1 set if JF(j) is on */
+};
+
+/* A cached profile: `NUM_PROFILE` rows of `key.num_heights` values */
+struct entry {
+  struct entry *newer; /* LRU list, most recently used first */
+  struct entry *older;
+  struct entry *chain; /* Next entry in the same hash bucket */
+  uint64_t hash;
+  struct cache_key key;
+  double values[];
+};
+
+struct iri_cache {
+  size_t max_bytes;
+  double position_step;
+  double hour_step;
+  struct entry **buckets;
+  size_t num_buckets; /* Power of 2 */
+  struct entry *newest;
+  struct entry *oldest;
+  struct iri_cache_stats stats;
+};
+
+/* Header of cache files (64 bytes), followed by each entry's key and values
+   from the least to the most recently used */
+struct cache_file_header {
+  char magic[8];          /* IRI_CACHE_MAGIC */
+  uint32_t version;       /* IRI_CACHE_VERSION */
+  uint32_t byte_order;    /* 0x01020304 in the host byte order */
+  double position_step;   /* Rounding steps of the cache */
+  double hour_step;
+  uint64_t num_entries;   /* Number of entries */
+  uint64_t data_fingerprint; /* iri_data_fingerprint() of the profiles */
+  uint8_t padding[16];    /* Zero */
+};
+
+static size_t entry_size(int num_heights) {
+  return sizeof(struct entry) +
+         (size_t)NUM_PROFILE * num_heights * sizeof(double);
+}
+
+/* FNV-1a of the key bytes */
+static uint64_t key_hash(const struct cache_key *key) {
+  const unsigned char *p = (const unsigned char *)key;
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < sizeof(*key); i++) {
+    h = (h ^ p[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+/* Round to a multiple of `step` (0 for the value itself), without -0 */
+static double round_to(double value, double step) {
+  if (step > 0.0) {
+    value = round(value / step) * step;
+  }
+  return value + 0.0;
+}
+
+struct iri_cache *iri_cache_new(size_t max_bytes, double position_step,
+                                double hour_step) {
+  if (!(position_step >= 0.0) || !(hour_step >= 0.0)) {
+    fprintf(stderr, "Error: Invalid cache rounding steps\n");
+    return NULL;
+  }
+  struct iri_cache *cache = calloc(1, sizeof(*cache));
+  if (cache == NULL) {
+    return NULL;
+  }
+  cache->buckets = calloc(MIN_BUCKETS, sizeof(*cache->buckets));
+  if (cache->buckets == NULL) {
+    free(cache);
+    return NULL;
+  }
+  cache->num_buckets = MIN_BUCKETS;
+  cache->max_bytes = max_bytes;
+  cache->position_step = position_step;
+  cache->hour_step = hour_step;
+  return cache;
+}
+
+void iri_cache_free(struct iri_cache *cache) {
+  if (cache == NULL) {
+    return;
+  }
+  struct entry *e = cache->newest;
+  while (e != NULL) {
+    struct entry *older = e->older;
+    free(e);
+    e = older;
+  }
+  free(cache->buckets);
+  free(cache);
+}
+
+void iri_cache_get_stats(const struct iri_cache *cache,
+                         struct iri_cache_stats *stats) {
+  *stats = cache->stats;
+}
+
+static void lru_unlink(struct iri_cache *cache, struct entry *e) {
+  if (e->newer != NULL) {
+    e->newer->older = e->older;
+  } else {
+    cache->newest = e->older;
+  }
+  if (e->older != NULL) {
+    e->older->newer = e->newer;
+  } else {
+    cache->oldest = e->newer;
+  }
+}
+
+static void lru_push_newest(struct iri_cache *cache, struct entry *e) {
+  e->newer = NULL;
+  e->older = cache->newest;
+  if (cache->newest != NULL) {
+    cache->newest->newer = e;
+  } else {
+    cache->oldest = e;
+  }
+  cache->newest = e;
+}
+
+static struct entry *find(const struct iri_cache *cache,
+                          const struct cache_key *key, uint64_t hash) {
+  struct entry *e = cache->buckets[hash & (cache->num_buckets - 1)];
+  while (e != NULL && (e->hash != hash || memcmp(&e->key, key, sizeof(*key))))
+  {
+    e = e->chain;
+  }
+  return e;
+}
+
+/* Remove an entry from its bucket and the LRU list, and free it */
+static void remove_entry(struct iri_cache *cache, struct entry *e) {
+  struct entry **p = &cache->buckets[e->hash & (cache->num_buckets - 1)];
+  while (*p != e) {
+    p = &(*p)->chain;
+  }
+  *p = e->chain;
+  lru_unlink(cache, e);
+  cache->stats.entries--;
+  cache->stats.bytes -= entry_size(e->key.num_heights);
+  free(e);
+}
+
+/* Double the buckets once there are more entries than buckets */
+static void maybe_grow(struct iri_cache *cache) {
+  if (cache->stats.entries <= cache->num_buckets) {
+    return;
+  }
+  size_t n = 2 * cache->num_buckets;
+  struct entry **buckets = calloc(n, sizeof(*buckets));
+  if (buckets == NULL) {
+    return; /* Longer chains, but still correct */
+  }
+  for (size_t b = 0; b < cache->num_buckets; b++) {
+    struct entry *e = cache->buckets[b];
+    while (e != NULL) {
+      struct entry *next = e->chain;
+      e->chain = buckets[e->hash & (n - 1)];
+      buckets[e->hash & (n - 1)] = e;
+      e = next;
+    }
+  }
+  free(cache->buckets);
+  cache->buckets = buckets;
+  cache->num_buckets = n;
+}
+
+/* Insert a new entry as the most recently used, evicting the least
+   recently used ones beyond the budget; entries larger than the whole
+   budget are not kept */
+static void insert(struct iri_cache *cache, struct entry *e) {
+  size_t size = entry_size(e->key.num_heights);
+  if (size > cache->max_bytes) {
+    free(e);
+    return;
+  }
+  while (cache->stats.bytes + size > cache->max_bytes) {
+    remove_entry(cache, cache->oldest);
+    cache->stats.evictions++;
+  }
+  struct entry **bucket = &cache->buckets[e->hash & (cache->num_buckets - 1)];
+  e->chain = *bucket;
+  *bucket = e;
+  lru_push_newest(cache, e);
+  cache->stats.entries++;
+  cache->stats.bytes += size;
+  maybe_grow(cache);
+}
+
+int iri_cache_profiles(struct iri_cache *cache, double latitude,
+                       double longitude, int year, int month, int day,
+                       double hour, double height_start, double height_end,
+                       double height_step, unsigned columns,
+                       double values[NUM_PROFILE][MAX_HEIGHT]) {
+  if (cache == NULL) {
+    return 1;
+  }
+  columns &= IRI_COLUMNS_ALL;
+  int jf_select[NUM_JF];
+  iri_jf_for_columns(columns, jf_select);
+
+  struct cache_key key;
+  memset(&key, 0, sizeof(key));
+  key.latitude = round_to(latitude, cache->position_step);
+  key.longitude = round_to(longitude, cache->position_step);
+  key.hour = round_to(hour, cache->hour_step);
+  key.height_start = height_start;
+  key.height_step = height_step;
+  key.year = year;
+  key.month = month;
+  key.day = day;
+  key.num_heights = iri_heights(height_start, height_end, height_step,
+                                values[0]);
+  key.columns = columns;
+  for (int j = 0; j < NUM_JF; j++) {
+    key.jf_mask |= (uint64_t)(jf_select[j] != 0) << j;
+  }
+  uint64_t hash = key_hash(&key);
+  int n = key.num_heights;
+
+  struct entry *e = find(cache, &key, hash);
+  if (e != NULL) {
+    cache->stats.hits++;
+    lru_unlink(cache, e);
+    lru_push_newest(cache, e);
+    for (int j = 0; j < NUM_PROFILE; j++) {
+      memcpy(values[j], e->values + (size_t)j * n, n * sizeof(double));
+    }
+    return 0;
+  }
+
+  cache->stats.misses++;
+  int status = iri_profiles_select(key.latitude, key.longitude, year, month,
+                                   day, key.hour, height_start, height_end,
+                                   height_step, columns, values);
+  if (status != 0) {
+    return status;
+  }
+  e = malloc(entry_size(n));
+  if (e != NULL) {
+    e->hash = hash;
+    e->key = key;
+    for (int j = 0; j < NUM_PROFILE; j++) {
+      memcpy(e->values + (size_t)j * n, values[j], n * sizeof(double));
+    }
+    insert(cache, e);
+  }
+  return 0;
+}
+
+int iri_cache_save(const struct iri_cache *cache, const char *path) {
+  if (cache == NULL) {
+    return 1;
+  }
+  char tmp_path[4096];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+      (int)sizeof(tmp_path)) {
+    fprintf(stderr, "Error: Cache filename is too long\n");
+    return 1;
+  }
+  FILE *fp = fopen(tmp_path, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "Error opening file %s for writing\n", tmp_path);
+    return 1;
+  }
+
+  struct cache_file_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, IRI_CACHE_MAGIC, sizeof(IRI_CACHE_MAGIC));
+  h.version = IRI_CACHE_VERSION;
+  h.byte_order = byte_order;
+  h.position_step = cache->position_step;
+  h.hour_step = cache->hour_step;
+  h.num_entries = cache->stats.entries;
+  h.data_fingerprint = iri_data_fingerprint();
+  int status = fwrite(&h, sizeof(h), 1, fp) != 1;
+
+  /* Oldest first, so that loading restores the order of use */
+  for (const struct entry *e = cache->oldest; e != NULL && status == 0;
+       e = e->newer) {
+    size_t num_values = (size_t)NUM_PROFILE * e->key.num_heights;
+    status = fwrite(&e->key, sizeof(e->key), 1, fp) != 1 ||
+             fwrite(e->values, sizeof(double), num_values, fp) != num_values;
+  }
+  if (fclose(fp) != 0) {
+    status = 1;
+  }
+  if (status == 0 && rename(tmp_path, path) != 0) {
+    status = 1;
+  }
+  if (status != 0) {
+    fprintf(stderr, "Error writing cache file %s\n", path);
+    remove(tmp_path);
+  }
+  return status;
+}
+
+int iri_cache_load(struct iri_cache *cache, const char *path) {
+  if (cache == NULL) {
+    return 1;
+  }
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "Error opening cache file %s\n", path);
+    return 1;
+  }
+
+  struct cache_file_header h;
+  if (fread(&h, sizeof(h), 1, fp) != 1 ||
+      memcmp(h.magic, IRI_CACHE_MAGIC, sizeof(IRI_CACHE_MAGIC)) != 0 ||
+      h.version != IRI_CACHE_VERSION || h.byte_order != byte_order) {
+    fprintf(stderr,
+            "Error: %s is not a cache file, or has an unsupported version "
+            "or byte order\n",
+            path);
+    fclose(fp);
+    return 1;
+  }
+  if (h.position_step != cache->position_step ||
+      h.hour_step != cache->hour_step) {
+    fprintf(stderr, "Error: Cache file %s has different rounding steps\n",
+            path);
+    fclose(fp);
+    return 1;
+  }
+
+  if (h.data_fingerprint != iri_data_fingerprint()) {
+    fprintf(stderr,
+            "Error: Cache file %s was computed from other IRI data files\n",
+            path);
+    fclose(fp);
+    return 1;
+  }
+
+  int status = 0;
+  for (uint64_t i = 0; i < h.num_entries && status == 0; i++) {
+    struct cache_key key;
+    if (fread(&key, sizeof(key), 1, fp) != 1 || key.num_heights < 1 ||
+        key.num_heights > MAX_HEIGHT) {
+      status = 1;
+      break;
+    }
+    struct entry *e = malloc(entry_size(key.num_heights));
+    if (e == NULL) {
+      status = 1;
+      break;
+    }
+    size_t num_values = (size_t)NUM_PROFILE * key.num_heights;
+    if (fread(e->values, sizeof(double), num_values, fp) != num_values) {
+      free(e);
+      status = 1;
+      break;
+    }
+    e->key = key;
+    e->hash = key_hash(&key);
+    struct entry *old = find(cache, &key, e->hash);
+    if (old != NULL) {
+      remove_entry(cache, old);
+    }
+    insert(cache, e);
+  }
+  fclose(fp);
+  if (status != 0) {
+    fprintf(stderr, "Error reading cache file %s\n", path);
+  }
+  return status;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @brief Memoizing cache of IRI profiles
+ *
+ * Services often ask for profiles at the same, or nearly the same, inputs
+ * again and again (a fixed grid of stations, an hourly cadence, a few height
+ * ranges). A cache sits in front of `iri_profiles_select()`: the position
+ * and time are rounded to a grid, and the profile of the rounded inputs is
+ * computed once and then copied out of memory. Entries are keyed by the
+ * rounded position and time, the date, the heights, the columns and the JF
+ * switches they need, and the least recently used ones are evicted to stay
+ * within a memory budget. The cache can be saved to a file and loaded at
+ * startup, so that a restarted process starts warm.
+ *
+ * A cache is not shared between processes: use it from the parent, not from
+ * the workers of `iri_pool_run()`.
+ *
+ * The key does not include the data files: cache files record a
+ * fingerprint of the loaded data (`iri_data_fingerprint()`) and are only
+ * loaded with the same data, but a cache in memory must be freed when
+ * `iri_init_with_dir()` loads other data.
+ */
+
+#ifndef IRI_CACHE_H
+#define IRI_CACHE_H
+
+#include "iri_interface.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Magic string at the start of cache files, with the terminating NUL */
+#define IRI_CACHE_MAGIC "IRICACH"
+
+/* Cache file format version */
+#define IRI_CACHE_VERSION 2
+
+/* Counters of a cache */
+struct iri_cache_stats {
+  uint64_t hits;      /* Profiles copied from the cache */
+  uint64_t misses;    /* Profiles computed by the model */
+  uint64_t evictions; /* Entries evicted to stay within the budget */
+  size_t entries;     /* Entries in the cache */
+  size_t bytes;       /* Memory used by the entries */
+};
+
+/* Cache state (opaque) */
+struct iri_cache;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Create a cache
+ *
+ * Latitudes and longitudes are rounded to multiples of `position_step` and
+ * hours to multiples of `hour_step`; a step of 0 keys on the exact value.
+ *
+ * @param max_bytes      Memory budget of the entries in bytes
+ * @param position_step  Latitude and longitude step in degrees (>= 0)
+ * @param hour_step      Hour step in hours (>= 0)
+ *
+ * @return Cache, or NULL on error
+ */
+struct iri_cache *iri_cache_new(size_t max_bytes, double position_step,
+                                double hour_step);
+
+/**
+ * @brief Free a cache
+ *
+ * @param cache  Cache (or NULL)
+ */
+void iri_cache_free(struct iri_cache *cache);
+
+/**
+ * @brief Calculate selected columns of a vertical profile through the cache
+ *
+ * Same as `iri_profiles_select()` at the rounded latitude, longitude and
+ * hour. On a hit the model is not called at all.
+ *
+ * @param cache      Cache
+ * @param latitude   Latitude in degrees North
+ * @param longitude  Longitude in degrees East
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param height_start    Start height in km
+ * @param height_end      End height in km
+ * @param height_step     Height step in km
+ * @param columns    `IRI_COLUMN()` bits of the columns to compute
+ * @param values     Output array for the profile data
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_cache_profiles(struct iri_cache *cache, double latitude,
+                       double longitude, int year, int month, int day,
+                       double hour, double height_start, double height_end,
+                       double height_step, unsigned columns,
+                       double values[NUM_PROFILE][MAX_HEIGHT]);
+
+/**
+ * @brief Get the counters of a cache
+ *
+ * @param cache  Cache
+ * @param stats  Output counters
+ */
+void iri_cache_get_stats(const struct iri_cache *cache,
+                         struct iri_cache_stats *stats);
+
+/**
+ * @brief Save the entries of a cache to a file
+ *
+ * The file is written next to `path` and renamed over it, so a reader never
+ * sees a partial file. It is in the host byte order.
+ *
+ * @param cache  Cache
+ * @param path   Filename
+ *
+ * @return 0 on success, non-zero on error (reported on stderr)
+ */
+int iri_cache_save(const struct iri_cache *cache, const char *path);
+
+/**
+ * @brief Load the entries of a file saved by `iri_cache_save()`
+ *
+ * The entries are added as if they had been used in the order of the saved
+ * cache, and the least recently used are evicted if they do not fit. The
+ * file must have the same rounding steps as the cache, and have been saved
+ * with the same IRI data loaded (a different data directory or blob, or
+ * updated index files, make it stale).
+ *
+ * @param cache  Cache
+ * @param path   Filename
+ *
+ * @return 0 on success, non-zero on error or if the file is not a cache of
+ * the same steps and data (reported on stderr)
+ */
+int iri_cache_load(struct iri_cache *cache, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRI_CACHE_H */
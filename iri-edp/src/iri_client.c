@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief Implementation of the IRI service client
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "iri_service.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int iri_service_read(int fd, void *buf, size_t size) {
+  char *p = buf;
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return 1;
+    }
+    p += n;
+    size -= n;
+  }
+  return 0;
+}
+
+int iri_service_write(int fd, const void *buf, size_t size) {
+  const char *p = buf;
+  while (size > 0) {
+    ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return 1;
+    }
+    p += n;
+    size -= n;
+  }
+  return 0;
+}
+
+int iri_client_connect(const char *path) {
+  if (path == NULL) {
+    path = IRI_SERVICE_SOCKET;
+  }
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Error: Socket path %s is too long\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("Failed to create socket");
+    return -1;
+  }
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    fprintf(stderr, "Error connecting to %s: %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Send a request header and read the response header */
+static int exchange(int fd, const struct iri_request_header *req,
+                    const void *body, size_t body_size,
+                    struct iri_response_header *resp) {
+  /* A server that rejects the header replies and closes without reading
+     the body, so read the reply even if sending the body failed */
+  if (iri_service_write(fd, req, sizeof(*req)) != 0) {
+    fprintf(stderr, "Error: Lost the connection to the server\n");
+    return 1;
+  }
+  int sent = iri_service_write(fd, body, body_size) == 0;
+  if (iri_service_read(fd, resp, sizeof(*resp)) != 0 ||
+      (!sent && resp->status == 0)) {
+    fprintf(stderr, "Error: Lost the connection to the server\n");
+    return 1;
+  }
+  if (resp->magic != IRI_SERVICE_MAGIC || resp->status != 0) {
+    fprintf(stderr, "Error: The server rejected the request\n");
+    return 1;
+  }
+  return 0;
+}
+
+int iri_client_profiles(int fd, size_t num_points,
+                        const struct iri_request_point points[],
+                        double height_start, double height_step,
+                        int num_heights, unsigned columns, float *values) {
+  /* The limits of the server, which would reject the request; beyond
+     32 bits the counts in the header would not match the body */
+  if (num_points > IRI_SERVICE_MAX_POINTS || num_heights < 1 ||
+      num_heights > IRI_SERVICE_MAX_HEIGHTS || !(height_step > 0.0) ||
+      (columns & IRI_COLUMNS_ALL) == 0) {
+    fprintf(stderr, "Error: Invalid profile request\n");
+    return 1;
+  }
+  columns &= IRI_COLUMNS_ALL;
+  int num_columns = 0;
+  for (int j = 0; j < NUM_PROFILE; j++) {
+    num_columns += (columns & IRI_COLUMN(j)) != 0;
+  }
+  struct iri_request_header req = {
+      .magic = IRI_SERVICE_MAGIC,
+      .version = IRI_SERVICE_VERSION,
+      .type = IRI_REQUEST_PROFILES,
+      .columns = columns,
+      .num_points = num_points,
+      .num_heights = num_heights,
+      .height_start = height_start,
+      .height_step = height_step,
+  };
+  struct iri_response_header resp;
+  if (exchange(fd, &req, points, num_points * sizeof(*points), &resp) != 0) {
+    return 1;
+  }
+  if (resp.num_points != num_points || resp.num_heights != (uint32_t)num_heights
+      || resp.columns != columns) {
+    fprintf(stderr, "Error: Unexpected response from the server\n");
+    return 1;
+  }
+
+  size_t point_size = (size_t)num_columns * num_heights;
+  int status = 0;
+  for (size_t i = 0; i < num_points; i++) {
+    struct iri_response_point point;
+    if (iri_service_read(fd, &point, sizeof(point)) != 0 ||
+        point.index >= num_points ||
+        iri_service_read(fd, values + point.index * point_size,
+                         point_size * sizeof(float)) != 0) {
+      fprintf(stderr, "Error: Lost the connection to the server\n");
+      return 1;
+    }
+    status |= point.status != 0;
+  }
+  return status;
+}
+
+int iri_client_stats(int fd, struct iri_service_stats *stats) {
+  struct iri_request_header req = {
+      .magic = IRI_SERVICE_MAGIC,
+      .version = IRI_SERVICE_VERSION,
+      .type = IRI_REQUEST_STATS,
+  };
+  struct iri_response_header resp;
+  if (exchange(fd, &req, NULL, 0, &resp) != 0) {
+    return 1;
+  }
+  return iri_service_read(fd, stats, sizeof(*stats));
+}
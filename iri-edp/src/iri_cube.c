@@ -0,0 +1,343 @@
+/**
+ * @file
+ * @brief Implementation of the Ne climatology cubes
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "iri_cube.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t byte_order = 0x01020304;
+
+/* Profiles computed per batch while building */
+#define BUILD_BLOCK 1024
+
+static size_t num_values(const struct iri_cube_grid *g) {
+  return (size_t)g->num_latitudes * g->num_longitudes * g->num_hours *
+         g->num_heights;
+}
+
+/*
+ * Whether a grid has at least two nodes on each axis, finite starts,
+ * positive finite steps, and a number of values whose size fits in size_t
+ */
+static int grid_valid(const struct iri_cube_grid *g) {
+  const double starts[] = {g->latitude_start, g->longitude_start,
+                           g->hour_start, g->height_start};
+  const double steps[] = {g->latitude_step, g->longitude_step, g->hour_step,
+                          g->height_step};
+  const uint32_t counts[] = {g->num_latitudes, g->num_longitudes,
+                             g->num_hours, g->num_heights};
+  size_t size = sizeof(float);
+  for (int k = 0; k < 4; k++) {
+    if (!isfinite(starts[k]) || !(steps[k] > 0.0) || !isfinite(steps[k]) ||
+        counts[k] < 2 || counts[k] > SIZE_MAX / size) {
+      return 0;
+    }
+    size *= counts[k];
+  }
+  return 1;
+}
+
+static int covers(double step, uint32_t num, double period) {
+  return fabs(step * num - period) < 1e-9 * period;
+}
+
+int iri_cube_build(struct iri_cube *cube, const struct iri_cube_grid *grid,
+                   int year, int month, int day, int num_workers) {
+  if (cube == NULL || grid == NULL) {
+    return 1;
+  }
+  memset(cube, 0, sizeof(*cube));
+  if (!grid_valid(grid) || grid->num_heights > MAX_HEIGHT) {
+    fprintf(stderr, "Error: Invalid cube grid\n");
+    return 1;
+  }
+
+  struct iri_cube_header *h = &cube->header;
+  memcpy(h->magic, IRI_CUBE_MAGIC, sizeof(IRI_CUBE_MAGIC));
+  h->version = IRI_CUBE_VERSION;
+  h->byte_order = byte_order;
+  h->year = year;
+  h->month = month;
+  h->day = day;
+  h->grid = *grid;
+  h->data_offset =
+      (sizeof(*h) + IRI_CUBE_ALIGN - 1) / IRI_CUBE_ALIGN * IRI_CUBE_ALIGN;
+
+  /* Each (latitude, longitude, hour) node is one profile */
+  size_t num_points =
+      (size_t)grid->num_latitudes * grid->num_longitudes * grid->num_hours;
+  size_t block = num_points < BUILD_BLOCK ? num_points : BUILD_BLOCK;
+  int nh = grid->num_heights;
+  double height_end = grid->height_start + (nh - 0.5) * grid->height_step;
+
+  float *values = malloc(num_values(grid) * sizeof(float));
+  double *latitude = malloc(block * sizeof(double));
+  double *longitude = malloc(block * sizeof(double));
+  double *hour = malloc(block * sizeof(double));
+  int *years = malloc(block * sizeof(int));
+  int *months = malloc(block * sizeof(int));
+  int *days = malloc(block * sizeof(int));
+  double *profiles = malloc(block * NUM_PROFILE * nh * sizeof(double));
+  int status = 0;
+  if (!values || !latitude || !longitude || !hour || !years || !months ||
+      !days || !profiles) {
+    fprintf(stderr, "Error: Failed to allocate the cube\n");
+    status = 1;
+  }
+
+  for (size_t begin = 0; begin < num_points && status == 0; begin += block) {
+    size_t n = num_points - begin < block ? num_points - begin : block;
+    for (size_t p = 0; p < n; p++) {
+      size_t node = begin + p;
+      uint32_t k = node % grid->num_hours;
+      uint32_t j = node / grid->num_hours % grid->num_longitudes;
+      uint32_t i = node / grid->num_hours / grid->num_longitudes;
+      latitude[p] = grid->latitude_start + i * grid->latitude_step;
+      longitude[p] = grid->longitude_start + j * grid->longitude_step;
+      hour[p] = grid->hour_start + k * grid->hour_step;
+      years[p] = year;
+      months[p] = month;
+      days[p] = day;
+    }
+    status = iri_profiles_batch_select(
+        n, latitude, longitude, years, months, days, hour,
+        grid->height_start, height_end, grid->height_step, IRI_COLUMN(1),
+        num_workers, profiles);
+    for (size_t p = 0; p < n && status == 0; p++) {
+      const double *ne = profiles + (p * NUM_PROFILE + 1) * nh;
+      float *out = values + (begin + p) * nh;
+      for (int l = 0; l < nh; l++) {
+        out[l] = ne[l] > 0.0 ? (float)ne[l] : 0.0f;
+      }
+    }
+  }
+  free(latitude);
+  free(longitude);
+  free(hour);
+  free(years);
+  free(months);
+  free(days);
+  free(profiles);
+
+  if (status != 0) {
+    free(values);
+    values = NULL;
+  }
+  cube->values = values;
+  return status;
+}
+
+int iri_cube_save(const struct iri_cube *cube, const char *path) {
+  if (cube == NULL || cube->values == NULL) {
+    return 1;
+  }
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "Error opening file %s for writing\n", path);
+    return 1;
+  }
+  static const char zeros[IRI_CUBE_ALIGN];
+  const struct iri_cube_header *h = &cube->header;
+  size_t pad = h->data_offset - sizeof(*h);
+  size_t n = num_values(&h->grid);
+  int status = fwrite(h, sizeof(*h), 1, fp) != 1 ||
+               fwrite(zeros, 1, pad, fp) != pad ||
+               fwrite(cube->values, sizeof(float), n, fp) != n;
+  if (fclose(fp) != 0) {
+    status = 1;
+  }
+  if (status != 0) {
+    fprintf(stderr, "Error writing cube file %s\n", path);
+  }
+  return status;
+}
+
+int iri_cube_map(struct iri_cube *cube, const char *path) {
+  if (cube == NULL) {
+    return 1;
+  }
+  memset(cube, 0, sizeof(*cube));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error opening cube file %s: %s\n", path,
+            strerror(errno));
+    return 1;
+  }
+  struct stat st;
+  void *ptr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 &&
+      (size_t)st.st_size >= sizeof(struct iri_cube_header)) {
+    ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr, "Error: %s is not a cube file\n", path);
+    return 1;
+  }
+
+  /* Check the header against the file size before trusting the values */
+  const struct iri_cube_header *h = ptr;
+  size_t size = st.st_size;
+  const struct iri_cube_grid *g = &h->grid;
+  if (memcmp(h->magic, IRI_CUBE_MAGIC, sizeof(IRI_CUBE_MAGIC)) != 0 ||
+      h->version != IRI_CUBE_VERSION || h->byte_order != byte_order ||
+      !grid_valid(g) || h->data_offset % sizeof(float) != 0 ||
+      h->data_offset < sizeof(*h) || h->data_offset > size ||
+      num_values(g) != (size - h->data_offset) / sizeof(float) ||
+      (size - h->data_offset) % sizeof(float) != 0) {
+    fprintf(stderr,
+            "Error: %s is not a cube file, or has an unsupported version or "
+            "byte order\n",
+            path);
+    munmap(ptr, size);
+    return 1;
+  }
+
+  cube->header = *h;
+  cube->values = (const float *)((const char *)ptr + h->data_offset);
+  cube->mapping = ptr;
+  cube->mapping_size = size;
+  return 0;
+}
+
+void iri_cube_free(struct iri_cube *cube) {
+  if (cube == NULL) {
+    return;
+  }
+  if (cube->mapping != NULL) {
+    munmap(cube->mapping, cube->mapping_size);
+  } else {
+    free((void *)cube->values);
+  }
+  cube->values = NULL;
+  cube->mapping = NULL;
+}
+
+/*
+ * Nodes and weights of one dimension at `x`: 2 (linear) or 4 (cubic)
+ * Returns the number of nodes, or 0 if `x` is outside the grid
+ */
+static int axis_weights(double x, double start, double step, uint32_t num,
+                        int periodic, enum iri_cube_method method,
+                        uint32_t node[4], double weight[4]) {
+  if (!isfinite(x)) {
+    return 0; /* NaN and infinities would pass fmod on periodic axes */
+  }
+  double t = (x - start) / step;
+  if (periodic) {
+    t = fmod(t, num);
+    if (t < 0.0) {
+      t += num;
+    }
+    if (t >= num) {
+      t = 0.0; /* Rounded up from just below the period */
+    }
+  } else if (!(t >= 0.0 && t <= num - 1)) {
+    return 0;
+  }
+  long i = (long)t;
+  if (i >= (long)num - 1 && !periodic) {
+    i = num - 2; /* The last node belongs to the last cell */
+  }
+  double f = t - i;
+
+  if (method == IRI_CUBE_LINEAR) {
+    node[0] = i;
+    node[1] = (i + 1) % num;
+    weight[0] = 1.0 - f;
+    weight[1] = f;
+    return 2;
+  }
+
+  /* Catmull-Rom through nodes i - 1 .. i + 2, clamped at the edges */
+  for (int m = 0; m < 4; m++) {
+    long k = i - 1 + m;
+    if (periodic) {
+      k = (k % (long)num + num) % num;
+    } else {
+      k = k < 0 ? 0 : (k > (long)num - 1 ? (long)num - 1 : k);
+    }
+    node[m] = k;
+  }
+  double f2 = f * f, f3 = f2 * f;
+  weight[0] = 0.5 * (-f3 + 2.0 * f2 - f);
+  weight[1] = 0.5 * (3.0 * f3 - 5.0 * f2 + 2.0);
+  weight[2] = 0.5 * (-3.0 * f3 + 4.0 * f2 + f);
+  weight[3] = 0.5 * (f3 - f2);
+  return 4;
+}
+
+int iri_cube_ne(const struct iri_cube *cube, double latitude,
+                double longitude, double hour, double height,
+                enum iri_cube_method method, double *ne) {
+  const struct iri_cube_grid *g = &cube->header.grid;
+  int lon_periodic = covers(g->longitude_step, g->num_longitudes, 360.0);
+  int hour_periodic = covers(g->hour_step, g->num_hours, 24.0);
+
+  /* Longitudes east of the start, for regional grids across 180 deg */
+  if (!lon_periodic) {
+    double d = fmod(longitude - g->longitude_start, 360.0);
+    longitude = g->longitude_start + (d < 0.0 ? d + 360.0 : d);
+  }
+
+  uint32_t ni[4], nj[4], nk[4], nl[4];
+  double wi[4], wj[4], wk[4], wl[4];
+  int ci = axis_weights(latitude, g->latitude_start, g->latitude_step,
+                        g->num_latitudes, 0, method, ni, wi);
+  int cj = axis_weights(longitude, g->longitude_start, g->longitude_step,
+                        g->num_longitudes, lon_periodic, method, nj, wj);
+  int ck = axis_weights(hour, g->hour_start, g->hour_step, g->num_hours,
+                        hour_periodic, method, nk, wk);
+  int cl = axis_weights(height, g->height_start, g->height_step,
+                        g->num_heights, 0, method, nl, wl);
+  if (ci == 0 || cj == 0 || ck == 0 || cl == 0) {
+    return 1;
+  }
+
+  double sum = 0.0;
+  for (int a = 0; a < ci; a++) {
+    for (int b = 0; b < cj; b++) {
+      size_t ij = (size_t)ni[a] * g->num_longitudes + nj[b];
+      double wij = wi[a] * wj[b];
+      for (int c = 0; c < ck; c++) {
+        const float *profile =
+            cube->values + (ij * g->num_hours + nk[c]) * g->num_heights;
+        double v = 0.0;
+        for (int d = 0; d < cl; d++) {
+          v += wl[d] * profile[nl[d]];
+        }
+        sum += wij * wk[c] * v;
+      }
+    }
+  }
+  /* Cubics can overshoot below zero near the bottom of the profiles */
+  *ne = sum > 0.0 ? sum : 0.0;
+  return 0;
+}
+
+size_t iri_cube_ne_batch(const struct iri_cube *cube, size_t num_points,
+                         const double latitude[], const double longitude[],
+                         const double hour[], const double height[],
+                         enum iri_cube_method method, double ne[]) {
+  size_t outside = 0;
+  for (size_t p = 0; p < num_points; p++) {
+    if (iri_cube_ne(cube, latitude[p], longitude[p], hour[p], height[p],
+                    method, &ne[p]) != 0) {
+      ne[p] = -1.0;
+      outside++;
+    }
+  }
+  return outside;
+}
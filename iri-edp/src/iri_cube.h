@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @brief Precomputed Ne climatology cubes, a fast surrogate for the IRI model
+ *
+ * A cube holds Ne on a regular latitude x longitude x hour x height grid
+ * for one date, computed once with the model (on the worker pool), so that
+ * consumers that need millions of lookups per second (ray tracing, quick-look
+ * displays) interpolate in memory instead of running IRI. Cubes are saved to
+ * a file and memory-mapped, and lookups interpolate multilinearly or with
+ * Catmull-Rom cubics in all four dimensions. For a monthly climatology,
+ * build the cube for the middle of the month.
+ *
+ * Longitude is periodic if the grid covers 360 degrees, and hour if it
+ * covers 24 hours. Ne where IRI has no value (below 80 km by default) is
+ * stored as 0.
+ *
+ * File layout (native byte order): a `struct iri_cube_header`, then at
+ * `data_offset` the Ne values in m-3 as float32, latitude-major with height
+ * varying fastest: node (i, j, k, l) is at index
+ * `((i * num_longitudes + j) * num_hours + k) * num_heights + l`
+ */
+
+#ifndef IRI_CUBE_H
+#define IRI_CUBE_H
+
+#include "iri_interface.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Magic string at the start of cube files, with the terminating NUL */
+#define IRI_CUBE_MAGIC "IRICUBE"
+
+/* Cube file format version */
+#define IRI_CUBE_VERSION 1
+
+/* Alignment of the values in the file (bytes) */
+#define IRI_CUBE_ALIGN 64
+
+/* Grid of a cube: values at start + i * step for i < num */
+struct iri_cube_grid {
+  double latitude_start; /* Degrees North */
+  double latitude_step;
+  double longitude_start; /* Degrees East */
+  double longitude_step;
+  double hour_start; /* Local time (or Universal time + 25) in hours */
+  double hour_step;
+  double height_start; /* km */
+  double height_step;
+  uint32_t num_latitudes;
+  uint32_t num_longitudes;
+  uint32_t num_hours;
+  uint32_t num_heights;
+};
+
+/* Header of cube files */
+struct iri_cube_header {
+  char magic[8];             /* IRI_CUBE_MAGIC */
+  uint32_t version;          /* IRI_CUBE_VERSION */
+  uint32_t byte_order;       /* 0x01020304 as written */
+  int32_t year;              /* Date of the cube */
+  int32_t month;
+  int32_t day;
+  uint32_t reserved;         /* Zero */
+  struct iri_cube_grid grid; /* Nodes */
+  uint64_t data_offset;      /* Offset of the values (bytes) */
+};
+
+/* Cube, built in memory or mapped from a file */
+struct iri_cube {
+  struct iri_cube_header header;
+  const float *values; /* Ne in m-3 (see the file layout) */
+  void *mapping;       /* File mapping, or NULL if built */
+  size_t mapping_size; /* Size of the mapping (bytes) */
+};
+
+/* Interpolation of lookups */
+enum iri_cube_method {
+  IRI_CUBE_LINEAR = 0, /* Multilinear, 16 nodes */
+  IRI_CUBE_CUBIC = 1,  /* Catmull-Rom cubic in each dimension, 256 nodes */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Build a cube with the IRI model, using multiple worker processes
+ *
+ * @param cube         Cube to initialize (free with `iri_cube_free()`)
+ * @param grid         Nodes (at least 2 per dimension, at most `MAX_HEIGHT`
+ *                     heights)
+ * @param year         Year (4 digits)
+ * @param month        Month (1-12)
+ * @param day          Day of month (1-31)
+ * @param num_workers  Number of worker processes (<= 0 for one per processor)
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_cube_build(struct iri_cube *cube, const struct iri_cube_grid *grid,
+                   int year, int month, int day, int num_workers);
+
+/**
+ * @brief Save a cube to a file
+ *
+ * @param cube  Cube
+ * @param path  Filename
+ *
+ * @return 0 on success, non-zero on error (reported on stderr)
+ */
+int iri_cube_save(const struct iri_cube *cube, const char *path);
+
+/**
+ * @brief Map a cube file into memory
+ *
+ * @param cube  Cube to initialize (free with `iri_cube_free()`)
+ * @param path  Filename
+ *
+ * @return 0 on success, non-zero if the file is not a cube of this version
+ * and byte order (reported on stderr)
+ */
+int iri_cube_map(struct iri_cube *cube, const char *path);
+
+/**
+ * @brief Free the values of a cube, or unmap its file
+ *
+ * @param cube  Cube (or NULL)
+ */
+void iri_cube_free(struct iri_cube *cube);
+
+/**
+ * @brief Interpolate Ne at a point
+ *
+ * @param cube       Cube
+ * @param latitude   Latitude in degrees North
+ * @param longitude  Longitude in degrees East
+ * @param hour       Hour, as in the grid
+ * @param height     Height in km
+ * @param method     Interpolation
+ * @param ne         Output Ne in m-3
+ *
+ * @return 0 on success, non-zero if the point is outside the grid
+ */
+int iri_cube_ne(const struct iri_cube *cube, double latitude,
+                double longitude, double hour, double height,
+                enum iri_cube_method method, double *ne);
+
+/**
+ * @brief Interpolate Ne at many points
+ *
+ * @param cube       Cube
+ * @param num_points Number of points
+ * @param latitude   Latitudes in degrees North
+ * @param longitude  Longitudes in degrees East
+ * @param hour       Hours, as in the grid
+ * @param height     Heights in km
+ * @param method     Interpolation
+ * @param ne         Output array of `num_points` Ne values in m-3 (-1
+ *                   outside the grid)
+ *
+ * @return Number of points outside the grid
+ */
+size_t iri_cube_ne_batch(const struct iri_cube *cube, size_t num_points,
+                         const double latitude[], const double longitude[],
+                         const double hour[], const double height[],
+                         enum iri_cube_method method, double ne[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRI_CUBE_H */
@@ -0,0 +1,333 @@
+/**
+ * @file
+ * @brief Implementation of IRI data file loading
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "iri_data.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* COMMON blocks holding the data file contents (Fortran array dimensions
+   reversed) */
+
+/* ig_rz.dat: COMMON /igrz/ in irifun.for */
+extern struct {
+  float aig[1600];
+  float arz[1600];
+  int iymst;
+  int iymend;
+} igrz_;
+
+/* apf107.dat: COMMON /apfa/ in irifun.for */
+extern struct {
+  int aap[9][27000];
+  float af107[3][27000];
+  int n;
+} apfa_;
+
+/* ccirNN.asc, ursiNN.asc: COMMON /ccirur/ in irifun.for */
+extern struct {
+  float f2c[12][2][76][13];
+  float fm3c[12][2][49][9];
+  float f2u[12][2][76][13];
+  int iccir[12];
+} ccirur_;
+
+/* mcsatNN.dat: COMMON /mcsat/ in irifun.for */
+extern struct {
+  double coeff[12][48][149];
+  int loaded[12];
+} mcsat_;
+
+/* dgrfYYYY.dat, igrfYYYY.dat: COMMON /igrfcf/ in igrf.for */
+extern struct {
+  float ghc[18][196];
+  float eradc[18];
+  int nmaxc[18];
+  int igrfld[18];
+} igrfcf_;
+
+/* Data directory: COMMON /iridir/ in irifun.for (blank-padded, with a
+   trailing '/', see datafn) */
+extern struct {
+  char datdir[256];
+} iridir_;
+
+/* Fortran loaders */
+extern void read_ig_rz_();
+extern void readapf107_();
+extern void read_ccir_ursi_(int *month, int *ier);
+extern void read_mcsat_(int *month, int *ier);
+extern void read_igrf_(int *set, int *ier);
+
+/* Blob sections, in file order */
+static const struct {
+  const char *name;
+  void *data;
+  size_t size;
+} sections[] = {
+    {"igrz", &igrz_, sizeof(igrz_)},       {"apfa", &apfa_, sizeof(apfa_)},
+    {"ccirur", &ccirur_, sizeof(ccirur_)}, {"mcsat", &mcsat_, sizeof(mcsat_)},
+    {"igrfcf", &igrfcf_, sizeof(igrfcf_)},
+};
+
+static const int num_sections = sizeof(sections) / sizeof(sections[0]);
+
+static const uint32_t byte_order = 0x01020304;
+
+/* Data directory with a trailing '/', or "" for the current directory */
+static char data_dir[IRI_DATA_DIR_MAX + 2];
+
+int iri_data_set_dir(const char *dir) {
+  size_t len = dir != NULL ? strlen(dir) : 0;
+  if (len > IRI_DATA_DIR_MAX) {
+    fprintf(stderr, "Error: Data directory name is too long: %s\n", dir);
+    return 1;
+  }
+  if (len > 0) {
+    struct stat st;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+      fprintf(stderr, "Error: Data directory %s does not exist\n", dir);
+      return 1;
+    }
+    memcpy(data_dir, dir, len);
+    if (dir[len - 1] != '/') {
+      data_dir[len++] = '/';
+    }
+  }
+  data_dir[len] = '\0';
+
+  /* Fortran strings are blank-padded */
+  memset(iridir_.datdir, ' ', sizeof(iridir_.datdir));
+  memcpy(iridir_.datdir, data_dir, len);
+  return 0;
+}
+
+int iri_data_path(const char *name, char *path, size_t size) {
+  int len = snprintf(path, size, "%s%s", data_dir, name);
+  return len < 0 || (size_t)len >= size;
+}
+
+/* Check that a data file read by a Fortran loader that has no error return
+   exists, since the Fortran runtime would abort otherwise */
+static int check_readable(const char *name) {
+  char path[IRI_DATA_DIR_MAX + 64];
+  if (iri_data_path(name, path, sizeof(path)) != 0 ||
+      access(path, R_OK) != 0) {
+    fprintf(stderr, "Error: Cannot read data file %s%s\n", data_dir, name);
+    return 1;
+  }
+  return 0;
+}
+
+int iri_data_load_ascii(void) {
+  int all = 0;
+  int ier = 0;
+
+  if (check_readable("ig_rz.dat") != 0 || check_readable("apf107.dat") != 0) {
+    return 1;
+  }
+  read_ig_rz_();
+  readapf107_();
+
+  read_ccir_ursi_(&all, &ier);
+  if (ier != 0) {
+    fprintf(stderr,
+            "Error: Failed to read CCIR/URSI coefficients for month %d\n",
+            ier);
+    return 1;
+  }
+  read_mcsat_(&all, &ier);
+  if (ier != 0) {
+    fprintf(stderr, "Error: Failed to read hmF2 coefficients for month %d\n",
+            ier);
+    return 1;
+  }
+  /* ier is the number of missing IGRF sets, which is fine */
+  read_igrf_(&all, &ier);
+  return 0;
+}
+
+int iri_data_igrf_covers(double year) {
+  if (!(fabs(year) < 1e6)) {
+    return 1;
+  }
+  /* The sets FELDCOF uses (in single precision, as there) */
+  float y = (float)year;
+  int l = ((int)(y / 5.0f) * 5 - 1945) / 5 + 1;
+  l = l < 1 ? 1 : (l > 17 ? 17 : l);
+  return igrfcf_.igrfld[l - 1] != 1 || igrfcf_.igrfld[l] != 1;
+}
+
+int iri_data_indices_cover(int year, int month) {
+  /* As TCON, in yyyymm */
+  if (year < -20000 || year > 20000 || month < 1 || month > 12) {
+    return 1;
+  }
+  int yyyymm = year * 100 + month;
+  return yyyymm < igrz_.iymst || yyyymm > igrz_.iymend;
+}
+
+uint64_t iri_data_fingerprint(void) {
+  /* FNV-1a over 8-byte words, then the remaining bytes of each block */
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < num_sections; i++) {
+    const unsigned char *p = sections[i].data;
+    size_t size = sections[i].size, k = 0;
+    for (; k + sizeof(uint64_t) <= size; k += sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, p + k, sizeof(word));
+      hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (; k < size; k++) {
+      hash = (hash ^ p[k]) * 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+/* Map a whole file read-only; returns NULL with errno set on failure */
+static void *map_file(const char *path, size_t *size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    return NULL;
+  }
+  *size = st.st_size;
+  return ptr;
+}
+
+/* Check the header and section table of a mapped blob */
+static int check_blob(const char *path, const unsigned char *blob,
+                      size_t size) {
+  const struct iri_data_header *hdr = (const struct iri_data_header *)blob;
+  if (size < sizeof(*hdr) || memcmp(hdr->magic, IRI_DATA_MAGIC,
+                                    sizeof(IRI_DATA_MAGIC)) != 0) {
+    fprintf(stderr, "Error: %s is not an IRI data blob\n", path);
+    return 1;
+  }
+  if (hdr->version != IRI_DATA_VERSION || hdr->byte_order != byte_order ||
+      hdr->num_sections != (uint32_t)num_sections) {
+    fprintf(stderr, "Error: %s has an unsupported version or byte order\n",
+            path);
+    return 1;
+  }
+  for (int i = 0; i < num_sections; i++) {
+    const struct iri_data_section *sec = &hdr->sections[i];
+    if (strncmp(sec->name, sections[i].name, sizeof(sec->name)) != 0 ||
+        sec->size != sections[i].size || sec->offset > size ||
+        sec->size > size - sec->offset) {
+      fprintf(stderr, "Error: %s: section %d does not match this build\n",
+              path, i);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int iri_data_load(const char *path) {
+  size_t size;
+  unsigned char *blob = map_file(path, &size);
+  if (blob == NULL) {
+    if (errno == ENOENT) {
+      return -1;
+    }
+    fprintf(stderr, "Error: Failed to map %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+
+  int status = check_blob(path, blob, size);
+  if (status == 0) {
+    const struct iri_data_header *hdr = (const struct iri_data_header *)blob;
+    for (int i = 0; i < num_sections; i++) {
+      memcpy(sections[i].data, blob + hdr->sections[i].offset,
+             sections[i].size);
+    }
+  }
+  munmap(blob, size);
+  return status;
+}
+
+int iri_data_save(const char *path) {
+  struct iri_data_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, IRI_DATA_MAGIC, sizeof(IRI_DATA_MAGIC));
+  hdr.version = IRI_DATA_VERSION;
+  hdr.byte_order = byte_order;
+  hdr.num_sections = num_sections;
+
+  uint64_t offset = sizeof(hdr);
+  for (int i = 0; i < num_sections; i++) {
+    offset = (offset + IRI_DATA_ALIGN - 1) / IRI_DATA_ALIGN * IRI_DATA_ALIGN;
+    strncpy(hdr.sections[i].name, sections[i].name,
+            sizeof(hdr.sections[i].name));
+    hdr.sections[i].offset = offset;
+    hdr.sections[i].size = sections[i].size;
+    offset += sections[i].size;
+  }
+
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    perror("Failed to open data blob for writing");
+    return 1;
+  }
+  static const char zeros[IRI_DATA_ALIGN];
+  int status = fwrite(&hdr, sizeof(hdr), 1, fp) != 1;
+  long pos = sizeof(hdr);
+  for (int i = 0; i < num_sections && status == 0; i++) {
+    long pad = (long)hdr.sections[i].offset - pos;
+    status = fwrite(zeros, 1, pad, fp) != (size_t)pad ||
+             fwrite(sections[i].data, sections[i].size, 1, fp) != 1;
+    pos = hdr.sections[i].offset + sections[i].size;
+  }
+  if (fclose(fp) != 0) {
+    status = 1;
+  }
+  if (status != 0) {
+    fprintf(stderr, "Error: Failed to write %s\n", path);
+  }
+  return status;
+}
+
+int iri_data_compare(const char *path) {
+  size_t size;
+  unsigned char *blob = map_file(path, &size);
+  if (blob == NULL) {
+    fprintf(stderr, "Error: Failed to map %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+
+  int status = check_blob(path, blob, size);
+  if (status == 0) {
+    const struct iri_data_header *hdr = (const struct iri_data_header *)blob;
+    for (int i = 0; i < num_sections; i++) {
+      if (memcmp(sections[i].data, blob + hdr->sections[i].offset,
+                 sections[i].size) != 0) {
+        fprintf(stderr, "Error: %s: section %s differs\n", path,
+                sections[i].name);
+        status = 1;
+      }
+    }
+  }
+  munmap(blob, size);
+  return status;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file
+ * @brief Loading of the IRI data files, from ASCII or a packed binary blob
+ *
+ * The Fortran IRI code keeps the contents of its data files in COMMON
+ * blocks (indices, CCIR/URSI and Shubin hmF2 coefficients, IGRF coefficient
+ * sets). Parsing the ASCII files takes a noticeable part of a short run, so
+ * the blocks can also be saved to a binary blob with a fixed layout, which
+ * is then mapped and copied back into place.
+ *
+ * Blob layout (native byte order, all offsets from the start of the file):
+ *
+ *     struct iri_data_header            magic, version, section table
+ *     section payloads                  each aligned to IRI_DATA_ALIGN bytes
+ *
+ * A blob written on one platform or build is only valid for the same COMMON
+ * block layout; the header records the size of each block so mismatches are
+ * detected and the ASCII files are used instead.
+ */
+
+#ifndef IRI_DATA_H
+#define IRI_DATA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Default blob file name, looked up in the data directory */
+#define IRI_DATA_BLOB "iri_data.bin"
+
+/** Maximum length of the data directory (the Fortran side has 256
+    characters for the directory and the file name) */
+#define IRI_DATA_DIR_MAX 224
+
+/** Magic bytes at the start of a blob */
+#define IRI_DATA_MAGIC "IRIDATA"
+
+/** Blob format version */
+#define IRI_DATA_VERSION 1
+
+/** Alignment of the section payloads in the blob */
+#define IRI_DATA_ALIGN 64
+
+/** Maximum number of sections in a blob */
+#define IRI_DATA_MAX_SECTIONS 8
+
+/** Section table entry of a blob */
+struct iri_data_section {
+  char name[8];     /**< COMMON block name, NUL-padded */
+  uint64_t offset;  /**< Offset of the payload */
+  uint64_t size;    /**< Size of the payload in bytes */
+};
+
+/** Header of a blob */
+struct iri_data_header {
+  char magic[8];          /**< IRI_DATA_MAGIC, NUL-terminated */
+  uint32_t version;       /**< IRI_DATA_VERSION */
+  uint32_t byte_order;    /**< 0x01020304 as written by the producer */
+  uint32_t num_sections;  /**< Number of used entries in `sections` */
+  uint32_t reserved;      /**< Zero */
+  struct iri_data_section sections[IRI_DATA_MAX_SECTIONS];
+};
+
+/**
+ * @brief Set the directory the IRI data files are read from
+ *
+ * @param dir  Directory, or NULL or "" for the current directory
+ *
+ * @return 0 on success, non-zero if the directory name is too long or is not
+ * a directory
+ */
+int iri_data_set_dir(const char *dir);
+
+/**
+ * @brief Build the path of a data file in the data directory
+ *
+ * @param name  File name
+ * @param path  Output path
+ * @param size  Size of `path`
+ *
+ * @return 0 on success, non-zero if the path does not fit
+ */
+int iri_data_path(const char *name, char *path, size_t size);
+
+/**
+ * @brief Read all IRI data files from ASCII into the COMMON blocks
+ *
+ * IGRF coefficient sets that are not present are skipped; they are only
+ * needed for dates in their 5-year interval.
+ *
+ * @return 0 on success, non-zero if a required file could not be read
+ */
+int iri_data_load_ascii(void);
+
+/**
+ * @brief Check that the loaded IGRF coefficient sets cover a decimal year
+ *
+ * The field at a date comes from the sets of the 5-year interval around it
+ * (extrapolated after the last one), and IRI stops the program if one of
+ * them was not loaded.
+ *
+ * @param year  Decimal year
+ *
+ * @return 0 if covered, non-zero otherwise (including NaN and infinities)
+ */
+int iri_data_igrf_covers(double year);
+
+/**
+ * @brief Check that the loaded solar and ionospheric indices cover a month
+ *
+ * IRI needs the 12-month running means of ig_rz.dat at the date, and
+ * returns without profiles for months outside the file.
+ *
+ * @param year   Year
+ * @param month  Month (1-12)
+ *
+ * @return 0 if covered, non-zero otherwise
+ */
+int iri_data_indices_cover(int year, int month);
+
+/**
+ * @brief Fingerprint of the loaded data
+ *
+ * A 64-bit FNV-1a hash of the COMMON blocks (by 8-byte words), which
+ * differs between data directories, blobs and updates of the index files
+ * (with high probability), so results derived from the data can be tied
+ * to it.
+ *
+ * @return Hash of the COMMON blocks
+ */
+uint64_t iri_data_fingerprint(void);
+
+/**
+ * @brief Copy the COMMON blocks from a blob
+ *
+ * @param path  Blob file name
+ *
+ * @return 0 on success, -1 if the file does not exist, 1 if it is invalid
+ */
+int iri_data_load(const char *path);
+
+/**
+ * @brief Write the current contents of the COMMON blocks to a blob
+ *
+ * @param path  Blob file name
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_data_save(const char *path);
+
+/**
+ * @brief Compare a blob byte for byte with the current COMMON blocks
+ *
+ * @param path  Blob file name
+ *
+ * @return 0 if identical, non-zero if different or on error (the differing
+ * sections are reported on stderr)
+ */
+int iri_data_compare(const char *path);
+
+#endif /* IRI_DATA_H */
@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @brief Implementation of the geomagnetic field from the IGRF model
+ */
+
+#include "iri_field.h"
+#include "iri_data.h"
+#include "iri_pool.h"
+#include <string.h>
+
+/* Function prototype for the Fortran batch field routine (igrf.for) */
+extern void igrf_batch_(float *year, int *n, float xlat[], float xlong[],
+                        float height[], int *lshell, float dec[],
+                        float dip[], float dipl[], float ymodip[],
+                        float babs[], float xl[], int icode[]);
+
+/* Points per Fortran call, converted through arrays on the stack */
+#define FIELD_BLOCK 256
+
+/* Fewest points per worker without the L shell, which costs about a
+   microsecond per point, against a millisecond to fork a worker */
+#define FIELD_MIN_POINTS 16384
+
+int iri_decimal_year(int year, int month, int day, double *decimal_year) {
+  static const int days_before_month[13] = {0,   31,  59,  90,  120,
+                                            151, 181, 212, 243, 273,
+                                            304, 334, 365};
+  /* IRI's leap year rule (MODA) */
+  int leap = year % 4 == 0;
+  if (month < 1 || month > 12 || day < 1 ||
+      day > days_before_month[month] - days_before_month[month - 1] +
+                (leap && month == 2)) {
+    return 1;
+  }
+  int day_of_year = days_before_month[month - 1] + day + (leap && month > 2);
+  *decimal_year = year + (day_of_year - 1.0) / (leap ? 366 : 365);
+  return 0;
+}
+
+/* Inputs and outputs of a field batch, shared with the worker processes */
+struct field_ctx {
+  const double *latitude;
+  const double *longitude;
+  const double *altitude;
+  float year;
+  int l_shell;
+  struct iri_field *field;
+};
+
+static int field_work(size_t begin, size_t end, void *ctx) {
+  struct field_ctx *f = ctx;
+  float lat[FIELD_BLOCK], lon[FIELD_BLOCK], alt[FIELD_BLOCK];
+  float dec[FIELD_BLOCK], dip[FIELD_BLOCK], dipl[FIELD_BLOCK];
+  float modip[FIELD_BLOCK], babs[FIELD_BLOCK], xl[FIELD_BLOCK];
+  int icode[FIELD_BLOCK];
+  int lshell = f->l_shell != 0;
+
+  for (size_t k = begin; k < end; k += FIELD_BLOCK) {
+    int n = end - k < FIELD_BLOCK ? (int)(end - k) : FIELD_BLOCK;
+    for (int i = 0; i < n; i++) {
+      lat[i] = (float)f->latitude[k + i];
+      lon[i] = (float)f->longitude[k + i];
+      alt[i] = (float)f->altitude[k + i];
+    }
+    igrf_batch_(&f->year, &n, lat, lon, alt, &lshell, dec, dip, dipl, modip,
+                babs, xl, icode);
+    for (int i = 0; i < n; i++) {
+      f->field[k + i] = (struct iri_field){
+          .declination = dec[i],
+          .dip = dip[i],
+          .dip_latitude = dipl[i],
+          .modip = modip[i],
+          .field = babs[i],
+          .l_shell = xl[i],
+          .l_code = icode[i],
+      };
+    }
+  }
+  return 0;
+}
+
+int iri_field_batch(size_t num_points, const double latitude[],
+                    const double longitude[], const double altitude[],
+                    double year, int l_shell, int num_workers,
+                    struct iri_field *field) {
+  if (iri_data_igrf_covers(year) != 0) {
+    return 1; /* IRI would stop the program on a missing set */
+  }
+  if (num_points == 0) {
+    return 0;
+  }
+  size_t size = num_points * sizeof(*field);
+
+  struct field_ctx ctx = {
+      .latitude = latitude,
+      .longitude = longitude,
+      .altitude = altitude,
+      .year = (float)year,
+      .l_shell = l_shell,
+      .field = field,
+  };
+
+  /* Workers write to shared memory, which is copied out at the end */
+  num_workers = iri_pool_workers(
+      num_workers, l_shell ? num_points : num_points / FIELD_MIN_POINTS + 1);
+  if (num_workers > 1) {
+    ctx.field = iri_pool_shared_alloc(size);
+    if (ctx.field == NULL) {
+      return 1;
+    }
+  }
+
+  int status = iri_pool_run(num_points, num_workers, FIELD_BLOCK, field_work,
+                            &ctx);
+
+  if (ctx.field != field) {
+    memcpy(field, ctx.field, size);
+    iri_pool_shared_free(ctx.field, size);
+  }
+
+  return status;
+}
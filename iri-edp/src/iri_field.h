@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @brief Geomagnetic field from the IGRF model used by IRI
+ *
+ * Evaluates the IGRF at many points for one date without computing
+ * profiles. The spherical harmonic coefficients for a date are interpolated
+ * once and kept for the following calls at the same date; IRI_SUB's own
+ * coefficients are left alone, so profiles and field calls can be mixed.
+ * Computations are in single precision, as in IRI.
+ */
+
+#ifndef IRI_FIELD_H
+#define IRI_FIELD_H
+
+#include "iri_interface.h"
+#include <stddef.h>
+
+/* Field at a point */
+struct iri_field {
+  double declination;  /* Degrees, positive East */
+  double dip;          /* Inclination in degrees, positive down */
+  double dip_latitude; /* atan(tan(dip) / 2) in degrees */
+  double modip;        /* Modified dip latitude in degrees */
+  double field;        /* Field strength in Gauss */
+  double l_shell;      /* McIlwain L in Earth radii, or -1 if not requested */
+  int l_code;          /* 1: L is correct, 2: L is not correct, 3: L is an
+                          approximation, 0: not requested */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Calculate the decimal year of a date as IRI does
+ *
+ * `year + (day_of_year - 1) / days_in_year`, i.e. the start of the day.
+ *
+ * @param year          Year (4 digits)
+ * @param month         Month (1-12)
+ * @param day           Day of month (1 to the number of days of the month)
+ * @param decimal_year  Output decimal year
+ *
+ * @return 0 on success, non-zero if the month or day is out of range
+ */
+int iri_decimal_year(int year, int month, int day, double *decimal_year);
+
+/**
+ * @brief Calculate the geomagnetic field at many points, using multiple
+ * worker processes
+ *
+ * The L shell traces the field line (SHELLG) and costs far more than the
+ * rest, so it is only computed if requested.
+ *
+ * @param num_points  Number of points
+ * @param latitude    Geodetic latitudes in degrees North
+ * @param longitude   Longitudes in degrees East
+ * @param altitude    Altitudes in km
+ * @param year        Decimal year (see `iri_decimal_year()`)
+ * @param l_shell     Non-zero to compute `l_shell` and `l_code`
+ * @param num_workers  Number of worker processes (<= 0 for one per processor)
+ * @param field       Output array of `num_points` fields
+ *
+ * @return 0 on success, non-zero on error, or if the loaded IGRF coefficient
+ * sets do not cover the year (see `iri_data_igrf_covers()`)
+ */
+int iri_field_batch(size_t num_points, const double latitude[],
+                    const double longitude[], const double altitude[],
+                    double year, int l_shell, int num_workers,
+                    struct iri_field *field);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRI_FIELD_H */
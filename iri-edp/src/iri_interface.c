@@ -4,15 +4,43 @@
  */
 
 #include "iri_interface.h"
+#include "iri_data.h"
+#include "iri_pool.h"
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* Function prototypes for Fortran functions */
-extern void read_ig_rz_();
-extern void readapf107_();
 extern void iri_sub_(int jf[NUM_JF], int *jmag, float *alati, float *along,
                      int *iyyyy, int *mmdd, float *dhour, float *heibeg,
                      float *heiend, float *heistp,
                      float outf[MAX_HEIGHT][NUM_OUTF], float oarr[NUM_OARR]);
+extern void iri_sub_hlist_(int jf[NUM_JF], int *jmag, float *alati,
+                           float *along, int *iyyyy, int *mmdd, float *dhour,
+                           int *nhei, float heights[],
+                           float outf[MAX_HEIGHT][NUM_OUTF],
+                           float oarr[NUM_OARR]);
+
+/* COMMON /LOCMEM/ in irisub.for: reuse of the magnetic field terms */
+extern struct {
+  int lmemo;  /* LOGICAL: reuse if the location and day are the same */
+  int nlmemo; /* Calls since the terms were computed (0: none) */
+} locmem_;
+
+/* COMMON /FASTCOL/ in irisub.for: fast column mode (see IONCOL) */
+extern struct {
+  int on; /* LOGICAL: knots instead of every height */
+} fastcol_;
+
+/* COMMON /STAGES/ in irisub.for: stage timers (see IRI_STAGE_BEGIN) */
+extern struct {
+  double time[IRI_NUM_STAGES];     /* Seconds per stage */
+  long long count[IRI_NUM_STAGES]; /* INTEGER*8: calls per stage */
+  long long start[IRI_NUM_STAGES]; /* INTEGER*8: clock at the last start */
+  long long rate;                  /* INTEGER*8: clock counts per second */
+  int on;                          /* LOGICAL: timers on */
+} stages_;
 
 /*
  * Default JF switches array for standard IRI operation
@@ -54,20 +82,38 @@ static const char *col_names[NUM_PROFILE] = {
 static const int take_cols[NUM_OUTF_PROFILE] = {1, 2, 3, 4,  5,  6,
                                                 7, 8, 9, 10, 11, 15};
 
-int iri_init(void) {
-  /* "Programs using subroutine IRI_SUB need to include" */
-  read_ig_rz_();
-  readapf107_();
-  /* Note: Currently no easy way to know if the routines succeeded or not */
-  return 0;
+int iri_init(void) { return iri_init_with_dir(NULL); }
+
+int iri_init_with_dir(const char *data_dir) {
+  if (iri_data_set_dir(data_dir) != 0) {
+    return 1;
+  }
+
+  /* "Programs using subroutine IRI_SUB need to include" read_ig_rz and
+     readapf107; we also load all coefficient files up front, so IRI_SUB
+     never has to open or parse a file while computing profiles. Use the
+     preprocessed blob if there is a valid one, and fall back to the ASCII
+     files. */
+  char blob[IRI_DATA_DIR_MAX + 64];
+  if (iri_data_path(IRI_DATA_BLOB, blob, sizeof(blob)) == 0 &&
+      iri_data_load(blob) == 0) {
+    return 0;
+  }
+  return iri_data_load_ascii();
 }
 
-int iri_heights(double height_start, double height_end, double height_step,
-                double heights[MAX_HEIGHT]) {
+int iri_num_heights(double height_start, double height_end,
+                    double height_step) {
   int num_heights = (int)((height_end - height_start) / height_step) + 1;
   if (num_heights > MAX_HEIGHT) {
     num_heights = MAX_HEIGHT;
   }
+  return num_heights;
+}
+
+int iri_heights(double height_start, double height_end, double height_step,
+                double heights[MAX_HEIGHT]) {
+  int num_heights = iri_num_heights(height_start, height_end, height_step);
 
   for (int i = 0; i < num_heights; i++) {
     heights[i] = height_start + i * height_step;
@@ -79,19 +125,46 @@ int iri_heights(double height_start, double height_end, double height_step,
   return num_heights;
 }
 
-int iri_profiles(double latitude, double longitude, int year, int month,
-                 int day, double hour, double height_start, double height_end,
-                 double height_step, double values[NUM_PROFILE][MAX_HEIGHT]) {
-  /* Use single-precision float arrays for Fortran function outputs */
-  float f_outf[MAX_HEIGHT][NUM_OUTF];
-  float f_oarr[NUM_OARR];
+/* Buffers for the IRI_SUB outputs, reused between calls */
+struct iri_workspace {
+  float outf[MAX_HEIGHT][NUM_OUTF];
+  float oarr[NUM_OARR];
+  float heights[MAX_HEIGHT];
+};
+
+/* Workspace of the functions that don't take one */
+static struct iri_workspace shared_workspace;
+
+struct iri_workspace *iri_workspace_new(void) {
+  return malloc(sizeof(struct iri_workspace));
+}
+
+void iri_workspace_free(struct iri_workspace *ws) { free(ws); }
+
+/*
+ * Call IRI_SUB with the given switches for the heights
+ * `height_start + k * height_step`, `k < num_heights`, or `heights[k]` if
+ * given, at most `MAX_HEIGHT` at a time, and store the columns in `columns`
+ * as double (`values`) or float (`values_f32`) rows `stride` apart; the
+ * other rows are not touched
+ */
+static int run_iri_sub(struct iri_workspace *ws, const int *jf_run,
+                       double latitude, double longitude, int year, int month,
+                       int day, double hour, double height_start,
+                       double height_step, const double *heights,
+                       int num_heights, unsigned columns, double *values,
+                       float *values_f32, size_t stride) {
+  if (num_heights < 1 || (heights == NULL && !(height_step > 0.0))) {
+    return 1;
+  }
+  if (ws == NULL) {
+    ws = &shared_workspace;
+  }
 
   /* Convert double-precision parameters to single for Fortran */
   float f_latitude = (float)latitude;
   float f_longitude = (float)longitude;
   float f_hour = (float)hour;
-  float f_height_start = (float)height_start;
-  float f_height_end = (float)height_end;
   float f_height_step = (float)height_step;
 
   /* Calculate MMDD parameter for IRI */
@@ -100,34 +173,359 @@ int iri_profiles(double latitude, double longitude, int year, int month,
   /* Assume geographic (= 0, as opposed to geomagnetic, = 1) */
   int jmag = 0;
 
-  /* Initialize output arrays */
-  for (int i = 0; i < MAX_HEIGHT; i++) {
-    for (int j = 0; j < NUM_OUTF; j++) {
-      f_outf[i][j] = -1.0f;
+  for (int begin = 0; begin < num_heights; begin += MAX_HEIGHT) {
+    int n = num_heights - begin < MAX_HEIGHT ? num_heights - begin
+                                             : MAX_HEIGHT;
+    /* IRI_SUB computes int((end - start) / step) + 1 heights (and
+       initializes only those rows of `outf`); aim half a step past the
+       last one so that single-precision rounding can't drop it */
+    float f_height_start = (float)(height_start + begin * height_step);
+    float f_height_end =
+        (float)(height_start + (begin + n - 0.5) * height_step);
+
+    for (int i = 0; i < NUM_OARR; i++) {
+      ws->oarr[i] = -1.0f;
+    }
+
+    /* Call the Fortran IRI_SUB routine */
+    if (heights != NULL) {
+      for (int k = 0; k < n; k++) {
+        ws->heights[k] = (float)heights[begin + k];
+      }
+      iri_sub_hlist_((int *)jf_run, &jmag, &f_latitude, &f_longitude, &year,
+                     &mmdd, &f_hour, &n, ws->heights, ws->outf, ws->oarr);
+    } else {
+      iri_sub_((int *)jf_run, &jmag, &f_latitude, &f_longitude, &year,
+               &mmdd, &f_hour, &f_height_start, &f_height_end,
+               &f_height_step, ws->outf, ws->oarr);
+    }
+
+    /* Heights, which will be the first column in our output, then the
+       profile results */
+    for (int j = 0; j < NUM_PROFILE; j++) {
+      if (j > 0 && !(columns & IRI_COLUMN(j))) {
+        continue;
+      }
+      int i_f = j > 0 ? take_cols[j - 1] - 1 : -1;
+      if (values != NULL) {
+        double *row = values + j * stride + begin;
+        for (int k = 0; k < n; k++) {
+          row[k] = j > 0             ? (float)ws->outf[k][i_f]
+                   : heights != NULL ? heights[begin + k]
+                                     : height_start + (begin + k) * height_step;
+        }
+      } else {
+        float *row = values_f32 + j * stride + begin;
+        for (int k = 0; k < n; k++) {
+          row[k] = j > 0 ? ws->outf[k][i_f]
+                         : (float)(heights != NULL
+                                       ? heights[begin + k]
+                                       : height_start +
+                                             (begin + k) * height_step);
+        }
+      }
     }
-  }
-  for (int i = 0; i < NUM_OARR; i++) {
-    f_oarr[i] = -1.0f;
   }
 
-  /* Call the Fortran IRI_SUB routine */
-  iri_sub_(jf, &jmag, &f_latitude, &f_longitude, &year, &mmdd, &f_hour,
-           &f_height_start, &f_height_end, &f_height_step, f_outf, f_oarr);
+  return 0;
+}
 
-  /* Compute heights, which will be the first column in our output */
+/* Run IRI_SUB into the rows of a fixed-size profile, with the other columns
+   set to -1 */
+static int run_iri_sub_fixed(const int *jf_run, double latitude,
+                             double longitude, int year, int month, int day,
+                             double hour, double height_start,
+                             double height_end, double height_step,
+                             unsigned columns,
+                             double values[NUM_PROFILE][MAX_HEIGHT]) {
   int num_heights =
       iri_heights(height_start, height_end, height_step, values[0]);
+  for (int j = 1; j < NUM_PROFILE; j++) {
+    if (!(columns & IRI_COLUMN(j))) {
+      for (int k = 0; k < num_heights; k++) {
+        values[j][k] = -1.0;
+      }
+    }
+  }
+  return run_iri_sub(NULL, jf_run, latitude, longitude, year, month, day,
+                     hour, height_start, height_step, NULL, num_heights,
+                     columns, values[0], NULL, MAX_HEIGHT);
+}
 
-  /* Copy profile results */
-  int i_f;
-  for (int i = 0; i < NUM_OUTF_PROFILE; i++) {
-    i_f = take_cols[i] - 1;
-    for (int j = 0; j < num_heights; j++) {
-      values[i + 1][j] = (float)f_outf[j][i_f];
+int iri_profiles(double latitude, double longitude, int year, int month,
+                 int day, double hour, double height_start, double height_end,
+                 double height_step, double values[NUM_PROFILE][MAX_HEIGHT]) {
+  return run_iri_sub_fixed(jf, latitude, longitude, year, month, day, hour,
+                           height_start, height_end, height_step,
+                           IRI_COLUMNS_ALL, values);
+}
+
+void iri_jf_for_columns(unsigned columns, int jf_out[NUM_JF]) {
+  /* Column bits of the parameter groups */
+  const unsigned ne_cols = IRI_COLUMN(1) | IRI_COLUMN(12);
+  const unsigned temp_cols = IRI_COLUMN(2) | IRI_COLUMN(3) | IRI_COLUMN(4);
+  /* PF/GF takes the field strength that the ion model leaves in BABS */
+  unsigned ion_cols = IRI_COLUMN(12);
+  for (int j = 5; j <= 11; j++) {
+    ion_cols |= IRI_COLUMN(j);
+  }
+
+  memcpy(jf_out, jf, sizeof(jf));
+  jf_out[1 - 1] = (columns & ne_cols) != 0;
+  jf_out[3 - 1] = (columns & ion_cols) != 0;
+  /* The RBTT ion composition (JF(6) off) needs the temperatures */
+  jf_out[2 - 1] =
+      (columns & temp_cols) != 0 || (jf_out[3 - 1] && !jf[6 - 1]);
+  jf_out[21 - 1] = 0; /* ion drift */
+  jf_out[28 - 1] = 0; /* spread-F probability */
+  jf_out[45 - 1] = 0; /* sporadic E probability */
+}
+
+int iri_profiles_select(double latitude, double longitude, int year,
+                        int month, int day, double hour, double height_start,
+                        double height_end, double height_step,
+                        unsigned columns,
+                        double values[NUM_PROFILE][MAX_HEIGHT]) {
+  int jf_select[NUM_JF];
+  iri_jf_for_columns(columns, jf_select);
+  return run_iri_sub_fixed(jf_select, latitude, longitude, year, month, day,
+                           hour, height_start, height_end, height_step,
+                           columns, values);
+}
+
+/* Switches for the columns, without a copy for all of them */
+static const int *jf_columns(unsigned columns, int jf_select[NUM_JF]) {
+  if ((columns & IRI_COLUMNS_ALL) == IRI_COLUMNS_ALL) {
+    return jf;
+  }
+  iri_jf_for_columns(columns, jf_select);
+  return jf_select;
+}
+
+int iri_profiles_ws(struct iri_workspace *ws, double latitude,
+                    double longitude, int year, int month, int day,
+                    double hour, double height_start, double height_step,
+                    int num_heights, unsigned columns, double *values) {
+  int jf_select[NUM_JF];
+  return run_iri_sub(ws, jf_columns(columns, jf_select), latitude, longitude,
+                     year, month, day, hour, height_start, height_step, NULL,
+                     num_heights, columns, values, NULL, num_heights);
+}
+
+int iri_profiles_ws_f32(struct iri_workspace *ws, double latitude,
+                        double longitude, int year, int month, int day,
+                        double hour, double height_start, double height_step,
+                        int num_heights, unsigned columns, float *values) {
+  int jf_select[NUM_JF];
+  return run_iri_sub(ws, jf_columns(columns, jf_select), latitude, longitude,
+                     year, month, day, hour, height_start, height_step, NULL,
+                     num_heights, columns, NULL, values, num_heights);
+}
+
+int iri_profiles_heights(struct iri_workspace *ws, double latitude,
+                         double longitude, int year, int month, int day,
+                         double hour, int num_heights, const double heights[],
+                         unsigned columns, double *values) {
+  int jf_select[NUM_JF];
+  return run_iri_sub(ws, jf_columns(columns, jf_select), latitude, longitude,
+                     year, month, day, hour, 0.0, 0.0, heights, num_heights,
+                     columns, values, NULL, num_heights);
+}
+
+int iri_profile_series(struct iri_workspace *ws, double latitude,
+                       double longitude, size_t num_times, const int year[],
+                       const int month[], const int day[], const double hour[],
+                       double height_start, double height_step,
+                       int num_heights, unsigned columns, iri_profile_fn fn,
+                       void *ctx) {
+  if (num_heights < 1 || fn == NULL) {
+    return 1;
+  }
+  double *values = malloc(NUM_PROFILE * num_heights * sizeof(double));
+  if (values == NULL) {
+    return 1;
+  }
+  /* The rows of the other columns are never written */
+  for (int j = 1; j < NUM_PROFILE; j++) {
+    if (!(columns & IRI_COLUMN(j))) {
+      for (int k = 0; k < num_heights; k++) {
+        values[j * num_heights + k] = -1.0;
+      }
     }
   }
+  int jf_select[NUM_JF];
+  const int *jf_run = jf_columns(columns, jf_select);
 
-  return 0;
+  /* The field terms only depend on the location and the day */
+  locmem_.lmemo = 1;
+  locmem_.nlmemo = 0;
+  int status = 0;
+  for (size_t i = 0; i < num_times && status == 0; i++) {
+    status = run_iri_sub(ws, jf_run, latitude, longitude, year[i], month[i],
+                         day[i], hour[i], height_start, height_step, NULL,
+                         num_heights, columns, values, NULL, num_heights);
+    if (status == 0) {
+      status = fn(i, values, ctx);
+    }
+  }
+  locmem_.lmemo = 0;
+
+  free(values);
+  return status;
+}
+
+/* Append a height to a list, if there is room */
+static void append_height(double height, int max_heights, double heights[],
+                          int *num_heights) {
+  if (*num_heights < max_heights) {
+    heights[*num_heights] = height;
+  }
+  (*num_heights)++;
+}
+
+int iri_peak_heights(struct iri_workspace *ws, double latitude,
+                     double longitude, int year, int month, int day,
+                     double hour, double height_start, double height_end,
+                     double fine_step, double coarse_step, double window,
+                     int max_heights, double heights[]) {
+  if (!(fine_step > 0.0) || !(coarse_step >= fine_step) ||
+      !(height_end >= height_start) || !(window >= 0.0)) {
+    return -1;
+  }
+  if (ws == NULL) {
+    ws = &shared_workspace;
+  }
+
+  /* One Ne height is enough to get the peaks in `oarr` */
+  double ne[NUM_PROFILE];
+  if (iri_profiles_ws(ws, latitude, longitude, year, month, day, hour,
+                      height_start, 1.0, 1, IRI_COLUMN(1), ne) != 0) {
+    return -1;
+  }
+  /* hmF2, hmF1 (-1 without an F1 layer) and hmE */
+  const double peaks[3] = {ws->oarr[1], ws->oarr[3], ws->oarr[5]};
+
+  int num_heights = 0;
+  double h = height_start;
+  while (h < height_end) {
+    append_height(h, max_heights, heights, &num_heights);
+    int near_peak = 0;
+    double next = h + coarse_step;
+    for (int i = 0; i < 3; i++) {
+      if (peaks[i] <= 0.0) {
+        continue;
+      }
+      /* From the lower edge, where the coarse steps stop */
+      if (h >= peaks[i] - window && h < peaks[i] + window) {
+        near_peak = 1;
+      } else if (h < peaks[i] - window && next > peaks[i] - window) {
+        next = peaks[i] - window; /* Don't step over a window */
+      }
+    }
+    h = near_peak ? h + fine_step : next;
+  }
+  append_height(height_end, max_heights, heights, &num_heights);
+  return num_heights;
+}
+
+/* Inputs and outputs of a batch run, shared with the worker processes */
+struct batch_ctx {
+  const double *latitude;
+  const double *longitude;
+  const int *year;
+  const int *month;
+  const int *day;
+  const double *hour;
+  double height_start;
+  double height_step;
+  int num_heights;
+  unsigned columns;
+  double *values;
+};
+
+static int batch_work(size_t begin, size_t end, void *ctx) {
+  struct batch_ctx *b = ctx;
+  int status = 0;
+  for (size_t i = begin; i < end; i++) {
+    /* Straight into the output, with the other columns set to -1 */
+    double *out = b->values + i * NUM_PROFILE * b->num_heights;
+    if (iri_profiles_ws(NULL, b->latitude[i], b->longitude[i], b->year[i],
+                        b->month[i], b->day[i], b->hour[i], b->height_start,
+                        b->height_step, b->num_heights, b->columns,
+                        out) != 0) {
+      status = 1;
+      continue;
+    }
+    for (int j = 1; j < NUM_PROFILE; j++) {
+      if (!(b->columns & IRI_COLUMN(j))) {
+        for (int k = 0; k < b->num_heights; k++) {
+          out[j * b->num_heights + k] = -1.0;
+        }
+      }
+    }
+  }
+  return status;
+}
+
+int iri_profiles_batch(size_t num_points, const double latitude[],
+                       const double longitude[], const int year[],
+                       const int month[], const int day[], const double hour[],
+                       double height_start, double height_end,
+                       double height_step, int num_workers, double *values) {
+  return iri_profiles_batch_select(num_points, latitude, longitude, year,
+                                   month, day, hour, height_start, height_end,
+                                   height_step, IRI_COLUMNS_ALL, num_workers,
+                                   values);
+}
+
+int iri_profiles_batch_select(size_t num_points, const double latitude[],
+                              const double longitude[], const int year[],
+                              const int month[], const int day[],
+                              const double hour[], double height_start,
+                              double height_end, double height_step,
+                              unsigned columns, int num_workers,
+                              double *values) {
+  int num_heights = iri_num_heights(height_start, height_end, height_step);
+  if (num_heights < 1) {
+    return 1;
+  }
+  size_t size = num_points * NUM_PROFILE * num_heights * sizeof(double);
+
+  struct batch_ctx ctx = {
+      .latitude = latitude,
+      .longitude = longitude,
+      .year = year,
+      .month = month,
+      .day = day,
+      .hour = hour,
+      .height_start = height_start,
+      .height_step = height_step,
+      .num_heights = num_heights,
+      .columns = columns,
+      .values = values,
+  };
+
+  /* Workers write to shared memory, which is copied out at the end */
+  num_workers = iri_pool_workers(num_workers, num_points);
+  if (num_workers > 1) {
+    ctx.values = iri_pool_shared_alloc(size);
+    if (ctx.values == NULL) {
+      return 1;
+    }
+  }
+
+  int status = iri_pool_run(num_points, num_workers, 0, batch_work, &ctx);
+
+  if (ctx.values != values) {
+    memcpy(values, ctx.values, size);
+    iri_pool_shared_free(ctx.values, size);
+  }
+
+  return status;
+}
+
+const char *iri_column_name(int column) {
+  return column >= 0 && column < NUM_PROFILE ? col_names[column] : NULL;
 }
 
 int iri_write_csv(const char *filename,
@@ -175,3 +573,66 @@ int iri_write_csv(const char *filename,
 
   return 0;
 }
+
+void iri_fast_columns_enable(int on) { fastcol_.on = on != 0; }
+
+static const char *stage_names[IRI_NUM_STAGES] = {
+    "iri_sub", "field", "msis", "ions", "dregion", "soco", "heights",
+};
+
+void iri_stats_enable(int on) { stages_.on = on != 0; }
+
+void iri_get_stats(struct iri_stats *stats) {
+  for (int i = 0; i < IRI_NUM_STAGES; i++) {
+    stats->calls[i] = stages_.count[i];
+    stats->seconds[i] = stages_.time[i];
+  }
+}
+
+void iri_reset_stats(void) {
+  for (int i = 0; i < IRI_NUM_STAGES; i++) {
+    stages_.count[i] = 0;
+    stages_.time[i] = 0;
+  }
+}
+
+void iri_add_stats(const struct iri_stats *stats) {
+  for (int i = 0; i < IRI_NUM_STAGES; i++) {
+    stages_.count[i] += stats->calls[i];
+    stages_.time[i] += stats->seconds[i];
+  }
+}
+
+const char *iri_stage_name(int stage) {
+  return stage >= 0 && stage < IRI_NUM_STAGES ? stage_names[stage] : NULL;
+}
+
+int iri_write_stats_json(const char *filename, const struct iri_stats *stats) {
+  FILE *fp = stdout;
+  if (filename != NULL) {
+    fp = fopen(filename, "w");
+    if (fp == NULL) {
+      fprintf(stderr, "Error opening file %s for writing\n", filename);
+      return 1;
+    }
+  }
+
+  fprintf(fp, "{\n");
+  for (int i = 0; i < IRI_NUM_STAGES; i++) {
+    double mean = stats->calls[i] > 0
+                      ? stats->seconds[i] / stats->calls[i] * 1e6
+                      : 0.0;
+    fprintf(fp,
+            "  \"%s\": {\"calls\": %llu, \"seconds\": %.9f, "
+            "\"mean_us\": %.3f}%s\n",
+            stage_names[i], stats->calls[i], stats->seconds[i], mean,
+            i < IRI_NUM_STAGES - 1 ? "," : "");
+  }
+  fprintf(fp, "}\n");
+
+  int status = ferror(fp) != 0;
+  if (filename != NULL && fclose(fp) != 0) {
+    status = 1;
+  }
+  return status;
+}
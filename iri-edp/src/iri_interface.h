@@ -23,25 +23,64 @@
 
 /* Number of Fortran `outf` array columns that have vertical profile data + 1
  * for height */
-#define NUM_PROFILE NUM_OUTF_PROFILE + 1
+#define NUM_PROFILE (NUM_OUTF_PROFILE + 1)
 
 /* Length of the Fortran `oarr` array */
 #define NUM_OARR 100
 
+/* Bit of profile column `j` (0: height, 1: Ne, ..., see `iri_column_name()`)
+ * in column masks */
+#define IRI_COLUMN(j) (1u << (j))
+
+/* All `NUM_PROFILE` columns */
+#define IRI_COLUMNS_ALL ((1u << NUM_PROFILE) - 1)
+
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief Initialize the IRI model
+ * @brief Initialize the IRI model, reading the data files from the current
+ * directory
  *
- * This function must be called before any other IRI function to
- * initialize the model's internal data.
+ * Same as `iri_init_with_dir(NULL)`.
  *
- * @return 0 to indicate success
+ * @return 0 on success, non-zero if the data files could not be read
  */
 int iri_init(void);
 
+/**
+ * @brief Initialize the IRI model, reading the data files from a directory
+ *
+ * This function (or `iri_init()`) must be called before any other IRI
+ * function to initialize the model's internal data. It loads the indices and
+ * all coefficient sets, which the model would otherwise read from disk
+ * whenever the date changes, from the preprocessed blob `IRI_DATA_BLOB` if
+ * there is a valid one (see `iri_pack`), or else from the ASCII data files.
+ * Afterwards, computing profiles does not open or parse any files.
+ *
+ * @param data_dir  Directory containing the data files (NULL or "" for the
+ *                  current directory)
+ *
+ * @return 0 on success, non-zero if the directory does not exist or the data
+ * files could not be read (the reason is reported on stderr)
+ */
+int iri_init_with_dir(const char *data_dir);
+
+/**
+ * @brief Calculate the number of heights for a start, end, and step
+ *
+ * @param height_start    Start height in km
+ * @param height_end      End height in km
+ * @param height_step     Height step in km
+ *
+ * @return Number of height steps (at most `MAX_HEIGHT`)
+ */
+int iri_num_heights(double height_start, double height_end,
+                    double height_step);
+
 /**
  * @brief Calculate height array based on start, end, and step, filling
  * `heights`
@@ -77,6 +116,391 @@ int iri_profiles(double latitude, double longitude, int year, int month,
                  int day, double hour, double height_start, double height_end,
                  double height_step, double values[NUM_PROFILE][MAX_HEIGHT]);
 
+/**
+ * @brief Calculate only some columns of a vertical profile
+ *
+ * Same as `iri_profiles()`, but the model only computes what the columns in
+ * `columns` need (see `iri_jf_for_columns()`), which is much faster for
+ * e.g. Ne only. The other columns are set to -1; the height column is always
+ * filled.
+ *
+ * @param latitude   Latitude in degrees North
+ * @param longitude  Longitude in degrees East
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param height_start    Start height in km
+ * @param height_end      End height in km
+ * @param height_step     Height step in km
+ * @param columns    `IRI_COLUMN()` bits of the columns to compute
+ * @param values     Output array for the profile data
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_profiles_select(double latitude, double longitude, int year,
+                        int month, int day, double hour, double height_start,
+                        double height_end, double height_step,
+                        unsigned columns,
+                        double values[NUM_PROFILE][MAX_HEIGHT]);
+
+/* Reusable buffers for the Fortran outputs (opaque) */
+struct iri_workspace;
+
+/**
+ * @brief Allocate a workspace for `iri_profiles_ws()`
+ *
+ * @return Workspace (free with `iri_workspace_free()`), or NULL on failure
+ */
+struct iri_workspace *iri_workspace_new(void);
+
+/**
+ * @brief Free a workspace from `iri_workspace_new()`
+ */
+void iri_workspace_free(struct iri_workspace *ws);
+
+/**
+ * @brief Calculate a vertical profile of any number of heights into a
+ * caller-sized array
+ *
+ * Same as `iri_profiles_select()`, but for the `num_heights` heights
+ * `height_start + k * height_step`, which may be more than `MAX_HEIGHT`
+ * (IRI_SUB is called for `MAX_HEIGHT` at a time). Only the used rows of the
+ * Fortran output are initialized and converted, and the rows of the other
+ * columns are not touched.
+ *
+ * @param ws         Workspace, or NULL for one shared by all calls
+ * @param latitude   Latitude in degrees North
+ * @param longitude  Longitude in degrees East
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param height_start    Start height in km
+ * @param height_step     Height step in km
+ * @param num_heights     Number of heights
+ * @param columns    `IRI_COLUMN()` bits of the columns to compute
+ * @param values     Output array of `NUM_PROFILE` rows (height first) of
+ *                   `num_heights` values: `values[j * num_heights + k]` is
+ *                   parameter `j` at height `k`
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_profiles_ws(struct iri_workspace *ws, double latitude,
+                    double longitude, int year, int month, int day,
+                    double hour, double height_start, double height_step,
+                    int num_heights, unsigned columns, double *values);
+
+/**
+ * @brief Calculate a vertical profile as single-precision floats
+ *
+ * Same as `iri_profiles_ws()`, with the model's float values stored as they
+ * are.
+ */
+int iri_profiles_ws_f32(struct iri_workspace *ws, double latitude,
+                        double longitude, int year, int month, int day,
+                        double hour, double height_start, double height_step,
+                        int num_heights, unsigned columns, float *values);
+
+/**
+ * @brief Calculate a vertical profile at a list of heights
+ *
+ * Same as `iri_profiles_ws()`, but at `heights[k]`, `k < num_heights`, in
+ * any order and spacing (e.g. dense around the peaks and sparse in the
+ * topside, see `iri_peak_heights()`); the height row of `values` is a copy
+ * of `heights`. The values are the same as on a uniform grid through the
+ * same heights, except PF/GF, for which IRI_SUB uses the field strength of
+ * the previous height.
+ *
+ * @param ws         Workspace, or NULL for one shared by all calls
+ * @param latitude   Latitude in degrees North
+ * @param longitude  Longitude in degrees East
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param num_heights     Number of heights
+ * @param heights    Heights in km
+ * @param columns    `IRI_COLUMN()` bits of the columns to compute
+ * @param values     Output array of `NUM_PROFILE` rows of `num_heights`
+ *                   values, as for `iri_profiles_ws()`
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_profiles_heights(struct iri_workspace *ws, double latitude,
+                         double longitude, int year, int month, int day,
+                         double hour, int num_heights, const double heights[],
+                         unsigned columns, double *values);
+
+/**
+ * @brief Receive one profile of a series
+ *
+ * @param index   Index of the time
+ * @param values  Profile, as for `iri_profiles_ws()` (only valid during the
+ *                call)
+ * @param ctx     Caller context passed through from `iri_profile_series()`
+ *
+ * @return 0 to continue, non-zero to stop the series
+ */
+typedef int (*iri_profile_fn)(size_t index, const double *values, void *ctx);
+
+/**
+ * @brief Calculate vertical profiles at one location for a series of times
+ *
+ * Same as `iri_profiles_ws()` for each time, passing the profiles to `fn`
+ * as they are computed. The magnetic field terms that only depend on the
+ * location and the day (declination, dip, modip, L-value) are computed once
+ * per day instead of at every time, so give the times in chronological
+ * order.
+ *
+ * @param ws         Workspace, or NULL for one shared by all calls
+ * @param latitude   Latitude in degrees North
+ * @param longitude  Longitude in degrees East
+ * @param num_times  Number of times
+ * @param year       Years (4 digits)
+ * @param month      Months (1-12)
+ * @param day        Days of month (1-31)
+ * @param hour       Local times (or Universal times + 25) in decimal hours
+ * @param height_start    Start height in km
+ * @param height_step     Height step in km
+ * @param num_heights     Number of heights
+ * @param columns    `IRI_COLUMN()` bits of the columns to compute (the
+ *                   others are -1)
+ * @param fn         Function receiving each profile
+ * @param ctx        Context passed to `fn`
+ *
+ * @return 0 on success, non-zero on error or if `fn` stopped the series
+ */
+int iri_profile_series(struct iri_workspace *ws, double latitude,
+                       double longitude, size_t num_times, const int year[],
+                       const int month[], const int day[], const double hour[],
+                       double height_start, double height_step,
+                       int num_heights, unsigned columns, iri_profile_fn fn,
+                       void *ctx);
+
+/**
+ * @brief Build a list of heights that is dense around the E, F1 and F2
+ * peaks
+ *
+ * Gets hmE, hmF1 and hmF2 from the model (`oarr`) for the point and time,
+ * then steps from `height_start` to `height_end` by `fine_step` from
+ * `window` below a peak to `window` above it and by `coarse_step`
+ * elsewhere (shortened to land on the start of a window), always ending at
+ * `height_end`.
+ *
+ * @param ws         Workspace, or NULL for one shared by all calls
+ * @param latitude   Latitude in degrees North
+ * @param longitude  Longitude in degrees East
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param height_start    Lowest height in km
+ * @param height_end      Highest height in km
+ * @param fine_step       Height step around the peaks in km
+ * @param coarse_step     Height step elsewhere in km
+ * @param window          Half-width of the dense region around each peak in
+ *                        km
+ * @param max_heights     Room in `heights`
+ * @param heights    Output heights in km, increasing
+ *
+ * @return Number of heights (more than `max_heights` if they did not all
+ * fit), or -1 on error
+ */
+int iri_peak_heights(struct iri_workspace *ws, double latitude,
+                     double longitude, int year, int month, int day,
+                     double hour, double height_start, double height_end,
+                     double fine_step, double coarse_step, double window,
+                     int max_heights, double heights[]);
+
+/**
+ * @brief Derive the "JF" switches that compute some columns
+ *
+ * Starts from the default switches of `iri_profiles()` and turns off the
+ * ion composition (JF(3)) unless its columns or PF/GF are requested (PF/GF
+ * uses the field strength of the ion model), the temperatures (JF(2))
+ * unless their columns or the ions are (the RBTT ion model uses them), Ne
+ * (JF(1)) unless it or PF/GF is (IRI_SUB turns it back on for the ions),
+ * and always the ion drift,
+ * spread-F and sporadic E probabilities, which only go to `oarr`
+ * (JF(21), JF(28), JF(45)). The requested columns are unchanged.
+ *
+ * @param columns  `IRI_COLUMN()` bits of the columns to compute
+ * @param jf_out   Output switches (1 => .TRUE., 0 => .FALSE.)
+ */
+void iri_jf_for_columns(unsigned columns, int jf_out[NUM_JF]);
+
+/**
+ * @brief Calculate vertical profiles for many points, using multiple worker
+ * processes
+ *
+ * Each point is one (latitude, longitude, date, time) column.
+ * Since the Fortran model is not thread-safe, the points are spread over
+ * forked worker processes, which must be started after `iri_init()`.
+ *
+ * The output is stored point by point, each point holding `NUM_PROFILE`
+ * rows (height first) of `iri_num_heights()` values, i.e.
+ * `values[(i * NUM_PROFILE + j) * num_heights + k]` is parameter `j` at
+ * height `k` for point `i`.
+ *
+ * @param num_points   Number of points
+ * @param latitude     Latitudes in degrees North
+ * @param longitude    Longitudes in degrees East
+ * @param year         Years (4 digits)
+ * @param month        Months (1-12)
+ * @param day          Days of month (1-31)
+ * @param hour         Local times (or Universal times + 25) in decimal hours
+ * @param height_start    Start height in km
+ * @param height_end      End height in km
+ * @param height_step     Height step in km
+ * @param num_workers  Number of worker processes (<= 0 for one per processor)
+ * @param values       Output array with room for
+ *                     `num_points * NUM_PROFILE * num_heights` values
+ *
+ * @return 0 on success, non-zero if any point failed
+ */
+int iri_profiles_batch(size_t num_points, const double latitude[],
+                       const double longitude[], const int year[],
+                       const int month[], const int day[], const double hour[],
+                       double height_start, double height_end,
+                       double height_step, int num_workers, double *values);
+
+/**
+ * @brief Calculate only some columns of vertical profiles for many points
+ *
+ * Same as `iri_profiles_batch()`, with the columns of
+ * `iri_profiles_select()`.
+ *
+ * @param num_points   Number of points
+ * @param latitude     Latitudes in degrees North
+ * @param longitude    Longitudes in degrees East
+ * @param year         Years (4 digits)
+ * @param month        Months (1-12)
+ * @param day          Days of month (1-31)
+ * @param hour         Local times (or Universal times + 25) in decimal hours
+ * @param height_start    Start height in km
+ * @param height_end      End height in km
+ * @param height_step     Height step in km
+ * @param columns      `IRI_COLUMN()` bits of the columns to compute
+ * @param num_workers  Number of worker processes (<= 0 for one per processor)
+ * @param values       Output array with room for
+ *                     `num_points * NUM_PROFILE * num_heights` values
+ *
+ * @return 0 on success, non-zero if any point failed
+ */
+int iri_profiles_batch_select(size_t num_points, const double latitude[],
+                              const double longitude[], const int year[],
+                              const int month[], const int day[],
+                              const double hour[], double height_start,
+                              double height_end, double height_step,
+                              unsigned columns, int num_workers,
+                              double *values);
+
+/**
+ * @brief Turn the fast column mode on or off
+ *
+ * The mode is off by default. When on, the topside ion composition (300 to
+ * 2000 km, with the default options) takes the IGRF L shell and field
+ * strength and the spherical harmonics of the ion model from knots every
+ * 100 km, computed once per profile and interpolated linearly in height,
+ * instead of at every height. A profile from 60 to 2000 km is 1.7 times
+ * faster at 100 heights and 3.5 times at 1000 (see the `fast_columns`
+ * benchmark). O+, H+, He+ and N+ differ from the exact values by at most
+ * 0.2% (they are equal at multiples of 100 km), PF/GF by at most 0.1%, and
+ * the other columns not at all.
+ *
+ * The mode is per process: worker processes of `iri_pool_run()` inherit it.
+ *
+ * @param on  Non-zero to turn the fast column mode on
+ */
+void iri_fast_columns_enable(int on);
+
+/* Timed stages of `IRI_SUB` (see `iri_get_stats()`) */
+enum iri_stage {
+  IRI_STAGE_IRI_SUB, /* Whole calls of IRI_SUB */
+  IRI_STAGE_FIELD,   /* IGRF magnetic field (IGRF_DIP, FIELDG, IGRF_SUB,
+                        GEOCGM01) */
+  IRI_STAGE_MSIS,    /* NRLMSIS neutral atmosphere (GTD7) */
+  IRI_STAGE_IONS,    /* Ion composition (CALION, FLIP CHEMION, IONDANI) */
+  IRI_STAGE_DREGION, /* D-region models (DRegion, F00) */
+  IRI_STAGE_SOCO,    /* Solar zenith angle and sunrise/sunset (SOCO) */
+  IRI_STAGE_HEIGHTS, /* Loop over the heights, including its calls */
+  IRI_NUM_STAGES
+};
+
+/* Call counts and times of the stages */
+struct iri_stats {
+  unsigned long long calls[IRI_NUM_STAGES];
+  double seconds[IRI_NUM_STAGES];
+};
+
+/**
+ * @brief Turn the stage timers on or off
+ *
+ * The timers are off by default. When on, `IRI_SUB` reads the clock around
+ * each call of each stage of `enum iri_stage` and adds the time and one call to
+ * the stage. The field, MSIS, ion, D-region and SOCO stages are disjoint
+ * parts of the whole call; the height loop includes some of their calls.
+ *
+ * The counters are per process: worker processes of `iri_pool_run()` add
+ * theirs to the parent's when they finish.
+ *
+ * @param on  Non-zero to turn the timers on
+ */
+void iri_stats_enable(int on);
+
+/**
+ * @brief Get the stage counters accumulated since the start or the last
+ * `iri_reset_stats()`
+ *
+ * @param stats  Output counters
+ */
+void iri_get_stats(struct iri_stats *stats);
+
+/**
+ * @brief Reset the stage counters to zero
+ */
+void iri_reset_stats(void);
+
+/**
+ * @brief Add counters, e.g. of another process, to the stage counters
+ *
+ * @param stats  Counters to add
+ */
+void iri_add_stats(const struct iri_stats *stats);
+
+/**
+ * @brief Name of a stage, as in the JSON output
+ *
+ * @param stage  `enum iri_stage` value
+ *
+ * @return Name, e.g. "msis", or NULL if out of range
+ */
+const char *iri_stage_name(int stage);
+
+/**
+ * @brief Write stage counters as JSON
+ *
+ * The output is an object with an object per stage holding `calls`,
+ * `seconds` and `mean_us` (microseconds per call), e.g.
+ * `{"iri_sub": {"calls": 1, "seconds": 0.0031, "mean_us": 3100.0}, ...}`.
+ *
+ * @param filename  Output filename, or NULL for stdout
+ * @param stats     Counters
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_write_stats_json(const char *filename, const struct iri_stats *stats);
+
+/**
+ * @brief Name of a profile column, as in the CSV header
+ *
+ * @param column  Column index (0 for height, up to `NUM_PROFILE - 1`)
+ *
+ * @return Name with unit, e.g. "ne(m-3)", or NULL if out of range
+ */
+const char *iri_column_name(int column);
+
 /**
  * @brief Write height and parameter values to a CSV file
  *
@@ -0,0 +1,225 @@
+/**
+ * @file
+ * @brief Load generator for the IRI service
+ *
+ * Forks client processes that send profile requests to `iri_server` and
+ * time them, then reports throughput and latency percentiles as seen by the
+ * clients, followed by the server's own counters (queue depth, busy
+ * workers, its latency percentiles).
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "iri_pool.h"
+#include "iri_service.h"
+#include "iri_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Parameters of a run */
+struct load {
+  const char *path;
+  int num_requests; /* Per client */
+  int num_points;   /* Per request */
+  int keep_alive;   /* One connection per client instead of per request */
+  unsigned columns;
+  double *latency;  /* Shared: per client, per request, in seconds */
+};
+
+/* Send the requests of one client; points move around a station grid */
+static int client_main(const struct load *load, int client) {
+  struct iri_request_point *points =
+      calloc(load->num_points, sizeof(*points));
+  const int num_heights = 54;
+  int num_columns = 0;
+  for (int j = 0; j < NUM_PROFILE; j++) {
+    num_columns += (load->columns & IRI_COLUMN(j)) != 0;
+  }
+  float *values =
+      malloc((size_t)load->num_points * num_columns * num_heights *
+             sizeof(float));
+  if (points == NULL || values == NULL) {
+    return 1;
+  }
+
+  int fd = -1;
+  int status = 0;
+  for (int r = 0; r < load->num_requests && status == 0; r++) {
+    for (int p = 0; p < load->num_points; p++) {
+      int k = (client * load->num_requests + r) * load->num_points + p;
+      points[p] = (struct iri_request_point){
+          .latitude = 30.0 + 2.0 * (k % 8),
+          .longitude = -80.0 + 3.0 * (k / 8 % 8),
+          .hour = k % 24,
+          .year = 2021,
+          .month = 3,
+          .day = 3,
+      };
+    }
+    double t0 = now();
+    if (fd < 0) {
+      fd = iri_client_connect(load->path);
+      if (fd < 0) {
+        status = 1;
+        break;
+      }
+    }
+    status = iri_client_profiles(fd, load->num_points, points, 70.0, 10.0,
+                                 num_heights, load->columns, values);
+    if (!load->keep_alive) {
+      close(fd);
+      fd = -1;
+    }
+    load->latency[(size_t)client * load->num_requests + r] = now() - t0;
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  free(points);
+  free(values);
+  return status;
+}
+
+void print_usage(const char *progname) {
+  printf("Usage: %s [options]\n", progname);
+  printf("Options:\n");
+  printf("  -s|--socket <path>    Socket path (default: %s)\n",
+         IRI_SERVICE_SOCKET);
+  printf("  -c|--clients <n>      Concurrent clients (default: 4)\n");
+  printf("  -n|--requests <n>     Requests per client (default: 50)\n");
+  printf("  -p|--points <n>       Points per request (default: 1)\n");
+  printf("  -P|--columns <list>   Comma-separated columns, e.g. height,ne "
+         "(default: all)\n");
+  printf("  -k|--keep-alive       One connection per client (default: one "
+         "per request)\n");
+  printf("  -h|--help             Show this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+  struct load load = {
+      .path = IRI_SERVICE_SOCKET,
+      .num_requests = 50,
+      .num_points = 1,
+      .keep_alive = 0,
+      .columns = IRI_COLUMNS_ALL,
+  };
+  int num_clients = 4;
+
+  for (int i = 1; i < argc; i++) {
+    if (((strcmp(argv[i], "-s") == 0) ||
+         (strcmp(argv[i], "--socket") == 0)) &&
+        i + 1 < argc) {
+      load.path = argv[++i];
+    } else if (((strcmp(argv[i], "-c") == 0) ||
+                (strcmp(argv[i], "--clients") == 0)) &&
+               i + 1 < argc) {
+      num_clients = atoi(argv[++i]);
+    } else if (((strcmp(argv[i], "-n") == 0) ||
+                (strcmp(argv[i], "--requests") == 0)) &&
+               i + 1 < argc) {
+      load.num_requests = atoi(argv[++i]);
+    } else if (((strcmp(argv[i], "-p") == 0) ||
+                (strcmp(argv[i], "--points") == 0)) &&
+               i + 1 < argc) {
+      load.num_points = atoi(argv[++i]);
+    } else if (((strcmp(argv[i], "-P") == 0) ||
+                (strcmp(argv[i], "--columns") == 0)) &&
+               i + 1 < argc) {
+      if (iri_parse_columns(argv[++i], &load.columns) != 0) {
+        return 1;
+      }
+    } else if ((strcmp(argv[i], "-k") == 0) ||
+               (strcmp(argv[i], "--keep-alive") == 0)) {
+      load.keep_alive = 1;
+    } else if ((strcmp(argv[i], "-h") == 0) ||
+               (strcmp(argv[i], "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else {
+      printf("Unknown option: %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (num_clients < 1 || load.num_requests < 1 || load.num_points < 1 ||
+      load.num_points > (int)IRI_SERVICE_MAX_POINTS) {
+    fprintf(stderr, "Error: Invalid load parameters\n");
+    return 1;
+  }
+
+  size_t total = (size_t)num_clients * load.num_requests;
+  size_t size = total * sizeof(double);
+  load.latency = iri_pool_shared_alloc(size);
+  if (load.latency == NULL) {
+    return 1;
+  }
+
+  fflush(NULL);
+  double t0 = now();
+  int status = 0;
+  for (int c = 0; c < num_clients; c++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("Failed to fork client");
+      status = 1;
+      break;
+    }
+    if (pid == 0) {
+      _exit(client_main(&load, c));
+    }
+  }
+  int wstatus;
+  while (wait(&wstatus) > 0) {
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+      status = 1;
+    }
+  }
+  double elapsed = now() - t0;
+
+  qsort(load.latency, total, sizeof(double), compare_doubles);
+  printf("%d clients x %d requests x %d points, %s\n", num_clients,
+         load.num_requests, load.num_points,
+         load.keep_alive ? "one connection per client"
+                         : "one connection per request");
+  printf("throughput: %.1f requests/s, %.1f profiles/s\n", total / elapsed,
+         total * load.num_points / elapsed);
+  printf("client latency (ms): median %.3f, 90%% %.3f, 99%% %.3f, max %.3f\n",
+         load.latency[total / 2] * 1e3, load.latency[total * 90 / 100] * 1e3,
+         load.latency[total * 99 / 100] * 1e3, load.latency[total - 1] * 1e3);
+  iri_pool_shared_free(load.latency, size);
+
+  int fd = iri_client_connect(load.path);
+  struct iri_service_stats st;
+  if (fd < 0 || iri_client_stats(fd, &st) != 0) {
+    return 1;
+  }
+  close(fd);
+  printf("server: %u workers (%u busy), queue depth %u (max %u), "
+         "%llu connections, %llu requests, %llu profiles, %llu errors, "
+         "up %.1f s\n",
+         st.num_workers, st.busy_workers, st.queue_depth, st.max_queue_depth,
+         (unsigned long long)st.connections, (unsigned long long)st.requests,
+         (unsigned long long)st.points, (unsigned long long)st.errors,
+         st.uptime);
+  printf("server latency (ms): median %.3f, 90%% %.3f, 99%% %.3f, max %.3f\n",
+         st.latency[0], st.latency[1], st.latency[2], st.latency[3]);
+  printf("queue wait (ms):     median %.3f, 90%% %.3f, 99%% %.3f, max %.3f\n",
+         st.wait[0], st.wait[1], st.wait[2], st.wait[3]);
+  return status;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @brief Program to pack the IRI data files into a binary blob
+ *
+ * This program parses the ASCII data files in the data directory and
+ * writes the resulting COMMON blocks to a blob that `iri_init()` maps
+ * instead, or checks that an existing blob is identical to what the ASCII
+ * files give.
+ */
+
+#include "iri_data.h"
+#include <stdio.h>
+#include <string.h>
+
+void print_usage(const char *progname) {
+  printf("Usage: %s [options]\n", progname);
+  printf("Options:\n");
+  printf("  -d|--data-dir <dir>  Directory with the IRI data files (default: "
+         "current\n"
+         "                       directory)\n");
+  printf("  -o|--out <filename>  Blob file (default: %s in the data "
+         "directory)\n",
+         IRI_DATA_BLOB);
+  printf("  -c|--check           Compare the blob with the ASCII files "
+         "instead of\n"
+         "                       writing it\n");
+  printf("  -h|--help            Show this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *data_dir = NULL;
+  const char *output_file = NULL;
+  char default_file[IRI_DATA_DIR_MAX + 64];
+  int check = 0;
+
+  /* Parse command line arguments */
+  for (int i = 1; i < argc; i++) {
+    if (((strcmp(argv[i], "-d") == 0) ||
+         (strcmp(argv[i], "--data-dir") == 0)) &&
+        i + 1 < argc) {
+      data_dir = argv[++i];
+    } else if (((strcmp(argv[i], "-o") == 0) ||
+                (strcmp(argv[i], "--out") == 0)) &&
+               i + 1 < argc) {
+      output_file = argv[++i];
+    } else if ((strcmp(argv[i], "-c") == 0) ||
+               (strcmp(argv[i], "--check") == 0)) {
+      check = 1;
+    } else if ((strcmp(argv[i], "-h") == 0) ||
+               (strcmp(argv[i], "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else {
+      printf("Unknown option: %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (iri_data_set_dir(data_dir) != 0) {
+    return 1;
+  }
+  if (output_file == NULL) {
+    iri_data_path(IRI_DATA_BLOB, default_file, sizeof(default_file));
+    output_file = default_file;
+  }
+
+  if (iri_data_load_ascii() != 0) {
+    fprintf(stderr, "Failed to read IRI data files\n");
+    return 1;
+  }
+
+  if (check) {
+    if (iri_data_compare(output_file) != 0) {
+      return 1;
+    }
+    printf("%s matches the ASCII data files\n", output_file);
+    return 0;
+  }
+  return iri_data_save(output_file);
+}
@@ -0,0 +1,143 @@
+/**
+ * @file
+ * @brief Implementation of the process-based IRI worker pool
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "iri_pool.h"
+#include "iri_interface.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Shared state for distributing chunks of work among the workers */
+struct pool_state {
+  size_t next;  /* Index of the next unclaimed item */
+  size_t done;  /* Number of items whose work function call returned */
+  int failures;  /* Number of failed work function calls */
+};
+
+int iri_pool_workers(int num_workers, size_t num_items) {
+  if (num_workers <= 0) {
+    long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+    num_workers = nproc > 0 ? (int)nproc : 1;
+  }
+  if ((size_t)num_workers > num_items) {
+    num_workers = num_items > 0 ? (int)num_items : 1;
+  }
+  return num_workers;
+}
+
+void *iri_pool_shared_alloc(size_t size) {
+  void *ptr = mmap(NULL, size > 0 ? size : 1, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+void iri_pool_shared_free(void *ptr, size_t size) {
+  if (ptr != NULL) {
+    munmap(ptr, size > 0 ? size : 1);
+  }
+}
+
+/* Claim and process chunks until the items run out */
+static void pool_work(struct pool_state *state, size_t num_items,
+                      size_t chunk, iri_pool_fn fn, void *ctx) {
+  for (;;) {
+    size_t begin = __atomic_fetch_add(&state->next, chunk, __ATOMIC_RELAXED);
+    if (begin >= num_items) {
+      break;
+    }
+    size_t end = begin + chunk < num_items ? begin + chunk : num_items;
+    if (fn(begin, end, ctx) != 0) {
+      __atomic_fetch_add(&state->failures, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&state->done, end - begin, __ATOMIC_RELAXED);
+  }
+}
+
+int iri_pool_run(size_t num_items, int num_workers, size_t chunk,
+                 iri_pool_fn fn, void *ctx) {
+  if (num_items == 0) {
+    return 0;
+  }
+  num_workers = iri_pool_workers(num_workers, num_items);
+  if (chunk == 0) {
+    chunk = num_items / ((size_t)num_workers * 8);
+    if (chunk == 0) {
+      chunk = 1;
+    }
+  }
+
+  /* Serial case: no need for processes */
+  if (num_workers == 1) {
+    return fn(0, num_items, ctx);
+  }
+
+  struct pool_state *state = iri_pool_shared_alloc(sizeof(*state));
+  if (state == NULL) {
+    perror("Failed to allocate shared pool state");
+    return 1;
+  }
+
+  /* Stage counters of each worker, added to the parent's at the end */
+  size_t stats_size = num_workers * sizeof(struct iri_stats);
+  struct iri_stats *stats = iri_pool_shared_alloc(stats_size);
+  pid_t *pids = malloc(num_workers * sizeof(*pids));
+  if (stats == NULL || pids == NULL) {
+    free(pids);
+    iri_pool_shared_free(stats, stats_size);
+    iri_pool_shared_free(state, sizeof(*state));
+    return 1;
+  }
+
+  /* Avoid duplicating buffered output in the children */
+  fflush(NULL);
+
+  int forked = 0;
+  int status = 0;
+  for (int i = 0; i < num_workers; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("Failed to fork IRI worker");
+      status = 1;
+      break;
+    }
+    if (pid == 0) {
+      iri_reset_stats();
+      pool_work(state, num_items, chunk, fn, ctx);
+      iri_get_stats(&stats[i]);
+      /* Skip exit handlers, which would flush the parent's stdio buffers */
+      _exit(0);
+    }
+    pids[forked++] = pid;
+  }
+
+  /* Reap the workers; any abnormal exit means lost items */
+  for (int i = 0; i < forked; i++) {
+    int wstatus;
+    if (waitpid(pids[i], &wstatus, 0) < 0 || !WIFEXITED(wstatus) ||
+        WEXITSTATUS(wstatus) != 0) {
+      status = 1;
+    }
+    iri_add_stats(&stats[i]);
+  }
+
+  /* If not all workers could be started, finish the rest here */
+  if (forked < num_workers) {
+    pool_work(state, num_items, chunk, fn, ctx);
+  }
+  /* A Fortran STOP exits a worker with status 0, losing its chunk */
+  if (state->failures > 0 || state->done != num_items) {
+    status = 1;
+  }
+
+  free(pids);
+  iri_pool_shared_free(stats, stats_size);
+  iri_pool_shared_free(state, sizeof(*state));
+  return status;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @brief Process-based worker pool for running the IRI model in parallel
+ *
+ * The Fortran IRI code keeps its state in COMMON blocks and SAVEd locals,
+ * so it cannot be called from several threads at once. Instead, we fork
+ * worker processes after the model has been initialized (so they share the
+ * loaded data copy-on-write) and have them write their results to memory
+ * that is shared with the parent.
+ */
+
+#ifndef IRI_POOL_H
+#define IRI_POOL_H
+
+#include <stddef.h>
+
+/**
+ * @brief Work function run by the pool for a range of items
+ *
+ * @param begin  Index of the first item to process
+ * @param end    One past the index of the last item to process
+ * @param ctx    Caller context passed through from `iri_pool_run()`
+ *
+ * @return 0 on success, non-zero on error
+ */
+typedef int (*iri_pool_fn)(size_t begin, size_t end, void *ctx);
+
+/**
+ * @brief Resolve the number of workers to use
+ *
+ * @param num_workers  Requested number of workers (<= 0 for one per online
+ *                     processor)
+ * @param num_items    Number of items to process (there is no point in
+ *                     having more workers than items)
+ *
+ * @return Number of workers, at least 1
+ */
+int iri_pool_workers(int num_workers, size_t num_items);
+
+/**
+ * @brief Allocate memory that is shared between the parent and the workers
+ *
+ * @param size  Number of bytes
+ *
+ * @return Pointer to zeroed memory, or NULL on failure
+ */
+void *iri_pool_shared_alloc(size_t size);
+
+/**
+ * @brief Free memory allocated with `iri_pool_shared_alloc()`
+ */
+void iri_pool_shared_free(void *ptr, size_t size);
+
+/**
+ * @brief Process `num_items` items with `fn`, spread over worker processes
+ *
+ * Workers claim chunks of `chunk` items at a time from a shared counter,
+ * so uneven per-item cost is balanced. With a single worker, `fn` runs in
+ * the calling process and no fork happens. With more than one, results must
+ * be written to memory from `iri_pool_shared_alloc()` to be visible to the
+ * caller. The workers' stage counters (`iri_get_stats()`) are added to the
+ * caller's.
+ *
+ * @param num_items    Number of items
+ * @param num_workers  Number of worker processes (see `iri_pool_workers()`)
+ * @param chunk        Number of items claimed at a time (0 for automatic)
+ * @param fn           Work function
+ * @param ctx          Context passed to `fn`
+ *
+ * @return 0 if all items were processed successfully, non-zero otherwise
+ * (including items of a worker that exited before finishing its chunk,
+ * such as on a Fortran `STOP`)
+ */
+int iri_pool_run(size_t num_items, int num_workers, size_t chunk,
+                 iri_pool_fn fn, void *ctx);
+
+#endif /* IRI_POOL_H */
@@ -0,0 +1,897 @@
+/**
+ * @file
+ * @brief Python extension module `iri_edp`: IRI profiles, and coord-tran's
+ * g2r and r2g, over arrays
+ *
+ * The functions take scalars, NumPy arrays or any other objects with the
+ * buffer protocol (one-dimensional, of any number type and stride), and
+ * read them in place; scalars and arrays of one value are repeated for the
+ * length of the others. Results are written in place into `out`, or into a
+ * new NumPy array. The GIL is released while computing, so other Python
+ * threads run meanwhile; the Fortran model is not thread-safe, so IRI calls
+ * from different threads take turns, while g2r and r2g run concurrently.
+ *
+ * Build with `make python` (see the README).
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pythread.h>
+
+#include "iri_data.h"
+#include "iri_field.h"
+#include "iri_interface.h"
+#include "iri_writer.h"
+#include "lib.h"
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Serializes the IRI calls (and the initialization) */
+static PyThread_type_lock iri_lock;
+
+/* Whether the IRI data has been loaded (with iri_lock) */
+static int iri_ready;
+
+/* numpy.empty, imported when first needed */
+static PyObject *numpy_empty;
+
+/* A number argument: a scalar, or a one-dimensional buffer */
+struct arg {
+  Py_buffer view; /* view.obj is NULL for a scalar */
+  double scalar;
+  char kind;     /* 'f' (float), 'i' (signed) or 'u' (unsigned) */
+  Py_ssize_t n;  /* Number of values (1 for a scalar) */
+};
+
+static int little_endian(void) {
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+/**
+ * Kind of a buffer's struct-module format, if it is a single number in the
+ * native byte order ('f', 'i' or 'u'), else 0
+ */
+static char format_kind(const char *format, Py_ssize_t itemsize) {
+  if (format == NULL) {
+    return itemsize == 1 ? 'u' : 0; /* Unsigned bytes */
+  }
+  if (*format != '\0' && strchr("@=<>!", *format) != NULL) {
+    int big = *format == '>' || *format == '!';
+    if (*format != '@' && *format != '=' && big == little_endian()) {
+      return 0;
+    }
+    format++;
+  }
+  if (format[0] == '\0' || format[1] != '\0') {
+    return 0;
+  }
+  if (strchr("fd", *format) != NULL && (itemsize == 4 || itemsize == 8)) {
+    return 'f';
+  }
+  if (strchr("bhilqn", *format) != NULL) {
+    return 'i';
+  }
+  if (strchr("BHILQN?", *format) != NULL) {
+    return 'u';
+  }
+  return 0;
+}
+
+/**
+ * Value i of an argument (the only value, if it has one)
+ */
+static double arg_value(const struct arg *a, Py_ssize_t i) {
+  if (a->view.obj == NULL) {
+    return a->scalar;
+  }
+  const char *p = a->view.buf;
+  if (a->n > 1) {
+    p += i * a->view.strides[0]; /* No strides for zero dimensions */
+  }
+  switch (a->kind * 16 + (int)a->view.itemsize) {
+  case 'f' * 16 + 4:
+    return *(const float *)p;
+  case 'f' * 16 + 8:
+    return *(const double *)p;
+  case 'i' * 16 + 1:
+    return *(const int8_t *)p;
+  case 'i' * 16 + 2:
+    return *(const int16_t *)p;
+  case 'i' * 16 + 4:
+    return *(const int32_t *)p;
+  case 'i' * 16 + 8:
+    return (double)*(const int64_t *)p;
+  case 'u' * 16 + 1:
+    return *(const uint8_t *)p;
+  case 'u' * 16 + 2:
+    return *(const uint16_t *)p;
+  case 'u' * 16 + 4:
+    return *(const uint32_t *)p;
+  default:
+    return (double)*(const uint64_t *)p;
+  }
+}
+
+/**
+ * The values of an argument, if they are contiguous doubles, else NULL
+ */
+static const double *arg_doubles(const struct arg *a) {
+  return a->view.obj != NULL && a->kind == 'f' && a->view.itemsize == 8 &&
+                 (a->n == 1 || a->view.strides[0] == sizeof(double))
+             ? a->view.buf
+             : NULL;
+}
+
+/**
+ * Read an argument's buffer (or scalar) without copying it
+ *
+ * @return 0 on success, -1 with an exception set
+ */
+static int arg_parse(PyObject *obj, const char *name, struct arg *a) {
+  memset(a, 0, sizeof(*a));
+  a->n = 1;
+  if (!PyObject_CheckBuffer(obj)) {
+    a->scalar = PyFloat_AsDouble(obj);
+    if (a->scalar == -1.0 && PyErr_Occurred()) {
+      PyErr_Format(PyExc_TypeError, "%s must be a number or an array",
+                   name);
+      return -1;
+    }
+    return 0;
+  }
+  if (PyObject_GetBuffer(obj, &a->view, PyBUF_STRIDES | PyBUF_FORMAT) != 0) {
+    return -1;
+  }
+  a->kind = format_kind(a->view.format, a->view.itemsize);
+  if (a->kind == 0 || a->view.itemsize > 8 || a->view.ndim > 1 ||
+      (a->view.itemsize & (a->view.itemsize - 1)) != 0) {
+    PyBuffer_Release(&a->view);
+    PyErr_Format(PyExc_TypeError,
+                 "%s must be a number or a one-dimensional array of numbers",
+                 name);
+    return -1;
+  }
+  if (a->view.ndim == 0) {
+    /* A NumPy scalar or zero-dimensional array */
+    a->scalar = arg_value(a, 0);
+    PyBuffer_Release(&a->view);
+    return 0;
+  }
+  a->n = a->view.shape[0];
+  return 0;
+}
+
+static void arg_release(struct arg *args, int num_args) {
+  for (int k = 0; k < num_args; k++) {
+    if (args[k].view.obj != NULL) {
+      PyBuffer_Release(&args[k].view);
+    }
+  }
+}
+
+/**
+ * Parse arguments and find their common length
+ *
+ * @param n          Output length (the arrays', or 1)
+ * @param any_array  Output: whether any argument is an array
+ *
+ * @return 0 on success, -1 with an exception set (and nothing to release)
+ */
+static int args_parse(int num_args, PyObject *const objs[],
+                      const char *const names[], struct arg *args,
+                      Py_ssize_t *n, int *any_array) {
+  *n = 1;
+  *any_array = 0;
+  for (int k = 0; k < num_args; k++) {
+    if (arg_parse(objs[k], names[k], &args[k]) != 0) {
+      arg_release(args, k);
+      return -1;
+    }
+    if (args[k].view.obj == NULL) {
+      continue;
+    }
+    if (args[k].n != 1 && *n != 1 && args[k].n != *n) {
+      arg_release(args, k + 1);
+      PyErr_Format(PyExc_ValueError,
+                   "%s has %zd values, but an earlier argument %zd",
+                   names[k], args[k].n, *n);
+      return -1;
+    }
+    if (args[k].n != 1) {
+      *n = args[k].n;
+    }
+    *any_array = 1;
+  }
+  return 0;
+}
+
+/**
+ * Get the buffer to write n doubles to: `out` if given (a writable,
+ * C-contiguous float64 array of that many values), else a new NumPy array
+ * of the shape
+ *
+ * @return New reference to the array, or NULL with an exception set
+ */
+static PyObject *output(PyObject *out, int ndim, const Py_ssize_t shape[],
+                        Py_buffer *view) {
+  Py_ssize_t n = 1;
+  for (int d = 0; d < ndim; d++) {
+    n *= shape[d];
+  }
+  PyObject *array;
+  if (out != NULL && out != Py_None) {
+    Py_INCREF(out);
+    array = out;
+  } else {
+    if (numpy_empty == NULL) {
+      PyObject *numpy = PyImport_ImportModule("numpy");
+      if (numpy == NULL) {
+        return NULL;
+      }
+      numpy_empty = PyObject_GetAttrString(numpy, "empty");
+      Py_DECREF(numpy);
+      if (numpy_empty == NULL) {
+        return NULL;
+      }
+    }
+    PyObject *dims = PyTuple_New(ndim);
+    if (dims == NULL) {
+      return NULL;
+    }
+    for (int d = 0; d < ndim; d++) {
+      PyObject *dim = PyLong_FromSsize_t(shape[d]);
+      if (dim == NULL) {
+        Py_DECREF(dims);
+        return NULL;
+      }
+      PyTuple_SET_ITEM(dims, d, dim);
+    }
+    array = PyObject_CallOneArg(numpy_empty, dims);
+    Py_DECREF(dims);
+    if (array == NULL) {
+      return NULL;
+    }
+  }
+  if (PyObject_GetBuffer(array, view,
+                         PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS |
+                             PyBUF_FORMAT) != 0) {
+    Py_DECREF(array);
+    return NULL;
+  }
+  if (format_kind(view->format, view->itemsize) != 'f' ||
+      view->itemsize != sizeof(double) || view->len != n * view->itemsize) {
+    PyBuffer_Release(view);
+    Py_DECREF(array);
+    PyErr_Format(PyExc_ValueError,
+                 "out must be a contiguous float64 array of %zd values", n);
+    return NULL;
+  }
+  return array;
+}
+
+/**
+ * Load the IRI data from a directory (with iri_lock, without the GIL)
+ */
+static int load_data(const char *data_dir) {
+  int status = iri_init_with_dir(data_dir);
+  iri_ready = status == 0;
+  return status;
+}
+
+/**
+ * Load the IRI data from the module's directory, unless it is loaded
+ *
+ * @return 0 on success, -1 with an exception set
+ */
+static int ensure_data(PyObject *module) {
+  if (iri_ready) {
+    return 0;
+  }
+  PyObject *filename = PyModule_GetFilenameObject(module);
+  if (filename == NULL) {
+    return -1;
+  }
+  const char *path = PyUnicode_AsUTF8(filename);
+  char *dir = path != NULL ? strdup(path) : NULL;
+  Py_DECREF(filename);
+  if (dir == NULL) {
+    if (path != NULL) {
+      PyErr_NoMemory();
+    }
+    return -1;
+  }
+  char *slash = strrchr(dir, '/');
+  if (slash != NULL) {
+    *slash = '\0';
+  } else {
+    dir[0] = '\0';
+  }
+  int status = 0;
+  Py_BEGIN_ALLOW_THREADS
+  PyThread_acquire_lock(iri_lock, WAIT_LOCK);
+  if (!iri_ready) {
+    status = load_data(dir);
+  }
+  PyThread_release_lock(iri_lock);
+  Py_END_ALLOW_THREADS
+  if (status != 0) {
+    PyErr_Format(PyExc_OSError, "Failed to read the IRI data files in '%s'",
+                 dir);
+  }
+  free(dir);
+  return status != 0 ? -1 : 0;
+}
+
+static PyObject *py_init(PyObject *module, PyObject *args, PyObject *kwargs) {
+  static char *kwlist[] = {"data_dir", NULL};
+  const char *data_dir = NULL;
+  (void)module;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|z", kwlist, &data_dir)) {
+    return NULL;
+  }
+  int status;
+  Py_BEGIN_ALLOW_THREADS
+  PyThread_acquire_lock(iri_lock, WAIT_LOCK);
+  status = load_data(data_dir);
+  PyThread_release_lock(iri_lock);
+  Py_END_ALLOW_THREADS
+  if (status != 0) {
+    PyErr_Format(PyExc_OSError, "Failed to read the IRI data files in '%s'",
+                 data_dir != NULL ? data_dir : ".");
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
+/**
+ * Number of heights from a start to an end (inclusive) by a step, like
+ * iri_num_heights() but without its limit of MAX_HEIGHT
+ *
+ * @return Number of heights, or -1 with an exception set
+ */
+static Py_ssize_t num_heights(double start, double end, double step) {
+  double n = floor((end - start) / step) + 1.0;
+  if (!(step > 0.0) || !(n >= 1.0) || n > INT_MAX) {
+    PyErr_SetString(PyExc_ValueError,
+                    "Heights need a positive step and end >= start");
+    return -1;
+  }
+  return (Py_ssize_t)n;
+}
+
+static PyObject *py_iri_heights(PyObject *module, PyObject *args) {
+  double start, end, step;
+  (void)module;
+  if (!PyArg_ParseTuple(args, "ddd", &start, &end, &step)) {
+    return NULL;
+  }
+  Py_ssize_t n = num_heights(start, end, step);
+  if (n < 0) {
+    return NULL;
+  }
+  Py_buffer view;
+  PyObject *array = output(NULL, 1, &n, &view);
+  if (array == NULL) {
+    return NULL;
+  }
+  double *heights = view.buf;
+  for (Py_ssize_t k = 0; k < n; k++) {
+    heights[k] = start + k * step;
+  }
+  PyBuffer_Release(&view);
+  return array;
+}
+
+/**
+ * Column mask from None (all), an int of IRI_COLUMN() bits, or a string of
+ * names as for the CLI's --columns
+ *
+ * @return 0 on success, -1 with an exception set
+ */
+static int parse_columns(PyObject *obj, unsigned *columns) {
+  if (obj == NULL || obj == Py_None) {
+    *columns = IRI_COLUMNS_ALL;
+    return 0;
+  }
+  if (PyUnicode_Check(obj)) {
+    const char *list = PyUnicode_AsUTF8(obj);
+    if (list == NULL) {
+      return -1;
+    }
+    if (iri_parse_columns(list, columns) != 0) {
+      PyErr_Format(PyExc_ValueError, "Invalid columns '%s'", list);
+      return -1;
+    }
+    return 0;
+  }
+  unsigned long mask = PyLong_AsUnsignedLong(obj);
+  if (PyErr_Occurred()) {
+    return -1;
+  }
+  if (mask == 0 || (mask & ~(unsigned long)IRI_COLUMNS_ALL) != 0) {
+    PyErr_SetString(PyExc_ValueError, "Invalid column mask");
+    return -1;
+  }
+  *columns = (unsigned)mask;
+  return 0;
+}
+
+/* Inputs of profiles: latitude, longitude, year, month, day, hour */
+#define NUM_POINT_ARGS 6
+
+static const char *const point_names[NUM_POINT_ARGS] = {
+    "latitude", "longitude", "year", "month", "day", "hour"};
+
+/* A profile run: the points, their heights and the output */
+struct profiles {
+  const struct arg *args; /* NUM_POINT_ARGS */
+  Py_ssize_t n;
+  double height_start, height_step;
+  const double *heights; /* Instead of the start and step, if not NULL */
+  int num_heights;
+  unsigned columns;
+  double *values;
+  Py_ssize_t failed; /* Index of the point that failed */
+};
+
+/**
+ * Check the dates of the points: the model stops the interpreter on years
+ * without IGRF coefficients, and returns nothing for months without indices
+ * or invalid dates (with the data loaded, before taking iri_lock)
+ *
+ * @return 0 if all are valid, -1 with a ValueError set
+ */
+static int check_dates(const struct arg *a, Py_ssize_t n) {
+  for (Py_ssize_t i = 0; i < n; i++) {
+    double year = arg_value(&a[2], i), month = arg_value(&a[3], i),
+           day = arg_value(&a[4], i), decimal_year;
+    /* Within the range of int before converting (NaN fails too) */
+    if (!(fabs(year) < 1e6 && fabs(month) < 1e6 && fabs(day) < 1e6) ||
+        iri_decimal_year((int)year, (int)month, (int)day, &decimal_year) !=
+            0) {
+      PyErr_Format(PyExc_ValueError, "Invalid date at point %zd", i);
+      return -1;
+    }
+    if (iri_data_igrf_covers(decimal_year) != 0 ||
+        iri_data_indices_cover((int)year, (int)month) != 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "The IRI data does not cover the date at point %zd", i);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Compute the profiles one by one into the output (with iri_lock, without
+ * the GIL)
+ */
+static int profiles_serial(struct profiles *p) {
+  const struct arg *a = p->args;
+  const Py_ssize_t size = (Py_ssize_t)NUM_PROFILE * p->num_heights;
+  for (Py_ssize_t i = 0; i < p->n; i++) {
+    double *v = p->values + i * size;
+    /* iri_profiles_ws() doesn't touch the rows of the other columns */
+    for (int j = 1; j < NUM_PROFILE; j++) {
+      if (!(p->columns & IRI_COLUMN(j))) {
+        for (int k = 0; k < p->num_heights; k++) {
+          v[j * p->num_heights + k] = -1.0;
+        }
+      }
+    }
+    double latitude = arg_value(&a[0], i), longitude = arg_value(&a[1], i);
+    int year = (int)arg_value(&a[2], i), month = (int)arg_value(&a[3], i),
+        day = (int)arg_value(&a[4], i);
+    double hour = arg_value(&a[5], i);
+    int status =
+        p->heights != NULL
+            ? iri_profiles_heights(NULL, latitude, longitude, year, month,
+                                   day, hour, p->num_heights, p->heights,
+                                   p->columns, v)
+            : iri_profiles_ws(NULL, latitude, longitude, year, month, day,
+                              hour, p->height_start, p->height_step,
+                              p->num_heights, p->columns, v);
+    if (status != 0) {
+      p->failed = i;
+      return status;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Compute the profiles with iri_profiles_batch_select()'s worker processes,
+ * which take arrays of each input (with iri_lock, without the GIL)
+ */
+static int profiles_batch(struct profiles *p, double height_end,
+                          int num_workers) {
+  size_t n = (size_t)p->n;
+  double *d = malloc(3 * n * sizeof(double));
+  int *t = malloc(3 * n * sizeof(int));
+  int status = 1;
+  if (d != NULL && t != NULL) {
+    for (size_t i = 0; i < n; i++) {
+      d[i] = arg_value(&p->args[0], i);
+      d[n + i] = arg_value(&p->args[1], i);
+      d[2 * n + i] = arg_value(&p->args[5], i);
+      for (int k = 0; k < 3; k++) {
+        t[k * n + i] = (int)arg_value(&p->args[2 + k], i);
+      }
+    }
+    status = iri_profiles_batch_select(
+        n, d, d + n, t, t + n, t + 2 * n, d + 2 * n, p->height_start,
+        height_end, p->height_step, p->columns, num_workers, p->values);
+  }
+  free(d);
+  free(t);
+  p->failed = -1;
+  return status;
+}
+
+/**
+ * Parse the points and the output, run the profiles, and return the output
+ */
+static PyObject *run_profiles(PyObject *module, PyObject *const objs[],
+                              struct profiles *p, PyObject *columns,
+                              PyObject *out, double height_end,
+                              int num_workers) {
+  struct arg args[NUM_POINT_ARGS];
+  int any_array;
+  if (parse_columns(columns, &p->columns) != 0 ||
+      args_parse(NUM_POINT_ARGS, objs, point_names, args, &p->n,
+                 &any_array) != 0) {
+    return NULL;
+  }
+  p->args = args;
+  if (num_workers != 1 &&
+      (p->heights != NULL || p->num_heights > MAX_HEIGHT)) {
+    arg_release(args, NUM_POINT_ARGS);
+    PyErr_Format(PyExc_ValueError,
+                 "workers need a start, end and step of at most %d heights",
+                 MAX_HEIGHT);
+    return NULL;
+  }
+  if (ensure_data(module) != 0 || check_dates(args, p->n) != 0) {
+    arg_release(args, NUM_POINT_ARGS);
+    return NULL;
+  }
+
+  Py_ssize_t shape[3] = {p->n, NUM_PROFILE, p->num_heights};
+  Py_buffer view;
+  PyObject *array =
+      output(out, any_array ? 3 : 2, any_array ? shape : shape + 1, &view);
+  if (array == NULL) {
+    arg_release(args, NUM_POINT_ARGS);
+    return NULL;
+  }
+  p->values = view.buf;
+  int status;
+  Py_BEGIN_ALLOW_THREADS
+  PyThread_acquire_lock(iri_lock, WAIT_LOCK);
+  status = num_workers != 1 && p->n > 1
+               ? profiles_batch(p, height_end, num_workers)
+               : profiles_serial(p);
+  PyThread_release_lock(iri_lock);
+  Py_END_ALLOW_THREADS
+  PyBuffer_Release(&view);
+  arg_release(args, NUM_POINT_ARGS);
+  if (status != 0) {
+    Py_DECREF(array);
+    if (p->failed >= 0) {
+      PyErr_Format(PyExc_RuntimeError, "IRI failed at point %zd",
+                   p->failed);
+    } else {
+      PyErr_SetString(PyExc_RuntimeError, "IRI failed");
+    }
+    return NULL;
+  }
+  return array;
+}
+
+static PyObject *py_iri_profiles(PyObject *module, PyObject *args,
+                                 PyObject *kwargs) {
+  static char *kwlist[] = {"latitude",     "longitude",  "year",
+                           "month",        "day",        "hour",
+                           "height_start", "height_end", "height_step",
+                           "columns",      "workers",    "out",
+                           NULL};
+  PyObject *objs[NUM_POINT_ARGS], *columns = NULL, *out = NULL;
+  double height_end;
+  int num_workers = 1;
+  struct profiles p = {0};
+  if (!PyArg_ParseTupleAndKeywords(
+          args, kwargs, "OOOOOOddd|$OiO", kwlist, &objs[0], &objs[1],
+          &objs[2], &objs[3], &objs[4], &objs[5], &p.height_start,
+          &height_end, &p.height_step, &columns, &num_workers, &out)) {
+    return NULL;
+  }
+  Py_ssize_t n = num_heights(p.height_start, height_end, p.height_step);
+  if (n < 0) {
+    return NULL;
+  }
+  p.num_heights = (int)n;
+  return run_profiles(module, objs, &p, columns, out, height_end,
+                      num_workers);
+}
+
+static PyObject *py_iri_profiles_heights(PyObject *module, PyObject *args,
+                                         PyObject *kwargs) {
+  static char *kwlist[] = {"latitude", "longitude", "year",    "month",
+                           "day",      "hour",      "heights", "columns",
+                           "out",      NULL};
+  PyObject *objs[NUM_POINT_ARGS], *heights_obj, *columns = NULL, *out = NULL;
+  struct profiles p = {0};
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOOOOO|$OO", kwlist,
+                                   &objs[0], &objs[1], &objs[2], &objs[3],
+                                   &objs[4], &objs[5], &heights_obj,
+                                   &columns, &out)) {
+    return NULL;
+  }
+  struct arg h;
+  if (arg_parse(heights_obj, "heights", &h) != 0) {
+    return NULL;
+  }
+  if (h.n > INT_MAX) {
+    arg_release(&h, 1);
+    PyErr_SetString(PyExc_ValueError, "Too many heights");
+    return NULL;
+  }
+  /* The model takes contiguous doubles; others are converted */
+  double *copy = NULL;
+  p.heights = arg_doubles(&h);
+  if (p.heights == NULL) {
+    copy = malloc(h.n * sizeof(double));
+    if (copy == NULL) {
+      arg_release(&h, 1);
+      return PyErr_NoMemory();
+    }
+    for (Py_ssize_t k = 0; k < h.n; k++) {
+      copy[k] = arg_value(&h, k);
+    }
+    p.heights = copy;
+  }
+  p.num_heights = (int)h.n;
+  PyObject *result = run_profiles(module, objs, &p, columns, out, 0.0, 1);
+  free(copy);
+  arg_release(&h, 1);
+  return result;
+}
+
+/* A coordinate conversion of four inputs to two outputs */
+struct conversion {
+  char *kwlist[7];
+  int initial[2]; /* Inputs of the initial point (lon, lat) */
+  int (*point)(int wgs84, const double in[4], double out[2]);
+  int (*batch)(int wgs84, size_t n, double lon, double lat, const double *u,
+               const double *v, double *a, double *b);
+};
+
+static int g2r_point(int wgs84, const double in[4], double out[2]) {
+  return (wgs84 ? g2r_wgs84 : g2r)(&out[0], &out[1], in[0], in[1], in[2],
+                                   in[3]);
+}
+
+static int g2r_arrays(int wgs84, size_t n, double lon, double lat,
+                      const double *u, const double *v, double *a,
+                      double *b) {
+  return (wgs84 ? g2r_wgs84_batch : g2r_batch)(n, a, b, lon, lat, u, v);
+}
+
+static int r2g_point(int wgs84, const double in[4], double out[2]) {
+  return (wgs84 ? r2g_wgs84 : r2g)(in[0], in[1], in[2], in[3], &out[0],
+                                   &out[1]);
+}
+
+static int r2g_arrays(int wgs84, size_t n, double lon, double lat,
+                      const double *u, const double *v, double *a,
+                      double *b) {
+  return (wgs84 ? r2g_wgs84_batch : r2g_batch)(n, u, v, lon, lat, a, b);
+}
+
+static const struct conversion g2r_conversion = {
+    {"lon_initial", "lat_initial", "lon_final", "lat_final", "wgs84", "out",
+     NULL},
+    {0, 1},
+    g2r_point,
+    g2r_arrays};
+
+static const struct conversion r2g_conversion = {
+    {"range", "bearing", "lon_initial", "lat_initial", "wgs84", "out", NULL},
+    {2, 3},
+    r2g_point,
+    r2g_arrays};
+
+/**
+ * Convert scalars or arrays; points that fail (nearly antipodal points on
+ * the ellipsoid) get NaN, as in the batch functions
+ */
+static PyObject *convert(const struct conversion *c, PyObject *args,
+                         PyObject *kwargs) {
+  PyObject *objs[4], *out = NULL;
+  int wgs84 = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|$pO",
+                                   (char **)c->kwlist, &objs[0], &objs[1],
+                                   &objs[2], &objs[3], &wgs84, &out)) {
+    return NULL;
+  }
+  struct arg a[4];
+  Py_ssize_t n;
+  int any_array;
+  if (args_parse(4, objs, (const char *const *)c->kwlist, a, &n,
+                 &any_array) != 0) {
+    return NULL;
+  }
+  if (!any_array && (out == NULL || out == Py_None)) {
+    double in[4] = {a[0].scalar, a[1].scalar, a[2].scalar, a[3].scalar};
+    double result[2];
+    if (c->point(wgs84, in, result) != 0) {
+      result[0] = result[1] = NAN;
+    }
+    return Py_BuildValue("(dd)", result[0], result[1]);
+  }
+
+  PyObject *outs[2] = {NULL, NULL};
+  if (out != NULL && out != Py_None) {
+    if (!PyTuple_Check(out) || PyTuple_GET_SIZE(out) != 2) {
+      arg_release(a, 4);
+      PyErr_SetString(PyExc_TypeError, "out must be a tuple of two arrays");
+      return NULL;
+    }
+    outs[0] = PyTuple_GET_ITEM(out, 0);
+    outs[1] = PyTuple_GET_ITEM(out, 1);
+  }
+  Py_buffer views[2];
+  PyObject *arrays[2] = {NULL, NULL};
+  for (int k = 0; k < 2; k++) {
+    arrays[k] = output(outs[k], 1, &n, &views[k]);
+    if (arrays[k] == NULL) {
+      if (k > 0) {
+        PyBuffer_Release(&views[0]);
+        Py_DECREF(arrays[0]);
+      }
+      arg_release(a, 4);
+      return NULL;
+    }
+  }
+
+  double *o1 = views[0].buf, *o2 = views[1].buf;
+  int i0 = c->initial[0], i1 = c->initial[1];
+  int u = i0 == 0 ? 2 : 0; /* First of the two per-point inputs */
+  const double *du = arg_doubles(&a[u]), *dv = arg_doubles(&a[u + 1]);
+  Py_BEGIN_ALLOW_THREADS
+  if (a[i0].n == 1 && a[i1].n == 1 && du != NULL && dv != NULL &&
+      a[u].n == n && a[u + 1].n == n && o1 != du && o1 != dv && o2 != du &&
+      o2 != dv) {
+    /* One initial point: the batch functions, straight on the buffers */
+    c->batch(wgs84, n, arg_value(&a[i0], 0), arg_value(&a[i1], 0), du, dv,
+             o1, o2);
+  } else {
+    for (Py_ssize_t i = 0; i < n; i++) {
+      double in[4], result[2];
+      for (int k = 0; k < 4; k++) {
+        in[k] = arg_value(&a[k], i);
+      }
+      if (c->point(wgs84, in, result) != 0) {
+        result[0] = result[1] = NAN;
+      }
+      o1[i] = result[0];
+      o2[i] = result[1];
+    }
+  }
+  Py_END_ALLOW_THREADS
+  arg_release(a, 4);
+  PyBuffer_Release(&views[0]);
+  PyBuffer_Release(&views[1]);
+  PyObject *result = PyTuple_Pack(2, arrays[0], arrays[1]);
+  Py_DECREF(arrays[0]);
+  Py_DECREF(arrays[1]);
+  return result;
+}
+
+static PyObject *py_g2r(PyObject *module, PyObject *args, PyObject *kwargs) {
+  (void)module;
+  return convert(&g2r_conversion, args, kwargs);
+}
+
+static PyObject *py_r2g(PyObject *module, PyObject *args, PyObject *kwargs) {
+  (void)module;
+  return convert(&r2g_conversion, args, kwargs);
+}
+
+static PyMethodDef methods[] = {
+    {"init", (PyCFunction)(void (*)(void))py_init,
+     METH_VARARGS | METH_KEYWORDS,
+     "init(data_dir=None)\n--\n\n"
+     "Load the IRI data files (or their blob) from a directory (None: the\n"
+     "current one). The IRI functions otherwise load them from the\n"
+     "module's directory on first use."},
+    {"iri_heights", py_iri_heights, METH_VARARGS,
+     "iri_heights(height_start, height_end, height_step)\n--\n\n"
+     "Heights from the start to the end by the step (km), as a float64\n"
+     "array; the same as iri_interface's, with no limit of heights."},
+    {"iri_profiles", (PyCFunction)(void (*)(void))py_iri_profiles,
+     METH_VARARGS | METH_KEYWORDS,
+     "iri_profiles(latitude, longitude, year, month, day, hour,\n"
+     "             height_start, height_end, height_step, *, columns=None,\n"
+     "             workers=1, out=None)\n--\n\n"
+     "Vertical profiles of the IRI model at points (latitude, longitude,\n"
+     "date and hour: local time, or universal time + 25), each a scalar or\n"
+     "an array. Returns float64 values of shape (points, NUM_PROFILE,\n"
+     "heights), or (NUM_PROFILE, heights) if all inputs are scalars, with\n"
+     "the rows in the order of COLUMNS.\n\n"
+     "columns: None (all), a string like 'height,ne,Te', or a mask of\n"
+     "  1 << column; the others are -1 and are not computed.\n"
+     "workers: more than 1 (or 0 for one per processor) spreads the points\n"
+     "  over worker processes, for at most MAX_HEIGHT heights.\n"
+     "out: C-contiguous float64 array to write to, which is returned.\n\n"
+     "Raises ValueError for invalid dates, and dates outside the data\n"
+     "files (IGRF coefficients and ig_rz.dat indices)."},
+    {"iri_profiles_heights",
+     (PyCFunction)(void (*)(void))py_iri_profiles_heights,
+     METH_VARARGS | METH_KEYWORDS,
+     "iri_profiles_heights(latitude, longitude, year, month, day, hour,\n"
+     "                     heights, *, columns=None, out=None)\n--\n\n"
+     "Same as iri_profiles(), at an array of heights (km) in any order and\n"
+     "spacing."},
+    {"g2r", (PyCFunction)(void (*)(void))py_g2r, METH_VARARGS | METH_KEYWORDS,
+     "g2r(lon_initial, lat_initial, lon_final, lat_final, *, wgs84=False,\n"
+     "    out=None)\n--\n\n"
+     "Range (km) and bearing (deg) from initial to final points (deg), each\n"
+     "a scalar or an array, on the sphere or the WGS-84 ellipsoid. Returns\n"
+     "two floats, or two float64 arrays (written to out=(range, bearing) if\n"
+     "given); points that fail get NaN."},
+    {"r2g", (PyCFunction)(void (*)(void))py_r2g, METH_VARARGS | METH_KEYWORDS,
+     "r2g(range, bearing, lon_initial, lat_initial, *, wgs84=False,\n"
+     "    out=None)\n--\n\n"
+     "Final longitude and latitude (deg) at a range (km) and bearing (deg)\n"
+     "from initial points, each a scalar or an array. Returns two floats,\n"
+     "or two float64 arrays (written to out=(lon, lat) if given)."},
+    {NULL, NULL, 0, NULL}};
+
+static struct PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "iri_edp",
+    "IRI profiles and coord-tran conversions over arrays, without copies",
+    -1, methods};
+
+PyMODINIT_FUNC PyInit_iri_edp(void) {
+  if (iri_lock == NULL) {
+    iri_lock = PyThread_allocate_lock();
+    if (iri_lock == NULL) {
+      return PyErr_NoMemory();
+    }
+  }
+  PyObject *module = PyModule_Create(&module_def);
+  if (module == NULL) {
+    return NULL;
+  }
+  PyObject *names = PyTuple_New(NUM_PROFILE);
+  if (names == NULL) {
+    Py_DECREF(module);
+    return NULL;
+  }
+  for (int j = 0; j < NUM_PROFILE; j++) {
+    PyObject *name = PyUnicode_FromString(iri_column_name(j));
+    if (name == NULL) {
+      Py_DECREF(names);
+      Py_DECREF(module);
+      return NULL;
+    }
+    PyTuple_SET_ITEM(names, j, name);
+  }
+  /* PyModule_AddObject() steals the reference only on success */
+  if (PyModule_AddObject(module, "COLUMNS", names) != 0) {
+    Py_DECREF(names);
+    Py_DECREF(module);
+    return NULL;
+  }
+  if (PyModule_AddIntConstant(module, "NUM_PROFILE", NUM_PROFILE) != 0 ||
+      PyModule_AddIntConstant(module, "MAX_HEIGHT", MAX_HEIGHT) != 0) {
+    Py_DECREF(module);
+    return NULL;
+  }
+  return module;
+}
@@ -0,0 +1,583 @@
+/**
+ * @file
+ * @brief Long-running IRI service over a Unix domain socket
+ *
+ * The server initializes the model once, warms it up, and forks a pool of
+ * worker processes that share the loaded data copy-on-write. The parent
+ * accepts connections, queues them while all workers are busy, and passes
+ * each to an idle worker over a control socket (`SCM_RIGHTS`). Workers
+ * serve the requests of a connection until the client closes it, and
+ * record their latencies in counters shared with the parent. The protocol
+ * is described in `iri_service.h`.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "iri_data.h"
+#include "iri_field.h"
+#include "iri_pool.h"
+#include "iri_service.h"
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Latency histogram: 4 buckets per factor of 2 from 1 us */
+#define NUM_BUCKETS 128
+#define BUCKETS_PER_OCTAVE 4
+#define BUCKET_BASE 1e-6
+
+/* Connections that can wait for a worker; beyond that they wait in the
+   listen backlog */
+#define MAX_QUEUE 1024
+
+/* Counters shared by the parent and the workers */
+struct shared_stats {
+  double start_time;
+  uint64_t connections;
+  uint64_t requests;
+  uint64_t points;
+  uint64_t errors;
+  uint32_t num_workers;
+  uint32_t busy_workers;
+  uint32_t queue_depth;
+  uint32_t max_queue_depth;
+  uint64_t latency_hist[NUM_BUCKETS];
+  uint64_t wait_hist[NUM_BUCKETS];
+  uint64_t latency_max_ns;
+  uint64_t wait_max_ns;
+};
+
+/* A worker process, as seen by the parent */
+struct worker {
+  pid_t pid;
+  int ctrl; /* Control socket: connections to the worker, idle bytes back */
+  int busy;
+};
+
+/* A connection waiting for a worker */
+struct pending {
+  int fd;
+  double accept_time;
+};
+
+static struct shared_stats *stats;
+static volatile sig_atomic_t stopping = 0;
+
+/* Parent state */
+static int listen_fd = -1;
+static struct worker *workers;
+static int num_workers;
+static struct pending *queue;
+static size_t head, count; /* Queue ring */
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void on_signal(int sig) {
+  (void)sig;
+  stopping = 1;
+}
+
+static void record(uint64_t hist[NUM_BUCKETS], uint64_t *max_ns,
+                   double seconds) {
+  int k = seconds > BUCKET_BASE
+              ? (int)(BUCKETS_PER_OCTAVE * log2(seconds / BUCKET_BASE))
+              : 0;
+  if (k >= NUM_BUCKETS) {
+    k = NUM_BUCKETS - 1;
+  }
+  __atomic_fetch_add(&hist[k], 1, __ATOMIC_RELAXED);
+  uint64_t ns = (uint64_t)(seconds * 1e9);
+  uint64_t old = __atomic_load_n(max_ns, __ATOMIC_RELAXED);
+  while (ns > old && !__atomic_compare_exchange_n(max_ns, &old, ns, 0,
+                                                  __ATOMIC_RELAXED,
+                                                  __ATOMIC_RELAXED)) {
+  }
+}
+
+/* Median, 90%, 99% (upper bounds of their buckets) and max in ms */
+static void percentiles(const uint64_t hist[NUM_BUCKETS], uint64_t max_ns,
+                        double out[4]) {
+  uint64_t counts[NUM_BUCKETS], total = 0;
+  for (int k = 0; k < NUM_BUCKETS; k++) {
+    counts[k] = __atomic_load_n(&hist[k], __ATOMIC_RELAXED);
+    total += counts[k];
+  }
+  static const double fractions[3] = {0.5, 0.9, 0.99};
+  for (int p = 0; p < 3; p++) {
+    out[p] = 0.0;
+    uint64_t seen = 0;
+    for (int k = 0; k < NUM_BUCKETS && total > 0; k++) {
+      seen += counts[k];
+      if (seen >= fractions[p] * total) {
+        out[p] = BUCKET_BASE *
+                 pow(2.0, (k + 1) / (double)BUCKETS_PER_OCTAVE) * 1e3;
+        break;
+      }
+    }
+  }
+  out[3] = max_ns * 1e-6;
+  /* The maximum is exact; a bucket bound must not exceed it */
+  for (int p = 0; p < 3; p++) {
+    out[p] = out[p] < out[3] ? out[p] : out[3];
+  }
+}
+
+static void get_stats(struct iri_service_stats *out) {
+  memset(out, 0, sizeof(*out));
+  out->connections = __atomic_load_n(&stats->connections, __ATOMIC_RELAXED);
+  out->requests = __atomic_load_n(&stats->requests, __ATOMIC_RELAXED);
+  out->points = __atomic_load_n(&stats->points, __ATOMIC_RELAXED);
+  out->errors = __atomic_load_n(&stats->errors, __ATOMIC_RELAXED);
+  out->num_workers = __atomic_load_n(&stats->num_workers, __ATOMIC_RELAXED);
+  out->busy_workers = __atomic_load_n(&stats->busy_workers, __ATOMIC_RELAXED);
+  out->queue_depth = __atomic_load_n(&stats->queue_depth, __ATOMIC_RELAXED);
+  out->max_queue_depth =
+      __atomic_load_n(&stats->max_queue_depth, __ATOMIC_RELAXED);
+  percentiles(stats->latency_hist, stats->latency_max_ns, out->latency);
+  percentiles(stats->wait_hist, stats->wait_max_ns, out->wait);
+  out->uptime = now() - stats->start_time;
+}
+
+/* Reply with a bare response header */
+static int reply(int fd, int status, const struct iri_request_header *req) {
+  struct iri_response_header resp = {
+      .magic = IRI_SERVICE_MAGIC,
+      .status = status,
+      .num_points = status == 0 ? req->num_points : 0,
+      .num_heights = status == 0 ? req->num_heights : 0,
+      .columns = status == 0 ? req->columns : 0,
+  };
+  return iri_service_write(fd, &resp, sizeof(resp));
+}
+
+/* Whether a point can go to the model: a Fortran STOP on a date outside
+   the IGRF sets would kill the worker and drop the connection */
+static int point_valid(const struct iri_request_point *p) {
+  double decimal_year;
+  return isfinite(p->latitude) && isfinite(p->longitude) &&
+         isfinite(p->hour) &&
+         iri_decimal_year(p->year, p->month, p->day, &decimal_year) == 0 &&
+         iri_data_igrf_covers(decimal_year) == 0 &&
+         iri_data_indices_cover(p->year, p->month) == 0;
+}
+
+/* Compute and stream the profiles of a request; returns 0, 1 if the client
+   went away, or -1 to reject the request */
+static int serve_profiles(int fd, struct iri_workspace *ws,
+                          const struct iri_request_header *req) {
+  size_t num_points = req->num_points;
+  int nh = req->num_heights;
+  unsigned columns = req->columns;
+  int num_columns = 0;
+  for (int j = 0; j < NUM_PROFILE; j++) {
+    num_columns += (columns & IRI_COLUMN(j)) != 0;
+  }
+
+  struct iri_request_point *points = malloc(num_points * sizeof(*points));
+  double *values = malloc((size_t)NUM_PROFILE * nh * sizeof(double));
+  size_t point_size = sizeof(struct iri_response_point) +
+                      (size_t)num_columns * nh * sizeof(float);
+  unsigned char *out = malloc(point_size);
+  int status;
+  if ((points == NULL && num_points > 0) || values == NULL || out == NULL) {
+    status = -1; /* Rejected, so the client gets an error response */
+  } else {
+    status = iri_service_read(fd, points, num_points * sizeof(*points)) ||
+             reply(fd, 0, req);
+  }
+
+  for (size_t i = 0; i < num_points && status == 0; i++) {
+    const struct iri_request_point *p = &points[i];
+    struct iri_response_point header = {.index = i};
+    header.status =
+        !point_valid(p)
+            ? 1
+            : iri_profiles_ws(ws, p->latitude, p->longitude, p->year,
+                              p->month, p->day, p->hour, req->height_start,
+                              req->height_step, nh, columns, values);
+    if (header.status != 0) {
+      __atomic_fetch_add(&stats->errors, 1, __ATOMIC_RELAXED);
+    }
+    memcpy(out, &header, sizeof(header));
+    float *f = (float *)(out + sizeof(header));
+    for (int j = 0; j < NUM_PROFILE; j++) {
+      if (columns & IRI_COLUMN(j)) {
+        for (int k = 0; k < nh; k++) {
+          *f++ = header.status == 0 ? (float)values[j * nh + k] : -1.0f;
+        }
+      }
+    }
+    status = iri_service_write(fd, out, point_size);
+  }
+  if (status >= 0) {
+    __atomic_fetch_add(&stats->points, num_points, __ATOMIC_RELAXED);
+  }
+
+  free(points);
+  free(values);
+  free(out);
+  return status;
+}
+
+/* Serve the requests of a connection until the client closes it */
+static void serve_connection(int fd, struct iri_workspace *ws) {
+  struct iri_request_header req;
+  while (iri_service_read(fd, &req, sizeof(req)) == 0) {
+    double t0 = now();
+    __atomic_fetch_add(&stats->requests, 1, __ATOMIC_RELAXED);
+    int status;
+    if (req.magic != IRI_SERVICE_MAGIC ||
+        req.version != IRI_SERVICE_VERSION) {
+      status = -1;
+    } else if (req.type == IRI_REQUEST_STATS) {
+      struct iri_service_stats out;
+      get_stats(&out);
+      req.num_points = req.num_heights = req.columns = 0;
+      status = reply(fd, 0, &req) ||
+               iri_service_write(fd, &out, sizeof(out));
+    } else if (req.type == IRI_REQUEST_PROFILES &&
+               req.num_points <= IRI_SERVICE_MAX_POINTS &&
+               req.num_heights >= 1 &&
+               req.num_heights <= IRI_SERVICE_MAX_HEIGHTS &&
+               req.height_step > 0.0 &&
+               (req.columns & IRI_COLUMNS_ALL) != 0 &&
+               (req.columns & ~IRI_COLUMNS_ALL) == 0) {
+      status = serve_profiles(fd, ws, &req);
+    } else {
+      status = -1;
+    }
+    if (status < 0) {
+      /* Rejected: the rest of the stream can't be trusted */
+      __atomic_fetch_add(&stats->errors, 1, __ATOMIC_RELAXED);
+      reply(fd, 1, &req);
+      break;
+    }
+    if (status != 0) {
+      break; /* The client went away */
+    }
+    record(stats->latency_hist, &stats->latency_max_ns, now() - t0);
+  }
+}
+
+/* Receive a connection from the parent; returns -1 when told to stop */
+static int receive_connection(int ctrl) {
+  char byte;
+  struct iovec iov = {.iov_base = &byte, .iov_len = 1};
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control.buf,
+      .msg_controllen = sizeof(control.buf),
+  };
+  ssize_t n;
+  do {
+    n = recvmsg(ctrl, &msg, 0);
+  } while (n < 0 && errno == EINTR);
+  struct cmsghdr *cmsg = n > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+  if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+  return fd;
+}
+
+static int send_connection(int ctrl, int fd) {
+  char byte = 'c';
+  struct iovec iov = {.iov_base = &byte, .iov_len = 1};
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  memset(&control, 0, sizeof(control));
+  struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control.buf,
+      .msg_controllen = sizeof(control.buf),
+  };
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+  return sendmsg(ctrl, &msg, 0) != 1;
+}
+
+static void worker_main(int ctrl) {
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGPIPE, SIG_IGN);
+  struct iri_workspace *ws = iri_workspace_new();
+  if (ws == NULL) {
+    _exit(1);
+  }
+  char idle = 'i';
+  while (iri_service_write(ctrl, &idle, 1) == 0) {
+    int fd = receive_connection(ctrl);
+    if (fd < 0) {
+      break;
+    }
+    serve_connection(fd, ws);
+    close(fd);
+  }
+  _exit(0);
+}
+
+/* Close the parent's descriptors in a new worker, so that only the parent
+   holds the listening socket, the queued connections and the other
+   workers' control sockets */
+static void close_parent_fds(void) {
+  close(listen_fd);
+  for (int i = 0; i < num_workers; i++) {
+    if (workers[i].pid > 0) {
+      close(workers[i].ctrl);
+    }
+  }
+  for (size_t n = 0; n < count; n++) {
+    close(queue[(head + n) % MAX_QUEUE].fd);
+  }
+}
+
+static int start_worker(struct worker *w) {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+    perror("Failed to create a worker control socket");
+    return 1;
+  }
+  fflush(NULL);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("Failed to fork IRI worker");
+    close(sv[0]);
+    close(sv[1]);
+    return 1;
+  }
+  if (pid == 0) {
+    close_parent_fds();
+    close(sv[0]);
+    worker_main(sv[1]);
+  }
+  close(sv[1]);
+  w->pid = pid;
+  w->ctrl = sv[0];
+  w->busy = 1; /* Until it reports idle */
+  return 0;
+}
+
+static int open_socket(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Error: Socket path %s is too long\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("Failed to create socket");
+    return -1;
+  }
+  unlink(path); /* A stale socket of a previous run */
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    fprintf(stderr, "Error listening on %s: %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void print_usage(const char *progname) {
+  printf("Usage: %s [options]\n", progname);
+  printf("Options:\n");
+  printf("  -s|--socket <path>   Socket path (default: %s)\n",
+         IRI_SERVICE_SOCKET);
+  printf("  -w|--workers <n>     Number of workers (default: one per "
+         "processor)\n");
+  printf("  -d|--data-dir <dir>  Directory with the IRI data files (default: "
+         "current\n"
+         "                       directory)\n");
+  printf("  -h|--help            Show this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *path = IRI_SERVICE_SOCKET;
+  const char *data_dir = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (((strcmp(argv[i], "-s") == 0) ||
+         (strcmp(argv[i], "--socket") == 0)) &&
+        i + 1 < argc) {
+      path = argv[++i];
+    } else if (((strcmp(argv[i], "-w") == 0) ||
+                (strcmp(argv[i], "--workers") == 0)) &&
+               i + 1 < argc) {
+      num_workers = atoi(argv[++i]);
+    } else if (((strcmp(argv[i], "-d") == 0) ||
+                (strcmp(argv[i], "--data-dir") == 0)) &&
+               i + 1 < argc) {
+      data_dir = argv[++i];
+    } else if ((strcmp(argv[i], "-h") == 0) ||
+               (strcmp(argv[i], "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else {
+      printf("Unknown option: %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  num_workers = iri_pool_workers(num_workers, (size_t)-1);
+
+  if (iri_init_with_dir(data_dir) != 0) {
+    fprintf(stderr, "Failed to initialize IRI model\n");
+    return 1;
+  }
+  /* Warm up before forking, so the workers share what the first call
+     touches */
+  static double profile[NUM_PROFILE][MAX_HEIGHT];
+  if (iri_profiles(37.8, -75.4, 2021, 3, 3, 36.0, 70.0, 600.0, 10.0,
+                   profile) != 0) {
+    fprintf(stderr, "IRI model calculation failed\n");
+    return 1;
+  }
+
+  stats = iri_pool_shared_alloc(sizeof(*stats));
+  workers = calloc(num_workers, sizeof(*workers));
+  queue = malloc(MAX_QUEUE * sizeof(*queue));
+  struct pollfd *fds = malloc((num_workers + 1) * sizeof(*fds));
+  if (stats == NULL || workers == NULL || queue == NULL || fds == NULL) {
+    fprintf(stderr, "Allocation failed\n");
+    return 1;
+  }
+  stats->start_time = now();
+  stats->num_workers = num_workers;
+
+  listen_fd = open_socket(path);
+  if (listen_fd < 0) {
+    return 1;
+  }
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  int status = 0;
+  for (int i = 0; i < num_workers && status == 0; i++) {
+    status = start_worker(&workers[i]);
+  }
+  if (status == 0) {
+    fprintf(stderr, "Serving on %s with %d workers\n", path, num_workers);
+  }
+
+  while (status == 0 && !stopping) {
+    /* Accept only while the queue has room */
+    fds[0].fd = count < MAX_QUEUE ? listen_fd : -1;
+    fds[0].events = POLLIN;
+    for (int i = 0; i < num_workers; i++) {
+      fds[i + 1].fd = workers[i].ctrl;
+      fds[i + 1].events = POLLIN;
+    }
+    if (poll(fds, num_workers + 1, -1) < 0) {
+      if (errno != EINTR) {
+        perror("poll");
+        status = 1;
+      }
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listen_fd, NULL, NULL);
+      if (fd >= 0) {
+        queue[(head + count) % MAX_QUEUE] = (struct pending){fd, now()};
+        count++;
+        __atomic_fetch_add(&stats->connections, 1, __ATOMIC_RELAXED);
+      }
+    }
+    for (int i = 0; i < num_workers; i++) {
+      if (!(fds[i + 1].revents & (POLLIN | POLLHUP))) {
+        continue;
+      }
+      char byte;
+      if (read(workers[i].ctrl, &byte, 1) == 1) {
+        workers[i].busy = 0;
+        continue;
+      }
+      /* The worker died: replace it */
+      fprintf(stderr, "Worker %d exited, restarting it\n", (int)workers[i].pid);
+      close(workers[i].ctrl);
+      waitpid(workers[i].pid, NULL, 0);
+      workers[i].pid = 0;
+      status = start_worker(&workers[i]);
+    }
+
+    /* Hand queued connections to idle workers */
+    for (int i = 0; i < num_workers && count > 0; i++) {
+      if (workers[i].busy) {
+        continue;
+      }
+      struct pending *p = &queue[head];
+      if (send_connection(workers[i].ctrl, p->fd) == 0) {
+        workers[i].busy = 1;
+        record(stats->wait_hist, &stats->wait_max_ns, now() - p->accept_time);
+      }
+      close(p->fd);
+      head = (head + 1) % MAX_QUEUE;
+      count--;
+    }
+
+    uint32_t busy = 0;
+    for (int i = 0; i < num_workers; i++) {
+      busy += workers[i].busy;
+    }
+    __atomic_store_n(&stats->busy_workers, busy, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->queue_depth, (uint32_t)count, __ATOMIC_RELAXED);
+    if (count > stats->max_queue_depth) {
+      __atomic_store_n(&stats->max_queue_depth, (uint32_t)count,
+                       __ATOMIC_RELAXED);
+    }
+  }
+
+  /* Closing the control sockets stops idle workers; busy ones are
+     signalled */
+  close(listen_fd);
+  unlink(path);
+  for (; count > 0; count--, head = (head + 1) % MAX_QUEUE) {
+    close(queue[head].fd);
+  }
+  for (int i = 0; i < num_workers; i++) {
+    if (workers[i].pid > 0) {
+      close(workers[i].ctrl);
+      kill(workers[i].pid, SIGTERM);
+      waitpid(workers[i].pid, NULL, 0);
+    }
+  }
+  free(workers);
+  free(queue);
+  free(fds);
+  iri_pool_shared_free(stats, sizeof(*stats));
+  return status;
+}
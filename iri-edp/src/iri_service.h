@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @brief Protocol and client of the IRI service
+ *
+ * `iri_server` initializes the model once and serves profiles over a Unix
+ * domain socket from a pool of pre-forked, warmed-up worker processes, so
+ * callers don't pay for process start and `iri_init()` on every run. The
+ * server accepts connections and hands each to an idle worker; connections
+ * wait in a queue while all workers are busy. A connection carries any
+ * number of requests, each answered before the next is read.
+ *
+ * The protocol is binary, in the host byte order (the socket is local):
+ *
+ * - A request is a `struct iri_request_header`, followed for
+ *   `IRI_REQUEST_PROFILES` by `num_points` `struct iri_request_point`.
+ * - The response is a `struct iri_response_header`, followed for
+ *   `IRI_REQUEST_PROFILES` by each point as it is computed: a
+ *   `struct iri_response_point`, then for each requested column (in column
+ *   order) `num_heights` float32 values (-1 where missing, or if the point
+ *   failed), and for `IRI_REQUEST_STATS` by a `struct iri_service_stats`.
+ */
+
+#ifndef IRI_SERVICE_H
+#define IRI_SERVICE_H
+
+#include "iri_interface.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* First field of requests and responses ("IRIS") */
+#define IRI_SERVICE_MAGIC 0x49524953u
+
+/* Protocol version */
+#define IRI_SERVICE_VERSION 1
+
+/* Default socket path */
+#define IRI_SERVICE_SOCKET "iri.sock"
+
+/* Limits of a request */
+#define IRI_SERVICE_MAX_POINTS (1u << 20)
+#define IRI_SERVICE_MAX_HEIGHTS 65536
+
+/* Request types */
+enum iri_request_type {
+  IRI_REQUEST_PROFILES = 1, /* Profiles at a list of points */
+  IRI_REQUEST_STATS = 2,    /* Server counters */
+};
+
+/* Header of a request (40 bytes) */
+struct iri_request_header {
+  uint32_t magic;       /* IRI_SERVICE_MAGIC */
+  uint32_t version;     /* IRI_SERVICE_VERSION */
+  uint32_t type;        /* enum iri_request_type */
+  uint32_t columns;     /* IRI_COLUMN() bits of the columns to compute */
+  uint32_t num_points;  /* Number of points that follow */
+  uint32_t num_heights; /* Heights per profile */
+  double height_start;  /* km */
+  double height_step;   /* km */
+};
+
+/* Point of a profiles request (40 bytes) */
+struct iri_request_point {
+  double latitude;  /* Degrees North */
+  double longitude; /* Degrees East */
+  double hour;      /* Local time (or Universal time + 25) in hours */
+  int32_t year;
+  int32_t month;
+  int32_t day;
+  int32_t reserved; /* Zero */
+};
+
+/* Header of a response (24 bytes) */
+struct iri_response_header {
+  uint32_t magic;       /* IRI_SERVICE_MAGIC */
+  int32_t status;       /* 0, or non-zero if the request was rejected (then
+                           nothing follows and the connection is closed) */
+  uint32_t num_points;  /* Number of points that follow */
+  uint32_t num_heights; /* Values per column per point */
+  uint32_t columns;     /* IRI_COLUMN() bits of the columns that follow */
+  uint32_t reserved;    /* Zero */
+};
+
+/* Header of each point of a profiles response (8 bytes) */
+struct iri_response_point {
+  uint32_t index; /* Index of the point in the request */
+  int32_t status; /* 0, or non-zero if the date was invalid or outside the
+                     data files, or the model failed */
+};
+
+/* Server counters; times in milliseconds, percentiles from a histogram with
+   4 buckets per factor of 2 (so within 19%) */
+struct iri_service_stats {
+  uint64_t connections; /* Connections accepted */
+  uint64_t requests;    /* Requests received */
+  uint64_t points;      /* Profiles computed */
+  uint64_t errors;      /* Rejected requests and failed points */
+  uint32_t num_workers;
+  uint32_t busy_workers;    /* Workers serving a connection */
+  uint32_t queue_depth;     /* Connections waiting for a worker */
+  uint32_t max_queue_depth; /* Largest queue depth so far */
+  double latency[4];        /* Request latency: median, 90%, 99%, max */
+  double wait[4];           /* Time in the queue: median, 90%, 99%, max */
+  double uptime;            /* Seconds since the server started */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Read exactly `size` bytes, retrying short reads
+ *
+ * @return 0 on success, non-zero on error or end of file
+ */
+int iri_service_read(int fd, void *buf, size_t size);
+
+/**
+ * @brief Write exactly `size` bytes to a socket, retrying short writes
+ *
+ * Sends with `MSG_NOSIGNAL`, so a peer that closed the connection gives an
+ * error rather than a SIGPIPE.
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_service_write(int fd, const void *buf, size_t size);
+
+/**
+ * @brief Connect to a server
+ *
+ * @param path  Socket path (NULL for `IRI_SERVICE_SOCKET`)
+ *
+ * @return Socket, or -1 on error (reported on stderr)
+ */
+int iri_client_connect(const char *path);
+
+/**
+ * @brief Request profiles
+ *
+ * @param fd           Socket from `iri_client_connect()`
+ * @param num_points   Number of points, up to `IRI_SERVICE_MAX_POINTS`
+ * @param points       Points
+ * @param height_start Start height in km
+ * @param height_step  Height step in km (positive)
+ * @param num_heights  Number of heights, 1 to `IRI_SERVICE_MAX_HEIGHTS`
+ * @param columns      `IRI_COLUMN()` bits of the columns to compute
+ * @param values       Output, point by point: for each column in `columns`
+ *                     (in column order), `num_heights` values
+ *
+ * @return 0 on success, non-zero on invalid arguments (checked before
+ * sending), a connection error, a rejected request, or if any point failed
+ */
+int iri_client_profiles(int fd, size_t num_points,
+                        const struct iri_request_point points[],
+                        double height_start, double height_step,
+                        int num_heights, unsigned columns, float *values);
+
+/**
+ * @brief Request the server counters
+ *
+ * @param fd     Socket from `iri_client_connect()`
+ * @param stats  Output counters
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_client_stats(int fd, struct iri_service_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRI_SERVICE_H */
@@ -0,0 +1,309 @@
+/**
+ * @file
+ * @brief Implementation of TEC from the IRI model
+ */
+
+#include "iri_tec.h"
+#include "iri_pool.h"
+#include "lib.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Function prototype for the Fortran TEC integrator (iritec.for) */
+extern void iritec_(float *alati, float *along, int *jmag, int jf[NUM_JF],
+                    int *iy, int *md, float *hour, float *hbeg, float *hend,
+                    float *hstep, float oarr[NUM_OARR], float *tecbo,
+                    float *tecto);
+
+int iri_tec(double latitude, double longitude, int year, int month, int day,
+            double hour, double height_start, double height_end,
+            double height_step, double *tec_bottom, double *tec_top) {
+  if (!(height_step > 0.0) || !(height_end - height_start >= height_step)) {
+    fprintf(stderr, "Error: Invalid TEC height range\n");
+    return 1;
+  }
+
+  /* IRITEC turns off everything but Ne itself, except in its last segment,
+     so start from the switches of an Ne-only profile */
+  int jf_tec[NUM_JF];
+  iri_jf_for_columns(IRI_COLUMN(1), jf_tec);
+
+  float f_latitude = (float)latitude;
+  float f_longitude = (float)longitude;
+  float f_hour = (float)hour;
+  float f_height_start = (float)height_start;
+  float f_height_end = (float)height_end;
+  float f_height_step = (float)height_step;
+  int mmdd = month * 100 + day;
+  int jmag = 0;
+  float f_oarr[NUM_OARR];
+  float f_tec_bottom = -1.0f, f_tec_top = -1.0f;
+  for (int i = 0; i < NUM_OARR; i++) {
+    f_oarr[i] = -1.0f;
+  }
+
+  iritec_(&f_latitude, &f_longitude, &jmag, jf_tec, &year, &mmdd, &f_hour,
+          &f_height_start, &f_height_end, &f_height_step, f_oarr,
+          &f_tec_bottom, &f_tec_top);
+
+  *tec_bottom = f_tec_bottom;
+  *tec_top = f_tec_top;
+  return 0;
+}
+
+/* Inputs and outputs of a TEC grid run, shared with the worker processes */
+struct grid_ctx {
+  const double *latitude;
+  size_t num_longitudes;
+  const double *longitude;
+  int year;
+  int month;
+  int day;
+  double hour;
+  double height_start;
+  double height_end;
+  double height_step;
+  double *tec_bottom;
+  double *tec_top;
+};
+
+static int grid_work(size_t begin, size_t end, void *ctx) {
+  struct grid_ctx *g = ctx;
+  int status = 0;
+  for (size_t k = begin; k < end; k++) {
+    status |= iri_tec(g->latitude[k / g->num_longitudes],
+                      g->longitude[k % g->num_longitudes], g->year, g->month,
+                      g->day, g->hour, g->height_start, g->height_end,
+                      g->height_step, &g->tec_bottom[k], &g->tec_top[k]);
+  }
+  return status;
+}
+
+int iri_tec_grid(size_t num_latitudes, const double latitude[],
+                 size_t num_longitudes, const double longitude[], int year,
+                 int month, int day, double hour, double height_start,
+                 double height_end, double height_step, int num_workers,
+                 double *tec_bottom, double *tec_top) {
+  size_t num_cells = num_latitudes * num_longitudes;
+  if (num_cells == 0) {
+    return 0;
+  }
+  size_t size = num_cells * sizeof(double);
+
+  struct grid_ctx ctx = {
+      .latitude = latitude,
+      .num_longitudes = num_longitudes,
+      .longitude = longitude,
+      .year = year,
+      .month = month,
+      .day = day,
+      .hour = hour,
+      .height_start = height_start,
+      .height_end = height_end,
+      .height_step = height_step,
+      .tec_bottom = tec_bottom,
+      .tec_top = tec_top,
+  };
+
+  /* Workers write to shared memory, which is copied out at the end */
+  num_workers = iri_pool_workers(num_workers, num_cells);
+  if (num_workers > 1) {
+    ctx.tec_bottom = iri_pool_shared_alloc(2 * size);
+    if (ctx.tec_bottom == NULL) {
+      return 1;
+    }
+    ctx.tec_top = ctx.tec_bottom + num_cells;
+  }
+
+  int status = iri_pool_run(num_cells, num_workers, 0, grid_work, &ctx);
+
+  if (ctx.tec_bottom != tec_bottom) {
+    memcpy(tec_bottom, ctx.tec_bottom, size);
+    memcpy(tec_top, ctx.tec_top, size);
+    iri_pool_shared_free(ctx.tec_bottom, 2 * size);
+  }
+
+  return status;
+}
+
+/* Ne at a height from a slant TEC profile, zero where IRI has none */
+static double profile_ne(const double ne[], int num_heights, double height) {
+  double x = (height - IRI_SLANT_HEIGHT_START) / IRI_SLANT_HEIGHT_STEP;
+  int k = (int)x;
+  if (k > num_heights - 2) {
+    k = num_heights - 2;
+  }
+  double f = x - k;
+  double ne0 = ne[k] > 0.0 ? ne[k] : 0.0;
+  double ne1 = ne[k + 1] > 0.0 ? ne[k + 1] : 0.0;
+  return (1.0 - f) * ne0 + f * ne1;
+}
+
+/* Compute the Ne profile at ground range `bin * profile_spacing` along a
+   beam into `profile` */
+static int beam_profile(double latitude, double longitude, double bearing,
+                        int year, int month, int day, double hour,
+                        double profile_spacing, long bin,
+                        double profile[NUM_PROFILE][MAX_HEIGHT]) {
+  double lon, lat;
+  if (r2g(bin * profile_spacing, bearing, longitude, latitude, &lon, &lat) !=
+      0) {
+    return 1;
+  }
+  return iri_profiles_select(lat, lon, year, month, day, hour,
+                             IRI_SLANT_HEIGHT_START, IRI_SLANT_HEIGHT_END,
+                             IRI_SLANT_HEIGHT_STEP, IRI_COLUMN(1), profile);
+}
+
+int iri_slant_tec(double latitude, double longitude, double bearing,
+                  double elevation, double range, int year, int month,
+                  int day, double hour, double step, double profile_spacing,
+                  double *tec, int *num_profiles) {
+  if (!(elevation >= 0.0 && elevation <= 90.0) || !(range >= 0.0) ||
+      !(step > 0.0) || !(profile_spacing > 0.0)) {
+    fprintf(stderr, "Error: Invalid slant TEC parameters\n");
+    return 1;
+  }
+  int num_heights = iri_num_heights(
+      IRI_SLANT_HEIGHT_START, IRI_SLANT_HEIGHT_END, IRI_SLANT_HEIGHT_STEP);
+
+  /* Profiles at the two bins around the current sample; the ground range
+     only grows along the ray, so each is computed once */
+  double(*profiles)[NUM_PROFILE][MAX_HEIGHT] =
+      malloc(2 * sizeof(*profiles));
+  if (profiles == NULL) {
+    return 1;
+  }
+  double(*near)[MAX_HEIGHT] = profiles[0], (*far)[MAX_HEIGHT] = profiles[1];
+  long near_bin = -1, far_bin = -1;
+  int computed = 0;
+
+  const double r = EARTH_RADIUS;
+  double sin_el = sin(elevation * (M_PI / 180.0));
+  double cos_el = cos(elevation * (M_PI / 180.0));
+  long num_steps = (long)ceil(range / step);
+  double ds = num_steps > 0 ? range / num_steps : 0.0;
+  double total = 0.0;
+  int status = 0;
+
+  for (long i = 0; i < num_steps && status == 0; i++) {
+    double s = (i + 0.5) * ds;
+    double height = sqrt(r * r + s * s + 2.0 * r * s * sin_el) - r;
+    if (height < IRI_SLANT_HEIGHT_START) {
+      continue;
+    }
+    if (height > IRI_SLANT_HEIGHT_END) {
+      break; /* The height only grows from here */
+    }
+    double x = r * atan2(s * cos_el, r + s * sin_el) / profile_spacing;
+    long bin = (long)x;
+    double f = x - bin;
+
+    if (bin != near_bin) {
+      if (bin == far_bin) {
+        double(*tmp)[MAX_HEIGHT] = near;
+        near = far;
+        far = tmp;
+        far_bin = -1;
+      } else {
+        status = beam_profile(latitude, longitude, bearing, year, month, day,
+                              hour, profile_spacing, bin, near);
+        computed++;
+      }
+      near_bin = bin;
+    }
+    double ne = profile_ne(near[1], num_heights, height);
+    if (f > 0.0 && status == 0) {
+      if (far_bin != bin + 1) {
+        status = beam_profile(latitude, longitude, bearing, year, month, day,
+                              hour, profile_spacing, bin + 1, far);
+        far_bin = bin + 1;
+        computed++;
+      }
+      ne = (1.0 - f) * ne + f * profile_ne(far[1], num_heights, height);
+    }
+    /* Ne in m-3, steps in km */
+    total += ne * ds * 1e3;
+  }
+
+  free(profiles);
+  *tec = total;
+  if (num_profiles != NULL) {
+    *num_profiles = computed;
+  }
+  return status;
+}
+
+/* Inputs and outputs of a slant TEC scan, shared with the worker processes */
+struct scan_ctx {
+  double latitude;
+  double longitude;
+  const double *bearing;
+  const double *elevation;
+  const double *range;
+  int year;
+  int month;
+  int day;
+  double hour;
+  double step;
+  double profile_spacing;
+  double *tec;
+};
+
+static int scan_work(size_t begin, size_t end, void *ctx) {
+  struct scan_ctx *c = ctx;
+  int status = 0;
+  for (size_t i = begin; i < end; i++) {
+    status |= iri_slant_tec(c->latitude, c->longitude, c->bearing[i],
+                            c->elevation[i], c->range[i], c->year, c->month,
+                            c->day, c->hour, c->step, c->profile_spacing,
+                            &c->tec[i], NULL);
+  }
+  return status;
+}
+
+int iri_slant_tec_scan(size_t num_beams, double latitude, double longitude,
+                       const double bearing[], const double elevation[],
+                       const double range[], int year, int month, int day,
+                       double hour, double step, double profile_spacing,
+                       int num_workers, double *tec) {
+  if (num_beams == 0) {
+    return 0;
+  }
+  size_t size = num_beams * sizeof(double);
+
+  struct scan_ctx ctx = {
+      .latitude = latitude,
+      .longitude = longitude,
+      .bearing = bearing,
+      .elevation = elevation,
+      .range = range,
+      .year = year,
+      .month = month,
+      .day = day,
+      .hour = hour,
+      .step = step,
+      .profile_spacing = profile_spacing,
+      .tec = tec,
+  };
+
+  /* Workers write to shared memory, which is copied out at the end */
+  num_workers = iri_pool_workers(num_workers, num_beams);
+  if (num_workers > 1) {
+    ctx.tec = iri_pool_shared_alloc(size);
+    if (ctx.tec == NULL) {
+      return 1;
+    }
+  }
+
+  int status = iri_pool_run(num_beams, num_workers, 0, scan_work, &ctx);
+
+  if (ctx.tec != tec) {
+    memcpy(tec, ctx.tec, size);
+    iri_pool_shared_free(ctx.tec, size);
+  }
+
+  return status;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file
+ * @brief Total electron content (TEC) from the IRI model
+ *
+ * Vertical TEC is integrated by the Fortran `IRITEC`, which computes only
+ * the electron density, split into the bottomside (below hmF2) and topside
+ * parts. TEC values are in m-2 (1 TECU = 1e16 m-2).
+ */
+
+#ifndef IRI_TEC_H
+#define IRI_TEC_H
+
+#include "iri_interface.h"
+#include <stddef.h>
+
+/* Electrons per m2 in one TEC unit */
+#define IRI_TECU 1e16
+
+/* Heights of the Ne profiles for slant TEC in km; Ne is taken as zero
+   outside them */
+#define IRI_SLANT_HEIGHT_START 60.0
+#define IRI_SLANT_HEIGHT_END 2000.0
+#define IRI_SLANT_HEIGHT_STEP 10.0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Calculate the vertical TEC at a point
+ *
+ * The density is integrated from `height_start` to `height_end` at the
+ * midpoints of steps of `height_step`; more than `MAX_HEIGHT` steps are
+ * fine (e.g. 65 to 2000 km in steps of 1 km).
+ *
+ * @param latitude   Latitude in degrees North
+ * @param longitude  Longitude in degrees East
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param height_start    Lower integration limit in km
+ * @param height_end      Upper integration limit in km
+ * @param height_step     Integration step in km
+ * @param tec_bottom  Output TEC below hmF2 in m-2
+ * @param tec_top     Output TEC above hmF2 in m-2
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_tec(double latitude, double longitude, int year, int month, int day,
+            double hour, double height_start, double height_end,
+            double height_step, double *tec_bottom, double *tec_top);
+
+/**
+ * @brief Calculate a map of vertical TEC, using multiple worker processes
+ *
+ * Evaluates `iri_tec()` at every (latitude, longitude) node of a grid at
+ * one time. Outputs are latitude-major: cell (i, j) is at index
+ * `i * num_longitudes + j`.
+ *
+ * @param num_latitudes   Number of grid latitudes
+ * @param latitude        Grid latitudes in degrees North
+ * @param num_longitudes  Number of grid longitudes
+ * @param longitude       Grid longitudes in degrees East
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param height_start    Lower integration limit in km
+ * @param height_end      Upper integration limit in km
+ * @param height_step     Integration step in km
+ * @param num_workers  Number of worker processes (<= 0 for one per processor)
+ * @param tec_bottom   Output array of `num_latitudes * num_longitudes` TEC
+ *                     values below hmF2 in m-2
+ * @param tec_top      Output array of `num_latitudes * num_longitudes` TEC
+ *                     values above hmF2 in m-2
+ *
+ * @return 0 on success, non-zero if any cell failed
+ */
+int iri_tec_grid(size_t num_latitudes, const double latitude[],
+                 size_t num_longitudes, const double longitude[], int year,
+                 int month, int day, double hour, double height_start,
+                 double height_end, double height_step, int num_workers,
+                 double *tec_bottom, double *tec_top);
+
+/**
+ * @brief Calculate the slant TEC along a straight ray
+ *
+ * The ray starts on the ground (a sphere of radius `EARTH_RADIUS`) and is
+ * sampled at the midpoints of equal steps of at most `step`; a sample at
+ * slant distance s has the height and ground range
+ *
+ *     h = sqrt(R^2 + s^2 + 2 R s sin(elevation)) - R
+ *     d = R atan2(s cos(elevation), R + s sin(elevation))
+ *
+ * and its position is `r2g(d, bearing, ...)`. Instead of calling IRI at
+ * every sample, Ne profiles are computed at ground ranges that are
+ * multiples of `profile_spacing` along the beam, and Ne is interpolated
+ * linearly between the two neighbouring profiles and in height. Sampling
+ * stops where the ray leaves `IRI_SLANT_HEIGHT_END`.
+ *
+ * @param latitude   Latitude of the start of the ray in degrees North
+ * @param longitude  Longitude of the start of the ray in degrees East
+ * @param bearing    Bearing (azimuth) of the ray in degrees
+ * @param elevation  Elevation of the ray in degrees (0-90)
+ * @param range      Length of the ray in km
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param step       Maximum integration step along the ray in km
+ * @param profile_spacing  Ground distance between Ne profiles in km
+ * @param tec        Output slant TEC in m-2
+ * @param num_profiles  Output number of IRI profiles computed (or NULL)
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_slant_tec(double latitude, double longitude, double bearing,
+                  double elevation, double range, int year, int month,
+                  int day, double hour, double step, double profile_spacing,
+                  double *tec, int *num_profiles);
+
+/**
+ * @brief Calculate the slant TEC along many beams from one site, using
+ * multiple worker processes
+ *
+ * Same as `iri_slant_tec()` for each (bearing, elevation, range), e.g. the
+ * beams of a radar scan, at one time.
+ *
+ * @param num_beams  Number of beams
+ * @param latitude   Latitude of the site in degrees North
+ * @param longitude  Longitude of the site in degrees East
+ * @param bearing    Bearings of the beams in degrees
+ * @param elevation  Elevations of the beams in degrees (0-90)
+ * @param range      Lengths of the beams in km
+ * @param year       Year (4 digits)
+ * @param month      Month (1-12)
+ * @param day        Day of month (1-31)
+ * @param hour       Local time (or Universal time + 25) in decimal hours
+ * @param step       Maximum integration step along the beams in km
+ * @param profile_spacing  Ground distance between Ne profiles in km
+ * @param num_workers  Number of worker processes (<= 0 for one per processor)
+ * @param tec        Output array of `num_beams` slant TEC values in m-2
+ *
+ * @return 0 on success, non-zero if any beam failed
+ */
+int iri_slant_tec_scan(size_t num_beams, double latitude, double longitude,
+                       const double bearing[], const double elevation[],
+                       const double range[], int year, int month, int day,
+                       double hour, double step, double profile_spacing,
+                       int num_workers, double *tec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRI_TEC_H */
@@ -0,0 +1,358 @@
+/**
+ * @file
+ * @brief Implementation of the output writers for IRI profiles
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "iri_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+
+/* Points per block of `iri_profiles_write()` by default */
+#define DEFAULT_BLOCK_SIZE 256
+
+struct iri_writer {
+  FILE *fp;
+  int is_stdout;
+  enum iri_format format;
+  int value_size;
+  unsigned columns;
+  int num_heights;
+  size_t num_profiles; /* Announced (columnar) */
+  size_t written;      /* Profiles written so far */
+  int error;
+  unsigned char *buf; /* Conversion buffer of one column of one profile */
+};
+
+static int host_is_little_endian(void) {
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+/* Store `n` values as little-endian float32 or float64 */
+static void put_values(unsigned char *out, const double *values, size_t n,
+                       int value_size) {
+  int swap = !host_is_little_endian();
+  for (size_t i = 0; i < n; i++) {
+    unsigned char bytes[8];
+    if (value_size == 4) {
+      float f = (float)values[i];
+      memcpy(bytes, &f, 4);
+    } else {
+      memcpy(bytes, &values[i], 8);
+    }
+    for (int b = 0; b < value_size; b++) {
+      out[i * value_size + b] = bytes[swap ? value_size - 1 - b : b];
+    }
+  }
+}
+
+/* Store an integer field as little-endian */
+static void put_uint(unsigned char *out, uint64_t v, int size) {
+  for (int b = 0; b < size; b++) {
+    out[b] = (unsigned char)(v >> (8 * b));
+  }
+}
+
+int iri_parse_columns(const char *list, unsigned *columns) {
+  *columns = 0;
+  const char *p = list;
+  while (*p != '\0') {
+    size_t len = strcspn(p, ",");
+    int found = 0;
+    if (len == 3 && strncasecmp(p, "all", 3) == 0) {
+      *columns |= IRI_COLUMNS_ALL;
+      found = 1;
+    }
+    for (int j = 0; j < NUM_PROFILE && !found; j++) {
+      /* Name without the unit */
+      const char *name = iri_column_name(j);
+      size_t name_len = strcspn(name, "(");
+      if (len > 0 && len == name_len && strncasecmp(p, name, len) == 0) {
+        *columns |= IRI_COLUMN(j);
+        found = 1;
+      }
+    }
+    if (!found) {
+      fprintf(stderr, "Error: Unknown column %.*s\n", (int)len, p);
+      return 1;
+    }
+    p += len;
+    if (*p == ',') {
+      p++;
+    }
+  }
+  if (*columns == 0) {
+    fprintf(stderr, "Error: No columns selected\n");
+    return 1;
+  }
+  return 0;
+}
+
+/* Write the file header, at the start of the file */
+static int write_header(struct iri_writer *w) {
+  unsigned char hdr[sizeof(struct iri_file_header)];
+  memset(hdr, 0, sizeof(hdr));
+  memcpy(hdr + offsetof(struct iri_file_header, magic), IRI_FILE_MAGIC,
+         sizeof(IRI_FILE_MAGIC));
+  put_uint(hdr + offsetof(struct iri_file_header, version), IRI_FILE_VERSION,
+           4);
+  put_uint(hdr + offsetof(struct iri_file_header, format), w->format, 4);
+  put_uint(hdr + offsetof(struct iri_file_header, value_size), w->value_size,
+           4);
+  put_uint(hdr + offsetof(struct iri_file_header, columns), w->columns, 4);
+  put_uint(hdr + offsetof(struct iri_file_header, num_heights),
+           w->num_heights, 4);
+  put_uint(hdr + offsetof(struct iri_file_header, num_profiles),
+           w->format == IRI_FORMAT_COLUMNAR ? w->num_profiles : w->written,
+           8);
+  return fwrite(hdr, sizeof(hdr), 1, w->fp) != 1;
+}
+
+/* Write the CSV header row */
+static int write_csv_header(struct iri_writer *w) {
+  int first = 1;
+  for (int j = 0; j < NUM_PROFILE; j++) {
+    if (w->columns & IRI_COLUMN(j)) {
+      fprintf(w->fp, "%s%s", first ? "" : ",", iri_column_name(j));
+      first = 0;
+    }
+  }
+  return fputc('\n', w->fp) == EOF;
+}
+
+struct iri_writer *iri_writer_open(const char *filename,
+                                   enum iri_format format, int value_size,
+                                   unsigned columns, int num_heights,
+                                   size_t num_profiles) {
+  columns &= IRI_COLUMNS_ALL;
+  if (format < IRI_FORMAT_CSV || format > IRI_FORMAT_CHUNKED ||
+      (value_size != 4 && value_size != 8) || columns == 0 ||
+      num_heights < 1 || num_heights > MAX_HEIGHT) {
+    fprintf(stderr, "Error: Invalid writer parameters\n");
+    return NULL;
+  }
+  if (format == IRI_FORMAT_COLUMNAR &&
+      (filename == NULL || num_profiles == 0)) {
+    fprintf(stderr,
+            "Error: The columnar format needs a file and the number of "
+            "profiles\n");
+    return NULL;
+  }
+
+  struct iri_writer *w = calloc(1, sizeof(*w));
+  if (w == NULL) {
+    return NULL;
+  }
+  w->format = format;
+  w->value_size = value_size;
+  w->columns = columns;
+  w->num_heights = num_heights;
+  w->num_profiles = num_profiles;
+  w->buf = malloc((size_t)num_heights * value_size);
+  if (w->buf == NULL) {
+    free(w);
+    return NULL;
+  }
+
+  if (filename != NULL) {
+    w->fp = fopen(filename, format == IRI_FORMAT_CSV ? "w" : "wb");
+  } else {
+    w->fp = stdout;
+    w->is_stdout = 1;
+  }
+  if (w->fp == NULL) {
+    fprintf(stderr, "Error opening file %s for writing\n", filename);
+    free(w->buf);
+    free(w);
+    return NULL;
+  }
+
+  w->error = format == IRI_FORMAT_CSV ? write_csv_header(w) : write_header(w);
+  return w;
+}
+
+/* Write one column of one profile */
+static void write_column(struct iri_writer *w, const double *values) {
+  put_values(w->buf, values, w->num_heights, w->value_size);
+  if (fwrite(w->buf, w->value_size, w->num_heights, w->fp) !=
+      (size_t)w->num_heights) {
+    w->error = 1;
+  }
+}
+
+/* Write profiles as CSV rows, with a blank line between profiles */
+static void write_csv(struct iri_writer *w, size_t num_profiles,
+                      const double *values) {
+  char line[NUM_PROFILE * 16 + 2];
+  for (size_t i = 0; i < num_profiles; i++) {
+    const double *profile = values + i * NUM_PROFILE * w->num_heights;
+    if (w->written + i > 0) {
+      fputc('\n', w->fp);
+    }
+    for (int k = 0; k < w->num_heights; k++) {
+      int len = 0;
+      for (int j = 0; j < NUM_PROFILE; j++) {
+        if (w->columns & IRI_COLUMN(j)) {
+          double v = profile[j * w->num_heights + k];
+          if (len > 0) {
+            line[len++] = ',';
+          }
+          len += snprintf(line + len, sizeof(line) - len,
+                          v == -1.0 ? "%.1e" : "%.6e", v);
+        }
+      }
+      line[len++] = '\n';
+      if (fwrite(line, 1, len, w->fp) != (size_t)len) {
+        w->error = 1;
+      }
+    }
+  }
+}
+
+int iri_writer_write(struct iri_writer *w, size_t num_profiles,
+                     const double *values) {
+  if (w == NULL || w->error) {
+    return 1;
+  }
+  size_t column_size = (size_t)w->num_heights * w->value_size;
+
+  switch (w->format) {
+  case IRI_FORMAT_CSV:
+    write_csv(w, num_profiles, values);
+    break;
+
+  case IRI_FORMAT_RAW:
+    for (size_t i = 0; i < num_profiles; i++) {
+      for (int j = 0; j < NUM_PROFILE; j++) {
+        if (w->columns & IRI_COLUMN(j)) {
+          write_column(w, values + (i * NUM_PROFILE + j) * w->num_heights);
+        }
+      }
+    }
+    break;
+
+  case IRI_FORMAT_COLUMNAR:
+    if (w->written + num_profiles > w->num_profiles) {
+      fprintf(stderr, "Error: More profiles than announced\n");
+      w->error = 1;
+      break;
+    }
+    /* Each column's slice for these profiles is contiguous in the file */
+    for (int j = 0, c = 0; j < NUM_PROFILE; j++) {
+      if (!(w->columns & IRI_COLUMN(j))) {
+        continue;
+      }
+      off_t offset = sizeof(struct iri_file_header) +
+                     ((off_t)c * w->num_profiles + w->written) * column_size;
+      if (fseeko(w->fp, offset, SEEK_SET) != 0) {
+        w->error = 1;
+        break;
+      }
+      for (size_t i = 0; i < num_profiles; i++) {
+        write_column(w, values + (i * NUM_PROFILE + j) * w->num_heights);
+      }
+      c++;
+    }
+    break;
+
+  case IRI_FORMAT_CHUNKED: {
+    unsigned char hdr[sizeof(struct iri_chunk_header)];
+    memset(hdr, 0, sizeof(hdr));
+    put_uint(hdr + offsetof(struct iri_chunk_header, first_profile),
+             w->written, 8);
+    put_uint(hdr + offsetof(struct iri_chunk_header, num_profiles),
+             num_profiles, 4);
+    if (fwrite(hdr, sizeof(hdr), 1, w->fp) != 1) {
+      w->error = 1;
+    }
+    for (int j = 0; j < NUM_PROFILE; j++) {
+      if (w->columns & IRI_COLUMN(j)) {
+        for (size_t i = 0; i < num_profiles; i++) {
+          write_column(w, values + (i * NUM_PROFILE + j) * w->num_heights);
+        }
+      }
+    }
+    break;
+  }
+  }
+
+  w->written += num_profiles;
+  return w->error;
+}
+
+int iri_writer_close(struct iri_writer *w) {
+  if (w == NULL) {
+    return 1;
+  }
+  int status = w->error;
+
+  if (w->format == IRI_FORMAT_COLUMNAR && w->written != w->num_profiles) {
+    fprintf(stderr, "Error: Wrote %zu of %zu profiles\n", w->written,
+            w->num_profiles);
+    status = 1;
+  }
+  /* Record the number of profiles, if the file is seekable */
+  if (w->format != IRI_FORMAT_CSV && w->format != IRI_FORMAT_COLUMNAR &&
+      status == 0 && fseeko(w->fp, 0, SEEK_SET) == 0) {
+    status = write_header(w);
+  }
+
+  if (w->is_stdout) {
+    status |= fflush(w->fp) != 0;
+  } else {
+    status |= fclose(w->fp) != 0;
+  }
+  if (status != 0) {
+    fprintf(stderr, "Error writing profiles\n");
+  }
+  free(w->buf);
+  free(w);
+  return status;
+}
+
+int iri_profiles_write(size_t num_points, const double latitude[],
+                       const double longitude[], const int year[],
+                       const int month[], const int day[], const double hour[],
+                       double height_start, double height_end,
+                       double height_step, int num_workers, size_t block_size,
+                       struct iri_writer *writer) {
+  int num_heights = iri_num_heights(height_start, height_end, height_step);
+  if (writer == NULL || num_heights != writer->num_heights) {
+    fprintf(stderr, "Error: Writer does not match the heights\n");
+    return 1;
+  }
+  if (block_size == 0) {
+    block_size = DEFAULT_BLOCK_SIZE;
+  }
+  if (block_size > num_points) {
+    block_size = num_points;
+  }
+
+  double *values =
+      malloc(block_size * NUM_PROFILE * num_heights * sizeof(double));
+  if (values == NULL && num_points > 0) {
+    return 1;
+  }
+
+  int status = 0;
+  for (size_t begin = 0; begin < num_points; begin += block_size) {
+    size_t n = num_points - begin < block_size ? num_points - begin
+                                                : block_size;
+    status |= iri_profiles_batch_select(
+        n, latitude + begin, longitude + begin, year + begin, month + begin,
+        day + begin, hour + begin, height_start, height_end, height_step,
+        writer->columns, num_workers, values);
+    if (iri_writer_write(writer, n, values) != 0) {
+      status = 1;
+      break;
+    }
+  }
+
+  free(values);
+  return status;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file
+ * @brief Output writers for IRI profiles
+ *
+ * A writer takes profiles in the layout of `iri_profiles_batch()` (point by
+ * point, each point holding `NUM_PROFILE` rows of `num_heights` values) as
+ * they are computed, and writes a subset of the columns in one of these
+ * formats:
+ *
+ * - `IRI_FORMAT_CSV`: text, like `iri_write_csv()`, with a blank line
+ *   between profiles
+ * - `IRI_FORMAT_RAW`: binary, profile by profile: for each profile, for each
+ *   written column, `num_heights` values
+ * - `IRI_FORMAT_COLUMNAR`: binary, one contiguous array per written column,
+ *   holding `num_profiles * num_heights` values profile by profile (the
+ *   number of profiles must be given up front)
+ * - `IRI_FORMAT_CHUNKED`: binary, one chunk per write: a
+ *   `struct iri_chunk_header`, then for each written column the
+ *   `num_profiles * num_heights` values of the chunk's profiles
+ *
+ * Binary files start with a `struct iri_file_header`, and all binary
+ * numbers (header fields and float32 or float64 values) are little-endian.
+ * Missing values are -1, as in the profiles.
+ */
+
+#ifndef IRI_WRITER_H
+#define IRI_WRITER_H
+
+#include "iri_interface.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Magic string at the start of binary files, with the terminating NUL */
+#define IRI_FILE_MAGIC "IRIPROF"
+
+/* Binary file format version */
+#define IRI_FILE_VERSION 1
+
+/* Output formats */
+enum iri_format {
+  IRI_FORMAT_CSV = 0,
+  IRI_FORMAT_RAW = 1,
+  IRI_FORMAT_COLUMNAR = 2,
+  IRI_FORMAT_CHUNKED = 3,
+};
+
+/* Header of binary files (64 bytes) */
+struct iri_file_header {
+  char magic[8];         /* IRI_FILE_MAGIC */
+  uint32_t version;      /* IRI_FILE_VERSION */
+  uint32_t format;       /* enum iri_format */
+  uint32_t value_size;   /* 4 (float32) or 8 (float64) */
+  uint32_t columns;      /* IRI_COLUMN(j) set if column j is written */
+  uint32_t num_heights;  /* Values per column per profile */
+  uint32_t reserved;     /* Zero */
+  uint64_t num_profiles; /* Number of profiles (0 if the file was written to
+                            a pipe: read to the end) */
+  uint8_t padding[24];   /* Zero */
+};
+
+/* Header of each chunk of `IRI_FORMAT_CHUNKED` files (16 bytes) */
+struct iri_chunk_header {
+  uint64_t first_profile; /* Index of the chunk's first profile */
+  uint32_t num_profiles;  /* Number of profiles in the chunk */
+  uint32_t reserved;      /* Zero */
+};
+
+/* Writer state (opaque) */
+struct iri_writer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Parse a comma-separated list of column names
+ *
+ * Names are matched without their unit and ignoring case, e.g.
+ * "height,ne,Te"; "all" selects all columns.
+ *
+ * @param list     Comma-separated names
+ * @param columns  Output `IRI_COLUMN()` bits
+ *
+ * @return 0 on success, non-zero on an unknown name (reported on stderr)
+ */
+int iri_parse_columns(const char *list, unsigned *columns);
+
+/**
+ * @brief Open a writer
+ *
+ * @param filename      Output filename, or NULL for stdout (not for
+ *                      `IRI_FORMAT_COLUMNAR`)
+ * @param format        Output format
+ * @param value_size    4 for float32 or 8 for float64 values (binary only)
+ * @param columns       `IRI_COLUMN()` bits of the columns to write
+ * @param num_heights   Number of heights per profile
+ * @param num_profiles  Total number of profiles (required for
+ *                      `IRI_FORMAT_COLUMNAR`, otherwise 0 if unknown)
+ *
+ * @return Writer, or NULL on error (reported on stderr)
+ */
+struct iri_writer *iri_writer_open(const char *filename,
+                                   enum iri_format format, int value_size,
+                                   unsigned columns, int num_heights,
+                                   size_t num_profiles);
+
+/**
+ * @brief Write the next profiles
+ *
+ * @param writer        Writer
+ * @param num_profiles  Number of profiles
+ * @param values        Profiles in the layout of `iri_profiles_batch()`
+ *
+ * @return 0 on success, non-zero on error
+ */
+int iri_writer_write(struct iri_writer *writer, size_t num_profiles,
+                     const double *values);
+
+/**
+ * @brief Finish the file and free the writer
+ *
+ * @param writer  Writer
+ *
+ * @return 0 on success, non-zero on error (including fewer profiles than
+ * announced for `IRI_FORMAT_COLUMNAR`)
+ */
+int iri_writer_close(struct iri_writer *writer);
+
+/**
+ * @brief Calculate vertical profiles for many points and write them as
+ * they finish
+ *
+ * Same as `iri_profiles_batch_select()` with the writer's columns, but the
+ * points are computed in blocks of `block_size`, each written before the
+ * next one starts, so memory use does not grow with the number of points.
+ *
+ * @param num_points   Number of points
+ * @param latitude     Latitudes in degrees North
+ * @param longitude    Longitudes in degrees East
+ * @param year         Years (4 digits)
+ * @param month        Months (1-12)
+ * @param day          Days of month (1-31)
+ * @param hour         Local times (or Universal times + 25) in decimal hours
+ * @param height_start    Start height in km
+ * @param height_end      End height in km
+ * @param height_step     Height step in km
+ * @param num_workers  Number of worker processes (<= 0 for one per processor)
+ * @param block_size   Number of points per block (0 for a default)
+ * @param writer       Writer opened with `iri_num_heights()` heights
+ *
+ * @return 0 on success, non-zero if any point failed or a write failed
+ */
+int iri_profiles_write(size_t num_points, const double latitude[],
+                       const double longitude[], const int year[],
+                       const int month[], const int day[], const double hour[],
+                       double height_start, double height_end,
+                       double height_step, int num_workers, size_t block_size,
+                       struct iri_writer *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRI_WRITER_H */
@@ -0,0 +1,260 @@
+#!/usr/bin/env -S uv run --script
+"""
+Test the Python module (src/iri_edp, `make python`): its profiles against
+the CSV of `iri -c 1` and `-c 2`, the worker, column, stride and type
+variants against each other, g2r and r2g on arrays against single points,
+and the errors. Run by `make test-python`.
+"""
+# /// script
+# dependencies = [
+#   "numpy",
+# ]
+# ///
+
+from __future__ import annotations
+
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+import numpy as np
+
+HERE = Path(__file__).parent
+SRC = HERE / "src"
+
+# The two cases of `iri -c`: latitude, longitude, year, month, day, hour
+CASES = [(37.8, -75.4, 2021, 3, 3, 11.0 + 25.0), (37.8, -75.4, 2021, 3, 4, 23.0 + 25.0)]
+HEIGHTS = (70.0, 600.0, 10.0)
+
+failures = 0
+
+
+def check(ok: bool, what: str) -> None:
+    global failures
+    if not ok:
+        failures += 1
+        print(f"FAILED: {what}")
+
+
+def raises(error: type, what: str, fn, *args, **kwargs) -> None:
+    try:
+        fn(*args, **kwargs)
+    except error:
+        return
+    except Exception as e:
+        check(False, f"{what}: {type(e).__name__} instead of {error.__name__}")
+        return
+    check(False, f"{what}: no {error.__name__}")
+
+
+def iri_csv(case: int) -> np.ndarray:
+    """The CSV of `iri -c`, as (13, heights)."""
+    with tempfile.TemporaryDirectory() as tmp:
+        path = Path(tmp) / "out.csv"
+        subprocess.run(
+            ["./iri", "-c", str(case), "-o", str(path)],
+            cwd=SRC,
+            capture_output=True,
+            check=True,
+        )
+        return np.loadtxt(path, delimiter=",", skiprows=1).T
+
+
+def test_profiles(m) -> None:
+    print("Testing the profiles...")
+    lat, lon, year, month, day, hour = (np.array(v) for v in zip(*CASES))
+
+    # Each case as scalars, and both at once, against the CSV's 6 digits
+    z = m.iri_profiles(lat, lon, year, month, day, hour, *HEIGHTS)
+    check(z.shape == (2, m.NUM_PROFILE, 54), f"shape {z.shape}")
+    for i, case in enumerate(CASES):
+        csv = iri_csv(i + 1)
+        single = m.iri_profiles(*case, *HEIGHTS)
+        check(single.shape == csv.shape, f"case {i + 1} shape {single.shape}")
+        diff = np.max(np.abs(single - csv) / np.maximum(np.abs(csv), 1e-300))
+        check(diff < 1e-5, f"case {i + 1} against the CSV: {diff:.1e}")
+        check(np.array_equal(z[i], single), f"case {i + 1} in an array")
+
+    # Worker processes, and the same heights as an array
+    n = 6
+    lat6, hour6 = np.linspace(30.0, 45.0, n), np.linspace(25.0, 49.0, n)
+    serial = m.iri_profiles(lat6, -75.4, 2021, 3, 3, hour6, *HEIGHTS)
+    for workers in (2, 0):
+        batch = m.iri_profiles(
+            lat6, -75.4, 2021, 3, 3, hour6, *HEIGHTS, workers=workers
+        )
+        check(np.array_equal(batch, serial), f"workers={workers}")
+    heights = m.iri_heights(*HEIGHTS)
+    check(np.array_equal(heights, serial[0, 0]), "iri_heights")
+    check(
+        np.array_equal(
+            m.iri_profiles_heights(lat6, -75.4, 2021, 3, 3, hour6, heights),
+            serial,
+        ),
+        "iri_profiles_heights",
+    )
+
+    # Columns not selected are -1, the others the same
+    for columns in ("height,ne,Te", (1 << 0) | (1 << 1) | (1 << 4)):
+        for workers in (1, 2):
+            some = m.iri_profiles(
+                lat6, -75.4, 2021, 3, 3, hour6, *HEIGHTS,
+                columns=columns, workers=workers,
+            )
+            kept = [0, 1, 4]
+            others = [j for j in range(m.NUM_PROFILE) if j not in kept]
+            check(
+                np.array_equal(some[:, kept], serial[:, kept]),
+                f"columns={columns!r} workers={workers}",
+            )
+            check(
+                np.all(some[:, others] == -1.0),
+                f"columns={columns!r} workers={workers}: -1 rows",
+            )
+
+    # Strided arrays and other number types are read as the float64 ones
+    wide = np.zeros(2 * n)
+    wide[::2] = lat6
+    typed = m.iri_profiles(
+        wide[::2],
+        np.full(n, -75, dtype=np.int16),
+        np.full(n, 2021, dtype=np.int64),
+        np.full(n, 3, dtype=np.uint8),
+        np.float32(3.0),
+        hour6[::-1][::-1],
+        *HEIGHTS,
+    )
+    integer_lon = m.iri_profiles(lat6, -75.0, 2021, 3, 3, hour6, *HEIGHTS)
+    check(np.array_equal(typed, integer_lon), "strided and integer inputs")
+
+    # out= is written to and returned
+    out = np.empty_like(serial)
+    result = m.iri_profiles(lat6, -75.4, 2021, 3, 3, hour6, *HEIGHTS, out=out)
+    check(result is out and np.array_equal(out, serial), "out=")
+
+
+def test_profile_errors(m) -> None:
+    print("Testing the profile errors...")
+    args = (37.8, -75.4, 2021, 3, 3, 36.0)
+    raises(ValueError, "lengths", m.iri_profiles,
+           np.zeros(2), np.zeros(3), 2021, 3, 3, 36.0, *HEIGHTS)
+    raises(TypeError, "two-dimensional", m.iri_profiles,
+           np.zeros((2, 2)), -75.4, 2021, 3, 3, 36.0, *HEIGHTS)
+    raises(TypeError, "string", m.iri_profiles, "x", *args[1:], *HEIGHTS)
+    raises(ValueError, "heights", m.iri_profiles, *args, 600.0, 70.0, 10.0)
+    raises(ValueError, "step", m.iri_profiles, *args, 70.0, 600.0, 0.0)
+    raises(ValueError, "columns", m.iri_profiles, *args, *HEIGHTS,
+           columns="height,x")
+    raises(ValueError, "column mask", m.iri_profiles, *args, *HEIGHTS,
+           columns=1 << m.NUM_PROFILE)
+    raises(ValueError, "workers and heights", m.iri_profiles, np.zeros(2),
+           *args[1:], 0.0, 10.0 * m.MAX_HEIGHT, 10.0, workers=2)
+
+    shape = (m.NUM_PROFILE, 54)
+    for out, what in [
+        (np.empty((m.NUM_PROFILE, 53)), "out= size"),
+        (np.empty(shape, dtype=np.float32), "out= type"),
+        (np.empty((m.NUM_PROFILE, 108))[:, ::2], "out= strides"),
+    ]:
+        raises(ValueError, what, m.iri_profiles, *args, *HEIGHTS, out=out)
+    readonly = np.empty(shape)
+    readonly.flags.writeable = False
+    raises(ValueError, "read-only out=", m.iri_profiles, *args, *HEIGHTS,
+           out=readonly)
+
+    # Dates: invalid, not integers, and outside the data files
+    for year, month, day in [
+        (2021, 0, 3), (2021, 13, 3), (2021, 2, 29), (2021, 4, 31),
+        (float("nan"), 3, 3), (1e300, 3, 3), (2021, float("inf"), 3),
+        (1900, 3, 3), (2100, 3, 3),
+    ]:
+        for workers in (1, 2):
+            raises(ValueError, f"date {year}-{month}-{day} workers={workers}",
+                   m.iri_profiles, np.array([37.8, 37.8]), -75.4,
+                   np.array([2021, year]), month, day, 36.0, *HEIGHTS,
+                   workers=workers)
+    check(m.iri_profiles(37.8, -75.4, 2020, 2, 29, 36.0, *HEIGHTS).shape
+          == shape, "leap day")
+
+
+def test_conversions(m) -> None:
+    print("Testing g2r and r2g...")
+    rng = np.random.default_rng(1)
+    n = 1000
+    lon, lat = rng.uniform(-180, 180, n), rng.uniform(-89, 89, n)
+    rng_km, bearing = rng.uniform(0, 3000, n), rng.uniform(0, 360, n)
+    for wgs84 in (False, True):
+        # One initial point (the batch functions), against single points
+        # (the point functions) and arrays of initial points
+        ranges, bearings = m.g2r(-75.4, 37.8, lon, lat, wgs84=wgs84)
+        lons, lats = m.r2g(rng_km, bearing, -75.4, 37.8, wgs84=wgs84)
+        single = np.array(
+            [m.g2r(-75.4, 37.8, lon[i], lat[i], wgs84=wgs84) for i in range(n)]
+        )
+        valid = ~np.isnan(single[:, 0])
+        check(np.array_equal(np.isnan(ranges), ~valid), f"g2r NaN {wgs84}")
+        check(
+            np.allclose(ranges[valid], single[valid, 0], rtol=1e-12, atol=1e-9)
+            and np.allclose(bearings[valid], single[valid, 1], atol=1e-9),
+            f"g2r arrays wgs84={wgs84}",
+        )
+        single = np.array(
+            [m.r2g(rng_km[i], bearing[i], -75.4, 37.8, wgs84=wgs84)
+             for i in range(n)]
+        )
+        check(
+            np.allclose(lons, single[:, 0], atol=1e-9)
+            and np.allclose(lats, single[:, 1], atol=1e-9),
+            f"r2g arrays wgs84={wgs84}",
+        )
+        per_point = m.r2g(rng_km, bearing, np.full(n, -75.4), np.full(n, 37.8),
+                          wgs84=wgs84)
+        check(np.array_equal(per_point[0], single[:, 0])
+              and np.array_equal(per_point[1], single[:, 1]),
+              f"r2g initial arrays wgs84={wgs84}")
+
+        # Back to the ranges and bearings
+        back = m.g2r(-75.4, 37.8, lons, lats, wgs84=wgs84)
+        turn = np.abs((back[1] - bearing + 180.0) % 360.0 - 180.0)
+        check(np.max(np.abs(back[0] - rng_km)) < 1e-6 and np.max(turn) < 1e-6,
+              f"round trip wgs84={wgs84}")
+
+        # out= of strided inputs, and other number types
+        out = (np.empty(n), np.empty(n))
+        wide = np.zeros((n, 2))
+        wide[:, 0] = lon
+        result = m.g2r(-75.4, 37.8, wide[:, 0], lat, wgs84=wgs84, out=out)
+        check(result[0] is out[0] and result[1] is out[1]
+              and np.array_equal(out[0], ranges, equal_nan=True),
+              f"g2r out= wgs84={wgs84}")
+        integer = m.g2r(-75, 37, np.array([-70, 10], dtype=np.int32), 40,
+                        wgs84=wgs84)
+        check(np.allclose(integer[0], [m.g2r(-75, 37, -70, 40, wgs84=wgs84)[0],
+                                       m.g2r(-75, 37, 10, 40, wgs84=wgs84)[0]]),
+              f"g2r integer inputs wgs84={wgs84}")
+
+    raises(ValueError, "conversion lengths", m.g2r, 0.0, 0.0, np.zeros(2),
+           np.zeros(3))
+    raises(TypeError, "out= of one array", m.g2r, 0.0, 0.0, np.zeros(2),
+           np.zeros(2), out=np.empty(2))
+    raises(ValueError, "out= size", m.r2g, np.zeros(2), 0.0, 0.0, 0.0,
+           out=(np.empty(2), np.empty(3)))
+
+
+def main() -> None:
+    sys.path.insert(0, str(SRC))
+    import iri_edp
+
+    iri_edp.init(str(SRC))
+    test_profiles(iri_edp)
+    test_profile_errors(iri_edp)
+    test_conversions(iri_edp)
+    if failures:
+        print(f"Test FAILED: {failures} failures")
+        sys.exit(1)
+    print("Test PASSED")
+
+
+if __name__ == "__main__":
+    main()